@@ -28,7 +28,9 @@
 #include "dnscache.h"
 #include "alarms.h"
 #include "stats/stats-registry.h"
+#include "stats/stats-counter.h"
 #include "logmsg/logmsg.h"
+#include "logmsg/logmsg-pool.h"
 #include "timeutils.h"
 #include "logsource.h"
 #include "logwriter.h"
@@ -128,6 +130,8 @@ app_startup(void)
   child_manager_init();
   alarm_init();
   stats_init();
+  stats_counter_thread_init();
+  log_msg_pool_thread_init();
   tzset();
   log_msg_global_init();
   log_tags_global_init();
@@ -165,6 +169,8 @@ app_shutdown(void)
   log_tags_global_deinit();
   log_msg_global_deinit();
 
+  log_msg_pool_thread_deinit();
+  stats_counter_thread_deinit();
   stats_destroy();
   child_manager_deinit();
   g_list_foreach(application_hooks, (GFunc) g_free, NULL);
@@ -195,11 +201,15 @@ app_thread_start(void)
   scratch_buffers_init();
   dns_caching_thread_init();
   main_loop_call_thread_init();
+  stats_counter_thread_init();
+  log_msg_pool_thread_init();
 }
 
 void
 app_thread_stop(void)
 {
+  log_msg_pool_thread_deinit();
+  stats_counter_thread_deinit();
   dns_caching_thread_deinit();
   scratch_buffers_free();
   main_loop_call_thread_deinit();
@@ -190,6 +190,7 @@ extern struct _StatsOptions *last_stats_options;
 %token KW_MARK_MODE                   10081
 %token KW_ENCODING                    10082
 %token KW_TYPE                        10083
+%token KW_MSG_POOL_SIZE               10084
 
 %token KW_CHAIN_HOSTNAMES             10090
 %token KW_NORMALIZE_HOSTNAMES         10091
@@ -327,6 +328,8 @@ extern struct _StatsOptions *last_stats_options;
 %token KW_ON_ERROR                    10510
 
 %token KW_RETRIES                     10511
+%token KW_WORKERS                     10512
+%token KW_WORKER_PARTITION_KEY        10513
 
 /* END_DECLS */
 
@@ -905,6 +908,11 @@ options_item
 	| KW_LOG_IW_SIZE '(' LL_NUMBER ')'	{ msg_error("Using a global log-iw-size() option was removed, please use a per-source log-iw-size()"); }
 	| KW_LOG_FETCH_LIMIT '(' LL_NUMBER ')'	{ msg_error("Using a global log-fetch-limit() option was removed, please use a per-source log-fetch-limit()"); }
 	| KW_LOG_MSG_SIZE '(' LL_NUMBER ')'	{ configuration->log_msg_size = $3; }
+	| KW_MSG_POOL_SIZE '(' LL_NUMBER ')'
+          {
+            CHECK_ERROR($3 >= 0, @3, "msg-pool-size() must not be negative");
+            configuration->msg_pool_size = $3;
+          }
 	| KW_KEEP_TIMESTAMP '(' yesno ')'	{ configuration->keep_timestamp = $3; }
 	| KW_CREATE_DIRS '(' yesno ')'		{ configuration->create_dirs = $3; }
         | KW_CUSTOM_DOMAIN '(' string ')'       { configuration->custom_domain = g_strdup($3); free($3); }
@@ -1089,6 +1097,16 @@ threaded_dest_driver_option
         {
           log_threaded_dest_driver_set_max_retries(last_driver, $3);
         }
+        | KW_WORKERS '(' LL_NUMBER ')'
+        {
+          log_threaded_dest_driver_set_num_workers(last_driver, $3);
+        }
+        | KW_WORKER_PARTITION_KEY '(' template_content ')'
+        {
+          log_threaded_dest_driver_set_worker_partition_key(last_driver, $3);
+          log_template_unref($3);
+        }
+        ;
 
 dest_driver_option
         /* NOTE: plugins need to set "last_driver" in order to incorporate this rule in their grammar */
@@ -29,6 +29,7 @@
 #include "template/templates.h"
 #include "userdb.h"
 #include "logmsg/logmsg.h"
+#include "logmsg/logmsg-pool.h"
 #include "dnscache.h"
 #include "serialize.h"
 #include "plugin.h"
@@ -206,6 +207,7 @@ cfg_init(GlobalConfig *cfg)
 
   stats_reinit(&cfg->stats_options);
   log_tags_reinit_stats(cfg);
+  log_msg_pool_set_max_size(cfg->msg_pool_size);
 
   dns_caching_update_options(&cfg->dns_cache_options);
   hostname_reinit(cfg->custom_domain);
@@ -304,6 +306,7 @@ cfg_new(gint version)
 
   self->log_fifo_size = 10000;
   self->log_msg_size = 8192;
+  self->msg_pool_size = LOG_MSG_POOL_DEFAULT_MAX_SIZE;
 
   file_perm_options_global_defaults(&self->file_perm_options);
 
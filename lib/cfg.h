@@ -92,6 +92,7 @@ struct _GlobalConfig
 
   gint log_fifo_size;
   gint log_msg_size;
+  gint msg_pool_size;
 
   gboolean create_dirs;
   FilePermOptions file_perm_options;
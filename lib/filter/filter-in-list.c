@@ -24,18 +24,442 @@
 
 #include "filter-in-list.h"
 #include "logmsg/logmsg.h"
-#include "str-utils.h"
 
 #include <errno.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+/*
+ * Set of strings, open addressing with linear probing.  Keys are stored
+ * back-to-back in a single arena and are compared by length first, so
+ * lookups work on the non-NUL-terminated values returned by
+ * log_msg_get_value() without copying them.
+ */
+typedef struct _InListSlot
+{
+  guint32 hash;
+  guint32 len;
+  /* offset in the arena, 0 means the slot is empty */
+  guint32 ofs;
+} InListSlot;
+
+typedef struct _InListStrings
+{
+  GString *arena;
+  InListSlot *slots;
+  guint32 mask;
+  guint32 num_keys;
+} InListStrings;
+
+static inline guint32
+_hash_string(const gchar *str, gsize len)
+{
+  guint32 h = 2166136261U;
+  gsize i;
+
+  /* FNV-1a */
+  for (i = 0; i < len; i++)
+    {
+      h ^= (guchar) str[i];
+      h *= 16777619U;
+    }
+  return h;
+}
+
+static InListSlot *
+_strings_find_slot(InListStrings *self, const gchar *str, gsize len, guint32 hash)
+{
+  guint32 i = hash & self->mask;
+
+  while (1)
+    {
+      InListSlot *slot = &self->slots[i];
+
+      if (slot->ofs == 0)
+        return slot;
+      if (slot->hash == hash && slot->len == len && memcmp(self->arena->str + slot->ofs, str, len) == 0)
+        return slot;
+      i = (i + 1) & self->mask;
+    }
+}
+
+static void
+_strings_resize(InListStrings *self, guint32 size)
+{
+  InListSlot *old_slots = self->slots;
+  guint32 old_size = self->mask + 1;
+  guint32 i;
+
+  self->slots = g_new0(InListSlot, size);
+  self->mask = size - 1;
+  for (i = 0; old_slots && i < old_size; i++)
+    {
+      if (old_slots[i].ofs)
+        *_strings_find_slot(self, self->arena->str + old_slots[i].ofs, old_slots[i].len, old_slots[i].hash) = old_slots[i];
+    }
+  g_free(old_slots);
+}
+
+static void
+_strings_insert(InListStrings *self, const gchar *str, gsize len)
+{
+  guint32 hash = _hash_string(str, len);
+  InListSlot *slot;
+
+  /* keep the load factor below 1/2 */
+  if ((self->num_keys + 1) * 2 > self->mask + 1)
+    _strings_resize(self, (self->mask + 1) * 2);
+
+  slot = _strings_find_slot(self, str, len, hash);
+  if (slot->ofs)
+    return;
+
+  slot->hash = hash;
+  slot->len = len;
+  slot->ofs = self->arena->len;
+  g_string_append_len(self->arena, str, len);
+  self->num_keys++;
+}
+
+static inline gboolean
+_strings_contains(InListStrings *self, const gchar *str, gsize len)
+{
+  return _strings_find_slot(self, str, len, _hash_string(str, len))->ofs != 0;
+}
+
+static void
+_strings_init(InListStrings *self)
+{
+  /* offset 0 is reserved to mark empty slots */
+  self->arena = g_string_new("");
+  g_string_append_c(self->arena, 0);
+  self->slots = NULL;
+  self->mask = 0;
+  self->num_keys = 0;
+  _strings_resize(self, 16);
+}
+
+static void
+_strings_destroy(InListStrings *self)
+{
+  g_string_free(self->arena, TRUE);
+  g_free(self->slots);
+}
+
+/*
+ * Binary prefix trie for IPv4/IPv6 networks, nodes are stored in an array
+ * and reference each other by index, index 0 being the root.
+ */
+typedef struct _InListTrieNode
+{
+  guint32 child[2];
+  gboolean terminal;
+} InListTrieNode;
+
+typedef struct _InListNetworks
+{
+  /* separate tries for AF_INET and AF_INET6 */
+  GArray *nodes[2];
+} InListNetworks;
+
+static inline gint
+_networks_family_index(gint family)
+{
+  return family == AF_INET ? 0 : 1;
+}
+
+static inline gint
+_address_bit(const guchar *addr, gint bit)
+{
+  return (addr[bit / 8] >> (7 - bit % 8)) & 1;
+}
+
+static void
+_networks_insert(InListNetworks *self, gint family, const guchar *addr, gint prefix_len)
+{
+  GArray *nodes = self->nodes[_networks_family_index(family)];
+  guint32 node = 0;
+  gint bit;
+
+  for (bit = 0; bit < prefix_len; bit++)
+    {
+      gint b = _address_bit(addr, bit);
+      guint32 next = g_array_index(nodes, InListTrieNode, node).child[b];
+
+      if (!next)
+        {
+          InListTrieNode empty = { { 0, 0 }, FALSE };
+
+          next = nodes->len;
+          g_array_append_val(nodes, empty);
+          g_array_index(nodes, InListTrieNode, node).child[b] = next;
+        }
+      node = next;
+    }
+  g_array_index(nodes, InListTrieNode, node).terminal = TRUE;
+}
+
+static gboolean
+_networks_contains(InListNetworks *self, gint family, const guchar *addr)
+{
+  GArray *nodes = self->nodes[_networks_family_index(family)];
+  gint addr_bits = family == AF_INET ? 32 : 128;
+  guint32 node = 0;
+  gint bit;
+
+  for (bit = 0; ; bit++)
+    {
+      InListTrieNode *n = &g_array_index(nodes, InListTrieNode, node);
+
+      if (n->terminal)
+        return TRUE;
+      if (bit >= addr_bits)
+        return FALSE;
+      node = n->child[_address_bit(addr, bit)];
+      if (!node)
+        return FALSE;
+    }
+}
+
+static void
+_networks_init(InListNetworks *self)
+{
+  InListTrieNode root = { { 0, 0 }, FALSE };
+  gint i;
+
+  for (i = 0; i < 2; i++)
+    {
+      self->nodes[i] = g_array_new(FALSE, FALSE, sizeof(InListTrieNode));
+      g_array_append_val(self->nodes[i], root);
+    }
+}
+
+static void
+_networks_destroy(InListNetworks *self)
+{
+  g_array_free(self->nodes[0], TRUE);
+  g_array_free(self->nodes[1], TRUE);
+}
+
+/* parses an IPv4/IPv6 address, @str does not need to be NUL terminated */
+static gboolean
+_parse_address(const gchar *str, gsize len, gint *family, guchar *addr)
+{
+  gchar buf[INET6_ADDRSTRLEN];
+
+  if (len == 0 || len >= sizeof(buf))
+    return FALSE;
+
+  memcpy(buf, str, len);
+  buf[len] = 0;
+  if (inet_pton(AF_INET, buf, addr) == 1)
+    {
+      *family = AF_INET;
+      return TRUE;
+    }
+  if (inet_pton(AF_INET6, buf, addr) == 1)
+    {
+      *family = AF_INET6;
+      return TRUE;
+    }
+  return FALSE;
+}
+
+/* parses "address/prefix-length" */
+static gboolean
+_parse_network(const gchar *str, gint *family, guchar *addr, gint *prefix_len)
+{
+  const gchar *slash = strchr(str, '/');
+  gchar *end;
+
+  if (!slash || !_parse_address(str, slash - str, family, addr))
+    return FALSE;
+
+  *prefix_len = strtol(slash + 1, &end, 10);
+  if (*end || end == slash + 1 || *prefix_len < 0 || *prefix_len > (*family == AF_INET ? 32 : 128))
+    return FALSE;
+  return TRUE;
+}
+
+/*
+ * The contents of a list file.  These are shared between filters
+ * referencing the same file and are looked up by filename when a filter
+ * is constructed, so that a configuration reload (SIGHUP) only rereads
+ * list files that changed on disk and reuses the rest.
+ *
+ * Lists are only constructed and freed while parsing and freeing the
+ * configuration, which happens in the main thread, so the cache needs no
+ * locking.
+ */
+typedef struct _InList
+{
+  gint ref_cnt;
+  gchar *filename;
+  dev_t st_dev;
+  ino_t st_ino;
+  off_t st_size;
+  time_t st_mtime;
+  glong st_mtime_nsec;
+
+  InListStrings strings;
+  InListNetworks networks;
+  gboolean has_networks;
+} InList;
+
+static GHashTable *in_list_cache;
+
+static void
+_in_list_add_line(InList *self, const gchar *line)
+{
+  guchar addr[16];
+  gint family, prefix_len;
+
+  /* networks are matched literally too */
+  _strings_insert(&self->strings, line, strlen(line));
+
+  if (_parse_network(line, &family, addr, &prefix_len))
+    {
+      _networks_insert(&self->networks, family, addr, prefix_len);
+      self->has_networks = TRUE;
+    }
+}
+
+/* files rewritten within the same second are only noticed with nanosecond resolution */
+static glong
+_get_mtime_nsec(struct stat *st)
+{
+#if SYSLOG_NG_HAVE_STRUCT_STAT_ST_MTIM
+  return st->st_mtim.tv_nsec;
+#else
+  return 0;
+#endif
+}
+
+static InList *
+_in_list_load(const gchar *list_file, struct stat *st)
+{
+  InList *self;
+  FILE *stream;
+  gchar line[16384];
+
+  stream = fopen(list_file, "r");
+  if (!stream)
+    {
+      msg_error("Error opening in-list filter list file",
+                evt_tag_str("file", list_file),
+                evt_tag_errno("errno", errno));
+      return NULL;
+    }
+
+  self = g_new0(InList, 1);
+  self->ref_cnt = 1;
+  self->filename = g_strdup(list_file);
+  self->st_dev = st->st_dev;
+  self->st_ino = st->st_ino;
+  self->st_size = st->st_size;
+  self->st_mtime = st->st_mtime;
+  self->st_mtime_nsec = _get_mtime_nsec(st);
+  _strings_init(&self->strings);
+  _networks_init(&self->networks);
+
+  while (fgets(line, sizeof(line), stream) != NULL)
+    {
+      gsize len = strlen(line);
+
+      if (len > 0 && line[len - 1] == '\n')
+        line[--len] = '\0';
+      if (line[0])
+        _in_list_add_line(self, line);
+    }
+  fclose(stream);
+
+  msg_debug("in-list filter list file loaded",
+            evt_tag_str("file", list_file),
+            evt_tag_int("strings", self->strings.num_keys),
+            evt_tag_int("networks", self->has_networks));
+  return self;
+}
+
+static gboolean
+_in_list_is_up_to_date(InList *self, struct stat *st)
+{
+  return self->st_dev == st->st_dev &&
+         self->st_ino == st->st_ino &&
+         self->st_size == st->st_size &&
+         self->st_mtime == st->st_mtime &&
+         self->st_mtime_nsec == _get_mtime_nsec(st);
+}
+
+static InList *
+_in_list_ref(InList *self)
+{
+  self->ref_cnt++;
+  return self;
+}
+
+static void
+_in_list_unref(InList *self)
+{
+  if (--self->ref_cnt > 0)
+    return;
+
+  if (in_list_cache && g_hash_table_lookup(in_list_cache, self->filename) == self)
+    g_hash_table_remove(in_list_cache, self->filename);
+  _strings_destroy(&self->strings);
+  _networks_destroy(&self->networks);
+  g_free(self->filename);
+  g_free(self);
+}
+
+static InList *
+_in_list_get(const gchar *list_file)
+{
+  struct stat st;
+  InList *self;
+
+  if (stat(list_file, &st) < 0)
+    {
+      msg_error("Error opening in-list filter list file",
+                evt_tag_str("file", list_file),
+                evt_tag_errno("errno", errno));
+      return NULL;
+    }
+
+  if (!in_list_cache)
+    in_list_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+  self = g_hash_table_lookup(in_list_cache, list_file);
+  if (self && _in_list_is_up_to_date(self, &st))
+    return _in_list_ref(self);
+
+  self = _in_list_load(list_file, &st);
+  if (self)
+    g_hash_table_replace(in_list_cache, g_strdup(list_file), self);
+  return self;
+}
+
+static gboolean
+_in_list_contains(InList *self, const gchar *value, gssize len)
+{
+  guchar addr[16];
+  gint family;
+
+  if (_strings_contains(&self->strings, value, len))
+    return TRUE;
+
+  if (self->has_networks && _parse_address(value, len, &family, addr))
+    return _networks_contains(&self->networks, family, addr);
+  return FALSE;
+}
 
 typedef struct _FilterInList
 {
   FilterExprNode super;
   NVHandle value_handle;
-  GTree *tree;
+  InList *list;
 } FilterInList;
 
 static gboolean
@@ -47,9 +471,8 @@ filter_in_list_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
   gssize len = 0;
 
   value = log_msg_get_value(msg, self->value_handle, &len);
-  APPEND_ZERO(value, value, len);
 
-  return (g_tree_lookup(self->tree, value) != NULL) ^ s->comp;
+  return _in_list_contains(self->list, value, len) ^ s->comp;
 }
 
 static void
@@ -57,37 +480,23 @@ filter_in_list_free(FilterExprNode *s)
 {
   FilterInList *self = (FilterInList *)s;
 
-  g_tree_destroy(self->tree);
+  _in_list_unref(self->list);
 }
 
 FilterExprNode *
 filter_in_list_new(const gchar *list_file, const gchar *property)
 {
   FilterInList *self;
-  FILE *stream;
-  gchar line[16384];
+  InList *list;
 
-  stream = fopen(list_file, "r");
-  if (!stream)
-    {
-      msg_error("Error opening in-list filter list file",
-                evt_tag_str("file", list_file),
-                evt_tag_errno("errno", errno));
-      return NULL;
-    }
+  list = _in_list_get(list_file);
+  if (!list)
+    return NULL;
 
   self = g_new0(FilterInList, 1);
   filter_expr_node_init_instance(&self->super);
   self->value_handle = log_msg_get_value_handle(property);
-  self->tree = g_tree_new_full((GCompareDataFunc)strcmp, NULL, g_free, NULL);
-
-  while (fgets(line, sizeof(line), stream) != NULL)
-    {
-      line[strlen(line) - 1] = '\0';
-      if (line[0])
-        g_tree_insert(self->tree, g_strdup(line), GINT_TO_POINTER(1));
-    }
-  fclose(stream);
+  self->list = list;
 
   self->super.eval = filter_in_list_eval;
   self->super.free_fn = filter_in_list_free;
@@ -23,6 +23,8 @@
  */
 
 #include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
 #include <glib.h>
 
 #include "cfg.h"
@@ -141,6 +143,87 @@ test_filter_with_long_line(const char *top_srcdir)
   g_free(list_file_with_long_line);
 }
 
+gboolean
+evaluate_value_testcase(const gchar *value, FilterExprNode *filter_node)
+{
+  LogMessage *log_msg;
+  gboolean result;
+
+  assert_not_null(filter_node, "Constructing an in-list filter");
+  log_msg = log_msg_new_empty();
+  log_msg_set_value_by_name(log_msg, "VALUE", value, -1);
+  result = filter_expr_eval(filter_node, log_msg);
+
+  log_msg_unref(log_msg);
+  filter_expr_unref(filter_node);
+  return result;
+}
+
+void
+test_filter_with_networks(const char *top_srcdir)
+{
+  gchar *list_file_with_networks = g_strdup_printf(LIST_FILE_DIR "cidr.list", top_srcdir);
+
+  assert_gboolean(evaluate_testcase(MSG_3, filter_in_list_new(list_file_with_networks, "HOST")),
+                  FALSE,
+                  "in-list filter matches an address outside of the listed networks");
+  assert_gboolean(evaluate_value_testcase("10.20.30.40", filter_in_list_new(list_file_with_networks, "VALUE")),
+                  TRUE,
+                  "in-list filter doesn't match an address in a /8 network");
+  assert_gboolean(evaluate_value_testcase("192.168.1.200", filter_in_list_new(list_file_with_networks, "VALUE")),
+                  TRUE,
+                  "in-list filter doesn't match an address in a /25 network");
+  assert_gboolean(evaluate_value_testcase("192.168.1.127", filter_in_list_new(list_file_with_networks, "VALUE")),
+                  FALSE,
+                  "in-list filter matches an address just outside a /25 network");
+  assert_gboolean(evaluate_value_testcase("2001:db8:1::1", filter_in_list_new(list_file_with_networks, "VALUE")),
+                  TRUE,
+                  "in-list filter doesn't match an IPv6 address in a /32 network");
+  assert_gboolean(evaluate_value_testcase("2001:db9::1", filter_in_list_new(list_file_with_networks, "VALUE")),
+                  FALSE,
+                  "in-list filter matches an IPv6 address outside of the listed networks");
+  assert_gboolean(evaluate_value_testcase("not-a-network/8", filter_in_list_new(list_file_with_networks, "VALUE")),
+                  TRUE,
+                  "in-list filter doesn't match a line that is not a network as a string");
+  assert_gboolean(evaluate_value_testcase("10.0.0.0/8", filter_in_list_new(list_file_with_networks, "VALUE")),
+                  TRUE,
+                  "in-list filter doesn't match a network line as a string");
+  g_free(list_file_with_networks);
+}
+
+void
+test_list_file_is_shared_until_it_changes(const char *top_srcdir)
+{
+  gchar *list_file;
+  FILE *stream;
+  FilterExprNode *first, *second;
+  gint fd;
+
+  fd = g_file_open_tmp("in-list-XXXXXX", &list_file, NULL);
+  stream = fdopen(fd, "w");
+  fputs("foo\n", stream);
+  fclose(stream);
+
+  first = filter_in_list_new(list_file, "VALUE");
+  assert_gboolean(evaluate_value_testcase("foo", filter_expr_ref(first)), TRUE, "in-list filter doesn't match");
+
+  /* different size, so the change is noticed even within the same second */
+  stream = fopen(list_file, "w");
+  fputs("foobar\nbar\n", stream);
+  fclose(stream);
+
+  second = filter_in_list_new(list_file, "VALUE");
+  assert_gboolean(evaluate_value_testcase("bar", filter_expr_ref(second)), TRUE,
+                  "in-list filter doesn't see the updated list file");
+  assert_gboolean(evaluate_value_testcase("bar", filter_expr_ref(first)), FALSE,
+                  "in-list filter changed while in use");
+
+  filter_expr_unref(first);
+  filter_expr_unref(second);
+  unlink(list_file);
+  g_free(list_file);
+}
+
 void
 run_testcases(const char *top_srcdir)
 {
@@ -152,6 +235,8 @@ run_testcases(const char *top_srcdir)
   test_list_file_contains_lot_of_lines(top_srcdir);
   test_filter_with_ip_address(top_srcdir);
   test_filter_with_long_line(top_srcdir);
+  test_filter_with_networks(top_srcdir);
+  test_list_file_is_shared_until_it_changes(top_srcdir);
 }
 
 int
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "syslog-ng.h"
+#include "apphook.h"
+#include "logmsg/logmsg.h"
+#include "filter/filter-in-list.h"
+#include "str-utils.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LIST_SIZE 500000
+#define NUM_MESSAGES 64
+#define BENCHMARK_COUNT 2000000
+
+gboolean success = TRUE;
+
+static gchar *
+_generate_list_file(GTree *tree)
+{
+  gchar *list_file;
+  FILE *stream;
+  gint fd, i;
+
+  fd = g_file_open_tmp("in-list-speed-XXXXXX", &list_file, NULL);
+  stream = fdopen(fd, "w");
+  for (i = 0; i < LIST_SIZE; i++)
+    {
+      gchar *line = g_strdup_printf("blocked-host-%d.example.com", i * 2);
+
+      fprintf(stream, "%s\n", line);
+      g_tree_insert(tree, line, GINT_TO_POINTER(1));
+    }
+  fclose(stream);
+  return list_file;
+}
+
+/* the lookup as it was done by the GTree based implementation */
+static gboolean
+_tree_lookup(GTree *tree, LogMessage *msg, NVHandle handle)
+{
+  const gchar *value;
+  gssize len = 0;
+
+  value = log_msg_get_value(msg, handle, &len);
+  APPEND_ZERO(value, value, len);
+
+  return g_tree_lookup(tree, value) != NULL;
+}
+
+int
+main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
+{
+  GTree *tree = g_tree_new_full((GCompareDataFunc) strcmp, NULL, g_free, NULL);
+  LogMessage *msgs[NUM_MESSAGES];
+  FilterExprNode *filter;
+  NVHandle handle;
+  GTimeVal start, end;
+  gchar *list_file;
+  gint tree_matches = 0, hash_matches = 0;
+  gint i;
+
+  app_startup();
+
+  list_file = _generate_list_file(tree);
+  handle = log_msg_get_value_handle("HOST");
+
+  g_get_current_time(&start);
+  filter = filter_in_list_new(list_file, "HOST");
+  g_get_current_time(&end);
+  printf("      %-10s load %d entries: %12.3f msec\n", "hash", LIST_SIZE, g_time_val_diff(&end, &start) / 1e3);
+
+  /* every other message is in the list */
+  for (i = 0; i < NUM_MESSAGES; i++)
+    {
+      gchar *host = g_strdup_printf("blocked-host-%d.example.com", i * 1544 + (i & 1));
+
+      msgs[i] = log_msg_new_empty();
+      log_msg_set_value(msgs[i], handle, host, -1);
+      g_free(host);
+    }
+
+  g_get_current_time(&start);
+  for (i = 0; i < BENCHMARK_COUNT; i++)
+    tree_matches += _tree_lookup(tree, msgs[i % NUM_MESSAGES], handle);
+  g_get_current_time(&end);
+  printf("      %-10s speed: %12.3f lookups/sec\n", "gtree", BENCHMARK_COUNT * 1e6 / g_time_val_diff(&end, &start));
+
+  g_get_current_time(&start);
+  for (i = 0; i < BENCHMARK_COUNT; i++)
+    hash_matches += filter_expr_eval(filter, msgs[i % NUM_MESSAGES]);
+  g_get_current_time(&end);
+  printf("      %-10s speed: %12.3f lookups/sec\n", "hash", BENCHMARK_COUNT * 1e6 / g_time_val_diff(&end, &start));
+
+  if (tree_matches != hash_matches || tree_matches != BENCHMARK_COUNT / 2)
+    {
+      fprintf(stderr, "lookup results differ, gtree=%d, hash=%d\n", tree_matches, hash_matches);
+      success = FALSE;
+    }
+
+  for (i = 0; i < NUM_MESSAGES; i++)
+    log_msg_unref(msgs[i]);
+  filter_expr_unref(filter);
+  g_tree_destroy(tree);
+  unlink(list_file);
+  g_free(list_file);
+
+  app_shutdown();
+
+  if (success)
+    return 0;
+  return 1;
+}
@@ -0,0 +1,367 @@
+/*
+ * Copyright (c) 2002-2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "logmsg/logmsg-pool.h"
+#include "stats/stats-registry.h"
+#include "tls-support.h"
+
+#include <string.h>
+
+/* size classes, two per power of two, between 256 bytes and 64k (including
+ * the block header).  Larger requests bypass the pool. */
+static const gsize pool_class_sizes[] =
+{
+  256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096, 6144,
+  8192, 12288, 16384, 24576, 32768, 49152, 65536
+};
+
+#define LOG_MSG_POOL_NUM_CLASSES G_N_ELEMENTS(pool_class_sizes)
+#define LOG_MSG_POOL_UNPOOLED    ((guint32) -1)
+
+typedef struct _LogMsgPool LogMsgPool;
+typedef union _LogMsgPoolBlock LogMsgPoolBlock;
+
+/* header in front of every block, its size keeps the payload 16 byte aligned */
+union _LogMsgPoolBlock
+{
+  struct
+  {
+    /* NULL if the block is not pooled */
+    LogMsgPool *owner;
+    guint32 size_class;
+  };
+  gdouble __align[2];
+};
+
+/* free blocks are chained through their first word */
+#define BLOCK_NEXT(block) (*(LogMsgPoolBlock **) ((block) + 1))
+
+struct _LogMsgPool
+{
+  LogMsgPoolBlock *free_lists[LOG_MSG_POOL_NUM_CLASSES];
+  gsize pooled_bytes;
+
+  /* blocks freed by other threads, pushed without locking */
+  LogMsgPoolBlock *volatile inbox;
+
+  /* set while the pool has no thread, its blocks are freed right away */
+  volatile gint orphaned;
+};
+
+TLS_BLOCK_START
+{
+  LogMsgPool *current_pool;
+}
+TLS_BLOCK_END;
+
+#define current_pool __tls_deref(current_pool)
+
+/* pools are never freed, as blocks owned by them may be released at any
+ * time.  The pools of exited threads are adopted by new ones. */
+static GStaticMutex pool_lock = G_STATIC_MUTEX_INIT;
+static GList *all_pools;
+static GList *orphan_pools;
+static gsize max_pooled_bytes = LOG_MSG_POOL_DEFAULT_MAX_SIZE;
+
+static StatsCounterItem *count_pool_hits;
+static StatsCounterItem *count_pool_misses;
+
+static inline guint32
+_find_size_class(gsize size)
+{
+  guint32 i;
+
+  for (i = 0; i < LOG_MSG_POOL_NUM_CLASSES; i++)
+    {
+      if (size <= pool_class_sizes[i])
+        return i;
+    }
+  return LOG_MSG_POOL_UNPOOLED;
+}
+
+static void
+_pool_put(LogMsgPool *pool, LogMsgPoolBlock *block)
+{
+  gsize block_size = pool_class_sizes[block->size_class];
+
+  if (pool->pooled_bytes + block_size > max_pooled_bytes)
+    {
+      g_free(block);
+      return;
+    }
+  BLOCK_NEXT(block) = pool->free_lists[block->size_class];
+  pool->free_lists[block->size_class] = block;
+  pool->pooled_bytes += block_size;
+}
+
+static void
+_pool_drain_inbox(LogMsgPool *pool)
+{
+  LogMsgPoolBlock *block, *next;
+
+  do
+    {
+      block = pool->inbox;
+    }
+  while (!g_atomic_pointer_compare_and_exchange((volatile gpointer *) &pool->inbox, block, NULL));
+
+  for (; block; block = next)
+    {
+      next = BLOCK_NEXT(block);
+      _pool_put(pool, block);
+    }
+}
+
+static void
+_pool_push_inbox(LogMsgPool *pool, LogMsgPoolBlock *block)
+{
+  LogMsgPoolBlock *head;
+
+  do
+    {
+      head = pool->inbox;
+      BLOCK_NEXT(block) = head;
+    }
+  while (!g_atomic_pointer_compare_and_exchange((volatile gpointer *) &pool->inbox, head, block));
+}
+
+/* called by threads other than the owner, once the pool is orphaned */
+static void
+_pool_free_inbox(LogMsgPool *pool)
+{
+  LogMsgPoolBlock *block, *next;
+
+  do
+    {
+      block = pool->inbox;
+    }
+  while (!g_atomic_pointer_compare_and_exchange((volatile gpointer *) &pool->inbox, block, NULL));
+
+  for (; block; block = next)
+    {
+      next = BLOCK_NEXT(block);
+      g_free(block);
+    }
+}
+
+static void
+_pool_release_cached_blocks(LogMsgPool *pool)
+{
+  LogMsgPoolBlock *block, *next;
+  gint i;
+
+  _pool_drain_inbox(pool);
+  for (i = 0; i < LOG_MSG_POOL_NUM_CLASSES; i++)
+    {
+      for (block = pool->free_lists[i]; block; block = next)
+        {
+          next = BLOCK_NEXT(block);
+          g_free(block);
+        }
+      pool->free_lists[i] = NULL;
+    }
+  pool->pooled_bytes = 0;
+}
+
+static LogMsgPoolBlock *
+_pool_get(LogMsgPool *pool, guint32 size_class)
+{
+  LogMsgPoolBlock *block = pool->free_lists[size_class];
+
+  if (!block && pool->inbox)
+    {
+      _pool_drain_inbox(pool);
+      block = pool->free_lists[size_class];
+    }
+
+  if (!block)
+    {
+      stats_counter_inc(count_pool_misses);
+      block = g_malloc(pool_class_sizes[size_class]);
+      block->owner = pool;
+      block->size_class = size_class;
+      return block;
+    }
+
+  stats_counter_inc(count_pool_hits);
+  pool->free_lists[size_class] = BLOCK_NEXT(block);
+  pool->pooled_bytes -= pool_class_sizes[size_class];
+  return block;
+}
+
+gpointer
+log_msg_pool_alloc(gsize size)
+{
+  LogMsgPool *pool = current_pool;
+  LogMsgPoolBlock *block;
+  guint32 size_class = _find_size_class(size + sizeof(LogMsgPoolBlock));
+
+  if (!pool || size_class == LOG_MSG_POOL_UNPOOLED || max_pooled_bytes == 0)
+    {
+      block = g_malloc(size + sizeof(LogMsgPoolBlock));
+      block->owner = NULL;
+      block->size_class = LOG_MSG_POOL_UNPOOLED;
+      return block + 1;
+    }
+
+  block = _pool_get(pool, size_class);
+  return block + 1;
+}
+
+void
+log_msg_pool_free(gpointer p)
+{
+  LogMsgPoolBlock *block;
+  LogMsgPool *pool;
+
+  if (!p)
+    return;
+
+  block = ((LogMsgPoolBlock *) p) - 1;
+  if (!block->owner)
+    {
+      g_free(block);
+      return;
+    }
+
+  pool = current_pool;
+  if (block->owner == pool)
+    {
+      _pool_put(pool, block);
+    }
+  else if (g_atomic_int_get(&block->owner->orphaned))
+    {
+      /* nobody would drain the inbox until the pool is adopted */
+      g_free(block);
+    }
+  else
+    {
+      _pool_push_inbox(block->owner, block);
+
+      /* the owner may have exited after draining its inbox for the last time */
+      if (g_atomic_int_get(&block->owner->orphaned))
+        _pool_free_inbox(block->owner);
+    }
+}
+
+gpointer
+log_msg_pool_realloc(gpointer p, gsize size)
+{
+  LogMsgPoolBlock *block;
+  gpointer new_p;
+  gsize old_size;
+
+  if (!p)
+    return log_msg_pool_alloc(size);
+
+  block = ((LogMsgPoolBlock *) p) - 1;
+  if (!block->owner)
+    {
+      block = g_realloc(block, size + sizeof(LogMsgPoolBlock));
+      return block + 1;
+    }
+
+  old_size = pool_class_sizes[block->size_class] - sizeof(LogMsgPoolBlock);
+  if (size <= old_size)
+    return p;
+
+  new_p = log_msg_pool_alloc(size);
+  memcpy(new_p, p, old_size);
+  log_msg_pool_free(p);
+  return new_p;
+}
+
+void
+log_msg_pool_set_max_size(gsize max_size)
+{
+  max_pooled_bytes = max_size;
+}
+
+void
+log_msg_pool_thread_init(void)
+{
+  LogMsgPool *pool;
+
+  if (current_pool)
+    return;
+
+  g_static_mutex_lock(&pool_lock);
+  if (orphan_pools)
+    {
+      pool = (LogMsgPool *) orphan_pools->data;
+      orphan_pools = g_list_delete_link(orphan_pools, orphan_pools);
+    }
+  else
+    {
+      pool = g_new0(LogMsgPool, 1);
+      all_pools = g_list_prepend(all_pools, pool);
+    }
+  g_static_mutex_unlock(&pool_lock);
+
+  g_atomic_int_set(&pool->orphaned, FALSE);
+  current_pool = pool;
+}
+
+void
+log_msg_pool_thread_deinit(void)
+{
+  LogMsgPool *pool = current_pool;
+
+  if (!pool)
+    return;
+
+  current_pool = NULL;
+  /* set before the last drain, blocks pushed after it are freed by the pusher */
+  g_atomic_int_set(&pool->orphaned, TRUE);
+  _pool_release_cached_blocks(pool);
+
+  g_static_mutex_lock(&pool_lock);
+  orphan_pools = g_list_prepend(orphan_pools, pool);
+  g_static_mutex_unlock(&pool_lock);
+}
+
+void
+log_msg_pool_global_init(void)
+{
+  stats_lock();
+  stats_register_counter(0, SCS_GLOBAL, "msg_pool_hits", NULL, SC_TYPE_PROCESSED, &count_pool_hits);
+  stats_register_counter(0, SCS_GLOBAL, "msg_pool_misses", NULL, SC_TYPE_PROCESSED, &count_pool_misses);
+  stats_unlock();
+}
+
+void
+log_msg_pool_global_deinit(void)
+{
+  GList *l;
+
+  stats_lock();
+  stats_unregister_counter(SCS_GLOBAL, "msg_pool_hits", NULL, SC_TYPE_PROCESSED, &count_pool_hits);
+  stats_unregister_counter(SCS_GLOBAL, "msg_pool_misses", NULL, SC_TYPE_PROCESSED, &count_pool_misses);
+  stats_unlock();
+
+  /* only the orphaned pools are idle at this point */
+  g_static_mutex_lock(&pool_lock);
+  for (l = orphan_pools; l; l = l->next)
+    _pool_release_cached_blocks((LogMsgPool *) l->data);
+  g_static_mutex_unlock(&pool_lock);
+}
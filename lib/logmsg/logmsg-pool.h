@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2002-2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef LOGMSG_POOL_H_INCLUDED
+#define LOGMSG_POOL_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/* default limit of the memory cached by a single thread */
+#define LOG_MSG_POOL_DEFAULT_MAX_SIZE (4 * 1024 * 1024)
+
+/*
+ * Memory used by LogMessage and NVTable instances is allocated from
+ * size-classed per-thread free lists.  Blocks freed by a thread other than
+ * the one that allocated them are returned to the owner's inbox, which the
+ * owner drains when its own free list runs out.  Blocks of threads that
+ * have exited are freed right away.
+ *
+ * Blocks allocated by this API must be freed/reallocated by the
+ * log_msg_pool_* functions.
+ */
+gpointer log_msg_pool_alloc(gsize size);
+gpointer log_msg_pool_realloc(gpointer p, gsize size);
+void log_msg_pool_free(gpointer p);
+
+void log_msg_pool_set_max_size(gsize max_size);
+
+void log_msg_pool_thread_init(void);
+void log_msg_pool_thread_deinit(void);
+void log_msg_pool_global_init(void);
+void log_msg_pool_global_deinit(void);
+
+#endif
@@ -45,6 +45,10 @@
  *   - the SDATA handles array that ensures that SDATA values are ordered
  *     the same way they were received.
  *
+ * Messages serialized by the same NVRegistry instance (e.g. a disk-queue
+ * written and read back by the same process) keep their handles, for those
+ * the entries are only validated.
+ *
  **********************************************************************/
 
 static gint
@@ -232,6 +236,9 @@ _fixup_entry(NVHandle old_handle, NVEntry *entry, NVIndexEntry *index_entry, gpo
       return TRUE;
     }
 
+  if (state->same_registry)
+    return FALSE;
+
   new_handle = _allocate_handle_for_entry_name(old_handle, entry);
 
   if (new_handle != old_handle)
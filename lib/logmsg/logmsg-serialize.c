@@ -32,6 +32,10 @@
 
 #include <stdlib.h>
 
+/* v27 stores the offset tables of the NVTable as a single block in native
+ * byte order and adds the id of the NVRegistry the handles belong to */
+#define LOGMSG_SERIALIZE_VERSION 27
+
 static gboolean
 _serialize_message(LogMessageSerializationState *state)
 {
@@ -39,6 +43,7 @@ _serialize_message(LogMessageSerializationState *state)
   SerializeArchive *sa = state->sa;
 
   serialize_write_uint8(sa, state->version);
+  serialize_write_uint64(sa, log_msg_registry_get_id());
   serialize_write_uint64(sa, msg->rcptid);
   g_assert(sizeof(msg->flags) == 4);
   serialize_write_uint32(sa, msg->flags & ~LF_STATE_MASK);
@@ -61,7 +66,7 @@ log_msg_serialize(LogMessage *self, SerializeArchive *sa)
 {
   LogMessageSerializationState state = { 0 };
 
-  state.version = 26;
+  state.version = LOGMSG_SERIALIZE_VERSION;
   state.msg = self;
   state.sa = sa;
   return _serialize_message(&state);
@@ -88,6 +93,15 @@ _deserialize_message(LogMessageSerializationState *state)
   LogMessage *msg = state->msg;
   SerializeArchive *sa = state->sa;
 
+  if (state->version >= 27)
+    {
+      guint64 registry_id;
+
+      if (!serialize_read_uint64(sa, &registry_id))
+        return FALSE;
+      state->same_registry = (registry_id == log_msg_registry_get_id());
+    }
+
   if (!serialize_read_uint64(sa, &msg->rcptid))
     return FALSE;
   if (!serialize_read_uint32(sa, &msg->flags))
@@ -131,10 +145,10 @@ _check_msg_version(LogMessageSerializationState *state)
   if (!serialize_read_uint8(state->sa, &state->version))
     return FALSE;
 
-  if (state->version != 26)
+  if (state->version < 26 || state->version > LOGMSG_SERIALIZE_VERSION)
     {
       msg_error("Error deserializing log message, unsupported version, "
-                "we only support v26 introduced in " VERSION_3_8 ", "
+                "we only support v26 and v27 introduced in " VERSION_3_8 ", "
                 "earlier versions in syslog-ng Premium Editions are not supported",
                 evt_tag_int("version", state->version));
       return FALSE;
@@ -28,6 +28,7 @@
 #include "logpipe.h"
 #include "timeutils.h"
 #include "logmsg/nvtable.h"
+#include "logmsg/logmsg-pool.h"
 #include "stats/stats-registry.h"
 #include "template/templates.h"
 #include "tls-support.h"
@@ -203,6 +204,8 @@ const gchar *builtin_value_names[] =
 
 static NVHandle match_handles[256];
 NVRegistry *logmsg_registry;
+/* random identifier of the current registry instance, see log_msg_registry_get_id() */
+static guint64 logmsg_registry_id;
 const char logmsg_sd_prefix[] = ".SDATA.";
 const gint logmsg_sd_prefix_len = sizeof(logmsg_sd_prefix) - 1;
 gint logmsg_queue_node_max = 1;
@@ -347,7 +350,8 @@ log_msg_get_value_handle(const gchar *value_name)
   handle = nv_registry_alloc_handle(logmsg_registry, value_name);
 
   /* check if name starts with sd_prefix and has at least one additional character */
-  if (strncmp(value_name, logmsg_sd_prefix, logmsg_sd_prefix_len) == 0 && value_name[6])
+  if (strncmp(value_name, logmsg_sd_prefix, logmsg_sd_prefix_len) == 0 && value_name[6] &&
+      !(nv_registry_get_handle_flags(logmsg_registry, handle) & LM_VF_SDATA))
     {
       nv_registry_set_handle_flags(logmsg_registry, handle, LM_VF_SDATA);
     }
@@ -1084,7 +1088,7 @@ log_msg_alloc(gsize payload_size)
       payload_ofs = alloc_size;
       alloc_size += payload_space;
     }
-  msg = g_malloc(alloc_size);
+  msg = log_msg_pool_alloc(alloc_size);
 
   memset(msg, 0, sizeof(LogMessage));
 
@@ -1294,7 +1298,7 @@ log_msg_free(LogMessage *self)
   if (self->original)
     log_msg_unref(self->original);
 
-  g_free(self);
+  log_msg_pool_free(self);
 }
 
 /**
@@ -1682,6 +1686,7 @@ log_msg_registry_init(void)
   gint i;
 
   logmsg_registry = nv_registry_new(builtin_value_names, NVHANDLE_MAX_VALUE);
+  logmsg_registry_id = ((guint64) g_random_int() << 32) | g_random_int();
   nv_registry_add_alias(logmsg_registry, LM_V_MESSAGE, "MSG");
   nv_registry_add_alias(logmsg_registry, LM_V_MESSAGE, "MSGONLY");
   nv_registry_add_alias(logmsg_registry, LM_V_HOST, "FULLHOST");
@@ -1708,6 +1713,18 @@ log_msg_registry_init(void)
     }
 }
 
+/*
+ * Handles are only meaningful within the registry that allocated them.
+ * The serialization code stores this identifier along with the message, so
+ * that deserializing a message in the same process can skip remapping its
+ * handles.
+ */
+guint64
+log_msg_registry_get_id(void)
+{
+  return logmsg_registry_id;
+}
+
 void
 log_msg_registry_deinit(void)
 {
@@ -1730,6 +1747,8 @@ log_msg_global_init(void)
   stats_register_counter(0, SCS_GLOBAL, "payload_reallocs", NULL, SC_TYPE_PROCESSED, &count_payload_reallocs);
   stats_register_counter(0, SCS_GLOBAL, "sdata_updates", NULL, SC_TYPE_PROCESSED, &count_sdata_updates);
   stats_unlock();
+  nv_table_global_init();
+  log_msg_pool_global_init();
 }
 
 const gchar *
@@ -1741,6 +1760,8 @@ log_msg_get_handle_name(NVHandle handle, gssize *length)
 void
 log_msg_global_deinit(void)
 {
+  log_msg_pool_global_deinit();
+  nv_table_global_deinit();
   log_msg_registry_deinit();
 }
 
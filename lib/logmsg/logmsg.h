@@ -326,6 +326,7 @@ void log_msg_refcache_stop(void);
 
 void log_msg_registry_init(void);
 void log_msg_registry_deinit(void);
+guint64 log_msg_registry_get_id(void);
 void log_msg_global_init(void);
 void log_msg_global_deinit(void);
 void log_msg_registry_foreach(GHFunc func, gpointer user_data);
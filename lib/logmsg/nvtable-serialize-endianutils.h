@@ -92,6 +92,16 @@ nv_table_data_swap_bytes(NVTable *self)
     }
 }
 
+static inline void
+nv_table_offsets_swap_bytes(NVTable *self)
+{
+  guint32 *offsets = self->static_entries;
+  gint i;
+
+  for (i = 0; i < self->num_static_entries + self->index_size * 2; i++)
+    offsets[i] = GUINT32_SWAP_LE_BE(offsets[i]);
+}
+
 static inline void
 nv_table_struct_swap_bytes(NVTable *self)
 {
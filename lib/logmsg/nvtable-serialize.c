@@ -27,12 +27,22 @@
 #include "logmsg/nvtable-serialize.h"
 #include "logmsg/nvtable-serialize-endianutils.h"
 #include "logmsg/logmsg.h"
+#include "logmsg/logmsg-pool.h"
 #include "messages.h"
 
 #include <stdlib.h>
 #include <string.h>
 
 
+/* The serialized size of an NVTable includes the in-memory header of the
+ * writer, which is 12 bytes before v27 and 20 bytes in v27.  The header
+ * may grow without a new serialization version: the reader adds the
+ * difference to the size, as the payload is addressed from the end of the
+ * table.  It must not shrink below the v27 size. */
+#define NV_TABLE_LEGACY_HEADER_SIZE 12
+#define NV_TABLE_V27_HEADER_SIZE    20
+#define NV_TABLE_HEADER_SIZE        G_STRUCT_OFFSET(NVTable, static_entries)
+
 typedef struct _NVTableMetaData
 {
   guint32 magic;
@@ -63,15 +73,31 @@ _deserialize_dynamic_entries(SerializeArchive *sa, NVTable *res)
 }
 
 static gboolean
-_read_struct(SerializeArchive *sa, NVTable *res)
+_has_to_swap_bytes(guint8 flags)
+{
+  return !!(flags & NVT_SF_BE) != (G_BYTE_ORDER == G_BIG_ENDIAN);
+}
+
+static inline gsize
+_get_offsets_size(NVTable *self)
 {
-  return _deserialize_static_entries(sa, res) && _deserialize_dynamic_entries(sa, res);
+  return self->num_static_entries * sizeof(self->static_entries[0]) + self->index_size * sizeof(NVIndexEntry);
 }
 
 static gboolean
-_has_to_swap_bytes(guint8 flags)
+_read_struct(LogMessageSerializationState *state, NVTable *res)
 {
-  return !!(flags & NVT_SF_BE) != (G_BYTE_ORDER == G_BIG_ENDIAN);
+  SerializeArchive *sa = state->sa;
+
+  if (state->version < 27)
+    return _deserialize_static_entries(sa, res) && _deserialize_dynamic_entries(sa, res);
+
+  /* static entries and the index are adjacent, stored in the byte order of the writer */
+  if (!serialize_read_blob(sa, res->static_entries, _get_offsets_size(res)))
+    return FALSE;
+  if (_has_to_swap_bytes(state->nvtable_flags))
+    nv_table_offsets_swap_bytes(res);
+  return TRUE;
 }
 
 static inline gboolean
@@ -112,10 +138,12 @@ _read_metadata(SerializeArchive *sa, NVTableMetaData *meta_data)
 }
 
 static gboolean
-_read_header(SerializeArchive *sa, NVTable **nvtable)
+_read_header(LogMessageSerializationState *state, NVTable **nvtable)
 {
+  SerializeArchive *sa = state->sa;
   NVTable *res = NULL;
   guint32 size;
+  guint32 header_growth;
 
   g_assert(*nvtable == NULL);
 
@@ -125,8 +153,16 @@ _read_header(SerializeArchive *sa, NVTable **nvtable)
   if (size > NV_TABLE_MAX_BYTES)
     goto error;
 
-  res = (NVTable *) g_malloc(size);
+  /* the header of the NVTable struct was smaller in earlier versions,
+   * leave room for the difference, so that tables without free space still fit */
+  header_growth = NV_TABLE_HEADER_SIZE - (state->version < 27 ? NV_TABLE_LEGACY_HEADER_SIZE : NV_TABLE_V27_HEADER_SIZE);
+  if (size <= NV_TABLE_MAX_BYTES - header_growth)
+    size += header_growth;
+
+  res = (NVTable *) log_msg_pool_alloc(size);
   res->size = size;
+  res->index_tail_size = 0;
+  res->dead_bytes = 0;
 
   if (!serialize_read_uint32(sa, &res->used))
     goto error;
@@ -156,7 +192,7 @@ _read_header(SerializeArchive *sa, NVTable **nvtable)
 
 error:
   if (res)
-    g_free(res);
+    log_msg_pool_free(res);
   return FALSE;
 }
 
@@ -176,12 +212,12 @@ nv_table_deserialize(LogMessageSerializationState *state)
   if (!_read_metadata(sa, &meta_data))
     goto error;
 
-  if (!_read_header(sa, &res))
+  if (!_read_header(state, &res))
     goto error;
 
   state->nvtable_flags = meta_data.flags;
   state->nvtable = res;
-  if (!_read_struct(sa, res))
+  if (!_read_struct(state, res))
     goto error;
 
   if (!_read_payload(sa, res))
@@ -195,7 +231,7 @@ nv_table_deserialize(LogMessageSerializationState *state)
 
 error:
   if (res)
-    g_free(res);
+    log_msg_pool_free(res);
   return NULL;
 }
 
@@ -210,8 +246,22 @@ _write_struct(SerializeArchive *sa, NVTable *self)
   serialize_write_uint32(sa, self->used);
   serialize_write_uint16(sa, self->index_size);
   serialize_write_uint8(sa, self->num_static_entries);
-  serialize_write_uint32_array(sa, self->static_entries, self->num_static_entries);
-  serialize_write_uint32_array(sa, (guint32 *) nv_table_get_index(self), self->index_size * 2);
+  if (self->index_tail_size == 0)
+    {
+      serialize_write_blob(sa, self->static_entries, _get_offsets_size(self));
+    }
+  else
+    {
+      /* readers expect a fully sorted index, merge the tail while writing
+       * as we might not be the only user of this NVTable.  index_size is
+       * a guint16, so this is up to 512k, too much for the stack. */
+      NVIndexEntry *sorted_index = g_new(NVIndexEntry, self->index_size);
+
+      nv_table_copy_sorted_index(self, sorted_index);
+      serialize_write_blob(sa, self->static_entries, self->num_static_entries * sizeof(self->static_entries[0]));
+      serialize_write_blob(sa, sorted_index, self->index_size * sizeof(sorted_index[0]));
+      g_free(sorted_index);
+    }
 }
 
 static void
@@ -241,6 +291,12 @@ nv_table_serialize(LogMessageSerializationState *state, NVTable *self)
 {
   NVTableMetaData meta_data = { 0 };
   SerializeArchive *sa = state->sa;
+  NVTable *compacted = NULL;
+
+  /* don't write dead entries to disk, the original might be shared with
+   * other threads, so compact a copy */
+  if (self->dead_bytes)
+    self = compacted = nv_table_clone(self, 0);
 
   _fill_meta_data(self, &meta_data);
   _write_meta_data(sa, &meta_data);
@@ -248,5 +304,8 @@ nv_table_serialize(LogMessageSerializationState *state, NVTable *self)
   _write_struct(sa, self);
 
   _write_payload(sa, self);
+
+  if (compacted)
+    nv_table_unref(compacted);
   return TRUE;
 }
@@ -22,7 +22,10 @@
  *
  */
 #include "logmsg/nvtable.h"
+#include "logmsg/logmsg-pool.h"
 #include "messages.h"
+#include "tls-support.h"
+#include "stats/stats-registry.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -31,30 +34,167 @@ GStaticMutex nv_registry_lock = G_STATIC_MUTEX_INIT;
 
 const gchar *null_string = "";
 
+static StatsCounterItem *count_payload_reclaimed_bytes;
+
+/* NVRegistryNameMap
+ *
+ * Open addressing hash table mapping names to handles.  Lookups are
+ * performed without taking nv_registry_lock: slots are only ever filled
+ * (never changed or removed) and a slot becomes visible to readers when its
+ * name pointer is set.  When the map becomes half full, a copy with twice
+ * the number of slots is published.  Retired maps are kept around until the
+ * registry is freed as readers may still be walking them.
+ */
+typedef struct _NVRegistryNameSlot
+{
+  const gchar *volatile name;
+  guint hash;
+  NVHandle handle;
+} NVRegistryNameSlot;
+
+struct _NVRegistryNameMap
+{
+  guint32 mask;
+  guint32 num_used;
+  NVRegistryNameSlot slots[0];
+};
+
+#define NV_REGISTRY_NAME_MAP_INITIAL_SIZE 256
+
+/* per-thread cache in front of the shared name map, direct mapped by hash */
+#define NV_REGISTRY_HANDLE_CACHE_SIZE 256
+
+typedef struct _NVRegistryHandleCacheEntry
+{
+  guint32 registry_id;
+  guint hash;
+  const gchar *name;
+  NVHandle handle;
+} NVRegistryHandleCacheEntry;
+
+TLS_BLOCK_START
+{
+  NVRegistryHandleCacheEntry handle_cache[NV_REGISTRY_HANDLE_CACHE_SIZE];
+}
+TLS_BLOCK_END;
+
+#define handle_cache __tls_deref(handle_cache)
+
+static volatile gint nv_registry_next_id = 1;
+
+static NVRegistryNameMap *
+_name_map_new(guint32 size)
+{
+  NVRegistryNameMap *self = g_malloc0(sizeof(NVRegistryNameMap) + size * sizeof(NVRegistryNameSlot));
+
+  self->mask = size - 1;
+  return self;
+}
+
+static NVRegistryNameSlot *
+_name_map_lookup(NVRegistryNameMap *self, const gchar *name, guint hash)
+{
+  guint32 i;
+
+  for (i = hash & self->mask; ; i = (i + 1) & self->mask)
+    {
+      NVRegistryNameSlot *slot = &self->slots[i];
+      const gchar *slot_name = g_atomic_pointer_get(&slot->name);
+
+      if (!slot_name)
+        return NULL;
+      if (slot->hash == hash && strcmp(slot_name, name) == 0)
+        return slot;
+    }
+}
+
+/* must be called with nv_registry_lock held, takes over the ownership of name */
+static void
+_name_map_insert(NVRegistryNameMap *self, const gchar *name, guint hash, NVHandle handle)
+{
+  NVRegistryNameSlot *slot;
+  guint32 i;
+
+  for (i = hash & self->mask; self->slots[i].name; i = (i + 1) & self->mask)
+    ;
+  slot = &self->slots[i];
+  slot->hash = hash;
+  slot->handle = handle;
+  self->num_used++;
+
+  /* publish the slot, the barrier orders the stores above before this one */
+  g_atomic_pointer_compare_and_exchange((volatile gpointer *) &slot->name, NULL, (gpointer) name);
+}
+
+/* must be called with nv_registry_lock held */
+static void
+_nv_registry_insert_name(NVRegistry *self, const gchar *name, NVHandle handle)
+{
+  NVRegistryNameMap *map = self->name_map;
+  guint hash = g_str_hash(name);
+
+  if ((map->num_used + 1) * 2 > map->mask + 1)
+    {
+      NVRegistryNameMap *new_map = _name_map_new((map->mask + 1) * 2);
+      guint32 i;
+
+      for (i = 0; i <= map->mask; i++)
+        {
+          if (map->slots[i].name)
+            _name_map_insert(new_map, map->slots[i].name, map->slots[i].hash, map->slots[i].handle);
+        }
+      g_atomic_pointer_compare_and_exchange((volatile gpointer *) &self->name_map, map, new_map);
+      self->retired_name_maps = g_list_prepend(self->retired_name_maps, map);
+      map = new_map;
+    }
+  _name_map_insert(map, name, hash, handle);
+}
+
+static inline NVHandle
+_nv_registry_lookup_handle(NVRegistry *self, const gchar *name, guint hash)
+{
+  NVRegistryHandleCacheEntry *cached = &handle_cache[hash % NV_REGISTRY_HANDLE_CACHE_SIZE];
+  NVRegistryNameSlot *slot;
+
+  if (cached->registry_id == self->id && cached->hash == hash && strcmp(cached->name, name) == 0)
+    return cached->handle;
+
+  slot = _name_map_lookup(g_atomic_pointer_get(&self->name_map), name, hash);
+  if (!slot)
+    return 0;
+
+  cached->registry_id = self->id;
+  cached->hash = hash;
+  cached->name = slot->name;
+  cached->handle = slot->handle;
+  return slot->handle;
+}
+
 NVHandle
 nv_registry_get_handle(NVRegistry *self, const gchar *name)
 {
-  gpointer p;
-
-  p = g_hash_table_lookup(self->name_map, name);
-  if (p)
-    return GPOINTER_TO_UINT(p);
-  return 0;
+  return _nv_registry_lookup_handle(self, name, g_str_hash(name));
 }
 
 NVHandle
 nv_registry_alloc_handle(NVRegistry *self, const gchar *name)
 {
-  gpointer p;
+  NVRegistryNameSlot *slot;
   NVHandleDesc stored;
   gsize len;
-  NVHandle res = 0;
+  NVHandle res;
+
+  res = nv_registry_get_handle(self, name);
+  if (res)
+    return res;
 
   g_static_mutex_lock(&nv_registry_lock);
-  p = g_hash_table_lookup(self->name_map, name);
-  if (p)
+
+  /* somebody else might have registered it since the lockless lookup */
+  slot = _name_map_lookup(self->name_map, name, g_str_hash(name));
+  if (slot)
     {
-      res = GPOINTER_TO_UINT(p);
+      res = slot->handle;
       goto exit;
     }
 
@@ -82,7 +222,7 @@ nv_registry_alloc_handle(NVRegistry *self, const gchar *name)
   stored.name_len = len;
   stored.name = g_strdup(name);
   g_array_append_val(self->names, stored);
-  g_hash_table_insert(self->name_map, stored.name, GUINT_TO_POINTER(self->names->len));
+  _nv_registry_insert_name(self, stored.name, self->names->len);
   res = self->names->len;
 exit:
   g_static_mutex_unlock(&nv_registry_lock);
@@ -98,7 +238,8 @@ void
 nv_registry_add_alias(NVRegistry *self, NVHandle handle, const gchar *alias)
 {
   g_static_mutex_lock(&nv_registry_lock);
-  g_hash_table_insert(self->name_map, g_strdup(alias), GUINT_TO_POINTER((glong) handle));
+  if (!_name_map_lookup(self->name_map, alias, g_str_hash(alias)))
+    _nv_registry_insert_name(self, g_strdup(alias), handle);
   g_static_mutex_unlock(&nv_registry_lock);
 }
 
@@ -117,7 +258,16 @@ nv_registry_set_handle_flags(NVRegistry *self, NVHandle handle, guint16 flags)
 void
 nv_registry_foreach(NVRegistry *self, GHFunc callback, gpointer user_data)
 {
-  g_hash_table_foreach(self->name_map, callback, user_data);
+  NVRegistryNameMap *map = g_atomic_pointer_get(&self->name_map);
+  guint32 i;
+
+  for (i = 0; i <= map->mask; i++)
+    {
+      const gchar *name = g_atomic_pointer_get(&map->slots[i].name);
+
+      if (name)
+        callback((gpointer) name, GUINT_TO_POINTER(map->slots[i].handle), user_data);
+    }
 }
 
 NVRegistry *
@@ -127,7 +277,8 @@ nv_registry_new(const gchar **static_names, guint32 nvhandle_max_value)
   gint i;
 
   self->nvhandle_max_value = nvhandle_max_value;
-  self->name_map = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  self->id = g_atomic_int_exchange_and_add(&nv_registry_next_id, 1);
+  self->name_map = _name_map_new(NV_REGISTRY_NAME_MAP_INITIAL_SIZE);
   self->names = g_array_new(FALSE, FALSE, sizeof(NVHandleDesc));
   for (i = 0; static_names[i]; i++)
     {
@@ -139,8 +290,15 @@ nv_registry_new(const gchar **static_names, guint32 nvhandle_max_value)
 void
 nv_registry_free(NVRegistry *self)
 {
+  guint32 i;
+
+  /* names and aliases are owned by the current map, retired maps share them */
+  for (i = 0; i <= self->name_map->mask; i++)
+    g_free((gchar *) self->name_map->slots[i].name);
+  g_free(self->name_map);
+  g_list_foreach(self->retired_name_maps, (GFunc) g_free, NULL);
+  g_list_free(self->retired_name_maps);
   g_array_free(self->names, TRUE);
-  g_hash_table_destroy(self->name_map);
   g_free(self);
 }
 
@@ -210,34 +368,29 @@ nv_table_resolve_entry(NVTable *self, NVEntry *entry, gssize *length)
     return nv_table_resolve_indirect(self, entry, length);
 }
 
-NVEntry *
-nv_table_get_entry_slow(NVTable *self, NVHandle handle, NVIndexEntry **index_entry)
+/* limits of the separately sorted tail of the index, the actual limit
+ * grows with the size of the index, see _index_tail_limit() */
+#define NV_TABLE_INDEX_TAIL_MIN 16
+#define NV_TABLE_INDEX_TAIL_MAX 256
+
+static inline NVIndexEntry *
+_index_bsearch(NVIndexEntry *index_table, gint count, NVHandle handle, gint *insert_pos)
 {
-  guint32 ofs;
   gint l, h, m;
-  NVIndexEntry *index_table = nv_table_get_index(self);
   guint32 mv;
 
-  if (!self->index_size)
-    {
-      *index_entry = NULL;
-      return NULL;
-    }
-
   /* open-coded binary search */
-  *index_entry = NULL;
   l = 0;
-  h = self->index_size - 1;
-  ofs = 0;
+  h = count - 1;
   while (l <= h)
     {
       m = (l+h) >> 1;
       mv = index_table[m].handle;
       if (mv == handle)
         {
-          *index_entry = &index_table[m];
-          ofs = index_table[m].ofs;
-          break;
+          if (insert_pos)
+            *insert_pos = m;
+          return &index_table[m];
         }
       else if (mv > handle)
         {
@@ -248,9 +401,79 @@ nv_table_get_entry_slow(NVTable *self, NVHandle handle, NVIndexEntry **index_ent
           l = m + 1;
         }
     }
+  if (insert_pos)
+    *insert_pos = l;
+  return NULL;
+}
 
-  NVEntry *entry = nv_table_get_entry_at_ofs(self, ofs);
-  return entry;
+NVEntry *
+nv_table_get_entry_slow(NVTable *self, NVHandle handle, NVIndexEntry **index_entry)
+{
+  NVIndexEntry *index_table = nv_table_get_index(self);
+  gint head_size = self->index_size - self->index_tail_size;
+
+  *index_entry = _index_bsearch(index_table, head_size, handle, NULL);
+  if (!(*index_entry) && self->index_tail_size)
+    *index_entry = _index_bsearch(&index_table[head_size], self->index_tail_size, handle, NULL);
+
+  if (!(*index_entry))
+    return NULL;
+  return nv_table_get_entry_at_ofs(self, (*index_entry)->ofs);
+}
+
+static inline gint
+_index_tail_limit(NVTable *self)
+{
+  return CLAMP((self->index_size - self->index_tail_size) / 8, NV_TABLE_INDEX_TAIL_MIN, NV_TABLE_INDEX_TAIL_MAX);
+}
+
+/* merge the tail of the index into the preceding, sorted part, in place */
+static void
+_merge_index_tail(NVTable *self)
+{
+  NVIndexEntry *index_table = nv_table_get_index(self);
+  NVIndexEntry tail[NV_TABLE_INDEX_TAIL_MAX + 1];
+  gint head_ndx, tail_ndx, dst_ndx;
+
+  head_ndx = self->index_size - self->index_tail_size - 1;
+  tail_ndx = self->index_tail_size - 1;
+  memcpy(tail, &index_table[head_ndx + 1], self->index_tail_size * sizeof(tail[0]));
+
+  for (dst_ndx = self->index_size - 1; tail_ndx >= 0; dst_ndx--)
+    {
+      if (head_ndx >= 0 && index_table[head_ndx].handle > tail[tail_ndx].handle)
+        index_table[dst_ndx] = index_table[head_ndx--];
+      else
+        index_table[dst_ndx] = tail[tail_ndx--];
+    }
+  self->index_tail_size = 0;
+}
+
+/**
+ * nv_table_copy_sorted_index:
+ * @dest: array of self->index_size elements
+ *
+ * Copies the dynamic index of @self to @dest as a single sorted array
+ * without changing @self.
+ **/
+void
+nv_table_copy_sorted_index(NVTable *self, NVIndexEntry *dest)
+{
+  NVIndexEntry *index_table = nv_table_get_index(self);
+  gint head_size = self->index_size - self->index_tail_size;
+  gint head_ndx = 0, tail_ndx = head_size, dst_ndx = 0;
+
+  while (head_ndx < head_size && tail_ndx < self->index_size)
+    {
+      if (index_table[head_ndx].handle < index_table[tail_ndx].handle)
+        dest[dst_ndx++] = index_table[head_ndx++];
+      else
+        dest[dst_ndx++] = index_table[tail_ndx++];
+    }
+  while (head_ndx < head_size)
+    dest[dst_ndx++] = index_table[head_ndx++];
+  while (tail_ndx < self->index_size)
+    dest[dst_ndx++] = index_table[tail_ndx++];
 }
 
 static gboolean
@@ -258,57 +481,42 @@ nv_table_reserve_table_entry(NVTable *self, NVHandle handle, NVIndexEntry **inde
 {
   if (G_UNLIKELY(!(*index_entry) && handle > self->num_static_entries))
     {
-      /* this is a dynamic value */
-      NVIndexEntry *index_table = nv_table_get_index(self);;
-      gint l, h, m, ndx;
-      gboolean found = FALSE;
+      /* this is a dynamic value, not yet present in the index */
+      NVIndexEntry *index_table = nv_table_get_index(self);
+      gint head_size = self->index_size - self->index_tail_size;
+      gint ndx;
 
       if (!nv_table_alloc_check(self, sizeof(index_table[0])))
         return FALSE;
 
-      l = 0;
-      h = self->index_size - 1;
-      ndx = -1;
-      while (l <= h)
+      if (self->index_tail_size == 0 && (head_size == 0 || index_table[head_size - 1].handle < handle))
         {
-          guint16 mv;
-
-          m = (l+h) >> 1;
-          mv = index_table[m].handle;
-
-          if (mv == handle)
-            {
-              ndx = m;
-              found = TRUE;
-              break;
-            }
-          else if (mv > handle)
-            {
-              h = m - 1;
-            }
-          else
-            {
-              l = m + 1;
-            }
+          /* the common case, handles are set in increasing order */
+          ndx = self->index_size;
         }
-      /* if we find the proper slot we set that, if we don't, we insert a new entry */
-      if (!found)
-        ndx = l;
-
-      g_assert(ndx >= 0 && ndx <= self->index_size);
-      if (ndx < self->index_size)
+      else
         {
+          _index_bsearch(&index_table[head_size], self->index_tail_size, handle, &ndx);
+          ndx += head_size;
           memmove(&index_table[ndx + 1], &index_table[ndx], (self->index_size - ndx) * sizeof(index_table[0]));
+          self->index_tail_size++;
         }
 
-      *index_entry = &index_table[ndx];
-
       /* we set ofs to zero here, which means that the NVEntry won't
          be found even if the slot is present in index */
-      (**index_entry).handle = handle;
-      (**index_entry).ofs    = 0;
-      if (!found)
-        self->index_size++;
+      index_table[ndx].handle = handle;
+      index_table[ndx].ofs    = 0;
+      self->index_size++;
+
+      if (self->index_tail_size > _index_tail_limit(self))
+        {
+          _merge_index_tail(self);
+          *index_entry = _index_bsearch(index_table, self->index_size, handle, NULL);
+        }
+      else
+        {
+          *index_entry = &index_table[ndx];
+        }
     }
   return TRUE;
 }
@@ -357,7 +565,7 @@ gboolean
 nv_table_add_value(NVTable *self, NVHandle handle, const gchar *name, gsize name_len, const gchar *value,
                    gsize value_len, gboolean *new_entry)
 {
-  NVEntry *entry;
+  NVEntry *entry, *old_entry;
   guint32 ofs;
   NVIndexEntry *index_entry;
 
@@ -410,11 +618,14 @@ nv_table_add_value(NVTable *self, NVHandle handle, const gchar *name, gsize name
    * size needed for a dynamic table slot */
   if (!nv_table_reserve_table_entry(self, handle, &index_entry))
     return FALSE;
+  old_entry = entry;
   entry = nv_table_alloc_value(self, NV_ENTRY_DIRECT_HDR + name_len + value_len + 2);
   if (G_UNLIKELY(!entry))
     {
       return FALSE;
     }
+  if (old_entry)
+    self->dead_bytes += old_entry->alloc_len;
 
   ofs = nv_table_get_ofs_for_an_entry(self, entry);
   entry->vdirect.value_len = value_len;
@@ -462,7 +673,7 @@ gboolean
 nv_table_add_value_indirect(NVTable *self, NVHandle handle, const gchar *name, gsize name_len, NVHandle ref_handle,
                             guint8 type, guint32 rofs, guint32 rlen, gboolean *new_entry)
 {
-  NVEntry *entry, *ref_entry;
+  NVEntry *entry, *ref_entry, *old_entry;
   NVIndexEntry *index_entry;
   guint32 ofs;
 
@@ -537,11 +748,14 @@ nv_table_add_value_indirect(NVTable *self, NVHandle handle, const gchar *name, g
 
   if (!nv_table_reserve_table_entry(self, handle, &index_entry))
     return FALSE;
+  old_entry = entry;
   entry = nv_table_alloc_value(self, NV_ENTRY_INDIRECT_HDR + name_len + 1);
   if (!entry)
     {
       return FALSE;
     }
+  if (old_entry)
+    self->dead_bytes += old_entry->alloc_len;
 
   ofs = nv_table_get_ofs_for_an_entry(self, entry);
   entry->vindirect.handle = ref_handle;
@@ -625,6 +839,8 @@ nv_table_clear(NVTable *self)
   g_assert(self->ref_cnt == 1);
   self->used = 0;
   self->index_size = 0;
+  self->index_tail_size = 0;
+  self->dead_bytes = 0;
   memset(&self->static_entries[0], 0, self->num_static_entries * sizeof(self->static_entries[0]));
 }
 
@@ -635,6 +851,8 @@ nv_table_init(NVTable *self, gsize alloc_length, gint num_static_entries)
   self->size = alloc_length;
   self->used = 0;
   self->index_size = 0;
+  self->index_tail_size = 0;
+  self->dead_bytes = 0;
   self->num_static_entries = num_static_entries;
   self->ref_cnt = 1;
   self->borrowed = FALSE;
@@ -648,7 +866,7 @@ nv_table_new(gint num_static_entries, gint index_size_hint, gint init_length)
   gsize alloc_length;
 
   alloc_length = nv_table_get_alloc_size(num_static_entries, index_size_hint, init_length);
-  self = (NVTable *) g_malloc(alloc_length);
+  self = (NVTable *) log_msg_pool_alloc(alloc_length);
 
   nv_table_init(self, alloc_length, num_static_entries);
   return self;
@@ -666,6 +884,56 @@ nv_table_init_borrowed(gpointer space, gsize space_len, gint num_static_entries)
   return self;
 }
 
+static inline gsize
+_get_entry_used_size(NVEntry *entry)
+{
+  if (entry->indirect)
+    return NV_TABLE_BOUND(NV_ENTRY_INDIRECT_HDR + entry->name_len + 1);
+  return NV_TABLE_BOUND(NV_ENTRY_DIRECT_HDR + entry->name_len + entry->vdirect.value_len + 2);
+}
+
+static guint32
+_copy_entry_compacted(NVTable *self, NVTable *new, guint32 ofs)
+{
+  NVEntry *entry = nv_table_get_entry_at_ofs(self, ofs);
+  NVEntry *new_entry;
+  gsize size;
+
+  if (!entry)
+    return 0;
+
+  size = _get_entry_used_size(entry);
+  new->used += size;
+  new_entry = (NVEntry *) (nv_table_get_top(new) - new->used);
+  memcpy(new_entry, entry, size);
+  new_entry->alloc_len = size;
+  return nv_table_get_ofs_for_an_entry(new, new_entry);
+}
+
+/* copies @self to @new leaving out dead entries and the unused space
+ * of live ones, new->size must be already set and not smaller than
+ * self->size */
+static void
+_copy_compacted(NVTable *self, NVTable *new)
+{
+  NVIndexEntry *index_table;
+  guint32 new_size = new->size;
+  gint i;
+
+  memcpy(new, self, sizeof(NVTable) + self->num_static_entries * sizeof(self->static_entries[0]) + self->index_size *
+         sizeof(NVIndexEntry));
+  new->size = new_size;
+  new->used = 0;
+  new->dead_bytes = 0;
+
+  for (i = 0; i < self->num_static_entries; i++)
+    new->static_entries[i] = _copy_entry_compacted(self, new, self->static_entries[i]);
+
+  index_table = nv_table_get_index(new);
+  for (i = 0; i < self->index_size; i++)
+    index_table[i].ofs = _copy_entry_compacted(self, new, index_table[i].ofs);
+}
+
 /* returns TRUE if successfully realloced, FALSE means that we're unable to grow */
 gboolean
 nv_table_realloc(NVTable *self, NVTable **new)
@@ -673,16 +941,24 @@ nv_table_realloc(NVTable *self, NVTable **new)
   gsize old_size = self->size;
   gsize new_size;
 
-  /* double the size of the current allocation */
-  new_size = ((gsize) self->size) << 1;
-  if (new_size > NV_TABLE_MAX_BYTES)
-    new_size = NV_TABLE_MAX_BYTES;
-  if (new_size == old_size)
-    return FALSE;
+  if (self->dead_bytes >= old_size / 4)
+    {
+      /* compacting the table frees enough space, don't grow */
+      new_size = old_size;
+    }
+  else
+    {
+      /* double the size of the current allocation */
+      new_size = ((gsize) self->size) << 1;
+      if (new_size > NV_TABLE_MAX_BYTES)
+        new_size = NV_TABLE_MAX_BYTES;
+      if (new_size == old_size && !self->dead_bytes)
+        return FALSE;
+    }
 
-  if (self->ref_cnt == 1 && !self->borrowed)
+  if (self->ref_cnt == 1 && !self->borrowed && !self->dead_bytes)
     {
-      *new = self = g_realloc(self, new_size);
+      *new = self = log_msg_pool_realloc(self, new_size);
 
       self->size = new_size;
       /* move the downwards growing region to the end of the new buffer */
@@ -690,9 +966,23 @@ nv_table_realloc(NVTable *self, NVTable **new)
               NV_TABLE_ADDR(self, old_size - self->used),
               self->used);
     }
+  else if (self->dead_bytes)
+    {
+      *new = log_msg_pool_alloc(new_size);
+      (*new)->size = new_size;
+      _copy_compacted(self, *new);
+      (*new)->ref_cnt = 1;
+      (*new)->borrowed = FALSE;
+
+      /* the compacted copy replaces the table, unlike clones which leave
+       * @self as it is, so the dead bytes are only counted here */
+      stats_counter_add(count_payload_reclaimed_bytes, self->used - (*new)->used);
+
+      nv_table_unref(self);
+    }
   else
     {
-      *new = g_malloc(new_size);
+      *new = log_msg_pool_alloc(new_size);
 
       /* we only copy the header first */
       memcpy(*new, self, sizeof(NVTable) + self->num_static_entries * sizeof(self->static_entries[0]) + self->index_size *
@@ -722,7 +1012,7 @@ nv_table_unref(NVTable *self)
 {
   if ((--self->ref_cnt == 0) && !self->borrowed)
     {
-      g_free(self);
+      log_msg_pool_free(self);
     }
 }
 
@@ -747,16 +1037,42 @@ nv_table_clone(NVTable *self, gint additional_space)
   if (new_size > NV_TABLE_MAX_BYTES)
     new_size = NV_TABLE_MAX_BYTES;
 
-  new = g_malloc(new_size);
-  memcpy(new, self, sizeof(NVTable) + self->num_static_entries * sizeof(self->static_entries[0]) + self->index_size *
-         sizeof(NVIndexEntry));
-  new->size = new_size;
+  new = log_msg_pool_alloc(new_size);
+  if (self->dead_bytes)
+    {
+      new->size = new_size;
+      _copy_compacted(self, new);
+    }
+  else
+    {
+      memcpy(new, self, sizeof(NVTable) + self->num_static_entries * sizeof(self->static_entries[0]) + self->index_size *
+             sizeof(NVIndexEntry));
+      new->size = new_size;
+
+      memcpy(NV_TABLE_ADDR(new, new->size - new->used),
+             NV_TABLE_ADDR(self, self->size - self->used),
+             self->used);
+    }
   new->ref_cnt = 1;
   new->borrowed = FALSE;
 
-  memcpy(NV_TABLE_ADDR(new, new->size - new->used),
-         NV_TABLE_ADDR(self, self->size - self->used),
-         self->used);
-
   return new;
 }
+
+void
+nv_table_global_init(void)
+{
+  stats_lock();
+  stats_register_counter(0, SCS_GLOBAL, "payload_reclaimed_bytes", NULL, SC_TYPE_PROCESSED,
+                         &count_payload_reclaimed_bytes);
+  stats_unlock();
+}
+
+void
+nv_table_global_deinit(void)
+{
+  stats_lock();
+  stats_unregister_counter(SCS_GLOBAL, "payload_reclaimed_bytes", NULL, SC_TYPE_PROCESSED,
+                           &count_payload_reclaimed_bytes);
+  stats_unlock();
+}
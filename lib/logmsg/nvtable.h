@@ -33,6 +33,7 @@ typedef struct _NVIndexEntry NVIndexEntry;
 typedef struct _NVEntry NVEntry;
 typedef guint32 NVHandle;
 typedef struct _NVHandleDesc NVHandleDesc;
+typedef struct _NVRegistryNameMap NVRegistryNameMap;
 typedef gboolean (*NVTableForeachFunc)(NVHandle handle, const gchar *name, const gchar *value, gssize value_len, gpointer user_data);
 typedef gboolean (*NVTableForeachEntryFunc)(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entry, gpointer user_data);
 
@@ -65,8 +66,12 @@ struct _NVRegistry
   /* number of static names that are statically allocated in each payload */
   gint num_static_names;
   GArray *names;
-  GHashTable *name_map;
+  /* name (or alias) -> handle map, looked up without locking, replaced
+   * with a larger copy when it fills up */
+  NVRegistryNameMap *volatile name_map;
+  GList *retired_name_maps;
   guint32 nvhandle_max_value;
+  guint32 id;
 };
 
 extern const gchar *null_string;
@@ -188,6 +193,11 @@ nv_entry_get_name(NVEntry *self)
  * Dynamic values:
  *   - a dynamically sized NVIndexEntry array (contains ID + offset)
  *   - dynamic values are sorted by the global ID to make handle->entry lookups fast
+ *   - handles are usually set in increasing order and then they are simply
+ *     appended.  Out of order handles are inserted into a short tail at
+ *     the end of the index, which is sorted separately and merged into
+ *     the rest once it grows too long, so lookups are two binary searches
+ *     and adding a value doesn't need to move the whole index.
  *
  * Memory allocation
  * =================
@@ -207,6 +217,11 @@ nv_entry_get_name(NVEntry *self)
  *   - It is possible to clone an NVTable, which basically copies the
  *     underlying memory contents.
  *
+ *   - When a value is overwritten with a longer one, a new entry is
+ *     allocated and the old one becomes dead.  Dead entries (and the unused
+ *     space at the end of live ones) are dropped when the table is copied
+ *     by nv_table_realloc(), nv_table_clone() or by serialization.
+ *
  * Limits
  * ======
  * There might be various assumptions here and there in the code that fields
@@ -233,6 +248,15 @@ struct _NVTable
   guint8 ref_cnt:7,
     borrowed:1; /* specifies if the memory used by NVTable was borrowed from the container struct */
 
+  /* number of entries at the end of the index that are sorted separately
+   * from the ones preceding them, not serialized, as the serialized index
+   * is always merged */
+  guint16 index_tail_size;
+
+  /* bytes in the payload area occupied by entries that were replaced by
+   * a new one, reclaimed when the table is compacted, not serialized */
+  guint32 dead_bytes;
+
   /* variable data, see memory layout in the comment above */
   union
   {
@@ -260,6 +284,8 @@ gboolean nv_table_add_value_indirect(NVTable *self, NVHandle handle, const gchar
 gboolean nv_table_foreach(NVTable *self, NVRegistry *registry, NVTableForeachFunc func, gpointer user_data);
 gboolean nv_table_foreach_entry(NVTable *self, NVTableForeachEntryFunc func, gpointer user_data);
 
+void nv_table_copy_sorted_index(NVTable *self, NVIndexEntry *dest);
+
 void nv_table_clear(NVTable *self);
 NVTable *nv_table_new(gint num_static_values, gint index_size_hint, gint init_length);
 NVTable *nv_table_init_borrowed(gpointer space, gsize space_len, gint num_static_entries);
@@ -268,6 +294,9 @@ NVTable *nv_table_clone(NVTable *self, gint additional_space);
 NVTable *nv_table_ref(NVTable *self);
 void nv_table_unref(NVTable *self);
 
+void nv_table_global_init(void);
+void nv_table_global_deinit(void);
+
 static inline gsize
 nv_table_get_alloc_size(gint num_static_entries, gint index_size_hint, gint init_length)
 {
@@ -37,6 +37,8 @@ typedef struct _LogMessageSerializationState
   NVTable *nvtable;
   guint8 nvtable_flags;
   guint8 handle_changed;
+  /* the message was serialized using the same NVRegistry, handles are valid as they are */
+  guint8 same_registry;
   NVHandle *updated_sdata_handles;
   NVIndexEntry *updated_index;
 } LogMessageSerializationState;
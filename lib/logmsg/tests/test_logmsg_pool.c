@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2002-2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "testutils.h"
+#include "apphook.h"
+#include "logmsg/logmsg.h"
+#include "logmsg/logmsg-pool.h"
+#include "stats/stats-registry.h"
+
+#include <string.h>
+
+#define ERROR_MSG "Failed at %s(%d)", __FILE__, __LINE__
+
+static guint64
+_get_pool_hits(void)
+{
+  StatsCounterItem *hits = NULL;
+  guint64 result;
+
+  stats_lock();
+  stats_register_counter(0, SCS_GLOBAL, "msg_pool_hits", NULL, SC_TYPE_PROCESSED, &hits);
+  result = stats_counter_get(hits);
+  stats_unregister_counter(SCS_GLOBAL, "msg_pool_hits", NULL, SC_TYPE_PROCESSED, &hits);
+  stats_unlock();
+  return result;
+}
+
+static void
+test_freed_blocks_are_reused_by_the_same_thread(void)
+{
+  gpointer p1, p2;
+
+  p1 = log_msg_pool_alloc(1000);
+  log_msg_pool_free(p1);
+  p2 = log_msg_pool_alloc(900);
+  assert_true(p1 == p2, "a freed block of the same size class was not reused; " ERROR_MSG);
+  log_msg_pool_free(p2);
+}
+
+static void
+test_large_blocks_are_not_pooled(void)
+{
+  gchar *p;
+
+  p = log_msg_pool_alloc(1024 * 1024);
+  memset(p, 'x', 1024 * 1024);
+  p = log_msg_pool_realloc(p, 2 * 1024 * 1024);
+  assert_gint(p[1024 * 1024 - 1], 'x', ERROR_MSG);
+  log_msg_pool_free(p);
+}
+
+static void
+test_realloc_keeps_contents(void)
+{
+  gchar *p, *q;
+
+  p = log_msg_pool_alloc(100);
+  strcpy(p, "foobar");
+
+  q = log_msg_pool_realloc(p, 120);
+  assert_true(p == q, "realloc within the same size class should not move the block; " ERROR_MSG);
+
+  q = log_msg_pool_realloc(q, 10000);
+  assert_string(q, "foobar", ERROR_MSG);
+  log_msg_pool_free(q);
+}
+
+static gpointer
+_free_blocks_thread(gpointer user_data)
+{
+  GPtrArray *blocks = (GPtrArray *) user_data;
+  gint i;
+
+  app_thread_start();
+  for (i = 0; i < blocks->len; i++)
+    log_msg_pool_free(g_ptr_array_index(blocks, i));
+  app_thread_stop();
+  return NULL;
+}
+
+static void
+test_blocks_freed_by_other_threads_return_to_their_owner(void)
+{
+  GPtrArray *blocks = g_ptr_array_new();
+  GThread *thread;
+  gpointer p;
+  gboolean found = FALSE;
+  gint i;
+
+  for (i = 0; i < 16; i++)
+    g_ptr_array_add(blocks, log_msg_pool_alloc(3000));
+
+  thread = g_thread_create(_free_blocks_thread, blocks, TRUE, NULL);
+  g_thread_join(thread);
+
+  p = log_msg_pool_alloc(3000);
+  for (i = 0; i < blocks->len; i++)
+    found |= (g_ptr_array_index(blocks, i) == p);
+  assert_true(found, "blocks freed by another thread were not returned to the owner; " ERROR_MSG);
+
+  log_msg_pool_free(p);
+  g_ptr_array_free(blocks, TRUE);
+}
+
+static gpointer
+_unref_messages_thread(gpointer user_data)
+{
+  GPtrArray *msgs = (GPtrArray *) user_data;
+  gint i;
+
+  app_thread_start();
+  for (i = 0; i < msgs->len; i++)
+    log_msg_unref((LogMessage *) g_ptr_array_index(msgs, i));
+  app_thread_stop();
+  return NULL;
+}
+
+static void
+test_messages_can_be_freed_in_another_thread(void)
+{
+  GPtrArray *msgs = g_ptr_array_new();
+  LogMessage *msg;
+  GThread *thread;
+  gint i, j;
+
+  for (i = 0; i < 100; i++)
+    {
+      msg = log_msg_new_empty();
+      /* grow the payload beyond the space embedded into the message */
+      for (j = 0; j < 20; j++)
+        {
+          gchar name[16];
+
+          g_snprintf(name, sizeof(name), "foo%d", j);
+          log_msg_set_value_by_name(msg, name, "barbarbarbarbarbarbarbarbarbarbar", -1);
+        }
+      g_ptr_array_add(msgs, msg);
+    }
+
+  thread = g_thread_create(_unref_messages_thread, msgs, TRUE, NULL);
+  g_thread_join(thread);
+
+  /* allocations are served from the returned blocks */
+  for (i = 0; i < 100; i++)
+    log_msg_unref(log_msg_new_empty());
+
+  g_ptr_array_free(msgs, TRUE);
+}
+
+static gpointer
+_alloc_blocks_thread(gpointer user_data)
+{
+  GPtrArray *blocks = (GPtrArray *) user_data;
+  gint i;
+
+  app_thread_start();
+  for (i = 0; i < 16; i++)
+    g_ptr_array_add(blocks, log_msg_pool_alloc(3000));
+  app_thread_stop();
+  return NULL;
+}
+
+static gpointer
+_alloc_one_block_thread(gpointer user_data)
+{
+  app_thread_start();
+  log_msg_pool_free(log_msg_pool_alloc(3000));
+  app_thread_stop();
+  return NULL;
+}
+
+static void
+test_blocks_of_exited_threads_are_not_cached(void)
+{
+  GPtrArray *blocks = g_ptr_array_new();
+  GThread *thread;
+  guint64 hits;
+  gint i;
+
+  thread = g_thread_create(_alloc_blocks_thread, blocks, TRUE, NULL);
+  g_thread_join(thread);
+
+  for (i = 0; i < blocks->len; i++)
+    log_msg_pool_free(g_ptr_array_index(blocks, i));
+
+  /* the new thread adopts the pool of the exited one, which has to be empty */
+  hits = _get_pool_hits();
+  thread = g_thread_create(_alloc_one_block_thread, NULL, TRUE, NULL);
+  g_thread_join(thread);
+  assert_guint64(_get_pool_hits(), hits, "blocks freed after their owner exited were cached; " ERROR_MSG);
+
+  g_ptr_array_free(blocks, TRUE);
+}
+
+static void
+test_pooling_can_be_disabled(void)
+{
+  gpointer p;
+  guint64 hits;
+
+  log_msg_pool_set_max_size(0);
+  hits = _get_pool_hits();
+  p = log_msg_pool_alloc(1000);
+  log_msg_pool_free(p);
+  p = log_msg_pool_alloc(1000);
+  log_msg_pool_free(p);
+  assert_guint64(_get_pool_hits(), hits, "allocations were served from the pool while it was disabled; " ERROR_MSG);
+  log_msg_pool_set_max_size(LOG_MSG_POOL_DEFAULT_MAX_SIZE);
+}
+
+#define ALLOC_THREADS 16
+#define ALLOC_ITERATIONS 200000
+
+static gpointer
+_alloc_free_messages_thread(gpointer user_data)
+{
+  LogMessage *msgs[64];
+  gint i, j;
+
+  app_thread_start();
+  for (i = 0; i < ALLOC_ITERATIONS / G_N_ELEMENTS(msgs); i++)
+    {
+      for (j = 0; j < G_N_ELEMENTS(msgs); j++)
+        {
+          msgs[j] = log_msg_new_empty();
+          log_msg_set_value(msgs[j], LM_V_MESSAGE, "message", -1);
+        }
+      for (j = 0; j < G_N_ELEMENTS(msgs); j++)
+        log_msg_unref(msgs[j]);
+    }
+  app_thread_stop();
+  return NULL;
+}
+
+static void
+test_allocation_performance(gsize pool_size)
+{
+  GThread *threads[ALLOC_THREADS];
+  gint i;
+
+  log_msg_pool_set_max_size(pool_size);
+  start_stopwatch();
+  for (i = 0; i < ALLOC_THREADS; i++)
+    threads[i] = g_thread_create(_alloc_free_messages_thread, NULL, TRUE, NULL);
+  for (i = 0; i < ALLOC_THREADS; i++)
+    g_thread_join(threads[i]);
+  stop_stopwatch_and_display_result(ALLOC_THREADS * ALLOC_ITERATIONS,
+                                    "allocating %d messages in %d threads, pool size %d, took",
+                                    ALLOC_THREADS * ALLOC_ITERATIONS, ALLOC_THREADS, (gint) pool_size);
+  log_msg_pool_set_max_size(LOG_MSG_POOL_DEFAULT_MAX_SIZE);
+}
+
+int
+main(int argc, char **argv)
+{
+  app_startup();
+
+  test_freed_blocks_are_reused_by_the_same_thread();
+  test_large_blocks_are_not_pooled();
+  test_realloc_keeps_contents();
+  test_blocks_freed_by_other_threads_return_to_their_owner();
+  test_messages_can_be_freed_in_another_thread();
+  test_blocks_of_exited_threads_are_not_cached();
+  test_pooling_can_be_disabled();
+
+  test_allocation_performance(0);
+  test_allocation_performance(LOG_MSG_POOL_DEFAULT_MAX_SIZE);
+
+  app_shutdown();
+  return 0;
+}
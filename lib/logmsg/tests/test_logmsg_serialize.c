@@ -202,6 +202,29 @@ test_serialize(void)
 
 }
 
+static void
+test_serialize_and_deserialize_in_the_same_registry(void)
+{
+  gssize length = 0;
+  GString *stream = g_string_new("");
+
+  SerializeArchive *sa = _serialize_message_for_test(stream);
+  LogMessage *msg = log_msg_new_empty();
+
+  assert_gint(stream->str[0], 27, "serialized messages are expected to be in the v27 format");
+  assert_true(log_msg_deserialize(msg, sa), ERROR_MSG);
+
+  _check_deserialized_message(msg, sa);
+
+  const gchar *indirect_value = log_msg_get_value_by_name(msg, "indirect_1", &length);
+  assert_nstring(indirect_value, length, "val", 3, ERROR_MSG);
+  assert_string(log_msg_get_value_by_name(msg, ".normal.dynamic.field31", NULL), "value", ERROR_MSG);
+
+  log_msg_unref(msg);
+  serialize_archive_free(sa);
+  g_string_free(stream, TRUE);
+}
+
 static void
 test_pe_serialized_message(void)
 {
@@ -272,6 +295,7 @@ main(int argc, char **argv)
   msg_format_options_defaults(&parse_options);
   msg_format_options_init(&parse_options, cfg);
   test_serialize();
+  test_serialize_and_deserialize_in_the_same_registry();
   test_pe_serialized_message();
   test_serialization_performance();
   test_deserialization_performance();
@@ -140,6 +140,62 @@ Test(nvtable, test_nv_registry)
   nv_registry_free(reg);
 }
 
+#define TEST_NV_REGISTRY_THREADS 8
+#define TEST_NV_REGISTRY_NAMES 2000
+
+static gpointer
+_alloc_handles_thread(gpointer user_data)
+{
+  NVRegistry *reg = ((gpointer *) user_data)[0];
+  NVHandle *handles = ((gpointer *) user_data)[1];
+  gint i;
+
+  for (i = 0; i < TEST_NV_REGISTRY_NAMES; i++)
+    {
+      gchar name[16];
+
+      g_snprintf(name, sizeof(name), "DYN%05d", i);
+      handles[i] = nv_registry_alloc_handle(reg, name);
+    }
+  return NULL;
+}
+
+Test(nvtable, test_nv_registry_concurrent_lookups_resolve_to_the_same_handle)
+{
+  const gchar *builtins[] = { "BUILTIN1", NULL };
+  NVHandle handles[TEST_NV_REGISTRY_THREADS][TEST_NV_REGISTRY_NAMES];
+  gpointer args[TEST_NV_REGISTRY_THREADS][2];
+  GThread *threads[TEST_NV_REGISTRY_THREADS];
+  NVRegistry *reg;
+  gint i, t;
+
+  reg = nv_registry_new(builtins, NVHANDLE_MAX_VALUE);
+  for (t = 0; t < TEST_NV_REGISTRY_THREADS; t++)
+    {
+      args[t][0] = reg;
+      args[t][1] = handles[t];
+      threads[t] = g_thread_create(_alloc_handles_thread, args[t], TRUE, NULL);
+    }
+  for (t = 0; t < TEST_NV_REGISTRY_THREADS; t++)
+    g_thread_join(threads[t]);
+
+  for (i = 0; i < TEST_NV_REGISTRY_NAMES; i++)
+    {
+      gchar name[16];
+
+      g_snprintf(name, sizeof(name), "DYN%05d", i);
+      cr_assert_neq(handles[0][i], 0);
+      cr_assert_str_eq(nv_registry_get_handle_name(reg, handles[0][i], NULL), name);
+      cr_assert_eq(nv_registry_get_handle(reg, name), handles[0][i]);
+      for (t = 1; t < TEST_NV_REGISTRY_THREADS; t++)
+        cr_assert_eq(handles[t][i], handles[0][i], "threads resolved %s to different handles", name);
+    }
+  cr_assert_eq(nv_registry_get_handle(reg, "BUILTIN1"), 1);
+  cr_assert_eq(nv_registry_get_handle(reg, "NONEXISTENT"), 0);
+
+  nv_registry_free(reg);
+}
+
 /*
  *  - NVTable direct values
  *    - set/get static NV entries
@@ -739,6 +795,42 @@ Test(nvtable, test_nvtable_lookup)
     }
 }
 
+Test(nvtable, test_nvtable_out_of_order_handles_are_merged_into_a_sorted_index)
+{
+  NVTable *tab;
+  NVHandle handle;
+  NVIndexEntry sorted_index[1000];
+  gchar name[16];
+  gboolean success;
+  gint i;
+
+  tab = nv_table_new(STATIC_VALUES, 1000, 65536);
+
+  /* interleave descending and ascending handles so that both the tail and
+   * the sorted part of the index grow */
+  for (i = 0; i < 1000; i++)
+    {
+      handle = (i % 2) ? 2000 + i : 2000 - i;
+      g_snprintf(name, sizeof(name), "VAL%d", handle);
+      success = nv_table_add_value(tab, handle, name, strlen(name), name, strlen(name), NULL);
+      cr_assert(success);
+    }
+
+  for (i = 0; i < 1000; i++)
+    {
+      handle = (i % 2) ? 2000 + i : 2000 - i;
+      g_snprintf(name, sizeof(name), "VAL%d", handle);
+      assert_nvtable(tab, handle, name, strlen(name));
+    }
+  cr_assert_eq(tab->index_size, 1000);
+
+  nv_table_copy_sorted_index(tab, sorted_index);
+  for (i = 1; i < 1000; i++)
+    cr_assert_lt(sorted_index[i - 1].handle, sorted_index[i].handle);
+
+  nv_table_unref(tab);
+}
+
 Test(nvtable, test_nvtable_clone_grows_the_cloned_structure)
 {
   NVTable *tab, *tab_clone;
@@ -795,6 +887,76 @@ Test(nvtable, test_nvtable_realloc_doubles_nvtable_size)
 
 }
 
+static NVTable *
+_create_table_with_dead_entries(void)
+{
+  NVTable *tab;
+  gchar value[512];
+  gboolean success;
+  gint i;
+
+  memset(value, 'x', sizeof(value));
+  tab = nv_table_new(STATIC_VALUES, STATIC_VALUES, 4096);
+
+  /* each value is longer than the previous one, so it never fits in place */
+  for (i = 1; i <= 10; i++)
+    {
+      success = nv_table_add_value(tab, DYN_HANDLE, DYN_NAME, strlen(DYN_NAME), value, i * 32, NULL);
+      cr_assert(success);
+    }
+  success = nv_table_add_value_indirect(tab, DYN_HANDLE + 1, "VAL18", 5, DYN_HANDLE, 0, 1, 10, NULL);
+  cr_assert(success);
+  success = nv_table_add_value(tab, STATIC_HANDLE, STATIC_NAME, strlen(STATIC_NAME), "value", 5, NULL);
+  cr_assert(success);
+  cr_assert_gt(tab->dead_bytes, 0);
+  return tab;
+}
+
+static void
+_assert_table_with_dead_entries(NVTable *tab)
+{
+  gchar value[512];
+
+  memset(value, 'x', sizeof(value));
+  assert_nvtable(tab, DYN_HANDLE, value, 320);
+  assert_nvtable(tab, DYN_HANDLE + 1, value + 1, 10);
+  assert_nvtable(tab, STATIC_HANDLE, "value", 5);
+}
+
+Test(nvtable, test_nvtable_clone_drops_dead_entries)
+{
+  NVTable *tab, *tab_clone;
+
+  tab = _create_table_with_dead_entries();
+  tab_clone = nv_table_clone(tab, 0);
+
+  cr_assert_eq(tab_clone->dead_bytes, 0);
+  cr_assert_leq(tab_clone->used, tab->used - tab->dead_bytes);
+  _assert_table_with_dead_entries(tab_clone);
+
+  nv_table_unref(tab_clone);
+  nv_table_unref(tab);
+}
+
+Test(nvtable, test_nvtable_realloc_compacts_instead_of_growing_if_enough_space_is_dead)
+{
+  NVTable *tab;
+  gsize old_size, old_used;
+
+  tab = _create_table_with_dead_entries();
+  old_size = tab->size;
+  old_used = tab->used;
+  cr_assert_geq(tab->dead_bytes, old_size / 4);
+
+  cr_assert(nv_table_realloc(tab, &tab));
+  cr_assert_eq(tab->size, old_size);
+  cr_assert_lt(tab->used, old_used);
+  cr_assert_eq(tab->dead_bytes, 0);
+  _assert_table_with_dead_entries(tab);
+
+  nv_table_unref(tab);
+}
+
 Test(nvtable, test_nvtable_realloc_sets_size_to_nv_table_max_bytes_at_most)
 {
   NVTable *tab;
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2002-2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "testutils.h"
+#include "apphook.h"
+#include "logmsg/nvtable.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define STATIC_VALUES 16
+#define BENCHMARK_FIELDS_TOTAL 2000000
+
+static gboolean success = TRUE;
+
+static void
+_generate_handles(NVHandle *handles, gint num_fields, gboolean shuffle)
+{
+  gint i;
+
+  for (i = 0; i < num_fields; i++)
+    handles[i] = STATIC_VALUES + 1 + i;
+
+  if (!shuffle)
+    return;
+
+  for (i = num_fields - 1; i > 0; i--)
+    {
+      gint j = rand() % (i + 1);
+      NVHandle tmp = handles[i];
+
+      handles[i] = handles[j];
+      handles[j] = tmp;
+    }
+}
+
+static void
+_fill_and_lookup(NVHandle *handles, gint num_fields)
+{
+  NVTable *tab;
+  gchar name[16];
+  gssize len;
+  gint i;
+
+  tab = nv_table_new(STATIC_VALUES, num_fields, num_fields * 64);
+  for (i = 0; i < num_fields; i++)
+    {
+      g_snprintf(name, sizeof(name), "F%d", handles[i]);
+      if (!nv_table_add_value(tab, handles[i], name, strlen(name), name, strlen(name), NULL))
+        {
+          fprintf(stderr, "Error adding value, handle=%d\n", handles[i]);
+          success = FALSE;
+          break;
+        }
+    }
+  for (i = 0; i < num_fields; i++)
+    {
+      nv_table_get_value(tab, handles[i], &len);
+      if (len == 0)
+        success = FALSE;
+    }
+  nv_table_unref(tab);
+}
+
+static void
+_test_fields(gint num_fields, gboolean shuffle)
+{
+  NVHandle handles[num_fields];
+  gint iterations = BENCHMARK_FIELDS_TOTAL / num_fields;
+  gint i;
+
+  _generate_handles(handles, num_fields, shuffle);
+
+  start_stopwatch();
+  for (i = 0; i < iterations; i++)
+    _fill_and_lookup(handles, num_fields);
+  stop_stopwatch_and_display_result(iterations, "setting and looking up %d fields, %s order, %d iterations took",
+                                    num_fields, shuffle ? "random" : "increasing", iterations);
+}
+
+int
+main(int argc, char *argv[])
+{
+  app_startup();
+
+  srand(time(NULL));
+  _test_fields(10, FALSE);
+  _test_fields(10, TRUE);
+  _test_fields(100, FALSE);
+  _test_fields(100, TRUE);
+  _test_fields(1000, FALSE);
+  _test_fields(1000, TRUE);
+
+  app_shutdown();
+  return !success;
+}
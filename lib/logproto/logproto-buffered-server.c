@@ -545,7 +545,9 @@ log_proto_buffered_server_prepare(LogProtoServer *s, GIOCondition *cond)
   if (*cond == 0)
     *cond = G_IO_IN;
 
-  return FALSE;
+  /* transports reading ahead (e.g. batched datagram receive) may hold
+   * input that would not wake us up via poll() */
+  return log_transport_has_pending_input(self->super.transport);
 }
 
 static gint
@@ -65,6 +65,8 @@ struct _LogProtoClient
   gboolean (*prepare)(LogProtoClient *s, gint *fd, GIOCondition *cond);
   LogProtoStatus (*post)(LogProtoClient *s, guchar *msg, gsize msg_len, gboolean *consumed);
   LogProtoStatus (*flush)(LogProtoClient *s);
+  /* completes the asynchronous writes, called before the writer leaves its queue */
+  LogProtoStatus (*drain)(LogProtoClient *s);
   gboolean (*validate_options)(LogProtoClient *s);
   void (*free_fn)(LogProtoClient *s);
   LogProtoClientFlowControlFuncs flow_control_funcs;
@@ -112,6 +114,15 @@ log_proto_client_flush(LogProtoClient *s)
     return LPS_SUCCESS;
 }
 
+static inline LogProtoStatus
+log_proto_client_drain(LogProtoClient *s)
+{
+  if (s->drain)
+    return s->drain(s);
+  else
+    return LPS_SUCCESS;
+}
+
 static inline LogProtoStatus
 log_proto_client_post(LogProtoClient *s, guchar *msg, gsize msg_len, gboolean *consumed)
 {
@@ -28,6 +28,11 @@
 #include "plugin.h"
 #include "plugin-types.h"
 
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 /**
  * Find the character terminating the buffer.
  *
@@ -36,10 +41,39 @@
  * sure that there's no NUL left in the message. This function iterates over
  * the input data and returns a pointer to the first occurence of NL or NUL.
  *
- * It uses an algorithm similar to what there's in libc memchr/strchr.
+ * With SSE2 it checks 16 bytes at a time, otherwise it uses an algorithm
+ * similar to what there's in libc memchr/strchr.
  *
  * NOTE: find_eom is not static as it is used by a unit test program.
  **/
+#ifdef __SSE2__
+
+const guchar *
+find_eom(const guchar *s, gsize n)
+{
+  const guchar *end = s + n;
+  const __m128i lf = _mm_set1_epi8('\n');
+  const __m128i nul = _mm_setzero_si128();
+
+  for (; end - s >= 16; s += 16)
+    {
+      __m128i block = _mm_loadu_si128((const __m128i *) s);
+      gint mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, lf), _mm_cmpeq_epi8(block, nul)));
+
+      if (mask)
+        return s + g_bit_nth_lsf(mask, -1);
+    }
+
+  for (; s < end; s++)
+    {
+      if (*s == '\n' || *s == '\0')
+        return s;
+    }
+  return NULL;
+}
+
+#else
+
 const guchar *
 find_eom(const guchar *s, gsize n)
 {
@@ -100,6 +134,8 @@ find_eom(const guchar *s, gsize n)
   return NULL;
 }
 
+#endif
+
 gboolean
 log_proto_server_validate_options_method(LogProtoServer *s)
 {
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2008-2013 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "testutils.h"
+#include "logproto/logproto-server.h"
+#include "utf8utils.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define BUFFER_SIZE (16 * 1024 * 1024)
+#define ITERATIONS 10
+
+/* sizes of the messages in the buffer, most syslog traffic is short
+ * lines, with the occasional large one */
+static gsize
+_random_message_length(void)
+{
+  gint r = rand() % 100;
+
+  if (r < 60)
+    return 60 + rand() % 100;
+  else if (r < 90)
+    return 160 + rand() % 350;
+  else if (r < 99)
+    return 512 + rand() % 1536;
+  return 2048 + rand() % 6144;
+}
+
+static const gchar *utf8_words[] = { "árvíztűrő", "tükörfúrógép", "Größe", "наименование" };
+
+static gchar *
+_generate_buffer(gboolean with_utf8, gsize *buffer_len, gsize *messages)
+{
+  gchar *buffer = g_malloc(BUFFER_SIZE);
+  gchar *p = buffer;
+  gsize n = 0;
+
+  while (p - buffer < BUFFER_SIZE - 8192 - 64)
+    {
+      gchar *end = p + _random_message_length();
+
+      while (p < end)
+        {
+          if (with_utf8 && rand() % 16 == 0)
+            {
+              const gchar *word = utf8_words[rand() % G_N_ELEMENTS(utf8_words)];
+
+              memcpy(p, word, strlen(word));
+              p += strlen(word);
+            }
+          else
+            {
+              *p++ = rand() % 8 == 0 ? ' ' : 'a' + rand() % 26;
+            }
+        }
+      *p++ = '\n';
+      n++;
+    }
+  *buffer_len = p - buffer;
+  *messages = n;
+  return buffer;
+}
+
+static gsize
+_frame_buffer(const gchar *buffer, gsize buffer_len, gboolean validate_utf8, gboolean use_glib)
+{
+  const guchar *p = (const guchar *) buffer;
+  const guchar *end = p + buffer_len;
+  const guchar *eom;
+  gsize valid = 0;
+
+  while ((eom = find_eom(p, end - p)))
+    {
+      if (validate_utf8)
+        {
+          if (use_glib)
+            valid += g_utf8_validate((const gchar *) p, eom - p, NULL);
+          else
+            valid += is_valid_utf8((const gchar *) p, eom - p);
+        }
+      p = eom + 1;
+    }
+  return valid;
+}
+
+static void
+_test_framing(gboolean with_utf8)
+{
+  gsize messages, buffer_len, valid;
+  gchar *buffer = _generate_buffer(with_utf8, &buffer_len, &messages);
+  gint i;
+
+  start_stopwatch();
+  for (i = 0; i < ITERATIONS; i++)
+    _frame_buffer(buffer, buffer_len, FALSE, FALSE);
+  stop_stopwatch_and_display_result(ITERATIONS, "framing %d messages (%s), %d iterations took",
+                                    (gint) messages, with_utf8 ? "utf8" : "ascii", ITERATIONS);
+
+  start_stopwatch();
+  for (i = 0; i < ITERATIONS; i++)
+    valid = _frame_buffer(buffer, buffer_len, TRUE, TRUE);
+  stop_stopwatch_and_display_result(ITERATIONS, "framing and validating %d messages (%s) with g_utf8_validate(), %d iterations took",
+                                    (gint) messages, with_utf8 ? "utf8" : "ascii", ITERATIONS);
+  assert_gint((gint) valid, (gint) messages, "not all messages were found to be valid utf8");
+
+  start_stopwatch();
+  for (i = 0; i < ITERATIONS; i++)
+    valid = _frame_buffer(buffer, buffer_len, TRUE, FALSE);
+  stop_stopwatch_and_display_result(ITERATIONS, "framing and validating %d messages (%s) with is_valid_utf8(), %d iterations took",
+                                    (gint) messages, with_utf8 ? "utf8" : "ascii", ITERATIONS);
+  assert_gint((gint) valid, (gint) messages, "not all messages were found to be valid utf8");
+
+  g_free(buffer);
+}
+
+int
+main(int argc, char *argv[])
+{
+  srand(0);
+  _test_framing(FALSE);
+  _test_framing(TRUE);
+  return 0;
+}
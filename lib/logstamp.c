@@ -26,6 +26,9 @@
 #include "messages.h"
 #include "timeutils.h"
 #include "str-format.h"
+#include "tls-support.h"
+
+#include <string.h>
 
 static void
 log_stamp_append_frac_digits(const LogStamp *stamp, GString *target, gint frac_digits)
@@ -48,29 +51,42 @@ log_stamp_append_frac_digits(const LogStamp *stamp, GString *target, gint frac_d
     }
 }
 
-/**
- * log_stamp_format:
- * @stamp: Timestamp to format
- * @target: Target storage for formatted timestamp
- * @ts_format: Specifies basic timestamp format (TS_FMT_BSD, TS_FMT_ISO)
- * @zone_offset: Specifies custom zone offset if @tz_convert == TZ_CNV_CUSTOM
+/*
+ * Formatting cache
  *
- * Emits the formatted version of @stamp into @target as specified by
- * @ts_format and @tz_convert.
- **/
-void
-log_stamp_append_format(const LogStamp *stamp, GString *target, gint ts_format, glong zone_offset, gint frac_digits)
+ * A destination formats the timestamps of a handful of seconds over and
+ * over again, so the formatted form without the fraction of a second (and
+ * the zone info that follows it in ISO format) is remembered per thread,
+ * keyed by (seconds, zone offset, format).
+ */
+#define FORMAT_CACHE_SIZE 16
+
+typedef struct _LogStampFormatCache
+{
+  time_t tv_sec;
+  glong zone_offset;
+  gint ts_format;
+  /* 0 means the entry is unused */
+  gint prefix_len;
+  gint suffix_len;
+  gchar prefix[32];
+  gchar suffix[8];
+} LogStampFormatCache;
+
+TLS_BLOCK_START
+{
+  LogStampFormatCache format_cache[FORMAT_CACHE_SIZE];
+}
+TLS_BLOCK_END;
+
+#define format_cache  __tls_deref(format_cache)
+
+static void
+log_stamp_append_format_prefix(const LogStamp *stamp, GString *target, gint ts_format, glong target_zone_offset)
 {
-  glong target_zone_offset = 0;
   struct tm *tm, tm_storage;
-  char buf[8];
   time_t t;
 
-  if (zone_offset != -1)
-    target_zone_offset = zone_offset;
-  else
-    target_zone_offset = stamp->zone_offset;
-
   t = stamp->tv_sec + target_zone_offset;
   cached_gmtime(&t, &tm_storage);
   tm = &tm_storage;
@@ -86,7 +102,6 @@ log_stamp_append_format(const LogStamp *stamp, GString *target, gint ts_format,
       format_uint32_padded(target, 2, '0', 10, tm->tm_min);
       g_string_append_c(target, ':');
       format_uint32_padded(target, 2, '0', 10, tm->tm_sec);
-      log_stamp_append_frac_digits(stamp, target, frac_digits);
       break;
     case TS_FMT_ISO:
       format_uint32_padded(target, 0, 0, 10, tm->tm_year + 1900);
@@ -100,10 +115,6 @@ log_stamp_append_format(const LogStamp *stamp, GString *target, gint ts_format,
       format_uint32_padded(target, 2, '0', 10, tm->tm_min);
       g_string_append_c(target, ':');
       format_uint32_padded(target, 2, '0', 10, tm->tm_sec);
-
-      log_stamp_append_frac_digits(stamp, target, frac_digits);
-      format_zone_info(buf, sizeof(buf), target_zone_offset);
-      g_string_append(target, buf);
       break;
     case TS_FMT_FULL:
       format_uint32_padded(target, 0, 0, 10, tm->tm_year + 1900);
@@ -117,12 +128,9 @@ log_stamp_append_format(const LogStamp *stamp, GString *target, gint ts_format,
       format_uint32_padded(target, 2, '0', 10, tm->tm_min);
       g_string_append_c(target, ':');
       format_uint32_padded(target, 2, '0', 10, tm->tm_sec);
-
-      log_stamp_append_frac_digits(stamp, target, frac_digits);
       break;
     case TS_FMT_UNIX:
       format_uint32_padded(target, 0, 0, 10, (int) stamp->tv_sec);
-      log_stamp_append_frac_digits(stamp, target, frac_digits);
       break;
     default:
       g_assert_not_reached();
@@ -130,6 +138,86 @@ log_stamp_append_format(const LogStamp *stamp, GString *target, gint ts_format,
     }
 }
 
+static LogStampFormatCache *
+log_stamp_format_cache_fill(LogStampFormatCache *entry, const LogStamp *stamp, GString *target, gint ts_format,
+                            glong target_zone_offset)
+{
+  gsize start = target->len;
+
+  log_stamp_append_format_prefix(stamp, target, ts_format, target_zone_offset);
+
+  if (target->len - start >= sizeof(entry->prefix))
+    {
+      entry->prefix_len = 0;
+      return NULL;
+    }
+
+  entry->tv_sec = stamp->tv_sec;
+  entry->zone_offset = target_zone_offset;
+  entry->ts_format = ts_format;
+  entry->prefix_len = target->len - start;
+  memcpy(entry->prefix, target->str + start, entry->prefix_len);
+
+  if (ts_format == TS_FMT_ISO)
+    {
+      format_zone_info(entry->suffix, sizeof(entry->suffix), target_zone_offset);
+      entry->suffix_len = strlen(entry->suffix);
+    }
+  else
+    {
+      entry->suffix_len = 0;
+    }
+  return entry;
+}
+
+/**
+ * log_stamp_format:
+ * @stamp: Timestamp to format
+ * @target: Target storage for formatted timestamp
+ * @ts_format: Specifies basic timestamp format (TS_FMT_BSD, TS_FMT_ISO)
+ * @zone_offset: Specifies custom zone offset if @tz_convert == TZ_CNV_CUSTOM
+ *
+ * Emits the formatted version of @stamp into @target as specified by
+ * @ts_format and @tz_convert.
+ **/
+void
+log_stamp_append_format(const LogStamp *stamp, GString *target, gint ts_format, glong zone_offset, gint frac_digits)
+{
+  glong target_zone_offset = 0;
+  LogStampFormatCache *entry;
+  char buf[8];
+
+  if (zone_offset != -1)
+    target_zone_offset = zone_offset;
+  else
+    target_zone_offset = stamp->zone_offset;
+
+  entry = &format_cache[((guint) stamp->tv_sec * 4 + ts_format) % FORMAT_CACHE_SIZE];
+  if (entry->prefix_len &&
+      entry->tv_sec == stamp->tv_sec &&
+      entry->zone_offset == target_zone_offset &&
+      entry->ts_format == ts_format)
+    {
+      g_string_append_len(target, entry->prefix, entry->prefix_len);
+    }
+  else
+    {
+      entry = log_stamp_format_cache_fill(entry, stamp, target, ts_format, target_zone_offset);
+    }
+
+  log_stamp_append_frac_digits(stamp, target, frac_digits);
+
+  if (entry)
+    {
+      g_string_append_len(target, entry->suffix, entry->suffix_len);
+    }
+  else if (ts_format == TS_FMT_ISO)
+    {
+      format_zone_info(buf, sizeof(buf), target_zone_offset);
+      g_string_append(target, buf);
+    }
+}
+
 void
 log_stamp_format(LogStamp *stamp, GString *target, gint ts_format, glong zone_offset, gint frac_digits)
 {
@@ -24,40 +24,106 @@
 
 #include "logthrdestdrv.h"
 #include "seqnum.h"
+#include "scratch-buffers.h"
+#include "tls-support.h"
 
 #define MAX_RETRIES_OF_FAILED_INSERT_DEFAULT 3
 
+TLS_BLOCK_START
+{
+  LogThrDestWorker *current_worker;
+}
+TLS_BLOCK_END;
+
+#define current_worker __tls_deref(current_worker)
+
+/* the first worker keeps the original persist names, so existing queues
+ * (e.g. disk buffers) and sequence numbers are picked up when switching to
+ * multiple workers */
+static gchar *
+log_threaded_dest_driver_format_seqnum_for_persist(LogThrDestDriver *self, gint worker_index)
+{
+  static gchar persist_name[256];
+  const gchar *driver_persist_name = self->super.super.super.generate_persist_name((const LogPipe *)self);
+
+  if (worker_index == 0)
+    g_snprintf(persist_name, sizeof(persist_name), "%s.seqnum", driver_persist_name);
+  else
+    g_snprintf(persist_name, sizeof(persist_name), "%s.seqnum.%d", driver_persist_name, worker_index);
+
+  return persist_name;
+}
+
 static gchar *
-log_threaded_dest_driver_format_seqnum_for_persist(LogThrDestDriver *self)
+log_threaded_dest_driver_format_queue_persist_name(LogThrDestDriver *self, gint worker_index)
 {
   static gchar persist_name[256];
+  const gchar *driver_persist_name = self->super.super.super.generate_persist_name((const LogPipe *)self);
 
-  g_snprintf(persist_name, sizeof(persist_name), "%s.seqnum",
+  if (worker_index == 0)
+    return (gchar *) driver_persist_name;
+
+  g_snprintf(persist_name, sizeof(persist_name), "%s.%d", driver_persist_name, worker_index);
+  return persist_name;
+}
+
+static gchar *
+log_threaded_dest_driver_format_num_workers_for_persist(LogThrDestDriver *self)
+{
+  static gchar persist_name[256];
+
+  g_snprintf(persist_name, sizeof(persist_name), "%s.workers",
              self->super.super.super.generate_persist_name((const LogPipe *)self));
 
   return persist_name;
 }
 
-void
-log_threaded_dest_driver_suspend(LogThrDestDriver *self)
+static gchar *
+log_threaded_dest_worker_format_stats_instance(LogThrDestWorker *self)
+{
+  static gchar stats_instance[1024];
+  LogThrDestDriver *owner = self->owner;
+
+  g_snprintf(stats_instance, sizeof(stats_instance), "%s#%d",
+             owner->format.stats_instance(owner), self->worker_index);
+  return stats_instance;
+}
+
+static void
+log_threaded_dest_worker_suspend(LogThrDestWorker *self)
 {
   iv_validate_now();
   self->timer_reopen.expires  = iv_now;
-  self->timer_reopen.expires.tv_sec += self->time_reopen;
+  self->timer_reopen.expires.tv_sec += self->owner->time_reopen;
   iv_timer_register(&self->timer_reopen);
 }
 
+/* NOTE: is to be called from the worker thread */
+void
+log_threaded_dest_driver_suspend(LogThrDestDriver *self)
+{
+  log_threaded_dest_worker_suspend(log_threaded_dest_driver_get_current_worker(self));
+}
+
+LogThrDestWorker *
+log_threaded_dest_driver_get_current_worker(LogThrDestDriver *self)
+{
+  if (current_worker && current_worker->owner == self)
+    return current_worker;
+  return &self->workers[0];
+}
+
 static void
-log_threaded_dest_driver_message_became_available_in_the_queue(gpointer user_data)
+log_threaded_dest_worker_message_became_available_in_the_queue(gpointer user_data)
 {
-  LogThrDestDriver *self = (LogThrDestDriver *) user_data;
+  LogThrDestWorker *self = (LogThrDestWorker *) user_data;
   iv_event_post(&self->wake_up_event);
 }
 
 static void
-log_threaded_dest_driver_wake_up(gpointer data)
+log_threaded_dest_worker_wake_up(gpointer data)
 {
-  LogThrDestDriver *self = (LogThrDestDriver *)data;
+  LogThrDestWorker *self = (LogThrDestWorker *)data;
 
   if (!iv_task_registered(&self->do_work))
     {
@@ -66,13 +132,13 @@ log_threaded_dest_driver_wake_up(gpointer data)
 }
 
 static void
-log_threaded_dest_driver_start_watches(LogThrDestDriver *self)
+log_threaded_dest_worker_start_watches(LogThrDestWorker *self)
 {
   iv_task_register(&self->do_work);
 }
 
 static void
-log_threaded_dest_driver_stop_watches(LogThrDestDriver *self)
+log_threaded_dest_worker_stop_watches(LogThrDestWorker *self)
 {
   if (iv_task_registered(&self->do_work))
     {
@@ -89,58 +155,218 @@ log_threaded_dest_driver_stop_watches(LogThrDestDriver *self)
 }
 
 static void
-log_threaded_dest_driver_shutdown(gpointer data)
+log_threaded_dest_worker_shutdown(gpointer data)
 {
-  LogThrDestDriver *self = (LogThrDestDriver *)data;
-  log_threaded_dest_driver_stop_watches(self);
+  LogThrDestWorker *self = (LogThrDestWorker *)data;
+  log_threaded_dest_worker_stop_watches(self);
+  if (iv_timer_registered(&self->timer_flush))
+    {
+      iv_timer_unregister(&self->timer_flush);
+    }
   iv_quit();
 }
 
 
 static void
-__connect(LogThrDestDriver *self)
+__connect(LogThrDestWorker *self)
 {
-  self->worker.connected = TRUE;
-  if (self->worker.connect)
+  LogThrDestDriver *owner = self->owner;
+
+  self->connected = TRUE;
+  if (owner->worker.connect)
     {
-      self->worker.connected = self->worker.connect(self);
+      self->connected = owner->worker.connect(owner);
     }
 
-  if (!self->worker.connected)
+  if (!self->connected)
     {
       log_queue_reset_parallel_push(self->queue);
-      log_threaded_dest_driver_suspend(self);
+      log_threaded_dest_worker_suspend(self);
     }
   else
     {
-      log_threaded_dest_driver_start_watches(self);
+      log_threaded_dest_worker_start_watches(self);
     }
 }
 
 static void
-__disconnect(LogThrDestDriver *self)
+__disconnect(LogThrDestWorker *self)
 {
-  if (self->worker.disconnect)
+  LogThrDestDriver *owner = self->owner;
+
+  if (owner->worker.disconnect)
     {
-      self->worker.disconnect(self);
+      owner->worker.disconnect(owner);
     }
-  self->worker.connected = FALSE;
+  self->connected = FALSE;
 }
 
 
 
 static void
-_disconnect_and_suspend(LogThrDestDriver *self)
+_disconnect_and_suspend(LogThrDestWorker *self)
 {
   self->suspended = TRUE;
   __disconnect(self);
   log_queue_reset_parallel_push(self->queue);
-  log_threaded_dest_driver_suspend(self);
+  log_threaded_dest_worker_suspend(self);
+}
+
+static void
+_batch_add_message(LogThrDestWorker *self)
+{
+  if (self->batch.size == 0)
+    {
+      self->batch.seq_num = *self->seq_num;
+      iv_validate_now();
+      self->batch.started = iv_now;
+    }
+  self->batch.size++;
+}
+
+static void
+_batch_reset(LogThrDestWorker *self)
+{
+  self->batch.size = 0;
+  if (iv_timer_registered(&self->timer_flush))
+    iv_timer_unregister(&self->timer_flush);
+}
+
+static void
+_batch_accept(LogThrDestWorker *self)
+{
+  gint i;
+
+  self->retries_counter = 0;
+  *self->seq_num = self->batch.seq_num;
+  for (i = 0; i < self->batch.size; i++)
+    step_sequence_number(self->seq_num);
+  log_queue_ack_backlog(self->queue, self->batch.size);
+  _batch_reset(self);
+}
+
+static void
+_batch_drop(LogThrDestWorker *self)
+{
+  stats_counter_add(self->owner->dropped_messages, self->batch.size);
+  _batch_accept(self);
+}
+
+static void
+_batch_rewind(LogThrDestWorker *self)
+{
+  log_queue_rewind_backlog(self->queue, self->batch.size);
+  *self->seq_num = self->batch.seq_num;
+  _batch_reset(self);
+}
+
+/*
+ * The result applies to all messages in the current batch: without
+ * batching (insert() never returns QUEUED) this is the single message
+ * we've just popped.  @msg is NULL if the result comes from flush().
+ */
+static void
+_process_result(LogThrDestWorker *self, worker_insert_result_t result, LogMessage *msg)
+{
+  LogThrDestDriver *owner = self->owner;
+
+  switch (result)
+    {
+    case WORKER_INSERT_RESULT_DROP:
+      _batch_drop(self);
+      _disconnect_and_suspend(self);
+      break;
+
+    case WORKER_INSERT_RESULT_ERROR:
+      self->retries_counter++;
+
+      if (self->retries_counter >= owner->retries.max)
+        {
+          if (owner->messages.retry_over && msg)
+            owner->messages.retry_over(owner, msg);
+          _batch_drop(self);
+        }
+      else
+        {
+          _batch_rewind(self);
+          _disconnect_and_suspend(self);
+        }
+      break;
+
+    case WORKER_INSERT_RESULT_NOT_CONNECTED:
+      _batch_rewind(self);
+      _disconnect_and_suspend(self);
+      break;
+
+    case WORKER_INSERT_RESULT_REWIND:
+      _batch_rewind(self);
+      break;
+
+    case WORKER_INSERT_RESULT_SUCCESS:
+      _batch_accept(self);
+      break;
+
+    case WORKER_INSERT_RESULT_QUEUED:
+      step_sequence_number(self->seq_num);
+      break;
+
+    default:
+      break;
+    }
+}
+
+static void
+log_threaded_dest_worker_flush(LogThrDestWorker *self)
+{
+  LogThrDestDriver *owner = self->owner;
+
+  if (self->batch.size == 0 || !owner->worker.flush)
+    return;
+
+  _process_result(self, owner->worker.flush(owner), NULL);
+}
+
+static void
+log_threaded_dest_worker_flush_timer_expired(gpointer data)
+{
+  LogThrDestWorker *self = (LogThrDestWorker *)data;
+
+  log_threaded_dest_worker_flush(self);
+}
+
+static void
+log_threaded_dest_worker_schedule_flush(LogThrDestWorker *self)
+{
+  struct timespec flush_at;
+  gint timeout = self->owner->batch.timeout;
+
+  if (self->batch.size == 0 || iv_timer_registered(&self->timer_flush))
+    return;
+
+  if (timeout <= 0)
+    {
+      log_threaded_dest_worker_flush(self);
+      return;
+    }
+
+  flush_at = self->batch.started;
+  timespec_add_msec(&flush_at, timeout);
+
+  iv_validate_now();
+  if (timespec_diff_msec(&iv_now, &flush_at) >= 0)
+    {
+      log_threaded_dest_worker_flush(self);
+      return;
+    }
+
+  self->timer_flush.expires = flush_at;
+  iv_timer_register(&self->timer_flush);
 }
 
 static void
-log_threaded_dest_driver_do_insert(LogThrDestDriver *self)
+log_threaded_dest_worker_do_insert(LogThrDestWorker *self)
 {
+  LogThrDestDriver *owner = self->owner;
   LogMessage *msg;
   worker_insert_result_t result;
   LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
@@ -151,81 +377,45 @@ log_threaded_dest_driver_do_insert(LogThrDestDriver *self)
       msg_set_context(msg);
       log_msg_refcache_start_consumer(msg, &path_options);
 
-      result = self->worker.insert(self, msg);
-
-      switch (result)
-        {
-        case WORKER_INSERT_RESULT_DROP:
-          log_threaded_dest_driver_message_drop(self, msg);
-          _disconnect_and_suspend(self);
-          break;
-
-        case WORKER_INSERT_RESULT_ERROR:
-          self->retries.counter++;
-
-          if (self->retries.counter >= self->retries.max)
-            {
-              if (self->messages.retry_over)
-                self->messages.retry_over(self, msg);
-              log_threaded_dest_driver_message_drop(self, msg);
-            }
-          else
-            {
-              log_threaded_dest_driver_message_rewind(self, msg);
-              _disconnect_and_suspend(self);
-            }
-          break;
-
-        case WORKER_INSERT_RESULT_NOT_CONNECTED:
-          log_threaded_dest_driver_message_rewind(self, msg);
-          _disconnect_and_suspend(self);
-          break;
-
-        case WORKER_INSERT_RESULT_REWIND:
-          log_threaded_dest_driver_message_rewind(self, msg);
-          break;
-
-        case WORKER_INSERT_RESULT_SUCCESS:
-          log_threaded_dest_driver_message_accept(self, msg);
-          break;
-
-        default:
-          break;
-        }
+      _batch_add_message(self);
+      result = owner->worker.insert(owner, msg);
+      _process_result(self, result, msg);
+      log_msg_unref(msg);
 
       msg_set_context(NULL);
       log_msg_refcache_stop();
     }
   if (!self->suspended)
     {
-      if (self->worker.worker_message_queue_empty)
+      log_threaded_dest_worker_schedule_flush(self);
+      if (!self->suspended && owner->worker.worker_message_queue_empty)
         {
-          self->worker.worker_message_queue_empty(self);
+          owner->worker.worker_message_queue_empty(owner);
         }
     }
 }
 
 static void
-log_threaded_dest_driver_do_work(gpointer data)
+log_threaded_dest_worker_do_work(gpointer data)
 {
-  LogThrDestDriver *self = (LogThrDestDriver *)data;
+  LogThrDestWorker *self = (LogThrDestWorker *)data;
   gint timeout_msec = 0;
 
   self->suspended = FALSE;
-  log_threaded_dest_driver_stop_watches(self);
+  log_threaded_dest_worker_stop_watches(self);
 
-  if (!self->worker.connected)
+  if (!self->connected)
     {
       __connect(self);
     }
 
   else if (log_queue_check_items(self->queue, &timeout_msec,
-                                 log_threaded_dest_driver_message_became_available_in_the_queue,
+                                 log_threaded_dest_worker_message_became_available_in_the_queue,
                                  self, NULL))
     {
-      log_threaded_dest_driver_do_insert(self);
+      log_threaded_dest_worker_do_insert(self);
       if (!self->suspended)
-        log_threaded_dest_driver_start_watches(self);
+        log_threaded_dest_worker_start_watches(self);
     }
   else if (timeout_msec != 0)
     {
@@ -238,93 +428,253 @@ log_threaded_dest_driver_do_work(gpointer data)
 }
 
 static void
-log_threaded_dest_driver_init_watches(LogThrDestDriver *self)
+log_threaded_dest_worker_init_watches(LogThrDestWorker *self)
 {
   IV_EVENT_INIT(&self->wake_up_event);
   self->wake_up_event.cookie = self;
-  self->wake_up_event.handler = log_threaded_dest_driver_wake_up;
+  self->wake_up_event.handler = log_threaded_dest_worker_wake_up;
   iv_event_register(&self->wake_up_event);
 
   IV_EVENT_INIT(&self->shutdown_event);
   self->shutdown_event.cookie = self;
-  self->shutdown_event.handler = log_threaded_dest_driver_shutdown;
+  self->shutdown_event.handler = log_threaded_dest_worker_shutdown;
   iv_event_register(&self->shutdown_event);
 
   IV_TIMER_INIT(&self->timer_reopen);
   self->timer_reopen.cookie = self;
-  self->timer_reopen.handler = log_threaded_dest_driver_do_work;
+  self->timer_reopen.handler = log_threaded_dest_worker_do_work;
 
   IV_TIMER_INIT(&self->timer_throttle);
   self->timer_throttle.cookie = self;
-  self->timer_throttle.handler = log_threaded_dest_driver_do_work;
+  self->timer_throttle.handler = log_threaded_dest_worker_do_work;
+
+  IV_TIMER_INIT(&self->timer_flush);
+  self->timer_flush.cookie = self;
+  self->timer_flush.handler = log_threaded_dest_worker_flush_timer_expired;
 
   IV_TASK_INIT(&self->do_work);
   self->do_work.cookie = self;
-  self->do_work.handler = log_threaded_dest_driver_do_work;
+  self->do_work.handler = log_threaded_dest_worker_do_work;
 }
 
 static void
-log_threaded_dest_driver_worker_thread_main(gpointer arg)
+log_threaded_dest_worker_thread_main(gpointer arg)
 {
-  LogThrDestDriver *self = (LogThrDestDriver *)arg;
+  LogThrDestWorker *self = (LogThrDestWorker *)arg;
+  LogThrDestDriver *owner = self->owner;
 
   iv_init();
 
+  current_worker = self;
+
   msg_debug("Worker thread started",
-            evt_tag_str("driver", self->super.super.id));
+            evt_tag_str("driver", owner->super.super.id),
+            evt_tag_int("worker_index", self->worker_index));
 
   log_queue_set_use_backlog(self->queue, TRUE);
 
-  log_threaded_dest_driver_init_watches(self);
+  log_threaded_dest_worker_init_watches(self);
 
-  log_threaded_dest_driver_start_watches(self);
+  log_threaded_dest_worker_start_watches(self);
 
-  if (self->worker.thread_init)
-    self->worker.thread_init(self);
+  if (owner->worker.thread_init)
+    owner->worker.thread_init(owner);
 
   iv_main();
 
+  if (self->batch.size > 0)
+    {
+      /* last chance to deliver the pending batch, anything not sent is
+       * put back to the queue */
+      if (!owner->worker.flush || owner->worker.flush(owner) != WORKER_INSERT_RESULT_SUCCESS)
+        _batch_rewind(self);
+      else
+        _batch_accept(self);
+    }
+
   __disconnect(self);
-  if (self->worker.thread_deinit)
-    self->worker.thread_deinit(self);
+  if (owner->worker.thread_deinit)
+    owner->worker.thread_deinit(owner);
 
   msg_debug("Worker thread finished",
-            evt_tag_str("driver", self->super.super.id));
+            evt_tag_str("driver", owner->super.super.id),
+            evt_tag_int("worker_index", self->worker_index));
+
+  current_worker = NULL;
   iv_deinit();
 }
 
 static void
-log_threaded_dest_driver_stop_thread(gpointer s)
+log_threaded_dest_worker_stop_thread(gpointer s)
 {
-  LogThrDestDriver *self = (LogThrDestDriver *) s;
+  LogThrDestWorker *self = (LogThrDestWorker *) s;
 
   iv_event_post(&self->shutdown_event);
 }
 
 static void
-log_threaded_dest_driver_start_thread(LogThrDestDriver *self)
+log_threaded_dest_worker_start_thread(LogThrDestWorker *self)
+{
+  main_loop_create_worker_thread(log_threaded_dest_worker_thread_main,
+                                 log_threaded_dest_worker_stop_thread,
+                                 self, &self->owner->worker_options);
+}
+
+static void
+log_threaded_dest_worker_register_counters(LogThrDestWorker *self)
+{
+  LogThrDestDriver *owner = self->owner;
+
+  if (owner->num_workers == 1)
+    return;
+
+  stats_register_counter(0, owner->stats_source | SCS_DESTINATION, owner->super.super.id,
+                         log_threaded_dest_worker_format_stats_instance(self),
+                         SC_TYPE_PROCESSED, &self->processed_messages);
+}
+
+static void
+log_threaded_dest_worker_unregister_counters(LogThrDestWorker *self)
+{
+  LogThrDestDriver *owner = self->owner;
+
+  stats_unregister_counter(owner->stats_source | SCS_DESTINATION, owner->super.super.id,
+                           log_threaded_dest_worker_format_stats_instance(self),
+                           SC_TYPE_PROCESSED, &self->processed_messages);
+}
+
+static gboolean
+log_threaded_dest_worker_init(LogThrDestWorker *self, LogThrDestDriver *owner, gint worker_index)
+{
+  memset(self, 0, sizeof(*self));
+  self->owner = owner;
+  self->worker_index = worker_index;
+
+  if (worker_index == 0)
+    self->seq_num = &owner->seq_num;
+  else
+    self->seq_num = &self->own_seq_num;
+
+  self->queue = log_dest_driver_acquire_queue(&owner->super,
+                                              log_threaded_dest_driver_format_queue_persist_name(owner, worker_index));
+  return self->queue != NULL;
+}
+
+static void
+log_threaded_dest_worker_restore_seq_num(LogThrDestWorker *self, GlobalConfig *cfg)
+{
+  LogThrDestDriver *owner = self->owner;
+
+  *self->seq_num = GPOINTER_TO_INT(cfg_persist_config_fetch(cfg,
+                                   log_threaded_dest_driver_format_seqnum_for_persist(owner, self->worker_index)));
+  if (!*self->seq_num)
+    init_sequence_number(self->seq_num);
+}
+
+static void
+log_threaded_dest_worker_save_seq_num(LogThrDestWorker *self, GlobalConfig *cfg)
+{
+  LogThrDestDriver *owner = self->owner;
+
+  cfg_persist_config_add(cfg, log_threaded_dest_driver_format_seqnum_for_persist(owner, self->worker_index),
+                         GINT_TO_POINTER(*self->seq_num), NULL, FALSE);
+}
+
+static gint
+log_threaded_dest_driver_choose_worker(LogThrDestDriver *self, LogMessage *msg)
 {
-  main_loop_create_worker_thread(log_threaded_dest_driver_worker_thread_main,
-                                 log_threaded_dest_driver_stop_thread,
-                                 self, &self->worker_options);
+  gint worker_index;
+
+  if (self->num_workers == 1)
+    return 0;
+
+  if (self->worker_partition_key)
+    {
+      SBGString *key = sb_gstring_acquire();
+
+      log_template_format(self->worker_partition_key, msg, NULL, LTZ_SEND, 0, NULL, sb_gstring_string(key));
+      worker_index = g_str_hash(sb_gstring_string(key)->str) % self->num_workers;
+      sb_gstring_release(key);
+      return worker_index;
+    }
+
+  worker_index = g_atomic_counter_exchange_and_add(&self->last_worker, 1);
+  return ((guint) worker_index) % self->num_workers;
 }
 
+/*
+ * The queues of the workers removed by lowering workers() are kept in the
+ * persistent config over a reload if they still contain messages, move
+ * those messages to the remaining workers.
+ */
+static void
+log_threaded_dest_driver_drain_removed_queues(LogThrDestDriver *self, GlobalConfig *cfg)
+{
+  gint prev_num_workers;
+  gint i;
+
+  prev_num_workers = GPOINTER_TO_INT(cfg_persist_config_fetch(cfg,
+                                     log_threaded_dest_driver_format_num_workers_for_persist(self)));
+
+  for (i = self->num_workers; i < prev_num_workers; i++)
+    {
+      LogQueue *queue = cfg_persist_config_fetch(cfg, log_threaded_dest_driver_format_queue_persist_name(self, i));
+      gint num_messages = 0;
+
+      if (!queue)
+        continue;
+
+      while (TRUE)
+        {
+          LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+          LogThrDestWorker *worker;
+          LogMessage *msg;
+
+          msg = log_queue_pop_head_ignore_throttle(queue, &path_options);
+          if (!msg)
+            break;
+
+          /* these messages have been accepted once, don't drop them on a full queue */
+          path_options.flow_control_requested = TRUE;
+          worker = &self->workers[log_threaded_dest_driver_choose_worker(self, msg)];
+          log_queue_push_tail(worker->queue, msg, &path_options);
+          num_messages++;
+        }
+
+      msg_notice("Moved the messages of a removed worker to the remaining workers",
+                 evt_tag_str("driver", self->super.super.id),
+                 evt_tag_int("worker_index", i),
+                 evt_tag_int("messages", num_messages));
+      log_queue_unref(queue);
+    }
+}
 
 gboolean
 log_threaded_dest_driver_start(LogPipe *s)
 {
   LogThrDestDriver *self = (LogThrDestDriver *)s;
   GlobalConfig *cfg = log_pipe_get_config(s);
+  gint64 num_stored = 0;
+  gint i;
 
   if (cfg && self->time_reopen == -1)
     self->time_reopen = cfg->time_reopen;
 
-  self->queue = log_dest_driver_acquire_queue(
-                  &self->super, self->super.super.super.generate_persist_name((const LogPipe *)self));
+  if (self->num_workers > self->max_workers)
+    {
+      msg_warning("This destination does not support the requested number of workers, limiting workers()",
+                  evt_tag_int("workers", self->num_workers),
+                  evt_tag_int("max_workers", self->max_workers),
+                  evt_tag_str("driver", self->super.super.id));
+      self->num_workers = self->max_workers;
+    }
 
-  if (self->queue == NULL)
+  g_free(self->workers);
+  self->workers = g_new0(LogThrDestWorker, self->num_workers);
+  for (i = 0; i < self->num_workers; i++)
     {
-      return FALSE;
+      if (!log_threaded_dest_worker_init(&self->workers[i], self, i))
+        return FALSE;
     }
 
   if (self->retries.max <= 0)
@@ -336,6 +686,8 @@ log_threaded_dest_driver_start(LogPipe *s)
       self->retries.max = MAX_RETRIES_OF_FAILED_INSERT_DEFAULT;
     }
 
+  log_threaded_dest_driver_drain_removed_queues(self, cfg);
+
   stats_lock();
   stats_register_counter(0, self->stats_source | SCS_DESTINATION, self->super.super.id,
                          self->format.stats_instance(self),
@@ -346,17 +698,25 @@ log_threaded_dest_driver_start(LogPipe *s)
   stats_register_counter(0, self->stats_source | SCS_DESTINATION, self->super.super.id,
                          self->format.stats_instance(self),
                          SC_TYPE_PROCESSED, &self->processed_messages);
+  for (i = 0; i < self->num_workers; i++)
+    log_threaded_dest_worker_register_counters(&self->workers[i]);
   stats_unlock();
 
-  log_queue_set_counters(self->queue, self->stored_messages,
-                         self->dropped_messages);
+  /* the queues of all workers update the counters of the driver,
+   * log_queue_set_counters() initializes stored to the length of a
+   * single queue, so it is summed up afterwards */
+  for (i = 0; i < self->num_workers; i++)
+    {
+      log_queue_set_counters(self->workers[i].queue, self->stored_messages, self->dropped_messages);
+      num_stored += log_queue_get_length(self->workers[i].queue);
+    }
+  stats_counter_set(self->stored_messages, num_stored);
 
-  self->seq_num = GPOINTER_TO_INT(cfg_persist_config_fetch(cfg,
-                                  log_threaded_dest_driver_format_seqnum_for_persist(self)));
-  if (!self->seq_num)
-    init_sequence_number(&self->seq_num);
+  for (i = 0; i < self->num_workers; i++)
+    log_threaded_dest_worker_restore_seq_num(&self->workers[i], cfg);
 
-  log_threaded_dest_driver_start_thread(self);
+  for (i = 0; i < self->num_workers; i++)
+    log_threaded_dest_worker_start_thread(&self->workers[i]);
 
   return TRUE;
 }
@@ -365,16 +725,23 @@ gboolean
 log_threaded_dest_driver_deinit_method(LogPipe *s)
 {
   LogThrDestDriver *self = (LogThrDestDriver *)s;
+  GlobalConfig *cfg = log_pipe_get_config(s);
+  gint i;
 
-  log_queue_reset_parallel_push(self->queue);
-
-  log_queue_set_counters(self->queue, NULL, NULL);
+  for (i = 0; i < self->num_workers; i++)
+    {
+      log_queue_reset_parallel_push(self->workers[i].queue);
+      log_queue_set_counters(self->workers[i].queue, NULL, NULL);
+    }
 
-  cfg_persist_config_add(log_pipe_get_config(s),
-                         log_threaded_dest_driver_format_seqnum_for_persist(self),
-                         GINT_TO_POINTER(self->seq_num), NULL, FALSE);
+  for (i = 0; i < self->num_workers; i++)
+    log_threaded_dest_worker_save_seq_num(&self->workers[i], cfg);
+  cfg_persist_config_add(cfg, log_threaded_dest_driver_format_num_workers_for_persist(self),
+                         GINT_TO_POINTER(self->num_workers), NULL, FALSE);
 
   stats_lock();
+  for (i = 0; i < self->num_workers; i++)
+    log_threaded_dest_worker_unregister_counters(&self->workers[i]);
   stats_unregister_counter(self->stats_source | SCS_DESTINATION, self->super.super.id,
                            self->format.stats_instance(self),
                            SC_TYPE_STORED, &self->stored_messages);
@@ -397,6 +764,8 @@ log_threaded_dest_driver_free(LogPipe *s)
 {
   LogThrDestDriver *self = (LogThrDestDriver *)s;
 
+  g_free(self->workers);
+  log_template_unref(self->worker_partition_key);
   log_dest_driver_free((LogPipe *)self);
 }
 
@@ -406,6 +775,7 @@ log_threaded_dest_driver_queue(LogPipe *s, LogMessage *msg,
                                gpointer user_data)
 {
   LogThrDestDriver *self = (LogThrDestDriver *)s;
+  LogThrDestWorker *worker;
   LogPathOptions local_options;
 
   if (!path_options->flow_control_requested)
@@ -414,10 +784,13 @@ log_threaded_dest_driver_queue(LogPipe *s, LogMessage *msg,
   if (self->queue_method)
     self->queue_method(self);
 
+  worker = &self->workers[log_threaded_dest_driver_choose_worker(self, msg)];
+
   log_msg_add_ack(msg, path_options);
-  log_queue_push_tail(self->queue, log_msg_ref(msg), path_options);
+  log_queue_push_tail(worker->queue, log_msg_ref(msg), path_options);
 
   stats_counter_inc(self->processed_messages);
+  stats_counter_inc(worker->processed_messages);
 
   log_dest_driver_queue_method(s, msg, path_options, user_data);
 }
@@ -436,15 +809,20 @@ log_threaded_dest_driver_init_instance(LogThrDestDriver *self, GlobalConfig *cfg
   self->time_reopen = -1;
 
   self->retries.max = MAX_RETRIES_OF_FAILED_INSERT_DEFAULT;
+  self->num_workers = 1;
+  self->max_workers = 1;
 }
 
+/* NOTE: the message_* functions are to be called from the worker thread */
 void
 log_threaded_dest_driver_message_accept(LogThrDestDriver *self,
                                         LogMessage *msg)
 {
-  self->retries.counter = 0;
-  step_sequence_number(&self->seq_num);
-  log_queue_ack_backlog(self->queue, 1);
+  LogThrDestWorker *worker = log_threaded_dest_driver_get_current_worker(self);
+
+  worker->retries_counter = 0;
+  step_sequence_number(worker->seq_num);
+  log_queue_ack_backlog(worker->queue, 1);
   log_msg_unref(msg);
 }
 
@@ -460,7 +838,9 @@ void
 log_threaded_dest_driver_message_rewind(LogThrDestDriver *self,
                                         LogMessage *msg)
 {
-  log_queue_rewind_backlog(self->queue, 1);
+  LogThrDestWorker *worker = log_threaded_dest_driver_get_current_worker(self);
+
+  log_queue_rewind_backlog(worker->queue, 1);
   log_msg_unref(msg);
 }
 
@@ -471,3 +851,28 @@ log_threaded_dest_driver_set_max_retries(LogDriver *s, gint max_retries)
 
   self->retries.max = max_retries;
 }
+
+void
+log_threaded_dest_driver_set_batch_timeout(LogDriver *s, gint batch_timeout)
+{
+  LogThrDestDriver *self = (LogThrDestDriver *)s;
+
+  self->batch.timeout = batch_timeout;
+}
+
+void
+log_threaded_dest_driver_set_num_workers(LogDriver *s, gint num_workers)
+{
+  LogThrDestDriver *self = (LogThrDestDriver *)s;
+
+  self->num_workers = MAX(num_workers, 1);
+}
+
+void
+log_threaded_dest_driver_set_worker_partition_key(LogDriver *s, LogTemplate *key)
+{
+  LogThrDestDriver *self = (LogThrDestDriver *)s;
+
+  log_template_unref(self->worker_partition_key);
+  self->worker_partition_key = log_template_ref(key);
+}
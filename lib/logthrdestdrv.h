@@ -29,7 +29,9 @@
 #include "driver.h"
 #include "stats/stats-registry.h"
 #include "logqueue.h"
+#include "template/templates.h"
 #include "mainloop-worker.h"
+#include "atomic.h"
 #include <iv.h>
 #include <iv_event.h>
 
@@ -39,10 +41,53 @@ typedef enum
   WORKER_INSERT_RESULT_ERROR,
   WORKER_INSERT_RESULT_REWIND,
   WORKER_INSERT_RESULT_SUCCESS,
+  WORKER_INSERT_RESULT_QUEUED,
   WORKER_INSERT_RESULT_NOT_CONNECTED
 } worker_insert_result_t;
 
 typedef struct _LogThrDestDriver LogThrDestDriver;
+typedef struct _LogThrDestWorker LogThrDestWorker;
+
+/*
+ * State of one worker thread.  Each worker consumes its own queue, so
+ * drivers running more than one worker have to keep their connection
+ * state per worker too (see log_threaded_dest_driver_get_current_worker()).
+ */
+struct _LogThrDestWorker
+{
+  LogThrDestDriver *owner;
+  gint worker_index;
+
+  LogQueue *queue;
+  gboolean connected;
+  gboolean suspended;
+  gint retries_counter;
+
+  /* the first worker uses the seq_num of the driver, so single-worker
+   * drivers can keep using self->super.seq_num in their templates */
+  gint32 *seq_num;
+  gint32 own_seq_num;
+
+  /* messages popped from the queue but not acknowledged yet, the result
+   * of insert() or flush() applies to all of them */
+  struct
+  {
+    gint size;
+    gint32 seq_num;
+    struct timespec started;
+  } batch;
+
+  /* stored and dropped messages are counted by the driver for all workers */
+  StatsCounterItem *processed_messages;
+
+  struct iv_event wake_up_event;
+  struct iv_event shutdown_event;
+  struct iv_timer timer_reopen;
+  struct iv_timer timer_throttle;
+  struct iv_timer timer_flush;
+  struct iv_task  do_work;
+};
+
 struct _LogThrDestDriver
 {
   LogDestDriver super;
@@ -51,21 +96,19 @@ struct _LogThrDestDriver
   StatsCounterItem *stored_messages;
   StatsCounterItem *processed_messages;
 
-  gboolean suspended;
   time_t time_reopen;
 
-  LogQueue *queue;
-
   /* Worker stuff */
   struct
   {
-    gboolean connected;
     void (*thread_init) (LogThrDestDriver *s);
     void (*thread_deinit) (LogThrDestDriver *s);
     worker_insert_result_t (*insert) (LogThrDestDriver *s, LogMessage *msg);
     gboolean (*connect) (LogThrDestDriver *s);
     void (*worker_message_queue_empty)(LogThrDestDriver *s);
     void (*disconnect) (LogThrDestDriver *s);
+    /* sends out messages accumulated by insert() returning QUEUED */
+    worker_insert_result_t (*flush) (LogThrDestDriver *s);
   } worker;
 
   struct
@@ -82,17 +125,23 @@ struct _LogThrDestDriver
 
   struct
   {
-    gint counter;
     gint max;
   } retries;
 
+  struct
+  {
+    gint timeout;
+  } batch;
+
+  /* drivers keeping their connection state per worker raise max_workers */
+  LogThrDestWorker *workers;
+  gint num_workers;
+  gint max_workers;
+  GAtomicCounter last_worker;
+  LogTemplate *worker_partition_key;
+
   void (*queue_method) (LogThrDestDriver *s);
   WorkerOptions worker_options;
-  struct iv_event wake_up_event;
-  struct iv_event shutdown_event;
-  struct iv_timer timer_reopen;
-  struct iv_timer timer_throttle;
-  struct iv_task  do_work;
 };
 
 gboolean log_threaded_dest_driver_deinit_method(LogPipe *s);
@@ -111,5 +160,10 @@ void log_threaded_dest_driver_message_rewind(LogThrDestDriver *self,
                                              LogMessage *msg);
 
 void log_threaded_dest_driver_set_max_retries(LogDriver *s, gint max_retries);
+void log_threaded_dest_driver_set_batch_timeout(LogDriver *s, gint batch_timeout);
+void log_threaded_dest_driver_set_num_workers(LogDriver *s, gint num_workers);
+void log_threaded_dest_driver_set_worker_partition_key(LogDriver *s, LogTemplate *key);
+
+LogThrDestWorker *log_threaded_dest_driver_get_current_worker(LogThrDestDriver *self);
 
 #endif
@@ -1207,10 +1207,15 @@ log_writer_flush(LogWriter *self, LogWriterFlushMode flush_mode)
         break;
     }
 
-  if (write_error)
-    return FALSE;
+  if (!write_error && !log_writer_flush_finalize(self))
+    write_error = TRUE;
+
+  /* the queue may be detached right after a forced flush, messages still
+   * being written asynchronously have to be acked (or rewound) now */
+  if (flush_mode == LW_FLUSH_FORCE && log_proto_client_drain(self->proto) != LPS_SUCCESS)
+    write_error = TRUE;
 
-  return log_writer_flush_finalize(self);
+  return !write_error;
 }
 
 static void
@@ -1384,7 +1389,12 @@ static void
 log_writer_free_proto(LogWriter *self)
 {
   if (self->proto)
-    log_proto_client_free(self->proto);
+    {
+      /* messages of the old proto are acked while the queue is still there */
+      if (self->queue)
+        log_proto_client_drain(self->proto);
+      log_proto_client_free(self->proto);
+    }
 
   self->proto = NULL;
 }
@@ -36,13 +36,49 @@ log_parser_set_template(LogParser *self, LogTemplate *template)
   self->template = template;
 }
 
+/* builtin values are never indirect, so they are always NUL terminated,
+ * which some parsers rely on */
+static inline gboolean
+_is_template_a_builtin_value(LogTemplate *template)
+{
+  return log_template_is_trivial(template) &&
+         !log_msg_is_handle_settable_with_an_indirect_value(template->trivial_value);
+}
+
+/* Parsers storing parts of their input into the message can use this to
+ * find the value the input is coming from, so that they can reference it
+ * with indirect values instead of copying.  Returns 0 if the input is not
+ * a value of @msg, e.g. because it was formatted using a template. */
+NVHandle
+log_parser_lookup_input_handle(LogParser *self, LogMessage *msg, const gchar *input, gsize input_len,
+                               gsize *input_ofs)
+{
+  NVHandle handle;
+  const gchar *value;
+  gssize value_len;
+
+  if (!self->template)
+    handle = LM_V_MESSAGE;
+  else if (_is_template_a_builtin_value(self->template))
+    handle = self->template->trivial_value;
+  else
+    return 0;
+
+  value = log_msg_get_value(msg, handle, &value_len);
+  if (input < value || input > value + value_len || input_len > (gsize) (value_len - (input - value)))
+    return 0;
+
+  *input_ofs = input - value;
+  return handle;
+}
+
 gboolean
 log_parser_process_message(LogParser *self, LogMessage **pmsg, const LogPathOptions *path_options)
 {
   LogMessage *msg = *pmsg;
   gboolean success;
 
-  if (G_LIKELY(!self->template))
+  if (G_LIKELY(!self->template || _is_template_a_builtin_value(self->template)))
     {
       NVTable *payload = nv_table_ref(msg->payload);
       const gchar *value;
@@ -55,9 +91,16 @@ log_parser_process_message(LogParser *self, LogMessage **pmsg, const LogPathOpti
        * until its refcounter drops to zero.  If that wouldn't be the case,
        * nv_table_realloc() could make our payload pointer and the
        * LM_V_MESSAGE pointer we pass to process() go stale.
+       *
+       * The same applies to templates that reference a single builtin
+       * value, those are passed to process() without formatting them
+       * first.
        */
 
-      value = log_msg_get_value(msg, LM_V_MESSAGE, &value_len);
+      if (!self->template)
+        value = log_msg_get_value(msg, LM_V_MESSAGE, &value_len);
+      else
+        value = log_template_get_trivial_value(self->template, msg, &value_len);
       success = self->process(self, pmsg, path_options, value, value_len);
       nv_table_unref(payload);
     }
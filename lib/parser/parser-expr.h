@@ -54,6 +54,8 @@ log_parser_process(LogParser *self, LogMessage **pmsg, const LogPathOptions *pat
   return self->process(self, pmsg, path_options, input, input_len);
 }
 
+NVHandle log_parser_lookup_input_handle(LogParser *self, LogMessage *msg, const gchar *input, gsize input_len,
+                                        gsize *input_ofs);
 gboolean log_parser_process_message(LogParser *self, LogMessage **pmsg, const LogPathOptions *path_options);
 
 #endif
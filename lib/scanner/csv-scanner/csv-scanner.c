@@ -148,6 +148,40 @@ _skip_whitespace(const gchar **src)
     (*src)++;
 }
 
+static void
+_flush_current_slice(CSVScanner *self)
+{
+  if (self->current_slice_start != self->current_slice_end)
+    g_string_append_len(self->current_value, self->current_slice_start,
+                        self->current_slice_end - self->current_slice_start);
+  self->current_slice_start = self->current_slice_end = NULL;
+}
+
+/* appends a part of the input to the current value.  Contiguous parts are
+ * collected into a slice, which is only copied if the value turns out to
+ * consist of more than a single slice, or if it is asked for as a string */
+static void
+_append_input(CSVScanner *self, const gchar *start, const gchar *end)
+{
+  if (start == end)
+    return;
+
+  if (self->current_slice_end == start)
+    {
+      self->current_slice_end = end;
+      return;
+    }
+  _flush_current_slice(self);
+  self->current_slice_start = start;
+  self->current_slice_end = end;
+}
+
+static gboolean
+_is_current_value_a_slice(CSVScanner *self)
+{
+  return self->current_value->len == 0;
+}
+
 static void
 _switch_to_next_column(CSVScanner *self)
 {
@@ -156,6 +190,7 @@ _switch_to_next_column(CSVScanner *self)
   else if (self->current_column)
     self->current_column = self->current_column->next;
   g_string_truncate(self->current_value, 0);
+  self->current_slice_start = self->current_slice_end = NULL;
 }
 
 static gboolean
@@ -219,10 +254,24 @@ _parse_character_with_quotation(CSVScanner *self)
       self->src++;
       return;
     }
-  g_string_append_c(self->current_value, *self->src);
+  _append_input(self, self->src, self->src + 1);
   self->src++;
 }
 
+/* skips to the next character that needs attention within quotation marks */
+static void
+_parse_quoted_run(CSVScanner *self)
+{
+  gchar escape = self->options->dialect == CSV_SCANNER_ESCAPE_BACKSLASH ? '\\' : self->current_quote;
+  const gchar *next;
+
+  next = _memchr_any4(self->src, self->src_end - self->src, self->current_quote, escape, self->current_quote, escape);
+  if (!next)
+    next = self->src_end;
+  _append_input(self, self->src, next);
+  self->src = next;
+}
+
 /* searches for str in list and returns the first occurence, otherwise NULL */
 static const gboolean
 _match_string_delimiters_at_current_position(const char *input, GList *string_delimiters, int *result_length)
@@ -286,10 +335,28 @@ _parse_delimiter(CSVScanner *self)
 static void
 _parse_unquoted_literal_character(CSVScanner *self)
 {
-  g_string_append_c(self->current_value, *self->src);
+  _append_input(self, self->src, self->src + 1);
   self->src++;
 }
 
+/* skips to the next delimiter, if they can be searched for in bulk */
+static void
+_parse_unquoted_run(CSVScanner *self)
+{
+  const gchar *next;
+
+  if (!self->fast_delimiters[0])
+    return;
+
+  next = _memchr_any4(self->src, self->src_end - self->src,
+                      self->fast_delimiters[0], self->fast_delimiters[1],
+                      self->fast_delimiters[2], self->fast_delimiters[3]);
+  if (!next)
+    next = self->src_end;
+  _append_input(self, self->src, next);
+  self->src = next;
+}
+
 static void
 _parse_value_with_whitespace_and_delimiter(CSVScanner *self)
 {
@@ -298,11 +365,17 @@ _parse_value_with_whitespace_and_delimiter(CSVScanner *self)
       if (self->current_quote)
         {
           /* within quotation marks */
+          _parse_quoted_run(self);
+          if (!*self->src)
+            break;
           _parse_character_with_quotation(self);
         }
       else
         {
           /* unquoted value */
+          _parse_unquoted_run(self);
+          if (!*self->src)
+            break;
           if (_parse_delimiter(self))
             break;
           _parse_unquoted_literal_character(self);
@@ -324,21 +397,42 @@ _get_value_length_without_right_whitespace(CSVScanner *self)
 static void
 _translate_rstrip_whitespace(CSVScanner *self)
 {
-  if (self->options->flags & CSV_SCANNER_STRIP_WHITESPACE)
+  if ((self->options->flags & CSV_SCANNER_STRIP_WHITESPACE) == 0)
+    return;
+
+  if (_is_current_value_a_slice(self))
+    {
+      while (self->current_slice_end > self->current_slice_start &&
+             _is_whitespace_char(self->current_slice_end - 1))
+        self->current_slice_end--;
+    }
+  else
     g_string_truncate(self->current_value, _get_value_length_without_right_whitespace(self));
 }
 
 static void
 _translate_null_value(CSVScanner *self)
 {
-  if (self->options->null_value &&
-      strcmp(self->current_value->str, self->options->null_value) == 0)
+  if (!self->options->null_value)
+    return;
+
+  if (_is_current_value_a_slice(self))
+    {
+      gsize len = self->current_slice_end - self->current_slice_start;
+
+      if (len == strlen(self->options->null_value) &&
+          memcmp(self->current_slice_start, self->options->null_value, len) == 0)
+        self->current_slice_start = self->current_slice_end = NULL;
+    }
+  else if (strcmp(self->current_value->str, self->options->null_value) == 0)
     g_string_truncate(self->current_value, 0);
 }
 
 static void
 _translate_value(CSVScanner *self)
 {
+  if (!_is_current_value_a_slice(self))
+    _flush_current_slice(self);
   _translate_rstrip_whitespace(self);
   _translate_null_value(self);
 }
@@ -353,7 +447,7 @@ csv_scanner_scan_next(CSVScanner *self)
 
   if (_is_last_column(self) && (self->options->flags & CSV_SCANNER_GREEDY))
     {
-      g_string_assign(self->current_value, self->src);
+      _append_input(self, self->src, self->src_end);
       self->src = NULL;
       return TRUE;
     }
@@ -391,11 +485,30 @@ csv_scanner_is_scan_finished(CSVScanner *self)
   return TRUE;
 }
 
+static void
+_setup_fast_delimiters(CSVScanner *self)
+{
+  gint num_delimiters, i;
+
+  num_delimiters = self->options->string_delimiters ? 0 : strlen(self->options->delimiters);
+  if (num_delimiters < 1 || num_delimiters > G_N_ELEMENTS(self->fast_delimiters))
+    {
+      self->fast_delimiters[0] = 0;
+      return;
+    }
+
+  for (i = 0; i < G_N_ELEMENTS(self->fast_delimiters); i++)
+    self->fast_delimiters[i] = self->options->delimiters[MIN(i, num_delimiters - 1)];
+}
+
 void
 csv_scanner_input(CSVScanner *self, const gchar *input)
 {
+  self->input = input;
   self->src = input;
+  self->src_end = input + strlen(input);
   self->current_column = NULL;
+  _setup_fast_delimiters(self);
 }
 
 void
@@ -403,9 +516,13 @@ csv_scanner_state_init(CSVScanner *self, CSVScannerOptions *options)
 {
   self->options = options;
   self->current_column = options->columns;
+  self->input = NULL;
   self->src = NULL;
+  self->src_end = NULL;
   self->current_value = g_string_sized_new(128);
+  self->current_slice_start = self->current_slice_end = NULL;
   self->current_quote = 0;
+  self->fast_delimiters[0] = 0;
 }
 
 void
@@ -417,13 +534,27 @@ csv_scanner_state_clean(CSVScanner *self)
 const gchar *
 csv_scanner_get_current_value(CSVScanner *self)
 {
+  _flush_current_slice(self);
   return self->current_value->str;
 }
 
 gint
 csv_scanner_get_current_value_len(CSVScanner *self)
 {
-  return self->current_value->len;
+  return self->current_value->len + (self->current_slice_end - self->current_slice_start);
+}
+
+/* Returns TRUE if the current value is stored verbatim in the input, in
+ * which case @offset is set to its position.  Call this before
+ * csv_scanner_get_current_value(), which copies the value to a string. */
+gboolean
+csv_scanner_get_current_value_offset(CSVScanner *self, gsize *offset)
+{
+  if (!_is_current_value_a_slice(self) || self->current_slice_start == self->current_slice_end)
+    return FALSE;
+
+  *offset = self->current_slice_start - self->input;
+  return TRUE;
 }
 
 gchar *
@@ -68,14 +68,24 @@ typedef struct _CSVScanner
 {
   CSVScannerOptions *options;
   GList *current_column;
+  const gchar *input;
   const gchar *src;
+  const gchar *src_end;
   GString *current_value;
+  /* the part of the input appended to the current value that was not yet
+   * copied to current_value */
+  const gchar *current_slice_start;
+  const gchar *current_slice_end;
   gchar current_quote;
+  /* delimiter characters that can be searched for in bulk, or 0 if the
+   * delimiters need to be checked character by character */
+  gchar fast_delimiters[4];
 } CSVScanner;
 
 const gchar *csv_scanner_get_current_name(CSVScanner *pstate);
 const gchar *csv_scanner_get_current_value(CSVScanner *pstate);
 gint csv_scanner_get_current_value_len(CSVScanner *self);
+gboolean csv_scanner_get_current_value_offset(CSVScanner *self, gsize *offset);
 gboolean csv_scanner_scan_next(CSVScanner *pstate);
 gboolean csv_scanner_is_scan_finished(CSVScanner *pstate);
 gchar *csv_scanner_dup_current_value(CSVScanner *self);
@@ -149,6 +149,11 @@ stats_cluster_track_counter(StatsCluster *self, gint type)
 
   g_assert(type < SC_TYPE_MAX);
 
+  /* stamps are only ever set, and dynamic clusters can be numerous, keep
+   * them out of the per-thread shards */
+  if (type != SC_TYPE_STAMP && !self->dynamic)
+    stats_counter_alloc_slot(&self->counters[type]);
+
   self->live_mask |= type_mask;
   self->use_count++;
   return &self->counters[type];
@@ -179,6 +184,10 @@ stats_cluster_new(gint component, const gchar *id, const gchar *instance)
 void
 stats_cluster_free(StatsCluster *self)
 {
+  gint type;
+
+  for (type = 0; type < SC_TYPE_MAX; type++)
+    stats_counter_free_slot(&self->counters[type]);
   g_free(self->id);
   g_free(self->instance);
   g_free(self);
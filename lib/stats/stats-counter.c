@@ -24,6 +24,190 @@
 #include "stats/stats-counter.h"
 #include "stats/stats-cluster.h"
 #include "stats/stats-registry.h"
+#include "tls-support.h"
+
+#include <string.h>
+
+typedef struct _StatsCounterShard
+{
+  gint64 *slots;
+  guint32 num_slots;
+} StatsCounterShard;
+
+TLS_BLOCK_START
+{
+  StatsCounterShard *current_shard;
+}
+TLS_BLOCK_END;
+
+#define current_shard __tls_deref(current_shard)
+
+/* protects the list of shards, the slot tables below and any access to
+ * a shard from a thread other than its owner */
+static GStaticMutex shard_lock = G_STATIC_MUTEX_INIT;
+static GList *shards;
+/* slot -> StatsCounterItem mapping, slot 0 means "unsharded" and is never allocated */
+static GPtrArray *slot_owners;
+static GSList *free_slots;
+
+static void
+_shard_grow(StatsCounterShard *shard, guint32 num_slots)
+{
+  shard->slots = g_renew(gint64, shard->slots, num_slots);
+  memset(&shard->slots[shard->num_slots], 0, (num_slots - shard->num_slots) * sizeof(gint64));
+  shard->num_slots = num_slots;
+}
+
+/*
+ * Slots are only ever written by the thread owning the shard, others only
+ * read them.  Instead of clearing the slots of other threads (which would
+ * race with their non-atomic updates), setting a counter or recycling a
+ * slot offsets counter->value by the current sum of the slot.
+ */
+static gint64
+_fold_slot(guint32 slot)
+{
+  gint64 sum = 0;
+  GList *l;
+
+  for (l = shards; l; l = l->next)
+    {
+      StatsCounterShard *shard = (StatsCounterShard *) l->data;
+
+      if (slot <= shard->num_slots)
+        {
+          sum += shard->slots[slot - 1];
+        }
+    }
+  return sum;
+}
+
+void
+stats_counter_add_sharded(StatsCounterItem *counter, gint64 add)
+{
+  StatsCounterShard *shard = current_shard;
+
+  if (G_UNLIKELY(!shard))
+    {
+      __sync_fetch_and_add(&counter->value, add);
+      return;
+    }
+
+  if (G_UNLIKELY(counter->slot > shard->num_slots))
+    {
+      /* readers may be walking our slots, so resize under the lock */
+      g_static_mutex_lock(&shard_lock);
+      _shard_grow(shard, slot_owners->len - 1);
+      g_static_mutex_unlock(&shard_lock);
+    }
+  shard->slots[counter->slot - 1] += add;
+}
+
+void
+stats_counter_set_sharded(StatsCounterItem *counter, guint64 value)
+{
+  g_static_mutex_lock(&shard_lock);
+  counter->value = value - _fold_slot(counter->slot);
+  g_static_mutex_unlock(&shard_lock);
+}
+
+guint64
+stats_counter_get_sharded(StatsCounterItem *counter)
+{
+  gint64 result;
+
+  g_static_mutex_lock(&shard_lock);
+  result = counter->value + _fold_slot(counter->slot);
+  g_static_mutex_unlock(&shard_lock);
+  return result;
+}
+
+void
+stats_counter_alloc_slot(StatsCounterItem *counter)
+{
+  g_static_mutex_lock(&shard_lock);
+  if (counter->slot)
+    goto exit;
+
+  if (!slot_owners)
+    {
+      slot_owners = g_ptr_array_new();
+      g_ptr_array_add(slot_owners, NULL);
+    }
+
+  if (free_slots)
+    {
+      counter->slot = GPOINTER_TO_UINT(free_slots->data);
+      free_slots = g_slist_delete_link(free_slots, free_slots);
+      g_ptr_array_index(slot_owners, counter->slot) = counter;
+      /* the shards may still hold the partial sums of the previous owner */
+      __sync_fetch_and_sub(&counter->value, _fold_slot(counter->slot));
+    }
+  else
+    {
+      counter->slot = slot_owners->len;
+      g_ptr_array_add(slot_owners, counter);
+    }
+exit:
+  g_static_mutex_unlock(&shard_lock);
+}
+
+void
+stats_counter_free_slot(StatsCounterItem *counter)
+{
+  g_static_mutex_lock(&shard_lock);
+  if (!counter->slot)
+    goto exit;
+
+  __sync_fetch_and_add(&counter->value, _fold_slot(counter->slot));
+  g_ptr_array_index(slot_owners, counter->slot) = NULL;
+  free_slots = g_slist_prepend(free_slots, GUINT_TO_POINTER(counter->slot));
+  counter->slot = 0;
+exit:
+  g_static_mutex_unlock(&shard_lock);
+}
+
+/*
+ * Registers a shard for the calling thread, from this point on sharded
+ * counters are updated without atomic operations from this thread.  Must be
+ * paired with stats_counter_thread_deinit() before the thread exits.
+ */
+void
+stats_counter_thread_init(void)
+{
+  StatsCounterShard *shard = g_new0(StatsCounterShard, 1);
+
+  g_static_mutex_lock(&shard_lock);
+  shards = g_list_prepend(shards, shard);
+  g_static_mutex_unlock(&shard_lock);
+  current_shard = shard;
+}
+
+void
+stats_counter_thread_deinit(void)
+{
+  StatsCounterShard *shard = current_shard;
+  guint32 i;
+
+  if (!shard)
+    return;
+
+  /* fold the partial sums of this thread back into the counters */
+  g_static_mutex_lock(&shard_lock);
+  for (i = 0; i < shard->num_slots; i++)
+    {
+      StatsCounterItem *owner = (StatsCounterItem *) g_ptr_array_index(slot_owners, i + 1);
+
+      if (owner && shard->slots[i])
+        __sync_fetch_and_add(&owner->value, shard->slots[i]);
+    }
+  shards = g_list_remove(shards, shard);
+  g_static_mutex_unlock(&shard_lock);
+
+  current_shard = NULL;
+  g_free(shard->slots);
+  g_free(shard);
+}
 
 static void
 _reset_counter(StatsCluster *sc, gint type, StatsCounterItem *counter, gpointer user_data)
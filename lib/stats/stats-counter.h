@@ -26,52 +26,83 @@
 
 #include "syslog-ng.h"
 
+/*
+ * Counters are 64 bits wide and, unless they are marked unsharded, they are
+ * updated through a per-thread shard: each thread that registered itself
+ * with stats_counter_thread_init() owns a private array of partial sums,
+ * indexed by counter->slot.  Increments from such threads are plain
+ * (non-atomic) additions to thread-local memory, so concurrent workers
+ * don't bounce the cacheline holding the counter between CPUs.  Reads
+ * fold the shards back into a single value.
+ *
+ * Threads without a shard (and counters without a slot) fall back to an
+ * atomic add on @value.
+ */
 typedef struct _StatsCounterItem
 {
-  gint value;
+  gint64 value;
+  guint32 slot;
 } StatsCounterItem;
 
+void stats_counter_add_sharded(StatsCounterItem *counter, gint64 add);
 
 static inline void
-stats_counter_add(StatsCounterItem *counter, gint add)
+stats_counter_add(StatsCounterItem *counter, gint64 add)
 {
-  if (counter)
-    g_atomic_int_add(&counter->value, add);
+  if (!counter)
+    return;
+
+  if (counter->slot)
+    stats_counter_add_sharded(counter, add);
+  else
+    __sync_fetch_and_add(&counter->value, add);
 }
 
 static inline void
 stats_counter_inc(StatsCounterItem *counter)
 {
-  if (counter)
-    g_atomic_int_inc(&counter->value);
+  stats_counter_add(counter, 1);
 }
 
 static inline void
 stats_counter_dec(StatsCounterItem *counter)
 {
-  if (counter)
-    g_atomic_int_add(&counter->value, -1);
+  stats_counter_add(counter, -1);
 }
 
+void stats_counter_set_sharded(StatsCounterItem *counter, guint64 value);
+guint64 stats_counter_get_sharded(StatsCounterItem *counter);
+
 /* NOTE: this is _not_ atomic and doesn't have to be as sets would race anyway */
 static inline void
-stats_counter_set(StatsCounterItem *counter, guint32 value)
+stats_counter_set(StatsCounterItem *counter, guint64 value)
 {
-  if (counter)
+  if (!counter)
+    return;
+
+  if (counter->slot)
+    stats_counter_set_sharded(counter, value);
+  else
     counter->value = value;
 }
 
 /* NOTE: this is _not_ atomic and doesn't have to be as sets would race anyway */
-static inline guint32
+static inline guint64
 stats_counter_get(StatsCounterItem *counter)
 {
-  guint32 result = 0;
+  guint64 result = 0;
 
   if (counter)
-    result = counter->value;
+    result = counter->slot ? stats_counter_get_sharded(counter) : counter->value;
   return result;
 }
 
+void stats_counter_alloc_slot(StatsCounterItem *counter);
+void stats_counter_free_slot(StatsCounterItem *counter);
+
+void stats_counter_thread_init(void);
+void stats_counter_thread_deinit(void);
+
 void stats_reset_non_stored_counters(void);
 
 #endif
@@ -109,7 +109,7 @@ stats_cluster_is_expired(StatsCluster *sc, time_t now)
   if ((sc->live_mask & (1 << SC_TYPE_STAMP)) == 0)
     return FALSE;
 
-  tstamp = sc->counters[SC_TYPE_STAMP].value;
+  tstamp = stats_counter_get(&sc->counters[SC_TYPE_STAMP]);
   return (tstamp <= now - stats_options->lifetime);
 }
 
@@ -129,7 +129,7 @@ stats_prune_counter(StatsCluster *sc, StatsTimerState *st)
   expired = stats_cluster_is_expired(sc, st->now.tv_sec);
   if (expired)
     {
-      time_t tstamp = sc->counters[SC_TYPE_STAMP].value;
+      time_t tstamp = stats_counter_get(&sc->counters[SC_TYPE_STAMP]);
       if ((st->oldest_counter) == 0 || st->oldest_counter > tstamp)
         st->oldest_counter = tstamp;
       st->dropped_counters++;
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "syslog-ng.h"
+#include "apphook.h"
+#include "stats/stats-cluster.h"
+#include "stats/stats-counter.h"
+
+#include <stdio.h>
+
+#define BENCHMARK_COUNT 10000000
+
+gboolean success = TRUE;
+
+typedef struct _BenchmarkThreadArgs
+{
+  StatsCounterItem *counter;
+  gboolean sharded;
+} BenchmarkThreadArgs;
+
+static gpointer
+_increment_counter_thread(gpointer user_data)
+{
+  BenchmarkThreadArgs *args = (BenchmarkThreadArgs *) user_data;
+  gint i;
+
+  if (args->sharded)
+    stats_counter_thread_init();
+
+  for (i = 0; i < BENCHMARK_COUNT; i++)
+    stats_counter_inc(args->counter);
+
+  if (args->sharded)
+    stats_counter_thread_deinit();
+  return NULL;
+}
+
+static void
+testcase(gint num_threads, gboolean sharded)
+{
+  StatsCluster *sc = stats_cluster_new(SCS_SOURCE | SCS_FILE, "bench", "counter");
+  StatsCounterItem *counter;
+  BenchmarkThreadArgs args;
+  GThread *threads[num_threads];
+  GTimeVal start, end;
+  guint64 expected = (guint64) num_threads * BENCHMARK_COUNT;
+  gint i;
+
+  counter = stats_cluster_track_counter(sc, SC_TYPE_PROCESSED);
+  if (!sharded)
+    stats_counter_free_slot(counter);
+
+  args.counter = counter;
+  args.sharded = sharded;
+
+  g_get_current_time(&start);
+  for (i = 0; i < num_threads; i++)
+    threads[i] = g_thread_create(_increment_counter_thread, &args, TRUE, NULL);
+  for (i = 0; i < num_threads; i++)
+    g_thread_join(threads[i]);
+  g_get_current_time(&end);
+
+  printf("      %-8s threads=%-3d speed: %12.3f inc/sec\n",
+         sharded ? "sharded" : "atomic", num_threads,
+         expected * 1e6 / g_time_val_diff(&end, &start));
+
+  if (stats_counter_get(counter) != expected)
+    {
+      fprintf(stderr, "counter value mismatch, value=%" G_GUINT64_FORMAT ", expected=%" G_GUINT64_FORMAT "\n",
+              stats_counter_get(counter), expected);
+      success = FALSE;
+    }
+
+  stats_cluster_untrack_counter(sc, SC_TYPE_PROCESSED, &counter);
+  stats_cluster_free(sc);
+}
+
+static void
+assert_counter_value(StatsCounterItem *counter, guint64 expected, const gchar *when)
+{
+  if (stats_counter_get(counter) != expected)
+    {
+      fprintf(stderr, "counter value mismatch %s, value=%" G_GUINT64_FORMAT ", expected=%" G_GUINT64_FORMAT "\n",
+              when, stats_counter_get(counter), expected);
+      success = FALSE;
+    }
+}
+
+static gpointer
+_slot_reuse_and_set_thread(gpointer user_data)
+{
+  StatsCounterItem first = { 0 }, second = { 0 };
+
+  stats_counter_thread_init();
+
+  stats_counter_alloc_slot(&first);
+  stats_counter_add(&first, 10);
+  stats_counter_free_slot(&first);
+  assert_counter_value(&first, 10, "after freeing the slot");
+
+  stats_counter_alloc_slot(&second);
+  assert_counter_value(&second, 0, "after recycling the slot");
+  stats_counter_inc(&second);
+  assert_counter_value(&second, 1, "after incrementing a recycled slot");
+
+  stats_counter_set(&second, 5);
+  stats_counter_inc(&second);
+  assert_counter_value(&second, 6, "after setting the counter");
+
+  stats_counter_thread_deinit();
+  assert_counter_value(&second, 6, "after folding the shard");
+  stats_counter_free_slot(&second);
+  return NULL;
+}
+
+/* the partial sums left in the shards must not leak into the new owner of
+ * a recycled slot, nor be lost when a counter is set */
+static void
+testcase_slot_reuse_and_set(void)
+{
+  g_thread_join(g_thread_create(_slot_reuse_and_set_thread, NULL, TRUE, NULL));
+}
+
+int
+main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
+{
+  gint thread_counts[] = { 1, 4, 16 };
+  gint i;
+
+  app_startup();
+
+  testcase_slot_reuse_and_set();
+
+  for (i = 0; i < G_N_ELEMENTS(thread_counts); i++)
+    {
+      testcase(thread_counts[i], FALSE);
+      testcase(thread_counts[i], TRUE);
+    }
+
+  app_shutdown();
+
+  if (success)
+    return 0;
+  return 1;
+}
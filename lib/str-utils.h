@@ -28,6 +28,10 @@
 #include "syslog-ng.h"
 #include <string.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 /* functions that should be implemented by GLib but they aren't */
 GString *g_string_assign_len(GString *s, const gchar *val, gint len);
 void g_string_steal(GString *s);
@@ -112,4 +116,44 @@ _strchr_optimized_for_single_char_haystack(const char *str, int c)
   return strchr(str + 1, c);
 }
 
+/* Finds the first occurrence of any of the characters c1..c4 in the first
+ * @len bytes of @s, similarly to what memchr() does for a single
+ * character.  Pass the same character multiple times if you need less than
+ * four.
+ *
+ * This is meant for scanners that look for a couple of special characters
+ * in mostly uninteresting text.  With SSE2 (always available on x86-64) it
+ * checks 16 bytes at a time, the tail and other platforms use a plain loop.
+ */
+static inline const gchar *
+_memchr_any4(const gchar *s, gsize len, gchar c1, gchar c2, gchar c3, gchar c4)
+{
+  const gchar *end = s + len;
+
+#ifdef __SSE2__
+  const __m128i v1 = _mm_set1_epi8(c1);
+  const __m128i v2 = _mm_set1_epi8(c2);
+  const __m128i v3 = _mm_set1_epi8(c3);
+  const __m128i v4 = _mm_set1_epi8(c4);
+
+  for (; end - s >= 16; s += 16)
+    {
+      __m128i block = _mm_loadu_si128((const __m128i *) s);
+      __m128i eq = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, v1), _mm_cmpeq_epi8(block, v2)),
+                                _mm_or_si128(_mm_cmpeq_epi8(block, v3), _mm_cmpeq_epi8(block, v4)));
+      gint mask = _mm_movemask_epi8(eq);
+
+      if (mask)
+        return s + g_bit_nth_lsf(mask, -1);
+    }
+#endif
+
+  for (; s < end; s++)
+    {
+      if (*s == c1 || *s == c2 || *s == c3 || *s == c4)
+        return s;
+    }
+  return NULL;
+}
+
 #endif
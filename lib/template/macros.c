@@ -36,6 +36,7 @@
 #include "hostname.h"
 #include "template/templates.h"
 #include "cfg.h"
+#include "tls-support.h"
 
 #include <string.h>
 
@@ -182,6 +183,43 @@ static GTimeVal app_uptime;
 static GHashTable *macro_hash;
 static LogTemplateOptions template_options_for_macro_expand;
 
+/*
+ * The date related macros of a template usually expand the same couple of
+ * timestamps (e.g. $YEAR $MONTH $DAY of the same message), so the
+ * broken-down time of the last few is kept per thread and shared by all
+ * of them.
+ */
+#define MACRO_TIME_CACHE_SIZE 4
+
+typedef struct _MacroTimeCache
+{
+  gboolean valid;
+  time_t t;
+  struct tm tm;
+} MacroTimeCache;
+
+TLS_BLOCK_START
+{
+  MacroTimeCache macro_time_cache[MACRO_TIME_CACHE_SIZE];
+}
+TLS_BLOCK_END;
+
+#define macro_time_cache  __tls_deref(macro_time_cache)
+
+static const struct tm *
+_get_broken_down_time(time_t t)
+{
+  MacroTimeCache *entry = &macro_time_cache[t & (MACRO_TIME_CACHE_SIZE - 1)];
+
+  if (!entry->valid || entry->t != t)
+    {
+      cached_gmtime(&t, &entry->tm);
+      entry->t = t;
+      entry->valid = TRUE;
+    }
+  return &entry->tm;
+}
+
 static void
 _result_append_value(GString *result, const LogMessage *lm, NVHandle handle, gboolean escape)
 {
@@ -435,7 +473,7 @@ log_macro_expand(GString *result, gint id, gboolean escape, const LogTemplateOpt
     default:
     {
       /* year, month, day */
-      struct tm *tm, tm_storage;
+      const struct tm *tm;
       gchar buf[64];
       gint length;
       time_t t;
@@ -487,8 +525,7 @@ log_macro_expand(GString *result, gint id, gboolean escape, const LogTemplateOpt
 
       t = stamp->tv_sec + zone_ofs;
 
-      cached_gmtime(&t, &tm_storage);
-      tm  = &tm_storage;
+      tm = _get_broken_down_time(t);
 
       switch (id)
         {
@@ -23,6 +23,7 @@
  */
 
 #include "template/repr.h"
+#include "template/macros.h"
 
 void
 log_template_elem_free(LogTemplateElem *e)
@@ -57,3 +58,64 @@ log_template_elem_free_list(GList *l)
     }
   g_list_free(l);
 }
+
+/*
+ * Translate the list of elements produced by the compiler into a
+ * contiguous array of instructions, so that evaluation doesn't have to
+ * chase list pointers.  Literal text becomes an instruction of its own,
+ * elements without an associated macro (e.g.  trailing literals) emit
+ * only their text.
+ *
+ * The instructions point into the elements, so the element list must
+ * outlive the returned array.
+ */
+LogTemplateInstr *
+log_template_elem_list_link(GList *el, gint *code_len)
+{
+  LogTemplateInstr *code;
+  gint n = 0;
+  GList *l;
+
+  /* at most two instructions per element */
+  code = g_new0(LogTemplateInstr, 2 * g_list_length(el) + 1);
+  for (l = el; l; l = l->next)
+    {
+      LogTemplateElem *e = (LogTemplateElem *) l->data;
+      LogTemplateInstr *instr;
+
+      if (e->text && e->text_len)
+        {
+          instr = &code[n++];
+          instr->op = LTI_TEXT;
+          instr->text.str = e->text;
+          instr->text.len = e->text_len;
+        }
+
+      if (e->type == LTE_MACRO && e->macro == M_NONE)
+        continue;
+
+      instr = &code[n++];
+      instr->msg_ref = e->msg_ref;
+      switch (e->type)
+        {
+        case LTE_VALUE:
+          instr->op = LTI_VALUE;
+          instr->value.handle = e->value_handle;
+          instr->value.default_value = e->default_value;
+          break;
+        case LTE_MACRO:
+          instr->op = LTI_MACRO;
+          instr->macro.id = e->macro;
+          instr->macro.default_value = e->default_value;
+          break;
+        case LTE_FUNC:
+          instr->op = LTI_FUNC;
+          instr->func = e;
+          break;
+        default:
+          g_assert_not_reached();
+        }
+    }
+  *code_len = n;
+  return code;
+}
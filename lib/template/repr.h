@@ -54,7 +54,42 @@ typedef struct _LogTemplateElem
   };
 } LogTemplateElem;
 
+/* flat, evaluation-time representation of a compiled template */
+enum
+{
+  LTI_TEXT,
+  LTI_VALUE,
+  LTI_MACRO,
+  LTI_FUNC
+};
+
+struct _LogTemplateInstr
+{
+  guint8 op;
+  guint16 msg_ref;
+  union
+  {
+    struct
+    {
+      const gchar *str;
+      gsize len;
+    } text;
+    struct
+    {
+      NVHandle handle;
+      const gchar *default_value;
+    } value;
+    struct
+    {
+      guint id;
+      const gchar *default_value;
+    } macro;
+    LogTemplateElem *func;
+  };
+};
+
 void log_template_elem_free_list(GList *el);
+LogTemplateInstr *log_template_elem_list_link(GList *el, gint *code_len);
 
 
 #endif
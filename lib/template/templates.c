@@ -31,10 +31,39 @@
 static void
 log_template_reset_compiled(LogTemplate *self)
 {
+  g_free(self->code);
+  self->code = NULL;
+  self->code_len = 0;
+  self->trivial_value = 0;
   log_template_elem_free_list(self->compiled_template);
   self->compiled_template = NULL;
 }
 
+static NVHandle
+_lookup_trivial_value(LogTemplate *self)
+{
+  LogTemplateInstr *instr = &self->code[0];
+
+  if (self->code_len != 1 || instr->msg_ref != 0)
+    return 0;
+
+  if (instr->op == LTI_VALUE && !instr->value.default_value)
+    return instr->value.handle;
+
+  /* $MSG is a macro only to support the pre-3.0 semantics */
+  if (instr->op == LTI_MACRO && instr->macro.id == M_MESSAGE && !instr->macro.default_value &&
+      self->cfg && !cfg_is_config_version_older(self->cfg, 0x0300))
+    return LM_V_MESSAGE;
+  return 0;
+}
+
+static void
+log_template_link(LogTemplate *self)
+{
+  self->code = log_template_elem_list_link(self->compiled_template, &self->code_len);
+  self->trivial_value = _lookup_trivial_value(self);
+}
+
 gboolean
 log_template_compile(LogTemplate *self, const gchar *template, GError **error)
 {
@@ -51,9 +80,29 @@ log_template_compile(LogTemplate *self, const gchar *template, GError **error)
   log_template_compiler_init(&compiler, self);
   result = log_template_compiler_compile(&compiler, &self->compiled_template, error);
   log_template_compiler_clear(&compiler);
+  log_template_link(self);
   return result;
 }
 
+/* returns TRUE if the template consists of a single value reference
+ * without a default value or escaping, e.g.  "$HOST" or "${.json.field}".
+ * These can be resolved without formatting or copying, see
+ * log_template_get_trivial_value() */
+gboolean
+log_template_is_trivial(LogTemplate *self)
+{
+  return self->trivial_value != 0 && !self->escape;
+}
+
+/* NOTE: the returned value is only valid as long as @msg is not changed */
+const gchar *
+log_template_get_trivial_value(LogTemplate *self, LogMessage *msg, gssize *value_len)
+{
+  g_assert(log_template_is_trivial(self));
+
+  return log_msg_get_value(msg, self->trivial_value, value_len);
+}
+
 void
 log_template_set_escape(LogTemplate *self, gboolean enable)
 {
@@ -69,24 +118,62 @@ log_template_set_type_hint(LogTemplate *self, const gchar *type_hint, GError **e
 }
 
 
+static inline void
+_append_function_call(LogTemplate *self, LogTemplateElem *e, LogMessage **messages, gint num_messages,
+                      const LogTemplateOptions *opts, gint tz, gint32 seq_num, const gchar *context_id, GString *result)
+{
+  g_static_mutex_lock(&self->arg_lock);
+  if (!self->arg_bufs)
+    self->arg_bufs = g_ptr_array_sized_new(0);
+
+  if (1)
+    {
+      LogTemplateInvokeArgs args =
+      {
+        self->arg_bufs,
+        messages,
+        num_messages,
+        opts,
+        tz,
+        seq_num,
+        context_id
+      };
+
+      if (e->func.ops->eval)
+        e->func.ops->eval(e->func.ops, e->func.state, &args);
+      e->func.ops->call(e->func.ops, e->func.state, &args, result);
+    }
+  g_static_mutex_unlock(&self->arg_lock);
+}
+
 void
 log_template_append_format_with_context(LogTemplate *self, LogMessage **messages, gint num_messages,
                                         const LogTemplateOptions *opts, gint tz, gint32 seq_num, const gchar *context_id, GString *result)
 {
-  GList *p;
-  LogTemplateElem *e;
+  LogTemplateInstr *instr, *end;
 
   if (!opts)
     opts = &self->cfg->template_options;
 
-  for (p = self->compiled_template; p; p = g_list_next(p))
+  if (log_template_is_trivial(self) && num_messages > 0)
+    {
+      const gchar *value;
+      gssize value_len;
+
+      value = log_msg_get_value(messages[num_messages - 1], self->trivial_value, &value_len);
+      g_string_append_len(result, value, value_len);
+      return;
+    }
+
+  end = self->code + self->code_len;
+  for (instr = self->code; instr < end; instr++)
     {
       gint msg_ndx;
 
-      e = (LogTemplateElem *) p->data;
-      if (e->text)
+      if (instr->op == LTI_TEXT)
         {
-          g_string_append_len(result, e->text, e->text_len);
+          g_string_append_len(result, instr->text.str, instr->text.len);
+          continue;
         }
 
       /* NOTE: msg_ref is 1 larger than the index specified by the user in
@@ -95,73 +182,50 @@ log_template_append_format_with_context(LogTemplate *self, LogMessage **messages
        *
        * msg_ref == 0 means that the user didn't specify msg_ref
        * msg_ref >= 1 means that the user supplied the given msg_ref, 1 is equal to @0 */
-      if (e->msg_ref > num_messages)
+      if (instr->msg_ref > num_messages)
         continue;
-      msg_ndx = num_messages - e->msg_ref;
+      msg_ndx = num_messages - instr->msg_ref;
 
       /* value and macro can't understand a context, assume that no msg_ref means @0 */
-      if (e->msg_ref == 0)
+      if (instr->msg_ref == 0)
         msg_ndx--;
 
-      switch (e->type)
+      switch (instr->op)
         {
-        case LTE_VALUE:
+        case LTI_VALUE:
         {
           const gchar *value = NULL;
           gssize value_len = -1;
 
-          value = log_msg_get_value(messages[msg_ndx], e->value_handle, &value_len);
+          value = log_msg_get_value(messages[msg_ndx], instr->value.handle, &value_len);
           if (value && value[0])
             result_append(result, value, value_len, self->escape);
-          else if (e->default_value)
-            result_append(result, e->default_value, -1, self->escape);
+          else if (instr->value.default_value)
+            result_append(result, instr->value.default_value, -1, self->escape);
           break;
         }
-        case LTE_MACRO:
+        case LTI_MACRO:
         {
           gint len = result->len;
 
-          if (e->macro)
-            {
-              log_macro_expand(result, e->macro, self->escape, opts ? opts : &self->cfg->template_options, tz, seq_num, context_id,
-                               messages[msg_ndx]);
-              if (len == result->len && e->default_value)
-                g_string_append(result, e->default_value);
-            }
+          log_macro_expand(result, instr->macro.id, self->escape, opts, tz, seq_num, context_id, messages[msg_ndx]);
+          if (len == result->len && instr->macro.default_value)
+            g_string_append(result, instr->macro.default_value);
           break;
         }
-        case LTE_FUNC:
-        {
-          g_static_mutex_lock(&self->arg_lock);
-          if (!self->arg_bufs)
-            self->arg_bufs = g_ptr_array_sized_new(0);
-
-          if (1)
-            {
-              LogTemplateInvokeArgs args =
-              {
-                self->arg_bufs,
-                e->msg_ref ? &messages[msg_ndx] : messages,
-                e->msg_ref ? 1 : num_messages,
-                opts,
-                tz,
-                seq_num,
-                context_id
-              };
-
-
-              /* if a function call is called with an msg_ref, we only
-               * pass that given logmsg to argument resolution, otherwise
-               * we pass the whole set so the arguments can individually
-               * specify which message they want to resolve from
-               */
-              if (e->func.ops->eval)
-                e->func.ops->eval(e->func.ops, e->func.state, &args);
-              e->func.ops->call(e->func.ops, e->func.state, &args, result);
-            }
-          g_static_mutex_unlock(&self->arg_lock);
+        case LTI_FUNC:
+          /* if a function call is called with an msg_ref, we only
+           * pass that given logmsg to argument resolution, otherwise
+           * we pass the whole set so the arguments can individually
+           * specify which message they want to resolve from
+           */
+          _append_function_call(self, instr->func,
+                                instr->msg_ref ? &messages[msg_ndx] : messages,
+                                instr->msg_ref ? 1 : num_messages,
+                                opts, tz, seq_num, context_id, result);
           break;
-        }
+        default:
+          g_assert_not_reached();
         }
     }
 }
@@ -29,6 +29,7 @@
 #include "common-template-typedefs.h"
 #include "timeutils.h"
 #include "type-hinting.h"
+#include "logmsg/nvtable.h"
 
 #define LTZ_LOCAL 0
 #define LTZ_SEND  1
@@ -59,7 +60,13 @@ typedef struct _LogTemplate
   gint ref_cnt;
   gchar *name;
   gchar *template;
+  /* the element list produced by the compiler, owns the compiled elements */
   GList *compiled_template;
+  /* flat instruction array, linked from compiled_template and used for evaluation */
+  LogTemplateInstr *code;
+  gint code_len;
+  /* set if the template is a single value reference, see log_template_get_trivial_value() */
+  NVHandle trivial_value;
   gboolean escape;
   gboolean def_inline;
   GlobalConfig *cfg;
@@ -99,6 +106,9 @@ void log_template_append_format_with_context(LogTemplate *self, LogMessage **mes
 void log_template_format_with_context(LogTemplate *self, LogMessage **messages, gint num_messages, const LogTemplateOptions *opts, gint tz, gint32 seq_num, const gchar *context_id, GString *result);
 void log_template_set_name(LogTemplate *self, const gchar *name);
 
+gboolean log_template_is_trivial(LogTemplate *self);
+const gchar *log_template_get_trivial_value(LogTemplate *self, LogMessage *msg, gssize *value_len);
+
 LogTemplate *log_template_new(GlobalConfig *cfg, const gchar *name);
 LogTemplate *log_template_ref(LogTemplate *s);
 void log_template_unref(LogTemplate *s);
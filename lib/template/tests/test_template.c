@@ -184,6 +184,10 @@ test_macros(void)
   assert_template_format("$S_UNIXTIME", "1139650496.000");
   assert_template_format("$S_TZOFFSET", "+01:00");
   assert_template_format("$S_TZ", "+01:00");
+  /* the same seconds formatted repeatedly in different formats */
+  assert_template_format("$ISODATE $R_ISODATE $DATE $ISODATE $R_UNIXTIME $YEAR$MONTH$DAY $R_HOUR",
+                         "2006-02-11T10:34:56.000+01:00 2006-02-11T19:58:35.639+01:00 Feb 11 10:34:56.000 "
+                         "2006-02-11T10:34:56.000+01:00 1139684315.639 20060211 19");
   assert_template_format("$HOST_FROM", "kismacska");
   assert_template_format("$FULLHOST_FROM", "kismacska");
   assert_template_format("$HOST", "bzorp");
@@ -342,12 +342,40 @@ test_value_name_can_be_the_empty_string_when_referenced_using_braces(void)
                            msg_ref = 0);
 }
 
+static void
+test_single_value_reference_is_trivial(void)
+{
+  assert_template_compile("${VALUE_NAME}");
+  assert_true(log_template_is_trivial(template), "Single value reference is not trivial");
+
+  assert_template_compile("$MSG");
+  assert_true(log_template_is_trivial(template), "$MSG is not trivial");
+}
+
+static void
+test_values_with_text_defaults_or_msgref_are_not_trivial(void)
+{
+  assert_template_compile("foo ${VALUE_NAME}");
+  assert_false(log_template_is_trivial(template), "Value with literal text is trivial");
+
+  assert_template_compile("${VALUE_NAME:-default}");
+  assert_false(log_template_is_trivial(template), "Value with a default is trivial");
+
+  assert_template_compile("${VALUE_NAME}@1");
+  assert_false(log_template_is_trivial(template), "Value with a msgref is trivial");
+
+  assert_template_compile("$HOST $PROGRAM");
+  assert_false(log_template_is_trivial(template), "Multiple values are trivial");
+}
+
 static void
 test_template_compile_value()
 {
   TEMPLATE_TESTCASE(test_simple_value);
   TEMPLATE_TESTCASE(test_value_without_braces);
   TEMPLATE_TESTCASE(test_backslash_within_braces_is_taken_literally);
+  TEMPLATE_TESTCASE(test_single_value_reference_is_trivial);
+  TEMPLATE_TESTCASE(test_values_with_text_defaults_or_msgref_are_not_trivial);
   TEMPLATE_TESTCASE(test_value_name_can_be_the_empty_string_when_referenced_using_braces);
 }
 
@@ -25,6 +25,9 @@
 #include "syslog-ng.h"
 #include "logmsg/logmsg.h"
 #include "template/templates.h"
+#include "template/repr.h"
+#include "template/macros.h"
+#include "template/escaping.h"
 #include "apphook.h"
 #include "cfg.h"
 #include "timeutils.h"
@@ -44,14 +47,93 @@ MsgFormatOptions parse_options;
 
 #define BENCHMARK_COUNT 10000
 
+/*
+ * The evaluator as it was before templates were linked into a flat
+ * instruction array: walks the element list produced by the compiler.
+ * Kept here as a baseline for the benchmark.
+ */
+static void
+_legacy_template_format(LogTemplate *self, LogMessage *msg, const LogTemplateOptions *opts, GString *result)
+{
+  GList *p;
+
+  g_string_truncate(result, 0);
+  for (p = self->compiled_template; p; p = g_list_next(p))
+    {
+      LogTemplateElem *e = (LogTemplateElem *) p->data;
+
+      if (e->text)
+        g_string_append_len(result, e->text, e->text_len);
+
+      if (e->msg_ref > 1)
+        continue;
+
+      switch (e->type)
+        {
+        case LTE_VALUE:
+        {
+          const gchar *value = NULL;
+          gssize value_len = -1;
+
+          value = log_msg_get_value(msg, e->value_handle, &value_len);
+          if (value && value[0])
+            result_append(result, value, value_len, self->escape);
+          else if (e->default_value)
+            result_append(result, e->default_value, -1, self->escape);
+          break;
+        }
+        case LTE_MACRO:
+        {
+          gint len = result->len;
+
+          if (e->macro)
+            {
+              log_macro_expand(result, e->macro, self->escape, opts, LTZ_LOCAL, 0, NULL, msg);
+              if (len == result->len && e->default_value)
+                g_string_append(result, e->default_value);
+            }
+          break;
+        }
+        case LTE_FUNC:
+        {
+          g_static_mutex_lock(&self->arg_lock);
+          if (!self->arg_bufs)
+            self->arg_bufs = g_ptr_array_sized_new(0);
+
+          if (1)
+            {
+              LogTemplateInvokeArgs args =
+              {
+                self->arg_bufs,
+                &msg,
+                1,
+                opts,
+                LTZ_LOCAL,
+                0,
+                NULL
+              };
+
+              if (e->func.ops->eval)
+                e->func.ops->eval(e->func.ops, e->func.state, &args);
+              e->func.ops->call(e->func.ops, e->func.state, &args, result);
+            }
+          g_static_mutex_unlock(&self->arg_lock);
+          break;
+        }
+        }
+    }
+}
+
 void
 testcase(const gchar *msg_str, gboolean syslog_proto, gchar *template)
 {
   LogTemplate *templ;
   LogMessage *msg;
   GString *res = g_string_sized_new(1024);
+  GString *legacy_res = g_string_sized_new(1024);
+  gdouble legacy_speed, speed;
   static TimeZoneInfo *tzinfo = NULL;
-  gint i;
+  gint i, template_len;
   GTimeVal start, end;
 
   if (!tzinfo)
@@ -84,18 +166,42 @@ testcase(const gchar *msg_str, gboolean syslog_proto, gchar *template)
 
   templ = log_template_new(configuration, "dummy");
   log_template_compile(templ, template, NULL);
+
   g_get_current_time(&start);
+  for (i = 0; i < BENCHMARK_COUNT; i++)
+    {
+      _legacy_template_format(templ, msg, &configuration->template_options, res);
+    }
+  g_get_current_time(&end);
+  legacy_speed = i * 1e6 / g_time_val_diff(&end, &start);
+  g_string_assign(legacy_res, res->str);
 
+  g_get_current_time(&start);
   for (i = 0; i < BENCHMARK_COUNT; i++)
     {
       log_template_format(templ, msg, NULL, LTZ_LOCAL, 0, NULL, res);
     }
   g_get_current_time(&end);
-  printf("      %-90.*s speed: %12.3f msg/sec\n", (int) strlen(template) - 1, template, i * 1e6 / g_time_val_diff(&end,
-         &start));
+  speed = i * 1e6 / g_time_val_diff(&end, &start);
+
+  /* don't print the trailing newline */
+  template_len = strlen(template);
+  if (template_len > 0 && template[template_len - 1] == '\n')
+    template_len--;
+
+  printf("      %-70.*s list: %12.3f msg/sec, linked: %12.3f msg/sec (%+.1f%%)%s\n",
+         template_len, template, legacy_speed, speed, (speed / legacy_speed - 1) * 100,
+         log_template_is_trivial(templ) ? " [trivial]" : "");
+
+  if (strcmp(res->str, legacy_res->str) != 0)
+    {
+      fprintf(stderr, "output mismatch, template=%s, list=%s, linked=%s\n", template, legacy_res->str, res->str);
+      success = FALSE;
+    }
 
   log_template_unref(templ);
   g_string_free(res, TRUE);
+  g_string_free(legacy_res, TRUE);
   log_msg_unref(msg);
 }
 
@@ -128,6 +234,9 @@ main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
   testcase("<155>2006-02-11T10:34:56.156+01:00 bzorp syslog-ng[23323]:árvíztűrőtükörfúrógép", FALSE,
            "$DATE $HOST\n");
 
+  testcase("<155>2006-02-11T10:34:56.156+01:00 bzorp syslog-ng[23323]:árvíztűrőtükörfúrógép", FALSE,
+           "$ISODATE $R_ISODATE $YEAR-$MONTH-$DAY $HOUR:$MIN:$SEC\n");
+
   testcase("<155>2006-02-11T10:34:56.156+01:00 bzorp syslog-ng[23323]:árvíztűrőtükörfúrógép", FALSE,
            "$DATE $HOST $MSGHDR\n");
 
@@ -143,6 +252,19 @@ main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
   testcase("<155>2006-02-11T10:34:56.156+01:00 bzorp syslog-ng[23323]:árvíztűrőtükörfúrógép", FALSE,
            "$MSG\n");
 
+  testcase("<155>2006-02-11T10:34:56.156+01:00 bzorp syslog-ng[23323]:árvíztűrőtükörfúrógép", FALSE,
+           "${APP.VALUE}\n");
+
+  /* trivial templates, evaluated by the fast path */
+  testcase("<155>2006-02-11T10:34:56.156+01:00 bzorp syslog-ng[23323]:árvíztűrőtükörfúrógép", FALSE,
+           "$MSG");
+
+  testcase("<155>2006-02-11T10:34:56.156+01:00 bzorp syslog-ng[23323]:árvíztűrőtükörfúrógép", FALSE,
+           "${APP.VALUE}");
+
+  testcase("<155>2006-02-11T10:34:56.156+01:00 bzorp syslog-ng[23323]:árvíztűrőtükörfúrógép", FALSE,
+           "$DATE $HOST $PROGRAM $PID ${APP.VALUE} ${APP.VALUE2} ${APP.VALUE3} ${APP.VALUE4} ${APP.VALUE5} ${APP.VALUE6} ${APP.VALUE7} $MSG\n");
+
   testcase("<155>2006-02-11T10:34:56.156+01:00 bzorp syslog-ng[23323]:árvíztűrőtükörfúrógép", FALSE,
            "$TAGS\n");
 
@@ -49,6 +49,36 @@ assert_strchr_finds_character_at(const gchar *str, int c, int ofs)
   assert_gint((result - str), ofs, "Expected the strchr() return value to point right to the specified offset");
 }
 
+static void
+assert_memchr_any4_finds_character_at(const gchar *str, const gchar *chars, gint ofs)
+{
+  const gchar *result = _memchr_any4(str, strlen(str), chars[0], chars[1], chars[2], chars[3]);
+
+  if (ofs < 0)
+    {
+      assert_null(result, "expected a NULL return, str=%s, chars=%s", str, chars);
+      return;
+    }
+  assert_not_null(result, "expected a non-NULL return, str=%s, chars=%s", str, chars);
+  assert_gint((result - str), ofs, "_memchr_any4() returned an unexpected offset, str=%s, chars=%s", str, chars);
+}
+
+static void
+test_memchr_any4(void)
+{
+  assert_memchr_any4_finds_character_at("", "xxxx", -1);
+  assert_memchr_any4_finds_character_at("abc", "xyzw", -1);
+  assert_memchr_any4_finds_character_at("abc", "xxxc", 2);
+  assert_memchr_any4_finds_character_at("abc", "cbxx", 1);
+  assert_memchr_any4_finds_character_at("0123456789abcdef", "xxxx", -1);
+  assert_memchr_any4_finds_character_at("0123456789abcdef", "fxxx", 15);
+  assert_memchr_any4_finds_character_at("0123456789abcdef0123456789ABCDEF", "xxxx", -1);
+  assert_memchr_any4_finds_character_at("0123456789abcdef0123456789ABCDEF", "xCxx", 28);
+  assert_memchr_any4_finds_character_at("0123456789abcdef0123456789ABCDEF!", "x!xx", 32);
+  assert_memchr_any4_finds_character_at("0123456789abcdef0123456789ABCDEF!", "x!xa", 10);
+  assert_memchr_any4_finds_character_at("0123456789abcdef\x80\xff", "\xff\xff\xff\xff", 17);
+}
+
 int
 main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
 {
@@ -67,5 +97,7 @@ main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
   assert_strchr_finds_character_at("0123456789abcdef", '7', 7);
   assert_strchr_finds_character_at("0123456789abcdef", 'f', 15);
 
+  test_memchr_any4();
+
   return 0;
 }
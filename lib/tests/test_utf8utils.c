@@ -25,6 +25,8 @@
 #include "testutils.h"
 #include "utf8utils.h"
 
+#include <string.h>
+
 
 
 void
@@ -57,6 +59,43 @@ assert_escaped_text(const gchar *str, const gchar *expected_escaped_str)
   assert_escaped_text_with_unsafe_chars(str, expected_escaped_str, NULL);
 }
 
+void
+assert_utf8_validity(const gchar *str, gsize str_len)
+{
+  assert_gboolean(is_valid_utf8(str, str_len), g_utf8_validate(str, str_len, NULL),
+                  "is_valid_utf8() differs from g_utf8_validate(), str=%s", str);
+}
+
+void
+test_utf8_validation(void)
+{
+  const gchar *samples[] =
+  {
+    "",
+    "a",
+    "0123456789abcdef",
+    "0123456789abcdef0123456789abcdef and the tail",
+    "árvíztűrőtükörfúrógép",
+    "0123456789abcdefárvíztűrőtükörfúrógép0123456789abcdef",
+    "0123456789abcde\xc3\xa1",
+    "0123456789abcdef\xad" "0123456789abcdef",
+    "0123456789abcdef0123456789abcdef\xc3",
+    "\xc0\xaf overlong slash",
+    "\xed\xa0\x80 surrogate",
+    "\xf4\x90\x80\x80 out of range",
+    "\xf0\x9f\x98\x80 four bytes",
+    NULL
+  };
+  gint i;
+
+  for (i = 0; samples[i]; i++)
+    assert_utf8_validity(samples[i], strlen(samples[i]));
+
+  /* NUL is not accepted, wherever it is */
+  assert_utf8_validity("0123456789abcdef\0abc", 20);
+  assert_utf8_validity("abc\0", 4);
+}
+
 int
 main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
 {
@@ -88,5 +127,7 @@ main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
   assert_escaped_text_with_unsafe_chars("\"text\"", "\\\"text\\\"", "\"");
   assert_escaped_text_with_unsafe_chars("\"text\"", "\\\"te\\xt\\\"", "\"x");
 
+  test_utf8_validation();
+
   return 0;
 }
@@ -24,14 +24,20 @@
 #include "tlscontext.h"
 #include "str-utils.h"
 #include "messages.h"
+#include "stats/stats-registry.h"
 
 #include <arpa/inet.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <openssl/x509_vfy.h>
 #include <openssl/x509v3.h>
 #include <openssl/err.h>
 #include <openssl/rand.h>
 
+#define TLS_SESSION_ID_CONTEXT "syslog-ng"
+#define TLS_SESSION_TIMEOUT_DEFAULT 300
+
 gboolean
 tls_get_x509_digest(X509 *x, GString *hash_string)
 {
@@ -238,10 +244,28 @@ tls_session_set_verify(TLSSession *self, TLSSessionVerifyFunc verify_func, gpoin
   self->verify_data_destroy = verify_destroy;
 }
 
+static void
+tls_session_handshake_completed(TLSSession *self)
+{
+  /* with TLS 1.3, post-handshake messages may signal completion again */
+  if (self->handshake_completed)
+    return;
+
+  self->handshake_completed = TRUE;
+  if (SSL_session_reused(self->ssl))
+    stats_counter_inc(self->ctx->resumed_handshakes);
+  else
+    stats_counter_inc(self->ctx->full_handshakes);
+}
+
 void
 tls_session_info_callback(const SSL *ssl, int where, int ret)
 {
   TLSSession *self = (TLSSession *)SSL_get_app_data(ssl);
+
+  if (where & SSL_CB_HANDSHAKE_DONE)
+    tls_session_handshake_completed(self);
+
   if( !self->peer_info.found && where == (SSL_ST_ACCEPT|SSL_CB_LOOP) )
     {
       X509 *cert = SSL_get_peer_certificate(ssl);
@@ -276,9 +300,44 @@ tls_session_new(SSL *ssl, TLSContext *ctx)
   return self;
 }
 
+static void
+tls_ssl_session_ref(SSL_SESSION *session)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+  SSL_SESSION_up_ref(session);
+#else
+  CRYPTO_add(&session->references, 1, CRYPTO_LOCK_SSL_SESSION);
+#endif
+}
+
+static void
+tls_context_forget_client_session(TLSContext *self, SSL_SESSION *session)
+{
+  /* the reference of the offered session keeps its address from being reused */
+  g_static_mutex_lock(&self->client_session_lock);
+  if (self->client_session && self->client_session == session)
+    {
+      SSL_SESSION_free(self->client_session);
+      self->client_session = NULL;
+    }
+  g_static_mutex_unlock(&self->client_session_lock);
+}
+
 void
 tls_session_free(TLSSession *self)
 {
+  /* don't offer the same session again if resuming it has failed */
+  if (self->offered_session && !self->handshake_completed)
+    tls_context_forget_client_session(self->ctx, self->offered_session);
+  if (self->offered_session)
+    SSL_SESSION_free(self->offered_session);
+
+  /* connections are closed without a close_notify, which would make
+   * OpenSSL drop the session from the caches when it is freed.  Sessions
+   * of connections failed with a fatal alert are invalidated anyway. */
+  if (self->handshake_completed)
+    SSL_set_shutdown(self->ssl, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+
   if (self->verify_data && self->verify_data_destroy)
     self->verify_data_destroy(self->verify_data);
   SSL_free(self->ssl);
@@ -301,6 +360,146 @@ file_exists(const gchar *fname)
   return TRUE;
 }
 
+static int
+tls_context_new_client_session(SSL *ssl, SSL_SESSION *session)
+{
+  TLSSession *tls_session = (TLSSession *) SSL_get_app_data(ssl);
+  TLSContext *self = tls_session->ctx;
+
+  g_static_mutex_lock(&self->client_session_lock);
+  if (self->client_session)
+    SSL_SESSION_free(self->client_session);
+  self->client_session = session;
+  g_static_mutex_unlock(&self->client_session_lock);
+
+  /* we have taken the reference */
+  return 1;
+}
+
+static void
+tls_context_offer_client_session(TLSContext *self, TLSSession *tls_session)
+{
+  SSL_SESSION *session;
+
+  g_static_mutex_lock(&self->client_session_lock);
+  session = self->client_session;
+  if (session && SSL_SESSION_get_time(session) + SSL_SESSION_get_timeout(session) <= time(NULL))
+    {
+      SSL_SESSION_free(session);
+      self->client_session = session = NULL;
+    }
+  if (session && SSL_set_session(tls_session->ssl, session))
+    {
+      tls_ssl_session_ref(session);
+      tls_session->offered_session = session;
+    }
+  g_static_mutex_unlock(&self->client_session_lock);
+}
+
+/*
+ * The ticket keys are random and live in the SSL_CTX unless they are
+ * loaded from a file, which lets tickets survive restarts and be shared
+ * by several servers.  The file holds the raw keys: a name, an HMAC and
+ * an AES key, 48 bytes with OpenSSL 1.0 and 80 bytes later.
+ */
+static gboolean
+tls_context_load_session_ticket_keys(TLSContext *self)
+{
+  gchar *keys;
+  gsize keys_len;
+  glong expected_len;
+  GError *error = NULL;
+  gboolean result;
+
+  if (!g_file_get_contents(self->session_ticket_key_file, &keys, &keys_len, &error))
+    {
+      msg_error("Error reading the TLS session ticket key file",
+                evt_tag_str("filename", self->session_ticket_key_file),
+                evt_tag_str("error", error->message));
+      g_clear_error(&error);
+      return FALSE;
+    }
+
+  expected_len = SSL_CTX_set_tlsext_ticket_keys(self->ssl_ctx, NULL, 0);
+  if (keys_len != expected_len)
+    {
+      msg_error("Invalid TLS session ticket key file, its length must match the size of the keys",
+                evt_tag_str("filename", self->session_ticket_key_file),
+                evt_tag_int("length", keys_len),
+                evt_tag_int("expected_length", expected_len));
+      result = FALSE;
+    }
+  else
+    {
+      result = SSL_CTX_set_tlsext_ticket_keys(self->ssl_ctx, keys, keys_len) > 0;
+    }
+
+  memset(keys, 0, keys_len);
+  g_free(keys);
+  return result;
+}
+
+static gboolean
+tls_context_setup_session_cache(TLSContext *self)
+{
+  SSL_CTX_set_timeout(self->ssl_ctx, self->session_timeout);
+  if (!self->session_tickets)
+    SSL_CTX_set_options(self->ssl_ctx, SSL_OP_NO_TICKET);
+  else if (self->mode == TM_SERVER && self->session_ticket_key_file && !tls_context_load_session_ticket_keys(self))
+    return FALSE;
+
+  if (self->session_cache_size == 0)
+    {
+      SSL_CTX_set_session_cache_mode(self->ssl_ctx, SSL_SESS_CACHE_OFF);
+      return TRUE;
+    }
+
+  if (self->mode == TM_CLIENT)
+    {
+      /* only the last session is kept, see tls_context_new_client_session() */
+      SSL_CTX_set_session_cache_mode(self->ssl_ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+      SSL_CTX_sess_set_new_cb(self->ssl_ctx, tls_context_new_client_session);
+      return TRUE;
+    }
+
+  SSL_CTX_set_session_cache_mode(self->ssl_ctx, SSL_SESS_CACHE_SERVER);
+  SSL_CTX_sess_set_cache_size(self->ssl_ctx, self->session_cache_size);
+
+  /* sessions can't be resumed without this if peer certificates are verified */
+  return SSL_CTX_set_session_id_context(self->ssl_ctx, (const guchar *) TLS_SESSION_ID_CONTEXT,
+                                        sizeof(TLS_SESSION_ID_CONTEXT) - 1);
+}
+
+static const gchar *
+tls_context_format_handshake_counter_name(TLSContext *self, gboolean resumed)
+{
+  if (self->mode == TM_CLIENT)
+    return resumed ? "tls_client_resumed_handshakes" : "tls_client_full_handshakes";
+  return resumed ? "tls_server_resumed_handshakes" : "tls_server_full_handshakes";
+}
+
+static void
+tls_context_register_counters(TLSContext *self)
+{
+  stats_lock();
+  stats_register_counter(0, SCS_GLOBAL, tls_context_format_handshake_counter_name(self, FALSE), NULL,
+                         SC_TYPE_PROCESSED, &self->full_handshakes);
+  stats_register_counter(0, SCS_GLOBAL, tls_context_format_handshake_counter_name(self, TRUE), NULL,
+                         SC_TYPE_PROCESSED, &self->resumed_handshakes);
+  stats_unlock();
+}
+
+static void
+tls_context_unregister_counters(TLSContext *self)
+{
+  stats_lock();
+  stats_unregister_counter(SCS_GLOBAL, tls_context_format_handshake_counter_name(self, FALSE), NULL,
+                           SC_TYPE_PROCESSED, &self->full_handshakes);
+  stats_unregister_counter(SCS_GLOBAL, tls_context_format_handshake_counter_name(self, TRUE), NULL,
+                           SC_TYPE_PROCESSED, &self->resumed_handshakes);
+  stats_unlock();
+}
+
 TLSSession *
 tls_context_setup_session(TLSContext *self)
 {
@@ -387,6 +586,11 @@ tls_context_setup_session(TLSContext *self)
           if (!SSL_CTX_set_cipher_list(self->ssl_ctx, self->cipher_suite))
             goto error;
         }
+      if (!tls_context_setup_session_cache(self))
+        goto error;
+
+      if (!self->full_handshakes)
+        tls_context_register_counters(self);
     }
 
   ssl = SSL_new(self->ssl_ctx);
@@ -398,6 +602,9 @@ tls_context_setup_session(TLSContext *self)
 
   session = tls_session_new(ssl, self);
   SSL_set_app_data(ssl, session);
+
+  if (self->mode == TM_CLIENT)
+    tls_context_offer_client_session(self, session);
   return session;
 
 error:
@@ -422,12 +629,21 @@ tls_context_new(TLSMode mode)
   self->mode = mode;
   self->verify_mode = TVM_REQUIRED | TVM_TRUSTED;
   self->ssl_options = TSO_NOSSLv2;
+  self->session_cache_size = SSL_SESSION_CACHE_MAX_SIZE_DEFAULT;
+  self->session_timeout = TLS_SESSION_TIMEOUT_DEFAULT;
+  self->session_tickets = TRUE;
+  g_static_mutex_init(&self->client_session_lock);
   return self;
 }
 
 void
 tls_context_free(TLSContext *self)
 {
+  if (self->full_handshakes)
+    tls_context_unregister_counters(self);
+  if (self->client_session)
+    SSL_SESSION_free(self->client_session);
+  g_static_mutex_free(&self->client_session_lock);
   SSL_CTX_free(self->ssl_ctx);
   g_list_foreach(self->trusted_fingerpint_list, (GFunc) g_free, NULL);
   g_list_foreach(self->trusted_dn_list, (GFunc) g_free, NULL);
@@ -436,6 +652,7 @@ tls_context_free(TLSContext *self)
   g_free(self->ca_dir);
   g_free(self->crl_dir);
   g_free(self->cipher_suite);
+  g_free(self->session_ticket_key_file);
   g_free(self);
 }
 
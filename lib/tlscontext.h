@@ -25,6 +25,7 @@
 #define TLSCONTEXT_H_INCLUDED
 
 #include "syslog-ng.h"
+#include "stats/stats-counter.h"
 
 #include <openssl/ssl.h>
 
@@ -68,6 +69,9 @@ typedef struct _TLSSession
   TLSSessionVerifyFunc verify_func;
   gpointer verify_data;
   GDestroyNotify verify_data_destroy;
+  /* the client session offered for resumption, a reference is held */
+  SSL_SESSION *offered_session;
+  gboolean handshake_completed;
   struct
   {
     int found;
@@ -93,6 +97,17 @@ struct _TLSContext
   GList *trusted_fingerpint_list;
   GList *trusted_dn_list;
   gint ssl_options;
+  gint session_cache_size;
+  gint session_timeout;
+  gboolean session_tickets;
+  gchar *session_ticket_key_file;
+
+  /* client mode: the session established last, offered when reconnecting */
+  GStaticMutex client_session_lock;
+  SSL_SESSION *client_session;
+
+  StatsCounterItem *full_handshakes;
+  StatsCounterItem *resumed_handshakes;
 };
 
 
@@ -36,6 +36,8 @@ struct _LogTransport
   GIOCondition cond;
   gssize (*read)(LogTransport *self, gpointer buf, gsize count, LogTransportAuxData *aux);
   gssize (*write)(LogTransport *self, const gpointer buf, gsize count);
+  /* optional: TRUE if the transport has already read input that poll() won't report */
+  gboolean (*has_pending_input)(LogTransport *self);
   void (*free_fn)(LogTransport *self);
 };
 
@@ -51,6 +53,12 @@ log_transport_read(LogTransport *self, gpointer buf, gsize count, LogTransportAu
   return self->read(self, buf, count, aux);
 }
 
+static inline gboolean
+log_transport_has_pending_input(LogTransport *self)
+{
+  return self->has_pending_input && self->has_pending_input(self);
+}
+
 void log_transport_init_instance(LogTransport *s, gint fd);
 void log_transport_free_method(LogTransport *s);
 void log_transport_free(LogTransport *s);
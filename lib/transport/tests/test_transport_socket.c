@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "testutils.h"
+#include "transport/transport-socket.h"
+#include "gsockaddr.h"
+#include "fdhelpers.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define NUM_DATAGRAMS 40
+
+static gint
+_create_udp_socket(struct sockaddr_in *sin)
+{
+  socklen_t salen = sizeof(*sin);
+  gint fd;
+
+  fd = socket(AF_INET, SOCK_DGRAM, 0);
+  memset(sin, 0, sizeof(*sin));
+  sin->sin_family = AF_INET;
+  sin->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  bind(fd, (struct sockaddr *) sin, sizeof(*sin));
+  getsockname(fd, (struct sockaddr *) sin, &salen);
+  return fd;
+}
+
+static void
+test_batched_dgram_transport_returns_each_datagram_with_its_peer_address(void)
+{
+  struct sockaddr_in receiver_addr, sender_addr;
+  gint receiver_fd, sender_fd;
+  LogTransport *transport;
+  gchar buf[1024];
+  gssize rc;
+  gint saved_errno;
+  gint i;
+
+  receiver_fd = _create_udp_socket(&receiver_addr);
+  sender_fd = _create_udp_socket(&sender_addr);
+  g_fd_set_nonblock(receiver_fd, TRUE);
+
+  for (i = 0; i < NUM_DATAGRAMS; i++)
+    {
+      gchar *msg = g_strdup_printf("message %d", i);
+
+      sendto(sender_fd, msg, strlen(msg), 0, (struct sockaddr *) &receiver_addr, sizeof(receiver_addr));
+      g_free(msg);
+    }
+
+  transport = log_transport_batched_dgram_socket_new(receiver_fd);
+  assert_false(log_transport_has_pending_input(transport), "transport has pending input before the first read");
+
+  for (i = 0; i < NUM_DATAGRAMS; i++)
+    {
+      LogTransportAuxData aux;
+      gchar *expected = g_strdup_printf("message %d", i);
+
+      log_transport_aux_data_init(&aux);
+      rc = log_transport_read(transport, buf, sizeof(buf), &aux);
+      assert_gint(rc, strlen(expected), "unexpected datagram length, index=%d", i);
+      assert_nstring(buf, rc, expected, -1, "unexpected datagram contents, index=%d", i);
+      assert_not_null(aux.peer_addr, "peer address is missing, index=%d", i);
+      assert_gint(g_sockaddr_get_port(aux.peer_addr), ntohs(sender_addr.sin_port),
+                  "unexpected peer port, index=%d", i);
+      log_transport_aux_data_destroy(&aux);
+      g_free(expected);
+    }
+
+  assert_false(log_transport_has_pending_input(transport), "transport has pending input after reading everything");
+  rc = log_transport_read(transport, buf, sizeof(buf), NULL);
+  saved_errno = errno;
+  assert_gint(rc, -1, "read succeeded on an empty socket");
+  assert_gint(saved_errno, EAGAIN, "read on an empty socket didn't set EAGAIN");
+
+  log_transport_free(transport);
+  close(sender_fd);
+}
+
+int
+main(int argc, char **argv)
+{
+  test_batched_dgram_transport_returns_each_datagram_with_its_peer_address();
+  return 0;
+}
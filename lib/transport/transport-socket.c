@@ -25,6 +25,8 @@
 
 #include <errno.h>
 #include <unistd.h>
+#include <string.h>
+#include <sys/socket.h>
 
 static gssize
 log_transport_dgram_socket_read_method(LogTransport *s, gpointer buf, gsize buflen, LogTransportAuxData *aux)
@@ -95,6 +97,137 @@ log_transport_dgram_socket_new(gint fd)
   return &self->super;
 }
 
+#if SYSLOG_NG_HAVE_RECVMMSG
+
+/*
+ * Datagram transport that receives up to LOG_TRANSPORT_DGRAM_BATCH_SIZE
+ * datagrams with a single recvmmsg() call and hands them out one by one
+ * on subsequent reads, saving a syscall for each datagram beyond the
+ * first in a batch.
+ */
+
+#define LOG_TRANSPORT_DGRAM_BATCH_SIZE 16
+
+typedef struct _LogTransportBatchedDGramSocket
+{
+  LogTransportSocket super;
+  guchar *buffers;
+  gsize buffer_size;
+  struct mmsghdr msgs[LOG_TRANSPORT_DGRAM_BATCH_SIZE];
+  struct iovec iov[LOG_TRANSPORT_DGRAM_BATCH_SIZE];
+  struct sockaddr_storage addrs[LOG_TRANSPORT_DGRAM_BATCH_SIZE];
+  /* index of the next datagram to return, and the number of datagrams received */
+  gint head, count;
+} LogTransportBatchedDGramSocket;
+
+static void
+_setup_batch_buffers(LogTransportBatchedDGramSocket *self, gsize buffer_size)
+{
+  gint i;
+
+  if (self->buffer_size != buffer_size)
+    {
+      g_free(self->buffers);
+      self->buffers = g_malloc(buffer_size * LOG_TRANSPORT_DGRAM_BATCH_SIZE);
+      self->buffer_size = buffer_size;
+    }
+
+  for (i = 0; i < LOG_TRANSPORT_DGRAM_BATCH_SIZE; i++)
+    {
+      self->iov[i].iov_base = self->buffers + i * buffer_size;
+      self->iov[i].iov_len = buffer_size;
+      memset(&self->msgs[i], 0, sizeof(self->msgs[i]));
+      self->msgs[i].msg_hdr.msg_iov = &self->iov[i];
+      self->msgs[i].msg_hdr.msg_iovlen = 1;
+      self->msgs[i].msg_hdr.msg_name = &self->addrs[i];
+      self->msgs[i].msg_hdr.msg_namelen = sizeof(self->addrs[i]);
+    }
+}
+
+static gboolean
+_receive_batch(LogTransportBatchedDGramSocket *self, gsize buffer_size)
+{
+  gint rc;
+
+  _setup_batch_buffers(self, buffer_size);
+  do
+    {
+      rc = recvmmsg(self->super.super.fd, self->msgs, LOG_TRANSPORT_DGRAM_BATCH_SIZE, 0, NULL);
+    }
+  while (rc == -1 && errno == EINTR);
+
+  self->head = 0;
+  self->count = MAX(rc, 0);
+  if (rc == 0)
+    errno = EAGAIN;
+  return rc > 0;
+}
+
+static gssize
+log_transport_batched_dgram_socket_read_method(LogTransport *s, gpointer buf, gsize buflen, LogTransportAuxData *aux)
+{
+  LogTransportBatchedDGramSocket *self = (LogTransportBatchedDGramSocket *) s;
+  struct mmsghdr *m;
+  gsize len;
+
+  if (self->head == self->count && !_receive_batch(self, buflen))
+    return -1;
+
+  m = &self->msgs[self->head++];
+  if (m->msg_hdr.msg_namelen && aux)
+    log_transport_aux_data_set_peer_addr_ref(aux, g_sockaddr_new((struct sockaddr *) m->msg_hdr.msg_name,
+                                                                 m->msg_hdr.msg_namelen));
+  if (m->msg_len == 0)
+    {
+      /* DGRAM sockets should never return EOF, they just need to be read again */
+      errno = EAGAIN;
+      return -1;
+    }
+
+  len = MIN(m->msg_len, buflen);
+  memcpy(buf, m->msg_hdr.msg_iov->iov_base, len);
+  return len;
+}
+
+static gboolean
+log_transport_batched_dgram_socket_has_pending_input(LogTransport *s)
+{
+  LogTransportBatchedDGramSocket *self = (LogTransportBatchedDGramSocket *) s;
+
+  return self->head < self->count;
+}
+
+static void
+log_transport_batched_dgram_socket_free_method(LogTransport *s)
+{
+  LogTransportBatchedDGramSocket *self = (LogTransportBatchedDGramSocket *) s;
+
+  g_free(self->buffers);
+  log_transport_free_method(s);
+}
+
+LogTransport *
+log_transport_batched_dgram_socket_new(gint fd)
+{
+  LogTransportBatchedDGramSocket *self = g_new0(LogTransportBatchedDGramSocket, 1);
+
+  log_transport_dgram_socket_init_instance(&self->super, fd);
+  self->super.super.read = log_transport_batched_dgram_socket_read_method;
+  self->super.super.has_pending_input = log_transport_batched_dgram_socket_has_pending_input;
+  self->super.super.free_fn = log_transport_batched_dgram_socket_free_method;
+  return &self->super.super;
+}
+
+#else
+
+LogTransport *
+log_transport_batched_dgram_socket_new(gint fd)
+{
+  return log_transport_dgram_socket_new(fd);
+}
+
+#endif
+
 static gssize
 log_transport_stream_socket_read_method(LogTransport *s, gpointer buf, gsize buflen, LogTransportAuxData *aux)
 {
@@ -199,3 +199,55 @@ convert_unsafe_utf8_to_escaped_text(const gchar *str, gssize str_len,
   append_unsafe_utf8_as_escaped_text(escaped_string, str, str_len, unsafe_chars);
   return g_string_free(escaped_string, FALSE);
 }
+
+/* returns the first byte that is either NUL or not 7-bit ASCII */
+static inline const gchar *
+_skip_ascii(const gchar *s, const gchar *end)
+{
+#ifdef __SSE2__
+  const __m128i nul = _mm_setzero_si128();
+
+  for (; end - s >= 16; s += 16)
+    {
+      __m128i block = _mm_loadu_si128((const __m128i *) s);
+      gint mask = _mm_movemask_epi8(_mm_or_si128(block, _mm_cmpeq_epi8(block, nul)));
+
+      if (mask)
+        return s + g_bit_nth_lsf(mask, -1);
+    }
+#endif
+
+  for (; s < end; s++)
+    {
+      if (*s == 0 || (*s & 0x80))
+        return s;
+    }
+  return s;
+}
+
+/**
+ * Equivalent to g_utf8_validate(str, str_len, NULL), e.g. NUL characters
+ * are considered invalid.
+ *
+ * Most log messages are plain ASCII, so runs of ASCII characters are
+ * skipped 16 bytes at a time (with SSE2), only multi-byte sequences are
+ * decoded one-by-one.
+ */
+gboolean
+is_valid_utf8(const gchar *str, gsize str_len)
+{
+  const gchar *end = str + str_len;
+  gunichar uchar;
+
+  while ((str = _skip_ascii(str, end)) < end)
+    {
+      if (*str == 0)
+        return FALSE;
+
+      uchar = g_utf8_get_char_validated(str, end - str);
+      if (uchar == (gunichar) -1 || uchar == (gunichar) -2)
+        return FALSE;
+      str = g_utf8_next_char(str);
+    }
+  return TRUE;
+}
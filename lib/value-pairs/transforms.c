@@ -233,30 +233,32 @@ value_pairs_transform_set_free(ValuePairsTransformSet *vpts)
   g_free(vpts);
 }
 
+void
+value_pairs_transform_set_apply_in_place(ValuePairsTransformSet *vpts, SBGString *key)
+{
+  GList *l;
+
+  if (!g_pattern_match_string(vpts->pattern, sb_gstring_string(key)->str))
+    return;
+
+  for (l = vpts->transforms; l; l = l->next)
+    value_pairs_transform_apply((ValuePairsTransform *)l->data, key);
+}
+
 gchar *
 value_pairs_transform_set_apply(ValuePairsTransformSet *vpts, gchar *key)
 {
-  if (g_pattern_match_string(vpts->pattern, key))
-    {
-      GList *l;
-      SBGString *sb;
-      gchar *new_key;
+  SBGString *sb;
+  gchar *new_key;
 
-      sb = sb_gstring_acquire ();
-      g_string_assign(sb_gstring_string(sb), key);
+  sb = sb_gstring_acquire ();
+  g_string_assign(sb_gstring_string(sb), key);
 
-      l = vpts->transforms;
-      while (l)
-        {
-          value_pairs_transform_apply((ValuePairsTransform *)l->data, sb);
-          l = l->next;
-        }
+  value_pairs_transform_set_apply_in_place(vpts, sb);
 
-      new_key = sb_gstring_string(sb)->str;
-      g_string_steal(sb_gstring_string(sb));
-      sb_gstring_release (sb);
+  new_key = sb_gstring_string(sb)->str;
+  g_string_steal(sb_gstring_string(sb));
+  sb_gstring_release (sb);
 
-      return new_key;
-    }
-  return g_strdup(key);
+  return new_key;
 }
@@ -26,6 +26,7 @@
 #define VPTRANSFORM_INCLUDED 1
 
 #include "syslog-ng.h"
+#include "scratch-buffers.h"
 
 typedef struct _ValuePairsTransform ValuePairsTransform;
 typedef struct _ValuePairsTransformSet ValuePairsTransformSet;
@@ -39,5 +40,6 @@ ValuePairsTransformSet *value_pairs_transform_set_new(const gchar *glob);
 void value_pairs_transform_set_add_func(ValuePairsTransformSet *vpts, ValuePairsTransform *vpt);
 void value_pairs_transform_set_free(ValuePairsTransformSet *vpts);
 gchar *value_pairs_transform_set_apply(ValuePairsTransformSet *vpts, gchar *key);
+void value_pairs_transform_set_apply_in_place(ValuePairsTransformSet *vpts, SBGString *key);
 
 #endif
@@ -54,6 +54,10 @@ struct _ValuePairs
   GPtrArray *vpairs;
   GPtrArray *transforms;
 
+  /* builtins and explicit pairs with their names already transformed,
+   * recompiled whenever the configuration changes, see vp_compile_plan() */
+  GArray *plan;
+
   /* guint32 as CfgFlagHandler only supports 32 bit integers */
   guint32 scopes;
 };
@@ -84,6 +88,38 @@ typedef struct
   gint id;
 } ValuePairSpec;
 
+/* a builtin or an explicit pair to be added to the result set of every message */
+typedef struct
+{
+  gchar *name;
+  ValuePairSpec *spec;
+  VPPairConf *pair;
+} VPPlanEntry;
+
+/* a name-value pair collected for a message, names either point to a
+ * stable string or are stored in the arena, values are always stored in
+ * the arena */
+typedef struct
+{
+  const gchar *name;
+  gssize name_ofs;
+  gsize value_ofs;
+  gsize value_len;
+  TypeHint type_hint;
+  gint seq;
+} VPResult;
+
+typedef struct
+{
+  ValuePairs *vp;
+
+  /* NUL terminated names and values */
+  SBGString *arena;
+  /* array of VPResult */
+  SBGString *results;
+  gint num_results;
+} VPResultSet;
+
 static ValuePairSpec rfc3164[] =
 {
   /* there's one macro named DATE that'll be expanded specially */
@@ -193,25 +229,119 @@ vp_transform_apply (ValuePairs *vp, gchar *key)
   return ckey;
 }
 
-/* runs over the name-value pairs requested by the user (e.g. with value_pairs_add_pair) */
 static void
-vp_pairs_foreach(gpointer data, gpointer user_data)
+vp_result_set_init(VPResultSet *self, ValuePairs *vp)
+{
+  self->vp = vp;
+  self->arena = sb_gstring_acquire();
+  self->results = sb_gstring_acquire();
+  self->num_results = 0;
+}
+
+static void
+vp_result_set_destroy(VPResultSet *self)
+{
+  sb_gstring_release(self->arena);
+  sb_gstring_release(self->results);
+}
+
+static inline GString *
+vp_result_set_arena(VPResultSet *self)
+{
+  return sb_gstring_string(self->arena);
+}
+
+static inline VPResult *
+vp_result_set_get_results(VPResultSet *self)
+{
+  return (VPResult *) sb_gstring_string(self->results)->str;
+}
+
+/* stores the transformed version of @name in the arena, returns its offset */
+static gssize
+vp_result_set_add_transformed_name(VPResultSet *self, const gchar *name)
+{
+  GString *arena = vp_result_set_arena(self);
+  gssize name_ofs = arena->len;
+  SBGString *key = sb_gstring_acquire();
+  gint i;
+
+  g_string_assign(sb_gstring_string(key), name);
+  for (i = 0; i < self->vp->transforms->len; i++)
+    value_pairs_transform_set_apply_in_place((ValuePairsTransformSet *) g_ptr_array_index(self->vp->transforms, i),
+                                             key);
+  g_string_append_len(arena, sb_gstring_string(key)->str, sb_gstring_string(key)->len + 1);
+  sb_gstring_release(key);
+  return name_ofs;
+}
+
+/* adds a result, its value is everything appended to the arena since @value_ofs */
+static void
+vp_result_set_add(VPResultSet *self, const gchar *name, gssize name_ofs, gsize value_ofs, TypeHint type_hint)
 {
-  ValuePairs *vp = ((gpointer *)user_data)[0];
-  LogMessage *msg = ((gpointer *)user_data)[2];
-  gint32 seq_num = GPOINTER_TO_INT (((gpointer *)user_data)[3]);
-  GTree *scope_set = ((gpointer *)user_data)[5];
-  const LogTemplateOptions *template_options = ((gpointer *)user_data)[6];
-  SBTHGString *sb = sb_th_gstring_acquire();
-  VPPairConf *vpc = (VPPairConf *)data;
-  gint time_zone_mode = GPOINTER_TO_INT (((gpointer *)user_data)[7]);
+  GString *arena = vp_result_set_arena(self);
+  GString *results = sb_gstring_string(self->results);
+  VPResult *result;
+
+  g_string_set_size(results, (self->num_results + 1) * sizeof(VPResult));
+  result = &vp_result_set_get_results(self)[self->num_results];
+  result->name = name;
+  result->name_ofs = name_ofs;
+  result->value_ofs = value_ofs;
+  result->value_len = arena->len - value_ofs;
+  result->type_hint = type_hint;
+  result->seq = self->num_results;
+  self->num_results++;
+
+  g_string_append_c(arena, 0);
+}
+
+/* adds the explicit pairs and the builtins to the result set, in the order they were compiled */
+static void
+vp_merge_plan(ValuePairs *vp, VPResultSet *results, LogMessage *msg, gint32 seq_num, gint time_zone_mode,
+              const LogTemplateOptions *template_options)
+{
+  GString *arena = vp_result_set_arena(results);
+  gint i;
+
+  for (i = 0; i < vp->plan->len; i++)
+    {
+      VPPlanEntry *entry = &g_array_index(vp->plan, VPPlanEntry, i);
+      gsize value_ofs = arena->len;
+
+      if (entry->pair)
+        {
+          log_template_append_format(entry->pair->template, msg, template_options,
+                                     time_zone_mode, seq_num, NULL, arena);
+          vp_result_set_add(results, entry->name, -1, value_ofs, entry->pair->template->type_hint);
+          continue;
+        }
+
+      switch (entry->spec->type)
+        {
+        case VPT_MACRO:
+          log_macro_expand(arena, entry->spec->id, FALSE,
+                           template_options, time_zone_mode, seq_num, NULL, msg);
+          break;
+        case VPT_NVPAIR:
+        {
+          const gchar *nv;
+          gssize len;
+
+          nv = log_msg_get_value(msg, (NVHandle) entry->spec->id, &len);
+          g_string_append_len(arena, nv, len);
+          break;
+        }
+        default:
+          g_assert_not_reached();
+        }
 
-  sb->type_hint = vpc->template->type_hint;
-  log_template_append_format((LogTemplate *)vpc->template, msg,
-                             template_options,
-                             time_zone_mode, seq_num, NULL, sb_th_gstring_string(sb));
+      /* empty builtins are skipped */
+      if (arena->len == value_ofs)
+        continue;
 
-  g_tree_insert(scope_set, vp_transform_apply(vp, vpc->name), sb);
+      vp_result_set_add(results, entry->name, -1, value_ofs, TYPE_HINT_STRING);
+    }
 }
 
 /* runs over the LogMessage nv-pairs, and inserts them unless excluded */
@@ -220,11 +350,13 @@ vp_msg_nvpairs_foreach(NVHandle handle, gchar *name,
                        const gchar *value, gssize value_len,
                        gpointer user_data)
 {
-  ValuePairs *vp = ((gpointer *)user_data)[0];
-  GTree *scope_set = ((gpointer *)user_data)[5];
+  VPResultSet *results = (VPResultSet *) user_data;
+  ValuePairs *vp = results->vp;
+  GString *arena;
   guint j;
   gboolean inc;
-  SBTHGString *sb;
+  gssize name_ofs = -1;
+  gsize value_ofs;
 
   inc = (name[0] == '.' && (vp->scopes & VPS_DOT_NV_PAIRS)) ||
   (name[0] != '.' && (vp->scopes & VPS_NV_PAIRS)) ||
@@ -240,15 +372,32 @@ vp_msg_nvpairs_foreach(NVHandle handle, gchar *name,
   if (!inc)
     return FALSE;
 
-  sb = sb_th_gstring_acquire();
+  /* registry names are never freed, they can be referenced as is */
+  if (vp->transforms->len > 0)
+    name_ofs = vp_result_set_add_transformed_name(results, name);
 
-  g_string_append_len(sb_th_gstring_string(sb), value, value_len);
-  sb->type_hint = TYPE_HINT_STRING;
-  g_tree_insert(scope_set, vp_transform_apply(vp, name), sb);
+  arena = vp_result_set_arena(results);
+  value_ofs = arena->len;
+  g_string_append_len(arena, value, value_len);
+  vp_result_set_add(results, name, name_ofs, value_ofs, TYPE_HINT_STRING);
 
   return FALSE;
 }
 
+static gint
+vp_result_cmp(gconstpointer a, gconstpointer b, gpointer user_data)
+{
+  const VPResult *r1 = (const VPResult *) a;
+  const VPResult *r2 = (const VPResult *) b;
+  GCompareDataFunc compare_func = (GCompareDataFunc) user_data;
+  gint result;
+
+  result = compare_func(r1->name, r2->name, NULL);
+  if (result == 0)
+    result = r1->seq - r2->seq;
+  return result;
+}
+
 static gboolean
 vp_find_in_set(ValuePairs *vp, gchar *name, gboolean exclude)
 {
@@ -295,6 +444,40 @@ vp_merge_set(ValuePairs *vp, ValuePairSpec *set)
 }
 
 
+static void
+vp_plan_clear(ValuePairs *vp)
+{
+  gint i;
+
+  for (i = 0; i < vp->plan->len; i++)
+    g_free(g_array_index(vp->plan, VPPlanEntry, i).name);
+  g_array_set_size(vp->plan, 0);
+}
+
+/* resolves everything that doesn't depend on the message at configuration time */
+static void
+vp_compile_plan(ValuePairs *vp)
+{
+  VPPlanEntry entry;
+  gint i;
+
+  vp_plan_clear(vp);
+  for (i = 0; i < vp->builtins->len; i++)
+    {
+      entry.spec = (ValuePairSpec *) g_ptr_array_index(vp->builtins, i);
+      entry.pair = NULL;
+      entry.name = vp_transform_apply(vp, entry.spec->name);
+      g_array_append_val(vp->plan, entry);
+    }
+  for (i = 0; i < vp->vpairs->len; i++)
+    {
+      entry.spec = NULL;
+      entry.pair = (VPPairConf *) g_ptr_array_index(vp->vpairs, i);
+      entry.name = vp_transform_apply(vp, entry.pair->name);
+      g_array_append_val(vp->plan, entry);
+    }
+}
+
 static void
 vp_update_builtin_list_of_values(ValuePairs *vp)
 {
@@ -314,68 +497,8 @@ vp_update_builtin_list_of_values(ValuePairs *vp)
 
   if (vp->scopes & VPS_ALL_MACROS)
     vp_merge_set(vp, all_macros);
-}
-
-static void
-vp_merge_builtins(ValuePairs *vp, LogMessage *msg, gint32 seq_num, gint time_zone_mode, GTree *dest,
-                  const LogTemplateOptions *template_options)
-{
-  gint i;
-  SBTHGString *sb;
-
-  for (i = 0; i < vp->builtins->len; i++)
-    {
-      ValuePairSpec *spec = (ValuePairSpec *) g_ptr_array_index(vp->builtins, i);
-
-      sb = sb_th_gstring_acquire();
-
-      switch (spec->type)
-        {
-        case VPT_MACRO:
-          log_macro_expand(sb_th_gstring_string(sb), spec->id, FALSE,
-                           template_options, time_zone_mode, seq_num, NULL, msg);
-          break;
-        case VPT_NVPAIR:
-        {
-          const gchar *nv;
-          gssize len;
-
-          nv = log_msg_get_value(msg, (NVHandle) spec->id, &len);
-          g_string_append_len(sb_th_gstring_string(sb), nv, len);
-          break;
-        }
-        default:
-          g_assert_not_reached();
-        }
-
-      if (sb_th_gstring_string(sb)->len == 0)
-        {
-          sb_th_gstring_release(sb);
-          continue;
-        }
-
-      g_tree_insert(dest, vp_transform_apply(vp, spec->name), sb);
-    }
-}
-
-static gboolean
-vp_foreach_helper (const gchar *name, const SBTHGString *hinted_value,
-                   gpointer data)
-{
-  VPForeachFunc func = ((gpointer *)data)[0];
-  gpointer user_data = ((gpointer *)data)[1];
-  gboolean *r = ((gpointer *)data)[2];
-
-  *r &= !func(name, hinted_value->type_hint,
-              sb_th_gstring_string(hinted_value)->str,
-              sb_th_gstring_string(hinted_value)->len, user_data);
-  return !*r;
-}
 
-static void
-vp_data_free (SBTHGString *s)
-{
-  sb_th_gstring_release (s);
+  vp_compile_plan(vp);
 }
 
 gboolean
@@ -385,18 +508,12 @@ value_pairs_foreach_sorted (ValuePairs *vp, VPForeachFunc func,
                             const LogTemplateOptions *template_options,
                             gpointer user_data)
 {
-  gpointer args[] = { vp, func, msg, GINT_TO_POINTER (seq_num), user_data, NULL,
-                      /* remove constness, we are not using that pointer non-const anyway */
-                      (LogTemplateOptions *) template_options, GINT_TO_POINTER(time_zone_mode)
-                    };
-  gboolean result = TRUE;
-  gpointer helper_args[] = { func, user_data, &result };
-  GTree *scope_set;
+  VPResultSet results;
+  VPResult *entries;
+  const gchar *arena;
+  gint i, first;
 
-  scope_set = g_tree_new_full((GCompareDataFunc)compare_func, NULL,
-                              (GDestroyNotify)g_free,
-                              (GDestroyNotify)vp_data_free);
-  args[5] = scope_set;
+  vp_result_set_init(&results, vp);
 
   /*
    * Build up the base set
@@ -404,19 +521,37 @@ value_pairs_foreach_sorted (ValuePairs *vp, VPForeachFunc func,
   if (vp->scopes & (VPS_NV_PAIRS + VPS_DOT_NV_PAIRS + VPS_SDATA + VPS_RFC5424) ||
       vp->patterns->len > 0)
     nv_table_foreach(msg->payload, logmsg_registry,
-                     (NVTableForeachFunc) vp_msg_nvpairs_foreach, args);
+                     (NVTableForeachFunc) vp_msg_nvpairs_foreach, &results);
+
+  /* Merge the builtins and the explicit key-value pairs too */
+  vp_merge_plan(vp, &results, msg, seq_num, time_zone_mode, template_options);
 
-  vp_merge_builtins(vp, msg, seq_num, time_zone_mode, scope_set, template_options);
+  /* the arena doesn't move anymore, resolve the names and sort */
+  arena = vp_result_set_arena(&results)->str;
+  entries = vp_result_set_get_results(&results);
+  for (i = 0; i < results.num_results; i++)
+    {
+      if (entries[i].name_ofs >= 0)
+        entries[i].name = arena + entries[i].name_ofs;
+    }
+  g_qsort_with_data(entries, results.num_results, sizeof(VPResult), vp_result_cmp, compare_func);
 
-  /* Merge the explicit key-value pairs too */
-  g_ptr_array_foreach(vp->vpairs, (GFunc)vp_pairs_foreach, args);
+  /* Aaand we run it through the callback! When a name was added more than
+   * once, the first name is used with the value added last. */
+  for (first = 0, i = 0; i < results.num_results; i++)
+    {
+      if (i + 1 < results.num_results && compare_func(entries[i].name, entries[i + 1].name, NULL) == 0)
+        continue;
 
-  /* Aaand we run it through the callback! */
-  g_tree_foreach(scope_set, (GTraverseFunc)vp_foreach_helper, helper_args);
+      if (func(entries[first].name, entries[i].type_hint,
+               arena + entries[i].value_ofs, entries[i].value_len, user_data))
+        break;
+      first = i + 1;
+    }
 
-  g_tree_destroy(scope_set);
+  vp_result_set_destroy(&results);
 
-  return result;
+  return i >= results.num_results;
 }
 
 gboolean
@@ -824,6 +959,7 @@ value_pairs_new(void)
   vp->vpairs = g_ptr_array_new();
   vp->patterns = g_ptr_array_new();
   vp->transforms = g_ptr_array_new();
+  vp->plan = g_array_new(FALSE, FALSE, sizeof(VPPlanEntry));
 
   return vp;
 }
@@ -863,6 +999,8 @@ value_pairs_free (ValuePairs *vp)
     }
   g_ptr_array_free(vp->transforms, TRUE);
   g_ptr_array_free(vp->builtins, TRUE);
+  vp_plan_clear(vp);
+  g_array_free(vp->plan, TRUE);
   g_free(vp);
 }
 
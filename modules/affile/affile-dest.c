@@ -28,6 +28,8 @@
 #include "gprocess.h"
 #include "stats/stats-registry.h"
 #include "mainloop-call.h"
+#include "mainloop-worker.h"
+#include "scratch-buffers.h"
 #include "transport/transport-file.h"
 #include "logproto/logproto-text-client.h"
 #include "logproto-file-writer.h"
@@ -37,6 +39,7 @@
 #include "logwriter.h"
 
 #include <iv.h>
+#include <iv_work.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -49,6 +52,9 @@
 #define DEFAULT_DW_REOPEN_FLAGS (O_WRONLY | O_CREAT | O_NOCTTY | O_NONBLOCK | O_LARGEFILE | O_APPEND)
 #define DEFAULT_DW_REOPEN_FLAGS_PIPE (O_RDWR | O_NOCTTY | O_NONBLOCK | O_LARGEFILE)
 
+#define AFFILE_WRITER_TABLE_SHARDS 16
+#define AFFILE_OPEN_THREADS 1
+
 /*
  * Threading notes:
  *
@@ -57,15 +63,24 @@
  * performed in various threads.
  *
  *   - queue runs in the thread of the source thread that generated the message
- *   - if the message is to be written to a not-yet-opened file, a new gets
- *     opened and stored in the writer_hash hashtable (initiated from queue,
- *     but performed in the main thread, but more on that later)
+ *   - if the message is to be written to a not-yet-opened file, a new
+ *     writer is created and stored in the writer table right away
+ *     (initiated and performed in queue), but it is initialized in the main
+ *     thread. Messages arriving in the meanwhile are parked in the writer.
+ *   - the file itself is opened by a dedicated open thread, the writer is
+ *     connected to the file in the main thread once the open completes.
+ *     Opens may block for long (e.g. create_dirs() on a slow or remote
+ *     filesystem), they are not submitted to the shared I/O worker pool so
+ *     that they never hold up the sources running there.  The open pool is
+ *     created by the first file destination and released by the last one.
  *   - currently opened destination files are checked regularly and closed
  *     if they are idle for a given amount of time (time_reap) (this is done
  *     in the main thread)
+ *   - if the number of writers exceeds max_open_files, the least recently
+ *     used idle ones are closed before a new one is initialized (main thread)
  *
- * Some of these operations have to be performed in the main thread, others
- * are done in the queue call.
+ * None of these operations block the source thread: it never waits for
+ * the main thread or for the file to be opened.
  *
  * References
  * ==========
@@ -75,29 +90,112 @@
  * syslog-ng is running.
  *
  * AFFileDestWriter instances are created dynamically when a new file is
- * opened. A reference is stored in the writer_hash hashtable. This is then:
+ * needed. A reference is stored in the writer table. This is then:
  *    - looked up in _queue() (in the source thread)
  *    - cleaned up in reap callback (in the main thread)
  *
- * writer_hash is locked (currently a simple mutex) using
- * AFFileDestDriver->lock.  The "queue" method cannot hold the lock while
+ * The writer table is split into shards by the hash of the filename, each
+ * shard being protected by its own mutex, so that source threads writing
+ * to different files rarely contend.  The hash is calculated once for
+ * each message and is stored in the key, thus it is never recalculated by
+ * the hash table.  The "queue" method cannot hold the lock while
  * forwarding it to the next pipe, thus a reference is taken under the
  * protection of the lock, keeping a the next pipe alive, even if that would
  * go away in a parallel reaper process.
+ *
+ * The non-templated single_writer is protected by AFFileDestDriver->lock,
+ * which also protects the list of writers waiting to be initialized.
+ *
+ * Once a source thread has looked up a writer, the writer counts it in
+ * queue_pending until the message is queued.  Writers are only reaped (or
+ * closed because of max_open_files) if they are idle, which is checked and
+ * the writer is removed from the table in one step, under both the lock
+ * of the table (or the driver) and that of the writer.  The lock order is
+ * table shard (or driver) lock -> writer lock.
  */
 
+/* the open thread, shared by all file destinations, see affile_dw_open_file() */
+static struct iv_work_pool affile_open_workers;
+static gint affile_open_workers_refs;
+static WorkerOptions affile_open_worker_options = { .is_output_thread = TRUE };
+
+/* NOTE: runs in the main thread */
+static void
+affile_open_workers_ref(void)
+{
+  main_loop_assert_main_thread();
+
+  if (affile_open_workers_refs++ > 0)
+    return;
+
+  affile_open_workers.max_threads = AFFILE_OPEN_THREADS;
+  affile_open_workers.cookie = &affile_open_worker_options;
+  affile_open_workers.thread_start = (void (*)(void *)) main_loop_worker_thread_start;
+  affile_open_workers.thread_stop = (void (*)(void *)) main_loop_worker_thread_stop;
+  iv_work_pool_create(&affile_open_workers);
+}
+
+/* NOTE: runs in the main thread, pending opens are still completed */
+static void
+affile_open_workers_unref(void)
+{
+  main_loop_assert_main_thread();
+
+  g_assert(affile_open_workers_refs > 0);
+  if (--affile_open_workers_refs == 0)
+    iv_work_pool_put(&affile_open_workers);
+}
+
+typedef struct _AFFileDestWriterKey
+{
+  guint hash;
+  const gchar *filename;
+} AFFileDestWriterKey;
+
+typedef struct _AFFileDestParkedMessage
+{
+  LogMessage *msg;
+  LogPathOptions path_options;
+} AFFileDestParkedMessage;
+
 struct _AFFileDestWriter
 {
   LogPipe super;
   GStaticMutex lock;
   AFFileDestDriver *owner;
   gchar *filename;
+  AFFileDestWriterKey key;
   LogWriter *writer;
   time_t last_msg_stamp;
   time_t last_open_stamp;
   time_t time_reopen;
   struct iv_timer reap_timer;
-  gboolean reopen_pending, queue_pending;
+  gboolean reopen_pending;
+  /* number of source threads that looked up this writer and are about to queue a message */
+  gint queue_pending;
+
+  /* messages received before the writer was initialized in the main thread */
+  gboolean init_pending;
+  GArray *parked_messages;
+  gboolean parked_messages_dropped;
+
+  /* the result of the open, passed from the open thread to the main thread */
+  struct iv_work_item open_work;
+  gboolean open_working;
+  gint open_fd;
+  gint open_errno;
+};
+
+typedef struct _AFFileDestWriterTableShard
+{
+  GStaticMutex lock;
+  GHashTable *writers;
+} AFFileDestWriterTableShard;
+
+struct _AFFileDestWriterTable
+{
+  AFFileDestWriterTableShard shards[AFFILE_WRITER_TABLE_SHARDS];
+  gint num_writers;
 };
 
 static gchar *
@@ -111,6 +209,7 @@ affile_dw_format_persist_name(AFFileDestWriter *self)
   return persist_name;
 }
 
+static gboolean affile_dd_remove_writer_if_idle(AFFileDestDriver *self, AFFileDestWriter *dw);
 static void affile_dd_reap_writer(AFFileDestDriver *self, AFFileDestWriter *dw);
 
 static void
@@ -123,19 +222,30 @@ affile_dw_arm_reaper(AFFileDestWriter *self)
   iv_timer_register(&self->reap_timer);
 }
 
+/* NOTE: lock should be acquired before calling this function. */
+static gboolean
+affile_dw_is_idle(AFFileDestWriter *self)
+{
+  return !self->init_pending &&
+         self->queue_pending == 0 &&
+         !self->open_working &&
+         !log_writer_has_pending_writes(self->writer);
+}
+
 static void
 affile_dw_reap(gpointer s)
 {
   AFFileDestWriter *self = (AFFileDestWriter *) s;
+  gboolean timed_out;
 
   main_loop_assert_main_thread();
 
   g_static_mutex_lock(&self->lock);
-  if (!log_writer_has_pending_writes(self->writer) &&
-      !self->queue_pending &&
-      (cached_g_current_time_sec() - self->last_msg_stamp) >= self->owner->time_reap)
+  timed_out = (cached_g_current_time_sec() - self->last_msg_stamp) >= self->owner->time_reap;
+  g_static_mutex_unlock(&self->lock);
+
+  if (timed_out && affile_dd_remove_writer_if_idle(self->owner, self))
     {
-      g_static_mutex_unlock(&self->lock);
       msg_verbose("Destination timed out, reaping",
                   evt_tag_str("template", self->owner->filename_template->template),
                   evt_tag_str("filename", self->filename));
@@ -143,7 +253,6 @@ affile_dw_reap(gpointer s)
     }
   else
     {
-      g_static_mutex_unlock(&self->lock);
       affile_dw_arm_reaper(self);
     }
 }
@@ -154,23 +263,13 @@ _affile_dw_reopen_file(AFFileDestWriter *self, gchar *name, gint *fd)
   return affile_open_file(name, &self->owner->file_open_options, &self->owner->file_perm_options, fd);
 }
 
-static gboolean
-affile_dw_reopen(AFFileDestWriter *self)
+/* NOTE: runs in the open thread, it may block (e.g. create_dirs) */
+static void
+affile_dw_open_file(gpointer s)
 {
-  int fd;
+  AFFileDestWriter *self = (AFFileDestWriter *) s;
   struct stat st;
-  GlobalConfig *cfg;
-  LogProtoClient *proto = NULL;
-
-  cfg = log_pipe_get_config(&self->super);
-  if (cfg)
-    self->time_reopen = cfg->time_reopen;
 
-  msg_verbose("Initializing destination file writer",
-              evt_tag_str("template", self->owner->filename_template->template),
-              evt_tag_str("filename", self->filename));
-
-  self->last_open_stamp = self->last_msg_stamp;
   if (self->owner->overwrite_if_older > 0 &&
       stat(self->filename, &st) == 0 &&
       st.st_mtime < time(NULL) - self->owner->overwrite_if_older)
@@ -181,26 +280,120 @@ affile_dw_reopen(AFFileDestWriter *self)
       unlink(self->filename);
     }
 
-  if (_affile_dw_reopen_file(self, self->filename, &fd))
+  if (!_affile_dw_reopen_file(self, self->filename, &self->open_fd))
     {
-      proto =  self->owner->file_open_options.is_pipe
-               ? log_proto_text_client_new(log_transport_pipe_new(fd), &self->owner->writer_options.proto_options.super)
-               : log_proto_file_writer_new(log_transport_file_new(fd), &self->owner->writer_options.proto_options.super,
-                                           self->owner->writer_options.flush_lines,
-                                           self->owner->use_fsync);
+      self->open_errno = errno;
+      self->open_fd = -1;
+    }
+}
+
+/* NOTE: runs in the main thread once affile_dw_open_file() has finished */
+static void
+affile_dw_open_file_completed(gpointer s)
+{
+  AFFileDestWriter *self = (AFFileDestWriter *) s;
+  LogProtoClient *proto = NULL;
 
-      main_loop_call((void *(*)(void *)) affile_dw_arm_reaper, self, TRUE);
+  main_loop_assert_main_thread();
+
+  if (!self->writer || !(((LogPipe *) self->writer)->flags & PIF_INITIALIZED))
+    {
+      /* deinitialized while the file was being opened */
+      if (self->open_fd >= 0)
+        close(self->open_fd);
     }
   else
     {
-      msg_error("Error opening file for writing",
-                evt_tag_str("filename", self->filename),
-                evt_tag_errno(EVT_TAG_OSERROR, errno));
+      if (self->open_fd >= 0)
+        {
+          proto =  self->owner->file_open_options.is_pipe
+                   ? log_proto_text_client_new(log_transport_pipe_new(self->open_fd),
+                                               &self->owner->writer_options.proto_options.super)
+                   : log_proto_file_writer_new(log_transport_file_new(self->open_fd),
+                                               &self->owner->writer_options.proto_options.super,
+                                               self->owner->writer_options.flush_lines,
+                                               self->owner->use_fsync,
+                                               self->owner->use_io_uring);
+
+          if (!iv_timer_registered(&self->reap_timer))
+            affile_dw_arm_reaper(self);
+        }
+      else
+        {
+          msg_error("Error opening file for writing",
+                    evt_tag_str("filename", self->filename),
+                    evt_tag_errno(EVT_TAG_OSERROR, self->open_errno));
+        }
+      log_writer_reopen(self->writer, proto);
     }
+  self->open_fd = -1;
 
-  log_writer_reopen(self->writer, proto);
+  g_static_mutex_lock(&self->lock);
+  self->reopen_pending = FALSE;
+  g_static_mutex_unlock(&self->lock);
+  log_pipe_unref(&self->super);
+}
 
-  return TRUE;
+/* NOTE: runs in the main thread, the completion of open_work */
+static void
+affile_dw_open_work_completed(gpointer s)
+{
+  AFFileDestWriter *self = (AFFileDestWriter *) s;
+
+  self->open_working = FALSE;
+  affile_dw_open_file_completed(self);
+  main_loop_worker_job_complete();
+}
+
+/*
+ * Opens the file asynchronously in the open thread, the writer keeps
+ * queueing messages until it is connected to the file.
+ */
+static void
+affile_dw_reopen(AFFileDestWriter *self)
+{
+  GlobalConfig *cfg;
+
+  main_loop_assert_main_thread();
+
+  /* an open is already in progress, its completion is going to reopen the writer */
+  if (self->open_working)
+    return;
+
+  cfg = log_pipe_get_config(&self->super);
+  if (cfg)
+    self->time_reopen = cfg->time_reopen;
+
+  msg_verbose("Initializing destination file writer",
+              evt_tag_str("template", self->owner->filename_template->template),
+              evt_tag_str("filename", self->filename));
+
+  g_static_mutex_lock(&self->lock);
+  self->last_open_stamp = self->last_msg_stamp;
+  self->reopen_pending = TRUE;
+  g_static_mutex_unlock(&self->lock);
+
+  log_pipe_ref(&self->super);
+  if (main_loop_worker_job_quit() || affile_open_workers_refs == 0)
+    {
+      /* no new jobs are started while we are shutting down */
+      affile_dw_open_file(self);
+      affile_dw_open_file_completed(self);
+    }
+  else
+    {
+      /* reloads wait for the open to complete, just like for I/O jobs */
+      main_loop_worker_job_start();
+      self->open_working = TRUE;
+      iv_work_pool_submit_work(&affile_open_workers, &self->open_work);
+    }
+}
+
+static void
+affile_dw_reopen_and_unref(AFFileDestWriter *self)
+{
+  affile_dw_reopen(self);
+  log_pipe_unref(&self->super);
 }
 
 static gboolean
@@ -237,7 +430,8 @@ affile_dw_init(LogPipe *s)
     }
   log_pipe_append(&self->super, (LogPipe *) self->writer);
 
-  return affile_dw_reopen(self);
+  affile_dw_reopen(self);
+  return TRUE;
 }
 
 static gboolean
@@ -258,6 +452,76 @@ affile_dw_deinit(LogPipe *s)
   return TRUE;
 }
 
+/*
+ * Called in the main thread after the writer was initialized (or failed
+ * to), passes on the messages parked while waiting for that.  They are
+ * forwarded without holding the lock, init_pending is only cleared once
+ * no more messages are parked, so that messages queued in parallel are
+ * parked too and don't overtake the ones being forwarded.
+ */
+static void
+affile_dw_release_parked_messages(AFFileDestWriter *self)
+{
+  GArray *parked_messages;
+  gint i;
+
+  while (TRUE)
+    {
+      g_static_mutex_lock(&self->lock);
+      parked_messages = self->parked_messages;
+      self->parked_messages = NULL;
+      if (!parked_messages)
+        {
+          self->init_pending = FALSE;
+          self->parked_messages_dropped = FALSE;
+          g_static_mutex_unlock(&self->lock);
+          break;
+        }
+      g_static_mutex_unlock(&self->lock);
+
+      for (i = 0; i < parked_messages->len; i++)
+        {
+          AFFileDestParkedMessage *parked = &g_array_index(parked_messages, AFFileDestParkedMessage, i);
+
+          if (self->writer)
+            log_pipe_forward_msg(&self->super, parked->msg, &parked->path_options);
+          else
+            log_msg_drop(parked->msg, &parked->path_options, AT_PROCESSED);
+        }
+      g_array_free(parked_messages, TRUE);
+    }
+}
+
+/* NOTE: lock should be acquired before calling this function. */
+static gboolean
+affile_dw_park_message(AFFileDestWriter *self, LogMessage *lm, const LogPathOptions *path_options)
+{
+  AFFileDestParkedMessage parked = { lm, *path_options };
+  gint max_parked = self->owner->super.log_fifo_size;
+
+  if (max_parked < 0)
+    max_parked = log_pipe_get_config(&self->super)->log_fifo_size;
+
+  /* flow controlled sources are limited by their window, like in the queue */
+  if (!path_options->flow_control_requested &&
+      self->parked_messages && self->parked_messages->len >= max_parked)
+    {
+      if (!self->parked_messages_dropped)
+        msg_debug("Destination file is not opened yet and too many messages are waiting for it, dropping messages",
+                  evt_tag_str("filename", self->filename),
+                  evt_tag_int("log_fifo_size", max_parked));
+      self->parked_messages_dropped = TRUE;
+      return FALSE;
+    }
+
+  /* path_options lives on the stack of our caller */
+  parked.path_options.matched = NULL;
+  if (!self->parked_messages)
+    self->parked_messages = g_array_new(FALSE, FALSE, sizeof(AFFileDestParkedMessage));
+  g_array_append_val(self->parked_messages, parked);
+  return TRUE;
+}
+
 /*
  * NOTE: the caller (e.g. AFFileDestDriver) holds a reference to @self, thus
  * @self may _never_ be freed, even if the reaper timer is elapsed in the
@@ -273,18 +537,39 @@ affile_dw_queue(LogPipe *s, LogMessage *lm, const LogPathOptions *path_options,
   if (self->last_open_stamp == 0)
     self->last_open_stamp = self->last_msg_stamp;
 
+  if (self->init_pending)
+    {
+      gboolean parked = affile_dw_park_message(self, lm, path_options);
+
+      g_static_mutex_unlock(&self->lock);
+      if (!parked)
+        log_msg_drop(lm, path_options, AT_PROCESSED);
+      return;
+    }
+
+  if (!self->writer)
+    {
+      /* initialization failed, the writer is being dropped */
+      g_static_mutex_unlock(&self->lock);
+      log_msg_drop(lm, path_options, AT_PROCESSED);
+      return;
+    }
+
   if (!log_writer_opened(self->writer) &&
       !self->reopen_pending &&
       (self->last_open_stamp < self->last_msg_stamp - self->time_reopen))
     {
       self->reopen_pending = TRUE;
+      g_static_mutex_unlock(&self->lock);
+
       /* if the file couldn't be opened, try it again every time_reopen seconds */
+      log_pipe_ref(&self->super);
+      main_loop_call((void *(*)(void *)) affile_dw_reopen_and_unref, self, FALSE);
+    }
+  else
+    {
       g_static_mutex_unlock(&self->lock);
-      affile_dw_reopen(self);
-      g_static_mutex_lock(&self->lock);
-      self->reopen_pending = FALSE;
     }
-  g_static_mutex_unlock(&self->lock);
 
   log_pipe_forward_msg(&self->super, lm, path_options);
 }
@@ -319,6 +604,7 @@ affile_dw_free(LogPipe *s)
 {
   AFFileDestWriter *self = (AFFileDestWriter *) s;
 
+  g_assert(self->parked_messages == NULL);
   log_pipe_unref((LogPipe *) self->writer);
 
   g_static_mutex_free(&self->lock);
@@ -342,7 +628,7 @@ affile_dw_notify(LogPipe *s, gint notify_code, gpointer user_data)
 }
 
 static AFFileDestWriter *
-affile_dw_new(const gchar *filename, GlobalConfig *cfg)
+affile_dw_new(const gchar *filename, guint filename_hash, GlobalConfig *cfg)
 {
   AFFileDestWriter *self = g_new0(AFFileDestWriter, 1);
 
@@ -359,13 +645,163 @@ affile_dw_new(const gchar *filename, GlobalConfig *cfg)
   self->reap_timer.cookie = self;
   self->reap_timer.handler = affile_dw_reap;
 
+  IV_WORK_ITEM_INIT(&self->open_work);
+  self->open_work.cookie = self;
+  self->open_work.work = affile_dw_open_file;
+  self->open_work.completion = affile_dw_open_work_completed;
+  self->open_fd = -1;
+
   /* we have to take care about freeing filename later.
      This avoids a move of the filename. */
   self->filename = g_strdup(filename);
+  self->key.filename = self->filename;
+  self->key.hash = filename_hash;
   g_static_mutex_init(&self->lock);
   return self;
 }
 
+/*
+ * Writer table
+ */
+
+static guint
+_writer_key_hash(gconstpointer k)
+{
+  return ((const AFFileDestWriterKey *) k)->hash;
+}
+
+static gboolean
+_writer_key_equal(gconstpointer a, gconstpointer b)
+{
+  const AFFileDestWriterKey *key_a = (const AFFileDestWriterKey *) a;
+  const AFFileDestWriterKey *key_b = (const AFFileDestWriterKey *) b;
+
+  return key_a->hash == key_b->hash && strcmp(key_a->filename, key_b->filename) == 0;
+}
+
+static AFFileDestWriterTable *
+affile_writer_table_new(void)
+{
+  AFFileDestWriterTable *self = g_new0(AFFileDestWriterTable, 1);
+  gint i;
+
+  for (i = 0; i < AFFILE_WRITER_TABLE_SHARDS; i++)
+    {
+      g_static_mutex_init(&self->shards[i].lock);
+      self->shards[i].writers = g_hash_table_new(_writer_key_hash, _writer_key_equal);
+    }
+  return self;
+}
+
+static AFFileDestWriterTableShard *
+affile_writer_table_get_shard(AFFileDestWriterTable *self, guint hash)
+{
+  return &self->shards[(hash ^ (hash >> 16)) % AFFILE_WRITER_TABLE_SHARDS];
+}
+
+/*
+ * Looks up the writer for @filename and returns a reference to it.  If
+ * there's none, a new one is created and stored in the table, and
+ * *@created is set to TRUE, the caller has to arrange its initialization.
+ */
+static AFFileDestWriter *
+affile_writer_table_lookup_or_create(AFFileDestWriterTable *self, AFFileDestDriver *owner,
+                                     const gchar *filename, guint hash, gboolean *created)
+{
+  AFFileDestWriterTableShard *shard = affile_writer_table_get_shard(self, hash);
+  AFFileDestWriterKey key = { hash, filename };
+  AFFileDestWriter *dw;
+
+  *created = FALSE;
+  g_static_mutex_lock(&shard->lock);
+  dw = g_hash_table_lookup(shard->writers, &key);
+  if (!dw)
+    {
+      dw = affile_dw_new(filename, hash, log_pipe_get_config(&owner->super.super.super));
+      affile_dw_set_owner(dw, owner);
+      dw->init_pending = TRUE;
+      g_hash_table_insert(shard->writers, &dw->key, dw);
+      g_atomic_int_inc(&self->num_writers);
+      *created = TRUE;
+    }
+  log_pipe_ref(&dw->super);
+  g_static_mutex_lock(&dw->lock);
+  dw->queue_pending++;
+  g_static_mutex_unlock(&dw->lock);
+  g_static_mutex_unlock(&shard->lock);
+  return dw;
+}
+
+static void
+affile_writer_table_remove(AFFileDestWriterTable *self, AFFileDestWriter *dw)
+{
+  AFFileDestWriterTableShard *shard = affile_writer_table_get_shard(self, dw->key.hash);
+
+  g_static_mutex_lock(&shard->lock);
+  if (g_hash_table_remove(shard->writers, &dw->key))
+    g_atomic_int_add(&self->num_writers, -1);
+  g_static_mutex_unlock(&shard->lock);
+}
+
+static gboolean
+affile_writer_table_remove_if_idle(AFFileDestWriterTable *self, AFFileDestWriter *dw)
+{
+  AFFileDestWriterTableShard *shard = affile_writer_table_get_shard(self, dw->key.hash);
+  gboolean removed = FALSE;
+
+  g_static_mutex_lock(&shard->lock);
+  g_static_mutex_lock(&dw->lock);
+  if (affile_dw_is_idle(dw) && g_hash_table_remove(shard->writers, &dw->key))
+    {
+      g_atomic_int_add(&self->num_writers, -1);
+      removed = TRUE;
+    }
+  g_static_mutex_unlock(&dw->lock);
+  g_static_mutex_unlock(&shard->lock);
+  return removed;
+}
+
+/* NOTE: runs in the main thread, thus writers are not removed in parallel */
+static void
+affile_writer_table_foreach(AFFileDestWriterTable *self, GHFunc func, gpointer user_data)
+{
+  gint i;
+
+  for (i = 0; i < AFFILE_WRITER_TABLE_SHARDS; i++)
+    {
+      g_static_mutex_lock(&self->shards[i].lock);
+      g_hash_table_foreach(self->shards[i].writers, func, user_data);
+      g_static_mutex_unlock(&self->shards[i].lock);
+    }
+}
+
+/* NOTE: runs in the main thread, while the source threads are stopped */
+static void
+affile_writer_table_foreach_remove(AFFileDestWriterTable *self, GHRFunc func, gpointer user_data)
+{
+  gint i;
+
+  for (i = 0; i < AFFILE_WRITER_TABLE_SHARDS; i++)
+    {
+      gint removed = g_hash_table_foreach_remove(self->shards[i].writers, func, user_data);
+
+      g_atomic_int_add(&self->num_writers, -removed);
+    }
+}
+
+static void
+affile_writer_table_free(AFFileDestWriterTable *self)
+{
+  gint i;
+
+  for (i = 0; i < AFFILE_WRITER_TABLE_SHARDS; i++)
+    {
+      g_hash_table_destroy(self->shards[i].writers);
+      g_static_mutex_free(&self->shards[i].lock);
+    }
+  g_free(self);
+}
+
 void
 affile_dd_set_create_dirs(LogDriver *s, gboolean create_dirs)
 {
@@ -382,6 +818,14 @@ affile_dd_set_overwrite_if_older(LogDriver *s, gint overwrite_if_older)
   self->overwrite_if_older = overwrite_if_older;
 }
 
+void
+affile_dd_set_max_open_files(LogDriver *s, gint max_open_files)
+{
+  AFFileDestDriver *self = (AFFileDestDriver *) s;
+
+  self->max_open_files = max_open_files;
+}
+
 void
 affile_dd_set_fsync(LogDriver *s, gboolean use_fsync)
 {
@@ -390,6 +834,14 @@ affile_dd_set_fsync(LogDriver *s, gboolean use_fsync)
   self->use_fsync = use_fsync;
 }
 
+void
+affile_dd_set_io_uring(LogDriver *s, gboolean use_io_uring)
+{
+  AFFileDestDriver *self = (AFFileDestDriver *) s;
+
+  self->use_io_uring = use_io_uring;
+}
+
 static inline const gchar *
 affile_dd_format_persist_name(const LogPipe *s)
 {
@@ -405,19 +857,13 @@ affile_dd_format_persist_name(const LogPipe *s)
   return persist_name;
 }
 
+/* NOTE: the reference held by the table/single_writer is not dropped */
 static void
-affile_dd_reap_writer(AFFileDestDriver *self, AFFileDestWriter *dw)
+affile_dd_remove_writer(AFFileDestDriver *self, AFFileDestWriter *dw)
 {
-  LogWriter *writer = (LogWriter *)dw->writer;
-
-  main_loop_assert_main_thread();
-
   if (self->filename_is_a_template)
     {
-      g_static_mutex_lock(&self->lock);
-      /* remove from hash table */
-      g_hash_table_remove(self->writer_hash, dw->filename);
-      g_static_mutex_unlock(&self->lock);
+      affile_writer_table_remove(self->writer_table, dw);
     }
   else
     {
@@ -426,23 +872,178 @@ affile_dd_reap_writer(AFFileDestDriver *self, AFFileDestWriter *dw)
       self->single_writer = NULL;
       g_static_mutex_unlock(&self->lock);
     }
+}
+
+/*
+ * Removes @dw if no messages are on their way to it, so that it can be
+ * reaped without new messages reaching it.  Returns FALSE if it is not
+ * idle.
+ */
+static gboolean
+affile_dd_remove_writer_if_idle(AFFileDestDriver *self, AFFileDestWriter *dw)
+{
+  gboolean removed = FALSE;
+
+  if (self->filename_is_a_template)
+    return affile_writer_table_remove_if_idle(self->writer_table, dw);
+
+  g_static_mutex_lock(&self->lock);
+  g_static_mutex_lock(&dw->lock);
+  if (affile_dw_is_idle(dw))
+    {
+      g_assert(dw == self->single_writer);
+      self->single_writer = NULL;
+      removed = TRUE;
+    }
+  g_static_mutex_unlock(&dw->lock);
+  g_static_mutex_unlock(&self->lock);
+  return removed;
+}
+
+/* NOTE: @dw has to be removed by affile_dd_remove_writer_if_idle() first */
+static void
+affile_dd_reap_writer(AFFileDestDriver *self, AFFileDestWriter *dw)
+{
+  LogWriter *writer = (LogWriter *)dw->writer;
+
+  main_loop_assert_main_thread();
 
   log_dest_driver_release_queue(&self->super, log_writer_get_queue(writer));
   log_pipe_deinit(&dw->super);
   log_pipe_unref(&dw->super);
 }
 
+static void
+affile_dd_collect_idle_writer(gpointer key, gpointer value, gpointer user_data)
+{
+  AFFileDestWriter *dw = (AFFileDestWriter *) value;
+  GPtrArray *idle_writers = (GPtrArray *) user_data;
+
+  g_static_mutex_lock(&dw->lock);
+  if (affile_dw_is_idle(dw))
+    g_ptr_array_add(idle_writers, dw);
+  g_static_mutex_unlock(&dw->lock);
+}
+
+static gint
+affile_dd_compare_writers_by_last_msg(gconstpointer a, gconstpointer b)
+{
+  const AFFileDestWriter *dw_a = *(const AFFileDestWriter **) a;
+  const AFFileDestWriter *dw_b = *(const AFFileDestWriter **) b;
+
+  if (dw_a->last_msg_stamp < dw_b->last_msg_stamp)
+    return -1;
+  return dw_a->last_msg_stamp > dw_b->last_msg_stamp;
+}
+
+/*
+ * Closes the least recently used idle writers to make room for a new one
+ * if max_open_files() is reached.  Somewhat more writers are closed than
+ * strictly necessary, so that the table is not scanned for every new file.
+ * Runs in the main thread.
+ */
+static void
+affile_dd_close_idle_writers(AFFileDestDriver *self)
+{
+  GPtrArray *idle_writers;
+  gint num_writers, num_to_close, i;
+
+  num_writers = g_atomic_int_get(&self->writer_table->num_writers);
+  if (self->max_open_files <= 0 || num_writers <= self->max_open_files)
+    return;
+
+  num_to_close = num_writers - self->max_open_files + self->max_open_files / 16;
+
+  idle_writers = g_ptr_array_new();
+  affile_writer_table_foreach(self->writer_table, affile_dd_collect_idle_writer, idle_writers);
+  g_ptr_array_sort(idle_writers, affile_dd_compare_writers_by_last_msg);
+
+  if (idle_writers->len < num_to_close)
+    msg_debug("Not enough idle destination files to stay below max_open_files()",
+              evt_tag_str("template", self->filename_template->template),
+              evt_tag_int("max_open_files", self->max_open_files),
+              evt_tag_int("open_files", num_writers));
+
+  for (i = 0; i < idle_writers->len && num_to_close > 0; i++)
+    {
+      AFFileDestWriter *dw = (AFFileDestWriter *) g_ptr_array_index(idle_writers, i);
+
+      /* a message may have been queued to it since it was collected */
+      if (!affile_dd_remove_writer_if_idle(self, dw))
+        continue;
+      num_to_close--;
+
+      msg_verbose("Too many open destination files, closing the least recently used one",
+                  evt_tag_str("template", self->filename_template->template),
+                  evt_tag_str("filename", dw->filename),
+                  evt_tag_int("max_open_files", self->max_open_files));
+      affile_dd_reap_writer(self, dw);
+    }
+  g_ptr_array_free(idle_writers, TRUE);
+}
+
+/*
+ * Queued writers are initialized here, in the main thread, on behalf of
+ * the source threads that created them.
+ */
+static void
+affile_dd_init_pending_writers(gpointer s)
+{
+  AFFileDestDriver *self = (AFFileDestDriver *) s;
+  GList *pending_writers, *l;
+
+  main_loop_assert_main_thread();
+
+  g_static_mutex_lock(&self->lock);
+  pending_writers = g_list_reverse(self->pending_writers);
+  self->pending_writers = NULL;
+  g_static_mutex_unlock(&self->lock);
+
+  for (l = pending_writers; l; l = l->next)
+    {
+      AFFileDestWriter *dw = (AFFileDestWriter *) l->data;
+
+      if (self->filename_is_a_template)
+        affile_dd_close_idle_writers(self);
+
+      if (!log_pipe_init(&dw->super))
+        {
+          affile_dd_remove_writer(self, dw);
+          /* the reference of the table */
+          log_pipe_unref(&dw->super);
+        }
+      affile_dw_release_parked_messages(dw);
+      log_pipe_unref(&dw->super);
+    }
+  g_list_free(pending_writers);
+}
+
+static void
+affile_dd_schedule_writer_init(AFFileDestDriver *self, AFFileDestWriter *dw)
+{
+  gboolean first;
+
+  log_pipe_ref(&dw->super);
+  g_static_mutex_lock(&self->lock);
+  first = (self->pending_writers == NULL);
+  self->pending_writers = g_list_prepend(self->pending_writers, dw);
+  g_static_mutex_unlock(&self->lock);
+
+  if (first)
+    iv_event_post(&self->pending_writers_posted);
+}
 
 /**
  * affile_dd_reuse_writer:
  *
- * This function is called as a g_hash_table_foreach() callback to set the
- * owner of each writer, previously connected to an AFileDestDriver instance
- * in an earlier configuration. This way AFFileDestWriter instances are
- * remembered accross reloads.
+ * This function is called as a g_hash_table_foreach_remove() callback to
+ * set the owner of each writer, previously connected to an AFileDestDriver
+ * instance in an earlier configuration. This way AFFileDestWriter instances
+ * are remembered accross reloads.  Writers that fail to initialize are
+ * removed.
  *
  **/
-static void
+static gboolean
 affile_dd_reuse_writer(gpointer key, gpointer value, gpointer user_data)
 {
   AFFileDestDriver *self = (AFFileDestDriver *) user_data;
@@ -451,10 +1052,10 @@ affile_dd_reuse_writer(gpointer key, gpointer value, gpointer user_data)
   affile_dw_set_owner(writer, self);
   if (!log_pipe_init(&writer->super))
     {
-      affile_dw_set_owner(writer, NULL);
       log_pipe_unref(&writer->super);
-      g_hash_table_remove(self->writer_hash, key);
+      return TRUE;
     }
+  return FALSE;
 }
 
 
@@ -477,9 +1078,11 @@ affile_dd_init(LogPipe *s)
 
   if (self->filename_is_a_template)
     {
-      self->writer_hash = cfg_persist_config_fetch(cfg, affile_dd_format_persist_name(s));
-      if (self->writer_hash)
-        g_hash_table_foreach(self->writer_hash, affile_dd_reuse_writer, self);
+      self->writer_table = cfg_persist_config_fetch(cfg, affile_dd_format_persist_name(s));
+      if (self->writer_table)
+        affile_writer_table_foreach_remove(self->writer_table, affile_dd_reuse_writer, self);
+      else
+        self->writer_table = affile_writer_table_new();
     }
   else
     {
@@ -490,11 +1093,14 @@ affile_dd_init(LogPipe *s)
           if (!log_pipe_init(&self->single_writer->super))
             {
               log_pipe_unref(&self->single_writer->super);
+              self->single_writer = NULL;
               return FALSE;
             }
         }
     }
 
+  iv_event_register(&self->pending_writers_posted);
+  affile_open_workers_ref();
   return TRUE;
 }
 
@@ -525,18 +1131,18 @@ affile_dd_destroy_writer_hr(gpointer key, gpointer value, gpointer user_data)
 }
 
 /**
- * affile_dd_destroy_writer_hash:
- * @value: GHashTable instance passed as a generic pointer
+ * affile_dd_destroy_writer_table:
+ * @value: AFFileDestWriterTable instance passed as a generic pointer
  *
- * Destroy notify callback for the GHashTable storing AFFileDestWriter instances.
+ * Destroy notify callback for the table storing AFFileDestWriter instances.
  **/
 static void
-affile_dd_destroy_writer_hash(gpointer value)
+affile_dd_destroy_writer_table(gpointer value)
 {
-  GHashTable *writer_hash = (GHashTable *) value;
+  AFFileDestWriterTable *writer_table = (AFFileDestWriterTable *) value;
 
-  g_hash_table_foreach_remove(writer_hash, affile_dd_destroy_writer_hr, NULL);
-  g_hash_table_destroy(writer_hash);
+  affile_writer_table_foreach_remove(writer_table, affile_dd_destroy_writer_hr, NULL);
+  affile_writer_table_free(writer_table);
 }
 
 static void
@@ -550,27 +1156,34 @@ affile_dd_deinit(LogPipe *s)
 {
   AFFileDestDriver *self = (AFFileDestDriver *) s;
   GlobalConfig *cfg = log_pipe_get_config(s);
+
+  /* writers created since the last main loop iteration */
+  affile_dd_init_pending_writers(self);
+  iv_event_unregister(&self->pending_writers_posted);
+
   /* NOTE: we free all AFFileDestWriter instances here as otherwise we'd
    * have circular references between AFFileDestDriver and file writers */
   if (self->single_writer)
     {
-      g_assert(self->writer_hash == NULL);
+      g_assert(self->writer_table == NULL);
 
       log_pipe_deinit(&self->single_writer->super);
       cfg_persist_config_add(cfg, affile_dd_format_persist_name(s), self->single_writer,
                              affile_dd_destroy_writer, FALSE);
       self->single_writer = NULL;
     }
-  else if (self->writer_hash)
+  else if (self->writer_table)
     {
       g_assert(self->single_writer == NULL);
 
-      g_hash_table_foreach(self->writer_hash, affile_dd_deinit_writer, NULL);
-      cfg_persist_config_add(cfg, affile_dd_format_persist_name(s), self->writer_hash,
-                             affile_dd_destroy_writer_hash, FALSE);
-      self->writer_hash = NULL;
+      affile_writer_table_foreach(self->writer_table, affile_dd_deinit_writer, NULL);
+      cfg_persist_config_add(cfg, affile_dd_format_persist_name(s), self->writer_table,
+                             affile_dd_destroy_writer_table, FALSE);
+      self->writer_table = NULL;
     }
 
+  affile_open_workers_unref();
+
   if (!log_dest_driver_deinit_method(s))
     return FALSE;
 
@@ -578,86 +1191,61 @@ affile_dd_deinit(LogPipe *s)
 }
 
 /*
- * This function is ran in the main thread whenever a writer is not yet
- * instantiated.  Returns a reference to the newly constructed LogPipe
- * instance where the caller needs to forward its message.
+ * Returns a reference to the writer of the single, non-templated file.
+ * It is created if it doesn't exist yet.
  */
-static LogPipe *
-affile_dd_open_writer(gpointer args[])
+static AFFileDestWriter *
+affile_dd_get_single_writer(AFFileDestDriver *self)
 {
-  AFFileDestDriver *self = args[0];
   AFFileDestWriter *next;
+  gboolean created = FALSE;
 
-  main_loop_assert_main_thread();
-  if (!self->filename_is_a_template)
+  /* we need to lock single_writer in order to get a reference and
+   * make sure it is not a stale pointer by the time we ref it */
+  g_static_mutex_lock(&self->lock);
+  next = self->single_writer;
+  if (!next)
     {
-      if (!self->single_writer)
-        {
-          next = affile_dw_new(self->filename_template->template, log_pipe_get_config(&self->super.super.super));
-          affile_dw_set_owner(next, self);
-          if (next && log_pipe_init(&next->super))
-            {
-              log_pipe_ref(&next->super);
-              g_static_mutex_lock(&self->lock);
-              self->single_writer = next;
-              g_static_mutex_unlock(&self->lock);
-            }
-          else
-            {
-              log_pipe_unref(&next->super);
-              next = NULL;
-            }
-        }
-      else
-        {
-          next = self->single_writer;
-          log_pipe_ref(&next->super);
-        }
+      next = affile_dw_new(self->filename_template->template, 0, log_pipe_get_config(&self->super.super.super));
+      affile_dw_set_owner(next, self);
+      next->init_pending = TRUE;
+      self->single_writer = next;
+      created = TRUE;
     }
-  else
-    {
-      GString *filename = args[1];
+  g_static_mutex_lock(&next->lock);
+  next->queue_pending++;
+  g_static_mutex_unlock(&next->lock);
+  log_pipe_ref(&next->super);
+  g_static_mutex_unlock(&self->lock);
 
-      /* hash table construction is serialized, as we only do that in the main thread. */
-      if (!self->writer_hash)
-        self->writer_hash = g_hash_table_new(g_str_hash, g_str_equal);
+  if (created)
+    affile_dd_schedule_writer_init(self, next);
+  return next;
+}
 
-      /* we don't need to lock the hashtable as it is only written in
-       * the main thread, which we're running right now.  lookups in
-       * other threads must be locked. writers must be locked even in
-       * this thread to exclude lookups in other threads.  */
+/*
+ * Returns a reference to the writer of the file the message is to be
+ * written to.  It is created if it doesn't exist yet.
+ */
+static AFFileDestWriter *
+affile_dd_get_templated_writer(AFFileDestDriver *self, LogMessage *msg)
+{
+  AFFileDestWriter *next;
+  SBGString *filename = sb_gstring_acquire();
+  gboolean created;
 
-      next = g_hash_table_lookup(self->writer_hash, filename->str);
-      if (!next)
-        {
-          next = affile_dw_new(filename->str, log_pipe_get_config(&self->super.super.super));
-          affile_dw_set_owner(next, self);
-          if (!log_pipe_init(&next->super))
-            {
-              log_pipe_unref(&next->super);
-              next = NULL;
-            }
-          else
-            {
-              log_pipe_ref(&next->super);
-              g_static_mutex_lock(&self->lock);
-              g_hash_table_insert(self->writer_hash, next->filename, next);
-              g_static_mutex_unlock(&self->lock);
-            }
-        }
-      else
-        {
-          log_pipe_ref(&next->super);
-        }
-    }
+  log_template_format(self->filename_template, msg, &self->writer_options.template_options, LTZ_LOCAL, 0, NULL,
+                      sb_gstring_string(filename));
 
-  if (next)
-    {
-      next->queue_pending = TRUE;
-      /* we're returning a reference */
-      return &next->super;
-    }
-  return NULL;
+  next = affile_writer_table_lookup_or_create(self->writer_table, self,
+                                              sb_gstring_string(filename)->str,
+                                              g_str_hash(sb_gstring_string(filename)->str),
+                                              &created);
+  sb_gstring_release(filename);
+
+  if (created)
+    affile_dd_schedule_writer_init(self, next);
+  return next;
 }
 
 static void
@@ -665,64 +1253,18 @@ affile_dd_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options,
 {
   AFFileDestDriver *self = (AFFileDestDriver *) s;
   AFFileDestWriter *next;
-  gpointer args[2] = { self, NULL };
 
   if (!self->filename_is_a_template)
-    {
-      /* no need to lock the check below, the worst case that happens is
-       * that we go to the mainloop to return the same information, but this
-       * is not fast path anyway */
-
-      g_static_mutex_lock(&self->lock);
-      if (!self->single_writer)
-        {
-          g_static_mutex_unlock(&self->lock);
-          next = main_loop_call((void *(*)(void *)) affile_dd_open_writer, args, TRUE);
-        }
-      else
-        {
-          /* we need to lock single_writer in order to get a reference and
-           * make sure it is not a stale pointer by the time we ref it */
-          next = self->single_writer;
-          next->queue_pending = TRUE;
-          log_pipe_ref(&next->super);
-          g_static_mutex_unlock(&self->lock);
-        }
-    }
+    next = affile_dd_get_single_writer(self);
   else
-    {
-      GString *filename;
-
-      filename = g_string_sized_new(32);
-      log_template_format(self->filename_template, msg, &self->writer_options.template_options, LTZ_LOCAL, 0, NULL, filename);
+    next = affile_dd_get_templated_writer(self, msg);
 
-      g_static_mutex_lock(&self->lock);
-      if (self->writer_hash)
-        next = g_hash_table_lookup(self->writer_hash, filename->str);
-      else
-        next = NULL;
-
-      if (next)
-        {
-          log_pipe_ref(&next->super);
-          next->queue_pending = TRUE;
-          g_static_mutex_unlock(&self->lock);
-        }
-      else
-        {
-          g_static_mutex_unlock(&self->lock);
-          args[1] = filename;
-          next = main_loop_call((void *(*)(void *)) affile_dd_open_writer, args, TRUE);
-        }
-      g_string_free(filename, TRUE);
-    }
-  if (next)
-    {
-      log_msg_add_ack(msg, path_options);
-      log_pipe_queue(&next->super, log_msg_ref(msg), path_options);
-      next->queue_pending = FALSE;
-      log_pipe_unref(&next->super);
-    }
+  log_msg_add_ack(msg, path_options);
+  log_pipe_queue(&next->super, log_msg_ref(msg), path_options);
+  g_static_mutex_lock(&next->lock);
+  next->queue_pending--;
+  g_static_mutex_unlock(&next->lock);
+  log_pipe_unref(&next->super);
 
   log_dest_driver_queue_method(s, msg, path_options, user_data);
 }
@@ -735,7 +1277,7 @@ affile_dd_free(LogPipe *s)
   g_static_mutex_free(&self->lock);
 
   /* NOTE: this must be NULL as deinit has freed it, otherwise we'd have circular references */
-  g_assert(self->single_writer == NULL && self->writer_hash == NULL);
+  g_assert(self->single_writer == NULL && self->writer_table == NULL);
 
   log_template_unref(self->filename_template);
   log_writer_options_destroy(&self->writer_options);
@@ -768,6 +1310,10 @@ affile_dd_new_instance(gchar *filename, GlobalConfig *cfg)
   self->file_open_options.needs_privileges = FALSE;
   self->file_open_options.open_flags = DEFAULT_DW_REOPEN_FLAGS;
   g_static_mutex_init(&self->lock);
+
+  IV_EVENT_INIT(&self->pending_writers_posted);
+  self->pending_writers_posted.cookie = self;
+  self->pending_writers_posted.handler = affile_dd_init_pending_writers;
   return self;
 }
 
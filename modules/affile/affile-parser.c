@@ -36,8 +36,10 @@ static CfgLexerKeyword affile_keywords[] =
   { "pipe",               KW_PIPE },
 
   { "fsync",              KW_FSYNC },
+  { "io_uring",           KW_IO_URING },
   { "remove_if_older",    KW_OVERWRITE_IF_OLDER, KWS_OBSOLETE, "overwrite_if_older" },
   { "overwrite_if_older", KW_OVERWRITE_IF_OLDER },
+  { "max_open_files",     KW_MAX_OPEN_FILES },
   { "follow_freq",        KW_FOLLOW_FREQ },
   { "multi_line_mode",    KW_MULTI_LINE_MODE  },
   { "multi_line_prefix",  KW_MULTI_LINE_PREFIX },
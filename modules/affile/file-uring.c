@@ -0,0 +1,269 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "file-uring.h"
+
+#if SYSLOG_NG_ENABLE_IO_URING
+
+#include "messages.h"
+#include "mainloop-worker.h"
+
+#include <liburing.h>
+#include <string.h>
+#include <errno.h>
+
+#define FILE_URING_ENTRIES 256
+
+/* the completion of the linked fdatasync is tagged in the lowest bit of the user data */
+#define FILE_URING_DATASYNC_TAG 0x1
+
+/*
+ * Locking:
+ *
+ * The ring is protected by ring_lock.  Only a single thread blocks in the
+ * kernel waiting for completions at a time (ring_waiting is set), others
+ * wait on the ring_completed condition.  While a thread is blocked, it is
+ * the only one reaping the completion queue, otherwise it could miss the
+ * completion it is waiting for.
+ */
+static struct io_uring ring;
+static gboolean ring_available;
+static GStaticMutex ring_lock = G_STATIC_MUTEX_INIT;
+static GCond *ring_completed;
+static gboolean ring_waiting;
+static WorkerBatchCallback submit_callbacks[MAIN_LOOP_MAX_WORKER_THREADS];
+
+/* NOTE: ring_lock should be acquired before calling this function. */
+static void
+_reap_completions(void)
+{
+  struct io_uring_cqe *cqe;
+  gboolean reaped = FALSE;
+
+  if (ring_waiting)
+    return;
+
+  while (io_uring_peek_cqe(&ring, &cqe) == 0)
+    {
+      guintptr user_data = (guintptr) io_uring_cqe_get_data(cqe);
+      FileURingWrite *write = (FileURingWrite *) (user_data & ~FILE_URING_DATASYNC_TAG);
+
+      if (user_data & FILE_URING_DATASYNC_TAG)
+        write->datasync_result = cqe->res;
+      else
+        write->write_result = cqe->res;
+      write->pending--;
+
+      io_uring_cqe_seen(&ring, cqe);
+      reaped = TRUE;
+    }
+  if (reaped)
+    g_cond_broadcast(ring_completed);
+}
+
+/* NOTE: ring_lock should be acquired before calling this function. */
+static void
+_submit_entries(void)
+{
+  gint rc;
+
+  if (io_uring_sq_ready(&ring) == 0)
+    return;
+
+  rc = io_uring_submit(&ring);
+
+  /* EBUSY/EAGAIN: the completion queue is full, retried after reaping */
+  if (rc < 0 && rc != -EBUSY && rc != -EAGAIN && rc != -EINTR)
+    msg_error("Error submitting file writes to io_uring",
+              evt_tag_errno(EVT_TAG_OSERROR, -rc));
+}
+
+static void
+_submit_batch(gpointer user_data)
+{
+  g_static_mutex_lock(&ring_lock);
+  _reap_completions();
+  _submit_entries();
+  g_static_mutex_unlock(&ring_lock);
+}
+
+/*
+ * Entries are submitted once the current worker job finishes, so that the
+ * writes of all files flushed in the same batch are submitted with a
+ * single system call.  Threads other than I/O workers submit immediately.
+ *
+ * NOTE: ring_lock should be acquired before calling this function.
+ */
+static void
+_schedule_submit(void)
+{
+  gint thread_id = main_loop_worker_get_thread_id();
+
+  if (thread_id < 0 || thread_id >= MAIN_LOOP_MAX_WORKER_THREADS)
+    {
+      _submit_entries();
+      return;
+    }
+
+  if (iv_list_empty(&submit_callbacks[thread_id].list))
+    main_loop_worker_register_batch_callback(&submit_callbacks[thread_id]);
+}
+
+static gpointer
+_init_ring(gpointer dummy)
+{
+  struct io_uring_params params;
+  gint rc, i;
+
+  memset(&params, 0, sizeof(params));
+  rc = io_uring_queue_init_params(FILE_URING_ENTRIES, &ring, &params);
+  if (rc < 0)
+    {
+      msg_info("io_uring is not available, writing files synchronously",
+               evt_tag_errno(EVT_TAG_OSERROR, -rc));
+      return NULL;
+    }
+
+  /* writes are submitted with offset -1, appending at the current position */
+  if ((params.features & IORING_FEAT_RW_CUR_POS) == 0)
+    {
+      msg_info("io_uring cannot write at the current file position, writing files synchronously");
+      io_uring_queue_exit(&ring);
+      return NULL;
+    }
+
+  for (i = 0; i < MAIN_LOOP_MAX_WORKER_THREADS; i++)
+    {
+      worker_batch_callback_init(&submit_callbacks[i]);
+      submit_callbacks[i].func = _submit_batch;
+    }
+  ring_completed = g_cond_new();
+  ring_available = TRUE;
+  return NULL;
+}
+
+gboolean
+file_uring_is_available(void)
+{
+  static GOnce ring_init = G_ONCE_INIT;
+
+  g_once(&ring_init, _init_ring, NULL);
+  return ring_available;
+}
+
+void
+file_uring_submit(FileURingWrite *write)
+{
+  struct io_uring_sqe *sqe;
+  gint num_entries = write->datasync ? 2 : 1;
+
+  write->pending = num_entries;
+  write->write_result = 0;
+  write->datasync_result = 0;
+
+  g_static_mutex_lock(&ring_lock);
+
+  /* the linked entries must not be split between two submissions */
+  while (io_uring_sq_space_left(&ring) < num_entries)
+    {
+      if (ring_waiting)
+        {
+          /* the completion queue is reaped by the thread blocked in the kernel */
+          g_cond_wait(ring_completed, g_static_mutex_get_mutex(&ring_lock));
+          continue;
+        }
+      _reap_completions();
+      _submit_entries();
+    }
+
+  sqe = io_uring_get_sqe(&ring);
+  io_uring_prep_writev(sqe, write->fd, write->iov, write->iov_count, -1);
+  io_uring_sqe_set_data(sqe, write);
+  if (write->datasync)
+    {
+      io_uring_sqe_set_flags(sqe, IOSQE_IO_LINK);
+
+      sqe = io_uring_get_sqe(&ring);
+      io_uring_prep_fsync(sqe, write->fd, IORING_FSYNC_DATASYNC);
+      io_uring_sqe_set_data(sqe, (gpointer) ((guintptr) write | FILE_URING_DATASYNC_TAG));
+    }
+  _schedule_submit();
+
+  g_static_mutex_unlock(&ring_lock);
+}
+
+void
+file_uring_wait(FileURingWrite *write)
+{
+  struct io_uring_cqe *cqe;
+
+  g_static_mutex_lock(&ring_lock);
+  while (TRUE)
+    {
+      _reap_completions();
+      if (write->pending == 0)
+        break;
+
+      /* our write may still be waiting for the end of the batch */
+      _submit_entries();
+
+      if (ring_waiting)
+        {
+          /* someone else is blocked in the kernel, it reaps our completion too */
+          g_cond_wait(ring_completed, g_static_mutex_get_mutex(&ring_lock));
+          continue;
+        }
+
+      ring_waiting = TRUE;
+      g_static_mutex_unlock(&ring_lock);
+
+      io_uring_wait_cqe(&ring, &cqe);
+
+      g_static_mutex_lock(&ring_lock);
+      ring_waiting = FALSE;
+      /* let the others take over waiting if their writes are still in progress */
+      g_cond_broadcast(ring_completed);
+    }
+  g_static_mutex_unlock(&ring_lock);
+}
+
+#else
+
+gboolean
+file_uring_is_available(void)
+{
+  return FALSE;
+}
+
+void
+file_uring_submit(FileURingWrite *write)
+{
+  g_assert_not_reached();
+}
+
+void
+file_uring_wait(FileURingWrite *write)
+{
+  g_assert_not_reached();
+}
+
+#endif
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef FILE_URING_H_INCLUDED
+#define FILE_URING_H_INCLUDED
+
+#include "syslog-ng.h"
+
+#include <sys/uio.h>
+
+/*
+ * Asynchronous file writes using a single io_uring instance shared by all
+ * file writers.  Submission queue entries are collected from every writer
+ * and are submitted at once when the current worker job finishes (or when
+ * someone has to wait for a completion), thus a busy worker thread issues a
+ * single system call for the writes of many files.
+ *
+ * A write is a writev() optionally followed by a linked fdatasync(), the
+ * iovec array and the buffers it points to must remain valid until the
+ * write completes.
+ */
+typedef struct _FileURingWrite
+{
+  gint fd;
+  struct iovec *iov;
+  gint iov_count;
+  gboolean datasync;
+
+  /* results, valid once file_uring_wait() returns */
+  gssize write_result;
+  gint datasync_result;
+
+  /* number of completions still expected */
+  gint pending;
+} FileURingWrite;
+
+gboolean file_uring_is_available(void);
+
+void file_uring_submit(FileURingWrite *write);
+void file_uring_wait(FileURingWrite *write);
+
+#endif
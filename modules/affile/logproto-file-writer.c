@@ -21,7 +21,9 @@
  *
  */
 
+
 #include "logproto-file-writer.h"
+#include "file-uring.h"
 #include "messages.h"
 
 #include <string.h>
@@ -39,9 +41,150 @@ typedef struct _LogProtoFileWriter
   gint fd;
   gint sum_len;
   gboolean fsync;
+  /* the batch being written by io_uring, its messages are acked once it is completed */
+  gboolean use_uring;
+  FileURingWrite inflight;
+  struct iovec *inflight_buffer;
   struct iovec buffer[0];
 } LogProtoFileWriter;
 
+/*
+ * log_proto_file_writer_save_partial:
+ *
+ * copies the data that was not written out by a short write into the
+ * partial buffer, @written is the number of bytes written from @iov
+ */
+static void
+log_proto_file_writer_save_partial(LogProtoFileWriter *self, const struct iovec *iov, gint iov_count, gint written)
+{
+  gint i, i0, sum, ofs, pos;
+
+  /* look for the first chunk that has been cut */
+  sum = iov[0].iov_len; /* sum is the cumulated length of the already processed items */
+  i = 0;
+  while (written > sum)
+    sum += iov[++i].iov_len;
+  self->partial_len = sum - written; /* this is the length of the first non-written chunk */
+  i0 = i;
+  ++i;
+  /* add the lengths of the following messages */
+  while (i < iov_count)
+    self->partial_len += iov[i++].iov_len;
+  /* allocate and copy the remaning data */
+  self->partial = (guchar *)g_malloc(self->partial_len);
+  ofs = sum - written; /* the length of the remaning (not processed) chunk in the first message */
+  pos = iov[i0].iov_len - ofs;
+  memcpy(self->partial, iov[i0].iov_base + pos, ofs);
+  i = i0 + 1;
+  while (i < iov_count)
+    {
+      memcpy(self->partial + ofs, iov[i].iov_base, iov[i].iov_len);
+      ofs += iov[i].iov_len;
+      ++i;
+    }
+  self->partial_pos = 0;
+}
+
+static void
+log_proto_file_writer_drop_buffer(LogProtoFileWriter *self)
+{
+  gint i;
+
+  for (i = 0; i < self->buf_count; ++i)
+    g_free(self->buffer[i].iov_base);
+  self->buf_count = 0;
+  self->sum_len = 0;
+}
+
+/*
+ * log_proto_file_writer_submit:
+ *
+ * hands the buffered messages over to io_uring, they are acked in
+ * log_proto_file_writer_complete_inflight() once written (and synced)
+ */
+static void
+log_proto_file_writer_submit(LogProtoFileWriter *self)
+{
+  memcpy(self->inflight_buffer, self->buffer, self->buf_count * sizeof(struct iovec));
+  self->inflight.fd = self->fd;
+  self->inflight.iov = self->inflight_buffer;
+  self->inflight.iov_count = self->buf_count;
+  self->inflight.datasync = self->fsync;
+  file_uring_submit(&self->inflight);
+
+  self->buf_count = 0;
+  self->sum_len = 0;
+}
+
+/*
+ * log_proto_file_writer_complete_inflight:
+ *
+ * waits for the batch submitted to io_uring by the previous flush.  If it
+ * failed, the messages not yet acked are rewound so that they are written
+ * again once the file is reopened.
+ */
+static LogProtoStatus
+log_proto_file_writer_complete_inflight(LogProtoFileWriter *self)
+{
+  FileURingWrite *inflight = &self->inflight;
+  gint num_msgs = inflight->iov_count;
+  gint error = 0;
+  gint i, sum_len = 0;
+
+  file_uring_wait(inflight);
+
+  for (i = 0; i < num_msgs; i++)
+    sum_len += inflight->iov[i].iov_len;
+
+  if (inflight->write_result < 0)
+    error = -inflight->write_result;
+  else if (inflight->datasync_result < 0 && inflight->write_result == sum_len)
+    error = -inflight->datasync_result;
+  else if (inflight->write_result != sum_len)
+    log_proto_file_writer_save_partial(self, inflight->iov, num_msgs, inflight->write_result);
+
+  for (i = 0; i < num_msgs; i++)
+    g_free(inflight->iov[i].iov_base);
+  inflight->iov_count = 0;
+
+  if (error)
+    {
+      msg_error("I/O error occurred while writing",
+                evt_tag_int("fd", self->super.transport->fd),
+                evt_tag_errno(EVT_TAG_OSERROR, error));
+      log_proto_file_writer_drop_buffer(self);
+      log_proto_client_msg_rewind(&self->super);
+      return LPS_ERROR;
+    }
+
+  log_proto_client_msg_ack(&self->super, num_msgs);
+  return LPS_SUCCESS;
+}
+
+/*
+ * log_proto_file_writer_drain:
+ *
+ * completes the batch being written by io_uring and rewinds the messages
+ * buffered but not yet submitted.  Called before the writer detaches from
+ * its queue, so that log_proto_file_writer_free() has nothing to ack.
+ */
+static LogProtoStatus
+log_proto_file_writer_drain(LogProtoClient *s)
+{
+  LogProtoFileWriter *self = (LogProtoFileWriter *)s;
+  LogProtoStatus status = LPS_SUCCESS;
+
+  if (self->inflight.iov_count > 0)
+    status = log_proto_file_writer_complete_inflight(self);
+
+  if (self->buf_count > 0)
+    {
+      log_proto_file_writer_drop_buffer(self);
+      log_proto_client_msg_rewind(&self->super);
+    }
+  return status;
+}
+
 /*
  * log_proto_file_writer_flush:
  *
@@ -54,7 +197,15 @@ static LogProtoStatus
 log_proto_file_writer_flush(LogProtoClient *s)
 {
   LogProtoFileWriter *self = (LogProtoFileWriter *)s;
-  gint rc, i, i0, sum, ofs, pos;
+  gint rc;
+
+  if (self->inflight.iov_count > 0)
+    {
+      LogProtoStatus status = log_proto_file_writer_complete_inflight(self);
+
+      if (status != LPS_SUCCESS)
+        return status;
+    }
 
   if (self->partial)
     {
@@ -84,6 +235,12 @@ log_proto_file_writer_flush(LogProtoClient *s)
   if (self->buf_count == 0)
     return LPS_SUCCESS;
 
+  if (self->use_uring)
+    {
+      log_proto_file_writer_submit(self);
+      return LPS_SUCCESS;
+    }
+
   rc = writev(self->fd, self->buffer, self->buf_count);
   if (rc > 0 && self->fsync)
     fsync(self->fd);
@@ -95,37 +252,11 @@ log_proto_file_writer_flush(LogProtoClient *s)
   else if (rc != self->sum_len)
     {
       /* partial success: not everything has been written out */
-      /* look for the first chunk that has been cut */
-      sum = self->buffer[0].iov_len; /* sum is the cumulated length of the already processed items */
-      i = 0;
-      while (rc > sum)
-        sum += self->buffer[++i].iov_len;
-      self->partial_len = sum - rc; /* this is the length of the first non-written chunk */
-      i0 = i;
-      ++i;
-      /* add the lengths of the following messages */
-      while (i < self->buf_count)
-        self->partial_len += self->buffer[i++].iov_len;
-      /* allocate and copy the remaning data */
-      self->partial = (guchar *)g_malloc(self->partial_len);
-      ofs = sum - rc; /* the length of the remaning (not processed) chunk in the first message */
-      pos = self->buffer[i0].iov_len - ofs;
-      memcpy(self->partial, self->buffer[i0].iov_base + pos, ofs);
-      i = i0 + 1;
-      while (i < self->buf_count)
-        {
-          memcpy(self->partial + ofs, self->buffer[i].iov_base, self->buffer[i].iov_len);
-          ofs += self->buffer[i].iov_len;
-          ++i;
-        }
-      self->partial_pos = 0;
+      log_proto_file_writer_save_partial(self, self->buffer, self->buf_count, rc);
     }
 
   /* free the previous message strings (the remaning part has been copied to the partial buffer) */
-  for (i = 0; i < self->buf_count; ++i)
-    g_free(self->buffer[i].iov_base);
-  self->buf_count = 0;
-  self->sum_len = 0;
+  log_proto_file_writer_drop_buffer(self);
 
   return LPS_SUCCESS;
 
@@ -160,6 +291,16 @@ log_proto_file_writer_post(LogProtoClient *s, guchar *msg, gsize msg_len, gboole
   LogProtoStatus result;
 
   *consumed = FALSE;
+  if (self->use_uring && self->inflight.iov_count > 0 && self->buf_count + 1 >= self->buf_size)
+    {
+      /* this message is going to be submitted right away, complete the
+       * previous batch first: if that fails, the buffer is dropped and
+       * this message must not be part of it yet */
+      result = log_proto_file_writer_complete_inflight(self);
+      if (result != LPS_SUCCESS)
+        return result;
+    }
+
   if (self->buf_count >= self->buf_size || self->partial)
     {
       result = log_proto_file_writer_flush(s);
@@ -188,7 +329,9 @@ log_proto_file_writer_post(LogProtoClient *s, guchar *msg, gsize msg_len, gboole
     }
 
   *consumed = TRUE;
-  log_proto_client_msg_ack(&self->super, 1);
+  /* with io_uring, messages are acked when their batch completes */
+  if (!self->use_uring)
+    log_proto_client_msg_ack(&self->super, 1);
   return LPS_SUCCESS;
 }
 
@@ -203,11 +346,36 @@ log_proto_file_writer_prepare(LogProtoClient *s, gint *fd, GIOCondition *cond)
   /* if there's no pending I/O in the transport layer, then we want to do a write */
   if (*cond == 0)
     *cond = G_IO_OUT;
-  return self->buf_count > 0 || self->partial;
+  return self->buf_count > 0 || self->partial || self->inflight.iov_count > 0;
+}
+
+static void
+log_proto_file_writer_free(LogProtoClient *s)
+{
+  LogProtoFileWriter *self = (LogProtoFileWriter *) s;
+
+  if (self->use_uring)
+    {
+      gint i;
+
+      /* the messages were acked by log_proto_file_writer_drain() if they
+       * could be, the kernel only has to be done with the buffers here */
+      if (self->inflight.iov_count > 0)
+        {
+          file_uring_wait(&self->inflight);
+          for (i = 0; i < self->inflight.iov_count; i++)
+            g_free(self->inflight.iov[i].iov_base);
+        }
+      log_proto_file_writer_drop_buffer(self);
+      g_free(self->inflight_buffer);
+    }
+  g_free(self->partial);
+  log_proto_client_free_method(s);
 }
 
 LogProtoClient *
-log_proto_file_writer_new(LogTransport *transport, const LogProtoClientOptions *options, gint flush_lines, gint fsync_)
+log_proto_file_writer_new(LogTransport *transport, const LogProtoClientOptions *options, gint flush_lines, gint fsync_,
+                          gboolean use_io_uring)
 {
   if (flush_lines == 0)
     /* the flush-lines option has not been specified, use a default value */
@@ -226,8 +394,15 @@ log_proto_file_writer_new(LogTransport *transport, const LogProtoClientOptions *
   self->fd = transport->fd;
   self->buf_size = flush_lines;
   self->fsync = fsync_;
+  if (use_io_uring && file_uring_is_available())
+    {
+      self->use_uring = TRUE;
+      self->inflight_buffer = g_new(struct iovec, flush_lines);
+      self->super.drain = log_proto_file_writer_drain;
+    }
   self->super.prepare = log_proto_file_writer_prepare;
   self->super.post = log_proto_file_writer_post;
   self->super.flush = log_proto_file_writer_flush;
+  self->super.free_fn = log_proto_file_writer_free;
   return &self->super;
 }
@@ -26,6 +26,7 @@
 
 #include "logproto/logproto-client.h"
 
-LogProtoClient *log_proto_file_writer_new(LogTransport *transport, const LogProtoClientOptions *options, gint flush_lines, gboolean fsync);
+LogProtoClient *log_proto_file_writer_new(LogTransport *transport, const LogProtoClientOptions *options, gint flush_lines, gboolean fsync,
+                                          gboolean use_io_uring);
 
 #endif
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "testutils.h"
+#include "apphook.h"
+#include "affile/logproto-file-writer.h"
+#include "transport/transport-file.h"
+#include "lib/messages.h"
+#include "compat/lfs.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#define BENCHMARK_FILES 16
+#define BENCHMARK_FLUSH_LINES 100
+
+#define TEST_MESSAGE "Oct 17 12:00:00 bzorp prog[1234]: benchmark message written to a file destination, 0123456789\n"
+
+static gboolean success = TRUE;
+static gint acked_messages;
+
+static void
+_ack_callback(gint num_msg_acked, gpointer user_data)
+{
+  acked_messages += num_msg_acked;
+}
+
+static void
+_post_message(LogProtoClient *proto)
+{
+  gboolean consumed;
+  guchar *msg = (guchar *) g_strdup(TEST_MESSAGE);
+
+  if (log_proto_client_post(proto, msg, strlen(TEST_MESSAGE), &consumed) != LPS_SUCCESS || !consumed)
+    {
+      fprintf(stderr, "Error posting message\n");
+      success = FALSE;
+      if (!consumed)
+        g_free(msg);
+    }
+}
+
+static void
+_test_throughput(gint num_messages, gboolean use_fsync, gboolean use_io_uring)
+{
+  LogProtoClientOptionsStorage options;
+  LogProtoClientFlowControlFuncs flow_control_funcs = { _ack_callback, NULL, NULL };
+  LogProtoClient *protos[BENCHMARK_FILES];
+  gchar *filenames[BENCHMARK_FILES];
+  struct stat st;
+  gint i;
+
+  memset(&options, 0, sizeof(options));
+  for (i = 0; i < BENCHMARK_FILES; i++)
+    {
+      gint fd = g_file_open_tmp("file-writer-XXXXXX", &filenames[i], NULL);
+
+      close(fd);
+      fd = open(filenames[i], O_WRONLY | O_APPEND | O_NOCTTY | O_NONBLOCK | O_LARGEFILE);
+      protos[i] = log_proto_file_writer_new(log_transport_file_new(fd), &options.super,
+                                            BENCHMARK_FLUSH_LINES, use_fsync, use_io_uring);
+      log_proto_client_set_client_flow_control(protos[i], &flow_control_funcs);
+    }
+
+  acked_messages = 0;
+  start_stopwatch();
+  for (i = 0; i < num_messages; i++)
+    _post_message(protos[i % BENCHMARK_FILES]);
+  for (i = 0; i < BENCHMARK_FILES; i++)
+    {
+      /* the same as a forced flush of LogWriter: the batch submitted by the flush is completed by the drain */
+      log_proto_client_flush(protos[i]);
+      log_proto_client_drain(protos[i]);
+    }
+  stop_stopwatch_and_display_result(num_messages, "writing %d messages to %d files, fsync=%d, io_uring=%d took",
+                                    num_messages, BENCHMARK_FILES, use_fsync, use_io_uring);
+
+  if (acked_messages != num_messages)
+    {
+      fprintf(stderr, "Number of acked messages mismatch, acked=%d, expected=%d\n", acked_messages, num_messages);
+      success = FALSE;
+    }
+
+  for (i = 0; i < BENCHMARK_FILES; i++)
+    {
+      log_proto_client_free(protos[i]);
+
+      if (stat(filenames[i], &st) < 0 ||
+          st.st_size != (num_messages / BENCHMARK_FILES) * strlen(TEST_MESSAGE))
+        {
+          fprintf(stderr, "File size mismatch, filename=%s\n", filenames[i]);
+          success = FALSE;
+        }
+      g_unlink(filenames[i]);
+      g_free(filenames[i]);
+    }
+
+  /* LogWriter detaches the queue before freeing the proto, it must not ack anything */
+  if (acked_messages != num_messages)
+    {
+      fprintf(stderr, "Messages acked while freeing the writer, acked=%d, expected=%d\n", acked_messages, num_messages);
+      success = FALSE;
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+  app_startup();
+  msg_init(FALSE);
+
+  _test_throughput(1000000, FALSE, FALSE);
+  _test_throughput(1000000, FALSE, TRUE);
+  _test_throughput(50000, TRUE, FALSE);
+  _test_throughput(50000, TRUE, TRUE);
+
+  app_shutdown();
+  return !success;
+}
@@ -488,7 +488,7 @@ __worker_message_retry_over(LogThrDestDriver *self, LogMessage *msg)
   msg_error("Multiple failures while sending message in email to the server, "
             "message dropped",
             evt_tag_str("driver", self->super.super.id),
-            evt_tag_int("attempts", self->retries.counter),
+            evt_tag_int("attempts", log_threaded_dest_driver_get_current_worker(self)->retries_counter),
             evt_tag_int("max-attempts", self->retries.max));
 }
 
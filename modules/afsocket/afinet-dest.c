@@ -97,6 +97,10 @@ afinet_dd_verify_callback(gint ok, X509_STORE_CTX *ctx, gpointer user_data)
   AFInetDestDriver *self G_GNUC_UNUSED = (AFInetDestDriver *) user_data;
   TransportMapperInet *transport_mapper_inet = (TransportMapperInet *) self->super.transport_mapper;
 
+  /* NOTE: this is not called when reconnecting with a resumed session,
+   * those are only offered to the same destination and were verified
+   * during the full handshake they were established with, see
+   * tls_context_offer_client_session() */
   if (ok && ctx->current_cert == ctx->cert && self->hostname
       && (transport_mapper_inet->tls_context->verify_mode & TVM_TRUSTED))
     {
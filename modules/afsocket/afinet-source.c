@@ -96,6 +96,16 @@ gboolean
 afinet_sd_init(LogPipe *s)
 {
   AFInetSourceDriver *self = (AFInetSourceDriver *) s;
+  SocketOptionsInet *socket_options = (SocketOptionsInet *) self->super.socket_options;
+
+  /* without SO_REUSEPORT only the first listener could bind() the address */
+  if (self->super.num_listeners > 1 && !socket_options->so_reuseport)
+    {
+      msg_error("listeners() requires so-reuseport(yes)",
+                evt_tag_str("id", self->super.super.super.id),
+                evt_tag_int("listeners", self->super.num_listeners));
+      return FALSE;
+    }
 
   if (!afsocket_sd_init_method(&self->super.super.super.super))
     return FALSE;
@@ -53,6 +53,10 @@ static CfgLexerKeyword afsocket_keywords[] =
   { "trusted_dn",         KW_TRUSTED_DN },
   { "cipher_suite",       KW_CIPHER_SUITE },
   { "ssl_options",        KW_SSL_OPTIONS },
+  { "session_cache_size", KW_SESSION_CACHE_SIZE },
+  { "session_timeout",    KW_SESSION_TIMEOUT },
+  { "session_tickets",    KW_SESSION_TICKETS },
+  { "session_ticket_key_file", KW_SESSION_TICKET_KEY_FILE },
 
   { "localip",            KW_LOCALIP },
   { "ip",                 KW_IP },
@@ -65,6 +69,7 @@ static CfgLexerKeyword afsocket_keywords[] =
   { "so_rcvbuf",          KW_SO_RCVBUF },
   { "so_sndbuf",          KW_SO_SNDBUF },
   { "so_keepalive",       KW_SO_KEEPALIVE },
+  { "so_reuseport",       KW_SO_REUSEPORT },
   { "tcp_keep_alive",     KW_SO_KEEPALIVE }, /* old, once deprecated form, but revived in 3.4 */
   { "tcp_keepalive",      KW_SO_KEEPALIVE }, /* alias for so-keepalive, as tcp is the only option actually using it */
   { "tcp_keepalive_time", KW_TCP_KEEPALIVE_TIME },
@@ -74,6 +79,7 @@ static CfgLexerKeyword afsocket_keywords[] =
   { "transport",          KW_TRANSPORT },
   { "ip_protocol",        KW_IP_PROTOCOL },
   { "max_connections",    KW_MAX_CONNECTIONS },
+  { "listeners",          KW_LISTENERS },
   { "keep_alive",         KW_KEEP_ALIVE },
   { "systemd_syslog",     KW_SYSTEMD_SYSLOG  },
   { NULL }
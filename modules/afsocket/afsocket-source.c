@@ -46,6 +46,8 @@ typedef struct _AFSocketSourceConnection
   LogReader *reader;
   int sock;
   GSockAddr *peer_addr;
+  /* index of the listening socket for dgram connections */
+  gint listener_index;
 } AFSocketSourceConnection;
 
 static void afsocket_sd_close_connection(AFSocketSourceDriver *self, AFSocketSourceConnection *sc);
@@ -62,6 +64,12 @@ afsocket_sc_stats_instance(AFSocketSourceConnection *self)
       if (self->owner->bind_addr)
         {
           g_sockaddr_format(self->owner->bind_addr, buf, sizeof(buf), GSA_ADDRESS_ONLY);
+          if (self->owner->num_listeners > 1)
+            {
+              gsize len = strlen(buf);
+
+              g_snprintf(buf + len, sizeof(buf) - len, "#%d", self->listener_index);
+            }
           return buf;
         }
       else
@@ -253,6 +261,14 @@ afsocket_sd_set_max_connections(LogDriver *s, gint max_connections)
   self->max_connections = max_connections;
 }
 
+void
+afsocket_sd_set_listeners(LogDriver *s, gint listeners)
+{
+  AFSocketSourceDriver *self = (AFSocketSourceDriver *) s;
+
+  self->num_listeners = MAX(listeners, 1);
+}
+
 static const gchar *
 afsocket_sd_format_name(const LogPipe *s)
 {
@@ -277,12 +293,18 @@ afsocket_sd_format_name(const LogPipe *s)
 }
 
 static const gchar *
-afsocket_sd_format_listener_name(const AFSocketSourceDriver *self)
+afsocket_sd_format_listener_name(const AFSocketSourceDriver *self, gint listener_index)
 {
   static gchar persist_name[1024];
 
-  g_snprintf(persist_name, sizeof(persist_name), "%s.listen_fd",
-             afsocket_sd_format_name((const LogPipe *)self));
+  /* the first listener keeps its original name, so that it is preserved
+   * when listeners() is changed across reloads */
+  if (listener_index == 0)
+    g_snprintf(persist_name, sizeof(persist_name), "%s.listen_fd",
+               afsocket_sd_format_name((const LogPipe *)self));
+  else
+    g_snprintf(persist_name, sizeof(persist_name), "%s.listen_fd.%d",
+               afsocket_sd_format_name((const LogPipe *)self), listener_index);
 
   return persist_name;
 }
@@ -299,7 +321,8 @@ afsocket_sd_format_connections_name(const AFSocketSourceDriver *self)
 }
 
 static gboolean
-afsocket_sd_process_connection(AFSocketSourceDriver *self, GSockAddr *client_addr, GSockAddr *local_addr, gint fd)
+afsocket_sd_process_connection(AFSocketSourceDriver *self, GSockAddr *client_addr, GSockAddr *local_addr, gint fd,
+                               gint listener_index)
 {
   gchar buf[MAX_SOCKADDR_STRING], buf2[MAX_SOCKADDR_STRING];
 #if SYSLOG_NG_ENABLE_TCP_WRAPPER
@@ -338,6 +361,7 @@ afsocket_sd_process_connection(AFSocketSourceDriver *self, GSockAddr *client_add
       AFSocketSourceConnection *conn;
 
       conn = afsocket_sc_new(client_addr, fd, self->super.super.super.cfg);
+      conn->listener_index = listener_index;
       afsocket_sc_set_owner(conn, self);
       if (log_pipe_init(&conn->super))
         {
@@ -359,7 +383,9 @@ afsocket_sd_process_connection(AFSocketSourceDriver *self, GSockAddr *client_add
 static void
 afsocket_sd_accept(gpointer s)
 {
-  AFSocketSourceDriver *self = (AFSocketSourceDriver *) s;
+  AFSocketSourceListener *listener = (AFSocketSourceListener *) s;
+  AFSocketSourceDriver *self = listener->owner;
+  gint listener_index = listener - self->listeners;
   GSockAddr *peer_addr;
   gchar buf1[256], buf2[256];
   gint new_fd;
@@ -370,7 +396,7 @@ afsocket_sd_accept(gpointer s)
     {
       GIOStatus status;
 
-      status = g_accept(self->fd, &new_fd, &peer_addr);
+      status = g_accept(listener->listen_fd.fd, &new_fd, &peer_addr);
       if (status == G_IO_STATUS_AGAIN)
         {
           /* no more connections to accept */
@@ -386,7 +412,7 @@ afsocket_sd_accept(gpointer s)
       g_fd_set_nonblock(new_fd, TRUE);
       g_fd_set_cloexec(new_fd, TRUE);
 
-      res = afsocket_sd_process_connection(self, peer_addr, self->bind_addr, new_fd);
+      res = afsocket_sd_process_connection(self, peer_addr, self->bind_addr, new_fd, listener_index);
 
       if (res)
         {
@@ -434,20 +460,25 @@ afsocket_sd_close_connection(AFSocketSourceDriver *self, AFSocketSourceConnectio
 }
 
 static void
-afsocket_sd_start_watches(AFSocketSourceDriver *self)
+afsocket_sd_start_watches(AFSocketSourceDriver *self, gint listener_index, gint fd)
 {
-  IV_FD_INIT(&self->listen_fd);
-  self->listen_fd.fd = self->fd;
-  self->listen_fd.cookie = self;
-  self->listen_fd.handler_in = afsocket_sd_accept;
-  iv_fd_register(&self->listen_fd);
+  AFSocketSourceListener *listener = &self->listeners[listener_index];
+
+  IV_FD_INIT(&listener->listen_fd);
+  listener->listen_fd.fd = fd;
+  listener->listen_fd.cookie = listener;
+  listener->listen_fd.handler_in = afsocket_sd_accept;
+  listener->owner = self;
+  iv_fd_register(&listener->listen_fd);
 }
 
 static void
-afsocket_sd_stop_watches(AFSocketSourceDriver *self)
+afsocket_sd_stop_watches(AFSocketSourceDriver *self, gint listener_index)
 {
-  if (iv_fd_registered (&self->listen_fd))
-    iv_fd_unregister(&self->listen_fd);
+  AFSocketSourceListener *listener = &self->listeners[listener_index];
+
+  if (iv_fd_registered (&listener->listen_fd))
+    iv_fd_unregister(&listener->listen_fd);
 }
 
 static gboolean
@@ -530,66 +561,161 @@ afsocket_sd_restore_kept_alive_connections(AFSocketSourceDriver *self)
 }
 
 static gboolean
-afsocket_sd_open_listener(AFSocketSourceDriver *self)
+afsocket_sd_open_socket(AFSocketSourceDriver *self, gint listener_index, gint *sock)
+{
+  *sock = -1;
+
+  /* a socket passed to us by the runtime environment can only serve a single listener */
+  if (listener_index == 0 && !afsocket_sd_acquire_socket(self, sock))
+    return FALSE;
+
+  if (*sock != -1 && self->num_listeners > 1)
+    {
+      msg_error("listeners() can't be used with a socket passed on by the runtime environment, e.g. systemd socket activation",
+                evt_tag_str("id", self->super.super.id),
+                evt_tag_int("listeners", self->num_listeners));
+      close(*sock);
+      *sock = -1;
+      return FALSE;
+    }
+
+  if (*sock == -1
+      && !transport_mapper_open_socket(self->transport_mapper, self->socket_options, self->bind_addr, AFSOCKET_DIR_RECV,
+                                       sock))
+    return FALSE;
+  return TRUE;
+}
+
+static void
+afsocket_sd_close_listeners(AFSocketSourceDriver *self)
+{
+  gint i;
+
+  for (i = 0; i < self->num_listeners; i++)
+    {
+      if (iv_fd_registered(&self->listeners[i].listen_fd))
+        {
+          afsocket_sd_stop_watches(self, i);
+          close(self->listeners[i].listen_fd.fd);
+        }
+    }
+  g_free(self->listeners);
+  self->listeners = NULL;
+}
+
+static gboolean
+afsocket_sd_open_stream_listener(AFSocketSourceDriver *self, gint listener_index)
 {
   GlobalConfig *cfg = log_pipe_get_config(&self->super.super.super);
   gint sock;
-  gboolean res = FALSE;
 
-  /* ok, we have connection list, check if we need to open a listener */
   sock = -1;
-  if (self->transport_mapper->sock_type == SOCK_STREAM)
+  if (self->connections_kept_alive_accross_reloads)
     {
-      if (self->connections_kept_alive_accross_reloads)
-        {
-          /* NOTE: this assumes that fd 0 will never be used for listening fds,
-           * main.c opens fd 0 so this assumption can hold */
-          sock = GPOINTER_TO_UINT(
-                   cfg_persist_config_fetch(cfg, afsocket_sd_format_listener_name(self))) -
-                 1;
-        }
+      /* NOTE: this assumes that fd 0 will never be used for listening fds,
+       * main.c opens fd 0 so this assumption can hold */
+      sock = GPOINTER_TO_UINT(
+               cfg_persist_config_fetch(cfg, afsocket_sd_format_listener_name(self, listener_index))) -
+             1;
+    }
 
-      if (sock == -1)
+  if (sock == -1)
+    {
+      if (!afsocket_sd_open_socket(self, listener_index, &sock))
+        return self->super.super.optional;
+    }
+
+  /* set up listening source */
+  if (listen(sock, self->listen_backlog) < 0)
+    {
+      msg_error("Error during listen()",
+                evt_tag_errno(EVT_TAG_OSERROR, errno));
+      close(sock);
+      return FALSE;
+    }
+
+  afsocket_sd_start_watches(self, listener_index, sock);
+  return TRUE;
+}
+
+static AFSocketSourceConnection *
+afsocket_sd_find_dgram_connection(AFSocketSourceDriver *self, gint listener_index)
+{
+  GList *l;
+
+  for (l = self->connections; l; l = l->next)
+    {
+      AFSocketSourceConnection *sc = (AFSocketSourceConnection *) l->data;
+
+      if (sc->listener_index == listener_index)
+        return sc;
+    }
+  return NULL;
+}
+
+static void
+afsocket_sd_drop_excess_dgram_connections(AFSocketSourceDriver *self)
+{
+  GList *l, *next;
+
+  /* listeners() was decreased since the connections were kept alive */
+  for (l = self->connections; l; l = next)
+    {
+      AFSocketSourceConnection *sc = (AFSocketSourceConnection *) l->data;
+
+      next = l->next;
+      if (sc->listener_index >= self->num_listeners)
         {
-          if (!afsocket_sd_acquire_socket(self, &sock))
-            return self->super.super.optional;
-          if (sock == -1
-              && !transport_mapper_open_socket(self->transport_mapper, self->socket_options, self->bind_addr, AFSOCKET_DIR_RECV,
-                                               &sock))
-            return self->super.super.optional;
+          self->connections = g_list_remove(self->connections, sc);
+          afsocket_sd_kill_connection(sc);
+          self->num_connections--;
         }
+    }
+}
+
+static gboolean
+afsocket_sd_open_dgram_listener(AFSocketSourceDriver *self, gint listener_index)
+{
+  gint sock;
+
+  /* reuse the connection kept alive across reloads, if any */
+  if (afsocket_sd_find_dgram_connection(self, listener_index))
+    return TRUE;
+
+  if (!afsocket_sd_open_socket(self, listener_index, &sock))
+    return self->super.super.optional;
+
+  return afsocket_sd_process_connection(self, NULL, self->bind_addr, sock, listener_index);
+}
 
-      /* set up listening source */
-      if (listen(sock, self->listen_backlog) < 0)
+static gboolean
+afsocket_sd_open_listener(AFSocketSourceDriver *self)
+{
+  gint i;
+
+  /* ok, we have connection list, check if we need to open listeners */
+  if (self->transport_mapper->sock_type == SOCK_STREAM)
+    {
+      self->listeners = g_new0(AFSocketSourceListener, self->num_listeners);
+      for (i = 0; i < self->num_listeners; i++)
         {
-          msg_error("Error during listen()",
-                    evt_tag_errno(EVT_TAG_OSERROR, errno));
-          close(sock);
-          return FALSE;
+          if (!afsocket_sd_open_stream_listener(self, i))
+            {
+              afsocket_sd_close_listeners(self);
+              return FALSE;
+            }
         }
-
-      self->fd = sock;
-      afsocket_sd_start_watches(self);
-      res = TRUE;
     }
   else
     {
-      if (!self->connections)
+      afsocket_sd_drop_excess_dgram_connections(self);
+      for (i = 0; i < self->num_listeners; i++)
         {
-          if (!afsocket_sd_acquire_socket(self, &sock))
-            return self->super.super.optional;
-          if (sock == -1
-              && !transport_mapper_open_socket(self->transport_mapper, self->socket_options, self->bind_addr, AFSOCKET_DIR_RECV,
-                                               &sock))
-            return self->super.super.optional;
+          if (!afsocket_sd_open_dgram_listener(self, i))
+            return FALSE;
         }
-      self->fd = -1;
-
-      /* we either have self->connections != NULL, or sock contains a new fd */
-      if (self->connections || afsocket_sd_process_connection(self, NULL, self->bind_addr, sock))
-        res = TRUE;
     }
-  return res;
+  return TRUE;
 }
 
 static void
@@ -629,25 +755,36 @@ static void
 afsocket_sd_save_listener(AFSocketSourceDriver *self)
 {
   GlobalConfig *cfg = log_pipe_get_config(&self->super.super.super);
+  gint i;
 
-  if (self->transport_mapper->sock_type == SOCK_STREAM)
+  if (!self->listeners)
+    return;
+
+  for (i = 0; i < self->num_listeners; i++)
     {
-      afsocket_sd_stop_watches(self);
+      gint fd = self->listeners[i].listen_fd.fd;
+
+      if (!iv_fd_registered(&self->listeners[i].listen_fd))
+        continue;
+
+      afsocket_sd_stop_watches(self, i);
       if (!self->connections_kept_alive_accross_reloads)
         {
           msg_verbose("Closing listener fd",
-                      evt_tag_int("fd", self->fd));
-          close(self->fd);
+                      evt_tag_int("fd", fd));
+          close(fd);
         }
       else
         {
           /* NOTE: the fd is incremented by one when added to persistent config
            * as persist config cannot store NULL */
 
-          cfg_persist_config_add(cfg, afsocket_sd_format_listener_name(self),
-                                 GUINT_TO_POINTER(self->fd + 1), afsocket_sd_close_fd, FALSE);
+          cfg_persist_config_add(cfg, afsocket_sd_format_listener_name(self, i),
+                                 GUINT_TO_POINTER(fd + 1), afsocket_sd_close_fd, FALSE);
         }
     }
+  g_free(self->listeners);
+  self->listeners = NULL;
 }
 
 
@@ -724,6 +861,7 @@ afsocket_sd_init_instance(AFSocketSourceDriver *self,
   self->socket_options = socket_options;
   self->transport_mapper = transport_mapper;
   self->max_connections = 10;
+  self->num_listeners = 1;
   self->listen_backlog = 255;
   self->connections_kept_alive_accross_reloads = TRUE;
   log_reader_options_defaults(&self->reader_options);
@@ -35,6 +35,13 @@
 #define AFSOCKET_WNDSIZE_INITED      0x10000
 
 typedef struct _AFSocketSourceDriver AFSocketSourceDriver;
+typedef struct _AFSocketSourceListener AFSocketSourceListener;
+
+struct _AFSocketSourceListener
+{
+  struct iv_fd listen_fd;
+  AFSocketSourceDriver *owner;
+};
 
 struct _AFSocketSourceDriver
 {
@@ -43,8 +50,10 @@ struct _AFSocketSourceDriver
     connections_kept_alive_accross_reloads:1,
     require_tls:1,
     window_size_initialized:1;
-  struct iv_fd listen_fd;
-  gint fd;
+  /* number of sockets bound to the same address, relies on SO_REUSEPORT if > 1 */
+  gint num_listeners;
+  /* listening sockets of SOCK_STREAM sources, num_listeners entries */
+  AFSocketSourceListener *listeners;
   LogReaderOptions reader_options;
   LogProtoServerFactory *proto_factory;
   GSockAddr *bind_addr;
@@ -73,6 +82,7 @@ struct _AFSocketSourceDriver
 
 void afsocket_sd_set_keep_alive(LogDriver *self, gint enable);
 void afsocket_sd_set_max_connections(LogDriver *self, gint max_connections);
+void afsocket_sd_set_listeners(LogDriver *self, gint listeners);
 
 static inline gboolean
 afsocket_sd_acquire_socket(AFSocketSourceDriver *s, gint *fd)
@@ -25,6 +25,7 @@
 #include "messages.h"
 
 #include <string.h>
+#include <errno.h>
 
 #ifndef SOL_IP
 #define SOL_IP IPPROTO_IP
@@ -43,6 +44,20 @@ socket_options_inet_setup_socket(SocketOptions *s, gint fd, GSockAddr *addr, AFS
   if (!socket_options_setup_socket_method(s, fd, addr, dir))
     return FALSE;
 
+  if (self->so_reuseport)
+    {
+#ifdef SO_REUSEPORT
+      if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &self->so_reuseport, sizeof(self->so_reuseport)) < 0)
+        {
+          msg_error("Error setting SO_REUSEPORT for so-reuseport()",
+                    evt_tag_errno(EVT_TAG_OSERROR, errno));
+          return FALSE;
+        }
+#else
+      msg_error("so-reuseport() is set but no SO_REUSEPORT setsockopt on this platform");
+      return FALSE;
+#endif
+    }
   if (self->tcp_keepalive_time > 0)
     {
 #ifdef TCP_KEEPIDLE
@@ -34,6 +34,7 @@ typedef struct _SocketOptionsInet
   gint tcp_keepalive_time;
   gint tcp_keepalive_intvl;
   gint tcp_keepalive_probes;
+  gboolean so_reuseport;
 } SocketOptionsInet;
 
 SocketOptionsInet *socket_options_inet_new_instance(void);
@@ -68,6 +68,10 @@ transport_mapper_open_socket(TransportMapper *self,
   g_fd_set_nonblock(sock, TRUE);
   g_fd_set_cloexec(sock, TRUE);
 
+  /* some options (e.g. SO_REUSEPORT) only take effect if set before bind() */
+  if (!socket_options_setup_socket(socket_options, sock, bind_addr, dir))
+    goto error_close;
+
   if (!transport_mapper_privileged_bind(sock, bind_addr))
     {
       gchar buf[256];
@@ -78,9 +82,6 @@ transport_mapper_open_socket(TransportMapper *self,
       goto error_close;
     }
 
-  if (!socket_options_setup_socket(socket_options, sock, bind_addr, dir))
-    goto error_close;
-
   *fd = sock;
   return TRUE;
 
@@ -101,7 +102,7 @@ LogTransport *
 transport_mapper_construct_log_transport_method(TransportMapper *self, gint fd)
 {
   if (self->sock_type == SOCK_DGRAM)
-    return log_transport_dgram_socket_new(fd);
+    return log_transport_batched_dgram_socket_new(fd);
   else
     return log_transport_stream_socket_new(fd);
 }
@@ -110,22 +110,44 @@ _get_formatted_key(CSVParser *self, const gchar *key)
   return self->formatted_key->str;
 }
 
+static void
+_set_current_value(CSVParser *self, LogMessage *msg, NVHandle *input_handle, gsize input_ofs)
+{
+  NVHandle handle = log_msg_get_value_handle(_get_formatted_key(self, csv_scanner_get_current_name(&self->scanner)));
+  gint len = csv_scanner_get_current_value_len(&self->scanner);
+  gsize ofs;
+
+  /* columns that need no unescaping reference the input instead of copying it */
+  if (*input_handle &&
+      handle != *input_handle &&
+      log_msg_is_handle_settable_with_an_indirect_value(handle) &&
+      csv_scanner_get_current_value_offset(&self->scanner, &ofs) &&
+      input_ofs + ofs + len <= G_MAXUINT16)
+    {
+      log_msg_set_value_indirect(msg, handle, *input_handle, 0, input_ofs + ofs, len);
+      return;
+    }
+
+  if (handle == *input_handle)
+    *input_handle = 0;
+  log_msg_set_value(msg, handle, csv_scanner_get_current_value(&self->scanner), len);
+}
+
 static gboolean
 csv_parser_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_options, const gchar *input,
                    gsize input_len)
 {
   CSVParser *self = (CSVParser *) s;
-  LogMessage *msg = log_msg_make_writable(pmsg, path_options);
+  NVHandle input_handle;
+  gsize input_ofs = 0;
+  LogMessage *msg;
+
+  input_handle = log_parser_lookup_input_handle(s, *pmsg, input, input_len, &input_ofs);
+  msg = log_msg_make_writable(pmsg, path_options);
 
   csv_scanner_input(&self->scanner, input);
   while (csv_scanner_scan_next(&self->scanner))
-    {
-
-      log_msg_set_value_by_name(msg,
-                                _get_formatted_key(self, csv_scanner_get_current_name(&self->scanner)),
-                                csv_scanner_get_current_value(&self->scanner),
-                                csv_scanner_get_current_value_len(&self->scanner));
-    }
+    _set_current_value(self, msg, &input_handle, input_ofs);
 
   return csv_scanner_is_scan_finished(&self->scanner);
 }
@@ -139,6 +139,10 @@ test_escaped_parsers(void)
   perftest_parser(_construct_parser(-1, CSV_SCANNER_ESCAPE_BACKSLASH, " ", "\"\"[]", "-", NULL),
                   "10.100.20.1 - - [31/Dec/2007:00:17:10 +0100] \"GET /cgi-bin/bugzilla/buglist.cgi?keywords_type=allwords&keywords=public&format=simple HTTP/1.1\" 200 2708 \"-\" \"curl/7.15.5 (i486-pc-linux-gnu) libcurl/7.15.5 OpenSSL/0.9.8c zlib/1.2.3 libidn/0.6.5\" 2 bugzilla.balabit");
 
+  perftest_parser(_construct_parser(-1, CSV_SCANNER_ESCAPE_DOUBLE_CHAR, ",", "\"\"", "-", NULL),
+                  "2016-10-17,12:34:56,42,10.1.2.3,-,-,OBSERVED,\"Technology/Internet\",-,200,TCP_HIT,GET,"
+                  "text/html,http,www.example.com,80,/index.html,-,-,\"Mozilla/5.0 (Windows NT 10.0; Win64; x64)\","
+                  "192.168.0.1,1234,567,-,\"none\",\"none\",-,proxy-sg-01,\"a \"\"quoted\"\" value\",last");
 }
 
 int
@@ -24,18 +24,71 @@
 #include "correllation-key.h"
 #include "correllation-context.h"
 
+static inline CorrellationStateShard *
+_get_shard(CorrellationState *self, const CorrellationKey *key)
+{
+  guint hash = correllation_key_hash(key);
+
+  return &self->shards[(hash ^ (hash >> 16)) % CORRELLATION_STATE_SHARDS];
+}
+
+CorrellationStateShard *
+correllation_state_lock_shard(CorrellationState *self, const CorrellationKey *key)
+{
+  CorrellationStateShard *shard = _get_shard(self, key);
+
+  g_static_mutex_lock(&shard->lock);
+  return shard;
+}
+
+void
+correllation_state_unlock_shard(CorrellationState *self, CorrellationStateShard *shard)
+{
+  g_static_mutex_unlock(&shard->lock);
+}
+
+CorrellationContext *
+correllation_state_lookup_context(CorrellationState *self, const CorrellationKey *key)
+{
+  return g_hash_table_lookup(_get_shard(self, key)->state, key);
+}
+
+void
+correllation_state_insert_context(CorrellationState *self, CorrellationContext *context)
+{
+  g_hash_table_insert(_get_shard(self, &context->key)->state, &context->key, context);
+}
+
+void
+correllation_state_remove_context(CorrellationState *self, const CorrellationKey *key)
+{
+  g_hash_table_remove(_get_shard(self, key)->state, key);
+}
+
 void
 correllation_state_init_instance(CorrellationState *self)
 {
-  self->state = g_hash_table_new_full(correllation_key_hash, correllation_key_equal, NULL,
-                                      (GDestroyNotify) correllation_context_unref);
+  gint i;
+
+  for (i = 0; i < CORRELLATION_STATE_SHARDS; i++)
+    {
+      g_static_mutex_init(&self->shards[i].lock);
+      self->shards[i].state = g_hash_table_new_full(correllation_key_hash, correllation_key_equal, NULL,
+                                                    (GDestroyNotify) correllation_context_unref);
+    }
 }
 
 void
 correllation_state_deinit_instance(CorrellationState *self)
 {
-  if (self->state)
-    g_hash_table_destroy(self->state);
+  gint i;
+
+  for (i = 0; i < CORRELLATION_STATE_SHARDS; i++)
+    {
+      if (self->shards[i].state)
+        g_hash_table_destroy(self->shards[i].state);
+      g_static_mutex_free(&self->shards[i].lock);
+    }
 }
 
 CorrellationState *
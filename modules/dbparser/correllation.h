@@ -25,12 +25,39 @@
 
 #include "syslog-ng.h"
 #include "correllation-key.h"
+#include "correllation-context.h"
 
-typedef struct _CorrellationState
+#define CORRELLATION_STATE_SHARDS 16
+
+/*
+ * The set of active correllation contexts is partitioned into shards based
+ * on the hash of their CorrellationKey, each shard protected by its own
+ * lock, so that messages belonging to different contexts can be
+ * correllated in parallel.
+ *
+ * The lookup/insert/remove functions below do not lock, the caller either
+ * has to hold the lock of the shard the key maps to, or has to ensure
+ * exclusive access to the whole state by other means (e.g.  when expiring
+ * contexts with the owner's lock held for writing).
+ */
+typedef struct _CorrellationStateShard
 {
+  GStaticMutex lock;
   GHashTable *state;
+} CorrellationStateShard;
+
+typedef struct _CorrellationState
+{
+  CorrellationStateShard shards[CORRELLATION_STATE_SHARDS];
 } CorrellationState;
 
+CorrellationStateShard *correllation_state_lock_shard(CorrellationState *self, const CorrellationKey *key);
+void correllation_state_unlock_shard(CorrellationState *self, CorrellationStateShard *shard);
+
+CorrellationContext *correllation_state_lookup_context(CorrellationState *self, const CorrellationKey *key);
+void correllation_state_insert_context(CorrellationState *self, CorrellationContext *context);
+void correllation_state_remove_context(CorrellationState *self, const CorrellationKey *key);
+
 void correllation_state_init_instance(CorrellationState *self);
 void correllation_state_deinit_instance(CorrellationState *self);
 CorrellationState *correllation_state_new(void);
@@ -32,8 +32,11 @@
 typedef struct _GroupingBy
 {
   StatefulParser super;
-  GStaticMutex lock;
+  /* held for reading while processing messages and for writing while
+   * advancing the time, see _perform_groupby() */
+  GStaticRWLock lock;
   struct iv_timer tick;
+  GStaticMutex timer_lock;
   TimerWheel *timer_wheel;
   GTimeVal last_tick;
   CorrellationState *correllation;
@@ -107,6 +110,18 @@ grouping_by_set_synthetic_message(LogParser *s, SyntheticMessage *message)
   self->synthetic_message = message;
 }
 
+/* NOTE: lock should be acquired for reading before calling this function. */
+static gboolean
+_grouping_by_is_time_update_needed(GroupingBy *self, const LogStamp *ls)
+{
+  GTimeVal now;
+
+  cached_g_current_time(&now);
+  if (now.tv_sec != self->last_tick.tv_sec)
+    return TRUE;
+  return MIN(ls->tv_sec, now.tv_sec) > timer_wheel_get_time(self->timer_wheel);
+}
+
 /* NOTE: lock should be acquired for writing before calling this function. */
 void
 grouping_by_set_time(GroupingBy *self, const LogStamp *ls)
@@ -143,7 +158,7 @@ _grouping_by_timer_tick(GroupingBy *self)
   GTimeVal now;
   glong diff;
 
-  g_static_mutex_lock(&self->lock);
+  g_static_rw_lock_writer_lock(&self->lock);
   cached_g_current_time(&now);
   diff = g_time_val_diff(&now, &self->last_tick);
 
@@ -167,7 +182,7 @@ _grouping_by_timer_tick(GroupingBy *self)
        */
       self->last_tick = now;
     }
-  g_static_mutex_unlock(&self->lock);
+  g_static_rw_lock_writer_unlock(&self->lock);
 }
 
 static void
@@ -232,7 +247,7 @@ grouping_by_expire_entry(TimerWheel *wheel, guint64 now, gpointer user_data)
                         log_expr_node_format_location(self->super.super.super.expr_node,
                             buf, sizeof(buf))));
   grouping_by_emit_synthetic(self, context);
-  g_hash_table_remove(self->correllation->state, &context->key);
+  correllation_state_remove_context(self->correllation, &context->key);
 
   /* correllation_context_free is automatically called when returning from
      this function by the timerwheel code as a destroy notify
@@ -256,17 +271,30 @@ _perform_groupby(GroupingBy *self, LogMessage *msg)
   CorrellationContext *context = NULL;
   gchar buf[256];
 
-  g_static_mutex_lock(&self->lock);
-  grouping_by_set_time(self, &msg->timestamps[LM_TS_STAMP]);
+  g_static_rw_lock_reader_lock(&self->lock);
+  if (_grouping_by_is_time_update_needed(self, &msg->timestamps[LM_TS_STAMP]))
+    {
+      g_static_rw_lock_reader_unlock(&self->lock);
+      g_static_rw_lock_writer_lock(&self->lock);
+      if (_grouping_by_is_time_update_needed(self, &msg->timestamps[LM_TS_STAMP]))
+        grouping_by_set_time(self, &msg->timestamps[LM_TS_STAMP]);
+      g_static_rw_lock_writer_unlock(&self->lock);
+      g_static_rw_lock_reader_lock(&self->lock);
+    }
+
+  /* contexts only expire with the lock held for writing, the shard lock
+   * protects them against other threads processing messages concurrently */
   if (self->key_template)
     {
       CorrellationKey key;
+      CorrellationStateShard *shard;
 
       log_template_format(self->key_template, msg, NULL, LTZ_LOCAL, 0, NULL, buffer);
       log_msg_set_value(msg, context_id_handle, buffer->str, -1);
 
       correllation_key_setup(&key, self->scope, msg, buffer->str);
-      context = g_hash_table_lookup(self->correllation->state, &key);
+      shard = correllation_state_lock_shard(self->correllation, &key);
+      context = correllation_state_lookup_context(self->correllation, &key);
       if (!context)
         {
           msg_debug("Correllation context lookup failure, starting a new context",
@@ -277,7 +305,7 @@ _perform_groupby(GroupingBy *self, LogMessage *msg)
                                 log_expr_node_format_location(self->super.super.super.expr_node,
                                     buf, sizeof(buf))));
           context = correllation_context_new(&key);
-          g_hash_table_insert(self->correllation->state, &context->key, context);
+          correllation_state_insert_context(self->correllation, context);
           g_string_steal(buffer);
         }
       else
@@ -306,12 +334,16 @@ _perform_groupby(GroupingBy *self, LogMessage *msg)
                                       buf, sizeof(buf))));
           /* close down state */
           if (context->timer)
-            timer_wheel_del_timer(self->timer_wheel, context->timer);
+            {
+              g_static_mutex_lock(&self->timer_lock);
+              timer_wheel_del_timer(self->timer_wheel, context->timer);
+              g_static_mutex_unlock(&self->timer_lock);
+            }
           grouping_by_expire_entry(self->timer_wheel, timer_wheel_get_time(self->timer_wheel), context);
         }
       else
         {
-
+          g_static_mutex_lock(&self->timer_lock);
           if (context->timer)
             {
               timer_wheel_mod_timer(self->timer_wheel, context->timer, self->timeout);
@@ -321,14 +353,16 @@ _perform_groupby(GroupingBy *self, LogMessage *msg)
               context->timer = timer_wheel_add_timer(self->timer_wheel, self->timeout, grouping_by_expire_entry,
                                                      correllation_context_ref(context), (GDestroyNotify) correllation_context_unref);
             }
+          g_static_mutex_unlock(&self->timer_lock);
         }
+      correllation_state_unlock_shard(self->correllation, shard);
     }
   else
     {
       context = NULL;
     }
 
-  g_static_mutex_unlock(&self->lock);
+  g_static_rw_lock_reader_unlock(&self->lock);
 
   if (context)
     log_msg_write_protect(msg);
@@ -414,7 +448,8 @@ grouping_by_free(LogPipe *s)
 {
   GroupingBy *self = (GroupingBy *) s;
 
-  g_static_mutex_free(&self->lock);
+  g_static_mutex_free(&self->timer_lock);
+  g_static_rw_lock_free(&self->lock);
   log_template_unref(self->key_template);
   if (self->synthetic_message)
     synthetic_message_free(self->synthetic_message);
@@ -433,7 +468,8 @@ grouping_by_new(GlobalConfig *cfg)
   self->super.super.super.deinit = grouping_by_deinit;
   self->super.super.super.clone = grouping_by_clone;
   self->super.super.process = grouping_by_process;
-  g_static_mutex_init(&self->lock);
+  g_static_rw_lock_init(&self->lock);
+  g_static_mutex_init(&self->timer_lock);
   self->scope = RCS_GLOBAL;
   self->timer_wheel = timer_wheel_new();
   timer_wheel_set_associated_data(self->timer_wheel, self, NULL);
@@ -60,7 +60,9 @@ struct _PatternDB
   GStaticRWLock lock;
   PDBRuleSet *ruleset;
   CorrellationState correllation;
+  GStaticMutex rate_limits_lock;
   GHashTable *rate_limits;
+  GStaticMutex timer_lock;
   TimerWheel *timer_wheel;
   GTimeVal last_tick;
   PatternDBEmitFunc emit;
@@ -98,6 +100,30 @@ struct _PatternDB
  *    2) process an incoming message stream on-line, expiring correllation
  *    states even if there are no incoming messages
  *
+ * Locking
+ * =======
+ *
+ * Messages are processed with the PatternDB lock held for reading, so that
+ * any number of threads can look up rules and update correllation
+ * contexts at the same time.  Contexts are stored in a sharded
+ * CorrellationState, each shard has its own lock, the timer wheel and the
+ * rate limits are protected by their own mutexes.  The lock order is:
+ * PatternDB lock -> shard lock -> timer_lock.
+ *
+ * The PatternDB lock is only acquired for writing when the ruleset or the
+ * state is replaced and when the current time is advanced, as that expires
+ * contexts.  As the time is kept with a granularity of a second, this
+ * happens at most a couple of times every second, see
+ * _pattern_db_is_time_update_needed().
+ *
+ * Rules without a context-id never touch the correllation state, so those
+ * messages are processed without acquiring any locks other than the
+ * PatternDB lock for reading.
+ *
+ * Actions triggered by a match run on a private copy of the context, as
+ * other threads may add messages to it once the shard lock is released.
+ * The messages they generate are collected and emitted together with the
+ * incoming message once the PatternDB lock is released.
  */
 
 
@@ -134,6 +160,20 @@ pdb_context_new(CorrellationKey *key)
   return self;
 }
 
+/* NOTE: the shard lock of the context should be held by the caller */
+static PDBContext *
+pdb_context_snapshot(PDBContext *self)
+{
+  PDBContext *snapshot = pdb_context_new(&self->super.key);
+  gint i;
+
+  snapshot->super.key.session_id = g_strdup(self->super.key.session_id);
+  for (i = 0; i < self->super.messages->len; i++)
+    g_ptr_array_add(snapshot->super.messages, log_msg_ref((LogMessage *) g_ptr_array_index(self->super.messages, i)));
+  snapshot->rule = pdb_rule_ref(self->rule);
+  return snapshot;
+}
+
 /***************************************************************************
  * PDBRateLimit
  ***************************************************************************/
@@ -193,6 +233,7 @@ pdb_check_action_rate_limit(PDBAction *self, PDBRule *rule, PatternDB *db, LogMe
   g_string_printf(buffer, "%s:%d", rule->rule_id, self->id);
   correllation_key_setup(&key, rule->context.scope, msg, buffer->str);
 
+  g_static_mutex_lock(&db->rate_limits_lock);
   rl = g_hash_table_lookup(db->rate_limits, &key);
   if (!rl)
     {
@@ -224,8 +265,10 @@ pdb_check_action_rate_limit(PDBAction *self, PDBRule *rule, PatternDB *db, LogMe
   if (rl->buckets)
     {
       rl->buckets--;
+      g_static_mutex_unlock(&db->rate_limits_lock);
       return TRUE;
     }
+  g_static_mutex_unlock(&db->rate_limits_lock);
   return FALSE;
 }
 
@@ -261,23 +304,50 @@ pdb_generate_message(PDBAction *self, PDBContext *context, LogMessage *msg, GStr
     return synthetic_message_generate_without_context(&self->content.message, msg, buffer);
 }
 
+/* the generated message is added to @emitted_messages if it is not NULL,
+ * otherwise it is emitted right away */
 void
-pdb_execute_action_message(PDBAction *self, PatternDB *db, PDBContext *context, LogMessage *msg, GString *buffer)
+pdb_execute_action_message(PDBAction *self, PatternDB *db, PDBContext *context, LogMessage *msg, GString *buffer,
+                           GPtrArray *emitted_messages)
 {
   LogMessage *genmsg;
 
   genmsg = pdb_generate_message(self, context, msg, buffer);
+  if (emitted_messages)
+    {
+      g_ptr_array_add(emitted_messages, genmsg);
+      return;
+    }
   db->emit(genmsg, TRUE, db->emit_data);
   log_msg_unref(genmsg);
 }
 
 static void pattern_db_expire_entry(TimerWheel *wheel, guint64 now, gpointer user_data);
 
+/* NOTE: the shard lock of the context should be held by the caller */
+static void
+_pattern_db_schedule_context_expiration(PatternDB *self, PDBContext *context, gint timeout)
+{
+  g_static_mutex_lock(&self->timer_lock);
+  if (context->super.timer)
+    {
+      timer_wheel_mod_timer(self->timer_wheel, context->super.timer, timeout);
+    }
+  else
+    {
+      context->super.timer = timer_wheel_add_timer(self->timer_wheel, timeout, pattern_db_expire_entry,
+                             correllation_context_ref(&context->super),
+                             (GDestroyNotify) correllation_context_unref);
+    }
+  g_static_mutex_unlock(&self->timer_lock);
+}
+
 void
 pdb_execute_action_create_context(PDBAction *self, PatternDB *db, PDBRule *rule, PDBContext *triggering_context,
                                   LogMessage *triggering_msg, GString *buffer)
 {
   CorrellationKey key;
+  CorrellationStateShard *shard;
   PDBContext *new_context;
   LogMessage *context_msg;
   SyntheticContext *syn_context;
@@ -308,26 +378,27 @@ pdb_execute_action_create_context(PDBAction *self, PatternDB *db, PDBRule *rule,
 
   correllation_key_setup(&key, syn_context->scope, context_msg, buffer->str);
   new_context = pdb_context_new(&key);
-  g_hash_table_insert(db->correllation.state, &new_context->super.key, new_context);
   g_string_steal(buffer);
 
   g_ptr_array_add(new_context->super.messages, context_msg);
-
-  new_context->super.timer = timer_wheel_add_timer(db->timer_wheel, rule->context.timeout, pattern_db_expire_entry,
-                             correllation_context_ref(&new_context->super),
-                             (GDestroyNotify) correllation_context_unref);
   new_context->rule = pdb_rule_ref(rule);
+
+  shard = correllation_state_lock_shard(&db->correllation, &new_context->super.key);
+  correllation_state_insert_context(&db->correllation, &new_context->super);
+  _pattern_db_schedule_context_expiration(db, new_context, rule->context.timeout);
+  correllation_state_unlock_shard(&db->correllation, shard);
 }
 
 void
-pdb_execute_action(PDBAction *self, PatternDB *db, PDBRule *rule, PDBContext *context, LogMessage *msg, GString *buffer)
+pdb_execute_action(PDBAction *self, PatternDB *db, PDBRule *rule, PDBContext *context, LogMessage *msg, GString *buffer,
+                   GPtrArray *emitted_messages)
 {
   switch (self->content_type)
     {
     case RAC_NONE:
       break;
     case RAC_MESSAGE:
-      pdb_execute_action_message(self, db, context, msg, buffer);
+      pdb_execute_action_message(self, db, context, msg, buffer, emitted_messages);
       break;
     case RAC_CREATE_CONTEXT:
       pdb_execute_action_create_context(self, db, rule, context, msg, buffer);
@@ -340,15 +411,15 @@ pdb_execute_action(PDBAction *self, PatternDB *db, PDBRule *rule, PDBContext *co
 
 void
 pdb_trigger_action(PDBAction *self, PatternDB *db, PDBRule *rule, PDBActionTrigger trigger, PDBContext *context,
-                   LogMessage *msg, GString *buffer)
+                   LogMessage *msg, GString *buffer, GPtrArray *emitted_messages)
 {
   if (pdb_is_action_triggered(self, db, rule, trigger, context, msg, buffer))
-    pdb_execute_action(self, db, rule, context, msg, buffer);
+    pdb_execute_action(self, db, rule, context, msg, buffer, emitted_messages);
 }
 
 void
 pdb_run_rule_actions(PDBRule *self, PatternDB *db, PDBActionTrigger trigger, PDBContext *context, LogMessage *msg,
-                     GString *buffer)
+                     GString *buffer, GPtrArray *emitted_messages)
 {
   gint i;
 
@@ -358,7 +429,7 @@ pdb_run_rule_actions(PDBRule *self, PatternDB *db, PDBActionTrigger trigger, PDB
     {
       PDBAction *action = (PDBAction *) g_ptr_array_index(self->actions, i);
 
-      pdb_trigger_action(action, db, self, trigger, context, msg, buffer);
+      pdb_trigger_action(action, db, self, trigger, context, msg, buffer, emitted_messages);
     }
 }
 
@@ -496,7 +567,7 @@ pdb_lookup_ruleset(PDBRuleSet *self, PDBLookupParams *lookup, GArray *dbg_list)
  *********************************************************/
 
 /* NOTE: this function requires PatternDB reader/writer lock to be
- * write-locked.
+ * write-locked, which is why the shard lock is not acquired here.
  *
  * Currently, it is, as timer_wheel_set_time() is only called with that
  * precondition, and timer-wheel callbacks are only called from within
@@ -515,8 +586,8 @@ pattern_db_expire_entry(TimerWheel *wheel, guint64 now, gpointer user_data)
             evt_tag_str("last_rule", context->rule->rule_id),
             evt_tag_long("utc", timer_wheel_get_time(pdb->timer_wheel)));
   if (pdb->emit)
-    pdb_run_rule_actions(context->rule, pdb, RAT_TIMEOUT, context, msg, buffer);
-  g_hash_table_remove(pdb->correllation.state, &context->super.key);
+    pdb_run_rule_actions(context->rule, pdb, RAT_TIMEOUT, context, msg, buffer, NULL);
+  correllation_state_remove_context(&pdb->correllation, &context->super.key);
   g_string_free(buffer, TRUE);
 
   /* pdb_context_free is automatically called when returning from
@@ -600,6 +671,7 @@ pattern_db_reload_ruleset(PatternDB *self, GlobalConfig *cfg, const gchar *pdb_f
     }
   else
     {
+      pdb_rule_set_compile(new_ruleset);
       g_static_rw_lock_writer_lock(&self->lock);
       if (self->ruleset)
         pdb_rule_set_free(self->ruleset);
@@ -647,93 +719,120 @@ _pattern_db_is_empty(PatternDB *self)
   return (G_UNLIKELY(!self->ruleset) || self->ruleset->is_empty);
 }
 
-static void
-_pattern_db_process_matching_rule(PatternDB *self, PDBRule *rule, LogMessage *msg)
+/* NOTE: lock should be acquired for reading before calling this function. */
+static gboolean
+_pattern_db_is_time_update_needed(PatternDB *self, const LogStamp *ls)
 {
-  PDBContext *context = NULL;
-  GString *buffer = g_string_sized_new(32);
+  GTimeVal now;
 
-  g_static_rw_lock_writer_lock(&self->lock);
-  pattern_db_set_time(self, &msg->timestamps[LM_TS_STAMP]);
-  if (rule->context.id_template)
-    {
-      CorrellationKey key;
+  cached_g_current_time(&now);
+  if (now.tv_sec != self->last_tick.tv_sec)
+    return TRUE;
+  return MIN(ls->tv_sec, now.tv_sec) > timer_wheel_get_time(self->timer_wheel);
+}
 
-      log_template_format(rule->context.id_template, msg, NULL, LTZ_LOCAL, 0, NULL, buffer);
-      log_msg_set_value(msg, context_id_handle, buffer->str, -1);
+static void
+_pattern_db_advance_time(PatternDB *self, const LogStamp *ls)
+{
+  g_static_rw_lock_writer_lock(&self->lock);
+  /* another thread may have done it while we were waiting for the lock */
+  if (_pattern_db_is_time_update_needed(self, ls))
+    pattern_db_set_time(self, ls);
+  g_static_rw_lock_writer_unlock(&self->lock);
+}
 
-      correllation_key_setup(&key, rule->context.scope, msg, buffer->str);
-      context = g_hash_table_lookup(self->correllation.state, &key);
-      if (!context)
-        {
-          msg_debug("Correllation context lookup failure, starting a new context",
-                    evt_tag_str("rule", rule->rule_id),
-                    evt_tag_str("context", buffer->str),
-                    evt_tag_int("context_timeout", rule->context.timeout),
-                    evt_tag_int("context_expiration", timer_wheel_get_time(self->timer_wheel) + rule->context.timeout));
-          context = pdb_context_new(&key);
-          g_hash_table_insert(self->correllation.state, &context->super.key, context);
-          g_string_steal(buffer);
-        }
-      else
-        {
-          msg_debug("Correllation context lookup successful",
-                    evt_tag_str("rule", rule->rule_id),
-                    evt_tag_str("context", buffer->str),
-                    evt_tag_int("context_timeout", rule->context.timeout),
-                    evt_tag_int("context_expiration", timer_wheel_get_time(self->timer_wheel) + rule->context.timeout),
-                    evt_tag_int("num_messages", context->super.messages->len));
-        }
+/* returns a copy of the context for running the actions of @rule, NULL if
+ * it has none */
+static PDBContext *
+_pattern_db_update_context(PatternDB *self, PDBRule *rule, LogMessage *msg, GString *buffer)
+{
+  CorrellationKey key;
+  CorrellationStateShard *shard;
+  PDBContext *context;
+  PDBContext *snapshot = NULL;
 
-      g_ptr_array_add(context->super.messages, log_msg_ref(msg));
+  log_template_format(rule->context.id_template, msg, NULL, LTZ_LOCAL, 0, NULL, buffer);
+  log_msg_set_value(msg, context_id_handle, buffer->str, -1);
 
-      if (context->super.timer)
-        {
-          timer_wheel_mod_timer(self->timer_wheel, context->super.timer, rule->context.timeout);
-        }
-      else
-        {
-          context->super.timer = timer_wheel_add_timer(self->timer_wheel, rule->context.timeout, pattern_db_expire_entry,
-                                 correllation_context_ref(&context->super),
-                                 (GDestroyNotify) correllation_context_unref);
-        }
-      if (context->rule != rule)
-        {
-          if (context->rule)
-            pdb_rule_unref(context->rule);
-          context->rule = pdb_rule_ref(rule);
-        }
+  correllation_key_setup(&key, rule->context.scope, msg, buffer->str);
+  shard = correllation_state_lock_shard(&self->correllation, &key);
+  context = (PDBContext *) correllation_state_lookup_context(&self->correllation, &key);
+  if (!context)
+    {
+      msg_debug("Correllation context lookup failure, starting a new context",
+                evt_tag_str("rule", rule->rule_id),
+                evt_tag_str("context", buffer->str),
+                evt_tag_int("context_timeout", rule->context.timeout),
+                evt_tag_int("context_expiration", timer_wheel_get_time(self->timer_wheel) + rule->context.timeout));
+      context = pdb_context_new(&key);
+      correllation_state_insert_context(&self->correllation, &context->super);
+      g_string_steal(buffer);
     }
   else
     {
-      context = NULL;
+      msg_debug("Correllation context lookup successful",
+                evt_tag_str("rule", rule->rule_id),
+                evt_tag_str("context", buffer->str),
+                evt_tag_int("context_timeout", rule->context.timeout),
+                evt_tag_int("context_expiration", timer_wheel_get_time(self->timer_wheel) + rule->context.timeout),
+                evt_tag_int("num_messages", context->super.messages->len));
     }
 
-  synthetic_message_apply(&rule->msg, &context->super, msg, buffer);
-  if (self->emit)
+  g_ptr_array_add(context->super.messages, log_msg_ref(msg));
+  _pattern_db_schedule_context_expiration(self, context, rule->context.timeout);
+
+  if (context->rule != rule)
     {
-      g_static_rw_lock_writer_unlock(&self->lock);
-      self->emit(msg, FALSE, self->emit_data);
-      pdb_run_rule_actions(rule, self, RAT_MATCH, context, msg, buffer);
-      g_static_rw_lock_writer_lock(&self->lock);
+      if (context->rule)
+        pdb_rule_unref(context->rule);
+      context->rule = pdb_rule_ref(rule);
     }
-  pdb_rule_unref(rule);
-  g_static_rw_lock_writer_unlock(&self->lock);
 
-  if (context)
-    log_msg_write_protect(msg);
+  synthetic_message_apply(&rule->msg, &context->super, msg, buffer);
+  if (rule->actions)
+    snapshot = pdb_context_snapshot(context);
+  correllation_state_unlock_shard(&self->correllation, shard);
+
+  return snapshot;
+}
 
+/* NOTE: lock should be acquired for reading before calling this function.
+ * The messages generated by the actions are added to @emitted_messages,
+ * they are emitted by the caller after releasing the lock. */
+static void
+_pattern_db_process_matching_rule(PatternDB *self, PDBRule *rule, LogMessage *msg, GPtrArray *emitted_messages)
+{
+  PDBContext *context = NULL;
+  GString *buffer = g_string_sized_new(32);
+
+  if (rule->context.id_template)
+    context = _pattern_db_update_context(self, rule, msg, buffer);
+  else
+    synthetic_message_apply(&rule->msg, NULL, msg, buffer);
+
+  if (self->emit)
+    pdb_run_rule_actions(rule, self, RAT_MATCH, context, msg, buffer, emitted_messages);
+
+  if (context)
+    correllation_context_unref(&context->super);
   g_string_free(buffer, TRUE);
 }
 
 static void
-_pattern_db_process_unmatching_rule(PatternDB *self, LogMessage *msg)
+_pattern_db_emit_messages(PatternDB *self, LogMessage *msg, GPtrArray *emitted_messages)
 {
-  g_static_rw_lock_writer_lock(&self->lock);
-  pattern_db_set_time(self, &msg->timestamps[LM_TS_STAMP]);
-  g_static_rw_lock_writer_unlock(&self->lock);
+  gint i;
+
   if (self->emit)
     self->emit(msg, FALSE, self->emit_data);
+
+  for (i = 0; i < emitted_messages->len; i++)
+    {
+      LogMessage *genmsg = (LogMessage *) g_ptr_array_index(emitted_messages, i);
+
+      self->emit(genmsg, TRUE, self->emit_data);
+      log_msg_unref(genmsg);
+    }
 }
 
 static gboolean
@@ -741,20 +840,43 @@ _pattern_db_process(PatternDB *self, PDBLookupParams *lookup, GArray *dbg_list)
 {
   PDBRule *rule;
   LogMessage *msg = lookup->msg;
+  GPtrArray *emitted_messages;
+  gboolean correllated;
 
   g_static_rw_lock_reader_lock(&self->lock);
+  if (_pattern_db_is_time_update_needed(self, &msg->timestamps[LM_TS_STAMP]))
+    {
+      g_static_rw_lock_reader_unlock(&self->lock);
+      _pattern_db_advance_time(self, &msg->timestamps[LM_TS_STAMP]);
+      g_static_rw_lock_reader_lock(&self->lock);
+    }
+
   if (_pattern_db_is_empty(self))
     {
       g_static_rw_lock_reader_unlock(&self->lock);
       return FALSE;
     }
   rule = pdb_lookup_ruleset(self->ruleset, lookup, dbg_list);
+  if (!rule)
+    {
+      g_static_rw_lock_reader_unlock(&self->lock);
+      if (self->emit)
+        self->emit(msg, FALSE, self->emit_data);
+      return FALSE;
+    }
+
+  emitted_messages = g_ptr_array_new();
+  correllated = rule->context.id_template != NULL;
+  _pattern_db_process_matching_rule(self, rule, msg, emitted_messages);
+  pdb_rule_unref(rule);
   g_static_rw_lock_reader_unlock(&self->lock);
-  if (rule)
-    _pattern_db_process_matching_rule(self, rule, msg);
-  else
-    _pattern_db_process_unmatching_rule(self, msg);
-  return rule != NULL;
+
+  _pattern_db_emit_messages(self, msg, emitted_messages);
+  g_ptr_array_free(emitted_messages, TRUE);
+
+  if (correllated)
+    log_msg_write_protect(msg);
+  return TRUE;
 }
 
 static void
@@ -842,6 +964,8 @@ pattern_db_new(void)
   _init_state(self);
   cached_g_current_time(&self->last_tick);
   g_static_rw_lock_init(&self->lock);
+  g_static_mutex_init(&self->rate_limits_lock);
+  g_static_mutex_init(&self->timer_lock);
   return self;
 }
 
@@ -851,6 +975,8 @@ pattern_db_free(PatternDB *self)
   if (self->ruleset)
     pdb_rule_set_free(self->ruleset);
   _destroy_state(self);
+  g_static_mutex_free(&self->timer_lock);
+  g_static_mutex_free(&self->rate_limits_lock);
   g_static_rw_lock_free(&self->lock);
   g_free(self);
 }
@@ -32,6 +32,23 @@ pdb_rule_set_new(void)
   return self;
 }
 
+static void
+_compile_program(gpointer value)
+{
+  PDBProgram *program = (PDBProgram *) value;
+
+  r_compile_node(program->rules, NULL);
+}
+
+/* optional step after loading, makes lookups faster at the expense of
+ * some memory, see r_compile_node() */
+void
+pdb_rule_set_compile(PDBRuleSet *self)
+{
+  if (self->programs)
+    r_compile_node(self->programs, _compile_program);
+}
+
 void
 pdb_rule_set_free(PDBRuleSet *self)
 {
@@ -36,6 +36,7 @@ typedef struct _PDBRuleSet
 } PDBRuleSet;
 
 PDBRuleSet *pdb_rule_set_new(void);
+void pdb_rule_set_compile(PDBRuleSet *self);
 void pdb_rule_set_free(PDBRuleSet *self);
 
 #endif
@@ -1114,6 +1114,121 @@ static GOptionEntry patternize_options[] =
   { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL }
 };
 
+static gint benchmark_iterations = 10;
+
+static gint
+pdbtool_benchmark(int argc, char *argv[])
+{
+  PatternDB *patterndb;
+  MsgFormatOptions parse_options;
+  LogProtoServerOptions proto_options;
+  LogProtoServer *proto;
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  GPtrArray *messages;
+  GTimeVal start, end;
+  const guchar *buf = NULL;
+  gsize buflen;
+  gboolean may_read = TRUE;
+  gint fd, i, j, matches = 0;
+  glong elapsed;
+  gint ret = 0;
+
+  if (!match_file)
+    {
+      fprintf(stderr, "The -f option is required to specify the sample log file\n");
+      return 1;
+    }
+
+  patterndb = pattern_db_new();
+  if (!pattern_db_reload_ruleset(patterndb, configuration, patterndb_file))
+    {
+      pattern_db_free(patterndb);
+      return 1;
+    }
+
+  if (strcmp(match_file, "-") == 0)
+    fd = 0;
+  else if ((fd = open(match_file, O_RDONLY)) < 0)
+    {
+      fprintf(stderr, "Error opening file to be processed: %s\n", g_strerror(errno));
+      pattern_db_free(patterndb);
+      return 1;
+    }
+
+  msg_format_options_defaults(&parse_options);
+  parse_options.flags |= LP_SYSLOG_PROTOCOL | LP_EXPECT_HOSTNAME;
+  msg_format_options_init(&parse_options, configuration);
+  log_proto_server_options_defaults(&proto_options);
+  proto_options.max_msg_size = 65536;
+  log_proto_server_options_init(&proto_options, configuration);
+
+  /* parse the sample in advance, so that only pattern matching is measured */
+  messages = g_ptr_array_new();
+  proto = log_proto_text_server_new(log_transport_file_new(fd), &proto_options);
+  while (log_proto_server_fetch(proto, &buf, &buflen, &may_read, NULL, NULL) == LPS_SUCCESS && buf)
+    {
+      LogMessage *msg = log_msg_new_empty();
+
+      parse_options.format_handler->parse(&parse_options, buf, buflen, msg);
+      log_msg_write_protect(msg);
+      g_ptr_array_add(messages, msg);
+      buf = NULL;
+    }
+  log_proto_server_free(proto);
+
+  if (messages->len == 0)
+    {
+      fprintf(stderr, "No messages found in the sample log file\n");
+      ret = 1;
+      goto exit;
+    }
+
+  path_options.ack_needed = FALSE;
+  g_get_current_time(&start);
+  for (i = 0; i < benchmark_iterations; i++)
+    {
+      for (j = 0; j < messages->len; j++)
+        {
+          LogMessage *msg = log_msg_clone_cow((LogMessage *) g_ptr_array_index(messages, j), &path_options);
+
+          if (pattern_db_process(patterndb, msg))
+            matches++;
+          log_msg_unref(msg);
+        }
+    }
+  g_get_current_time(&end);
+  elapsed = MAX(g_time_val_diff(&end, &start), 1);
+
+  printf("Processed %d messages (%d distinct) in %.3f seconds, %d matched, %.0f msg/sec\n",
+         messages->len * benchmark_iterations, messages->len, elapsed / 1e6, matches,
+         (messages->len * benchmark_iterations) / (elapsed / 1e6));
+
+exit:
+  pattern_db_expire_state(patterndb);
+  g_ptr_array_foreach(messages, (GFunc) log_msg_unref, NULL);
+  g_ptr_array_free(messages, TRUE);
+  pattern_db_free(patterndb);
+  msg_format_options_destroy(&parse_options);
+  return ret;
+}
+
+static GOptionEntry benchmark_options[] =
+{
+  {
+    "pdb",       'p', 0, G_OPTION_ARG_STRING, &patterndb_file,
+    "Name of the patterndb file", "<patterndb_file>"
+  },
+  {
+    "file",      'f', 0, G_OPTION_ARG_STRING, &match_file,
+    "Sample log file to match against the pattern database, use '-' for stdin", "<path>"
+  },
+  {
+    "iterations", 'n', 0, G_OPTION_ARG_INT, &benchmark_iterations,
+    "Number of times the sample is processed (default: 10)", "<n>"
+  },
+  { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL }
+};
+
 
 const gchar *
 pdbtool_mode(int *argc, char **argv[])
@@ -1169,6 +1284,7 @@ static struct
   { "test", test_options, "Test pattern databases", pdbtool_test },
   { "patternize", patternize_options, "Create a pattern database from logs", pdbtool_patternize },
   { "dictionary", dictionary_options, "Dump pattern dictionary", pdbtool_dictionary },
+  { "benchmark", benchmark_options, "Measure pattern matching throughput on a sample log file", pdbtool_benchmark },
   { NULL, NULL },
 };
 
@@ -39,6 +39,16 @@ r_parser_string(guint8 *str, gint *len, const gchar *param, gpointer state, RPar
 {
   *len = 0;
 
+  if (state)
+    {
+      /* character class precomputed by r_new_pnode() */
+      const guint8 *accepted = (const guint8 *) state;
+
+      while (accepted[str[*len]])
+        (*len)++;
+      return *len > 0;
+    }
+
   while (str[*len] && (g_ascii_isalnum(str[*len]) || (param && strchr(param, str[*len]))))
     (*len)++;
 
@@ -744,6 +754,21 @@ r_new_pnode(guint8 *key)
         parser_node->param = g_strdup(params[2]);
     }
 
+  if (parser_node && parser_node->type == RPT_STRING && parser_node->param)
+    {
+      /* avoid strchr() on the extra characters for every input byte */
+      guint8 *accepted = g_new0(guint8, 256);
+      const guint8 *p;
+      gint c;
+
+      for (c = 1; c < 256; c++)
+        accepted[c] = g_ascii_isalnum(c);
+      for (p = (const guint8 *) parser_node->param; *p; p++)
+        accepted[*p] = 1;
+      parser_node->state = accepted;
+      parser_node->free_state = g_free;
+    }
+
 
   g_strfreev(params);
 
@@ -794,6 +819,13 @@ r_node_cmp(const void *ap, const void *bp)
 void
 r_add_child(RNode *parent, RNode *child)
 {
+  /* the tree is modified after compilation, drop the stale table */
+  if (parent->child_table)
+    {
+      g_free(parent->child_table);
+      parent->child_table = NULL;
+    }
+
   parent->children = g_realloc(parent->children, (sizeof(RNode *) * (parent->num_children + 1)));
 
   //FIXME: we could do a simple sorted insert without resorting always
@@ -880,6 +912,9 @@ r_find_child_by_first_character(RNode *root, char key)
   register gint l, u, idx;
   register char k = key;
 
+  if (root->child_table)
+    return root->child_table[(guint8) key];
+
   l = 0;
   u = root->num_children;
 
@@ -1052,8 +1087,10 @@ r_insert_node(RNode *root, guint8 *key, gpointer value, RNodeGetValueFunc value_
             {
               old_tree->children = root->children;
               old_tree->num_children = root->num_children;
+              old_tree->child_table = root->child_table;
               root->children = NULL;
               root->num_children = 0;
+              root->child_table = NULL;
             }
 
           if (root->num_pchildren)
@@ -1248,13 +1285,36 @@ _is_pnode_matching_initial_character(RParserNode *parser_node, guint8 *key)
   return (parser_node->first <= key[0]) && (key[0] <= parser_node->last);
 }
 
+static inline gboolean
+_pnode_parse(RParserNode *parser_node, guint8 *key, gint *extracted_match_len, RParserMatch *match)
+{
+  /* call the most frequently used parsers directly instead of through the
+   * function pointer, so that the compiler can inline them */
+  switch (parser_node->type)
+    {
+    case RPT_STRING:
+      return r_parser_string(key, extracted_match_len, parser_node->param, parser_node->state, match);
+    case RPT_NUMBER:
+      return r_parser_number(key, extracted_match_len, parser_node->param, parser_node->state, match);
+    case RPT_IPV4:
+      return r_parser_ipv4(key, extracted_match_len, parser_node->param, parser_node->state, match);
+    case RPT_ESTRING:
+      if (parser_node->parse == r_parser_estring_c)
+        return r_parser_estring_c(key, extracted_match_len, parser_node->param, parser_node->state, match);
+      break;
+    default:
+      break;
+    }
+  return parser_node->parse(key, extracted_match_len, parser_node->param, parser_node->state, match);
+}
+
 static gboolean
 _pnode_try_parse(RParserNode *parser_node, guint8 *key, gint *extracted_match_len, RParserMatch *match)
 {
   if (!_is_pnode_matching_initial_character(parser_node, key))
     return FALSE;
 
-  if (!parser_node->parse(key, extracted_match_len, parser_node->param, parser_node->state, match))
+  if (!_pnode_parse(parser_node, key, extracted_match_len, match))
     return FALSE;
 
   return TRUE;
@@ -1499,6 +1559,8 @@ r_new_node(guint8 *key, gpointer value)
   node->num_pchildren = 0;
   node->pchildren = NULL;
 
+  node->child_table = NULL;
+
   return node;
 }
 
@@ -1519,6 +1581,9 @@ r_free_node(RNode *node, void (*free_fn)(gpointer data))
   if (node->pchildren)
     g_free(node->pchildren);
 
+  if (node->child_table)
+    g_free(node->child_table);
+
   if (node->key)
     g_free(node->key);
 
@@ -1527,3 +1592,43 @@ r_free_node(RNode *node, void (*free_fn)(gpointer data))
 
   g_free(node);
 }
+
+/* nodes with at least this many literal children get a lookup table */
+#define R_CHILD_TABLE_MIN_CHILDREN 8
+
+/**
+ * r_compile_node:
+ *
+ * Prepare a fully loaded tree for lookups: literal nodes with a lot of
+ * children get a 256 entry table indexed by the first character of the
+ * child, replacing the binary search in r_find_child_by_first_character().
+ * @compile_value is called for each value stored in the tree, so that
+ * nested trees can be compiled as well.  Inserting nodes afterwards is
+ * allowed, the affected tables are simply dropped.
+ **/
+void
+r_compile_node(RNode *node, void (*compile_value)(gpointer value))
+{
+  gint i;
+
+  if (!node->child_table && node->num_children >= R_CHILD_TABLE_MIN_CHILDREN)
+    {
+      node->child_table = g_new0(RNode *, 256);
+      for (i = 0; i < node->num_children; i++)
+        {
+          guint8 first = node->children[i]->key[0];
+
+          if (!node->child_table[first])
+            node->child_table[first] = node->children[i];
+        }
+    }
+
+  for (i = 0; i < node->num_children; i++)
+    r_compile_node(node->children[i], compile_value);
+
+  for (i = 0; i < node->num_pchildren; i++)
+    r_compile_node(node->pchildren[i], compile_value);
+
+  if (node->value && compile_value)
+    compile_value(node->value);
+}
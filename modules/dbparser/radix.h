@@ -97,6 +97,10 @@ struct _RNode
 
   guint num_pchildren;
   RNode **pchildren;
+
+  /* children indexed by their first character, only built by
+   * r_compile_node() for nodes with a lot of children */
+  RNode **child_table;
 };
 
 typedef struct _RDebugInfo
@@ -152,6 +156,7 @@ void r_insert_node(RNode *root, guint8 *key, gpointer value, RNodeGetValueFunc v
 RNode *r_find_node(RNode *root, guint8 *key, gint keylen, GArray *matches);
 RNode *r_find_node_dbg(RNode *root, guint8 *key, gint keylen, GArray *matches, GArray *dbg_list);
 gchar **r_find_all_applicable_nodes(RNode *root, guint8 *key, gint keylen, RNodeGetValueFunc value_func);
+void r_compile_node(RNode *node, void (*compile_value)(gpointer value));
 
 #endif
 
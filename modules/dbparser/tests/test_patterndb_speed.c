@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "testutils.h"
+#include "apphook.h"
+#include "logmsg/logmsg.h"
+#include "messages.h"
+#include "patterndb.h"
+#include "plugin.h"
+#include "cfg.h"
+
+#include <string.h>
+#include <glib/gstdio.h>
+
+#define BENCHMARK_MESSAGES_TOTAL 800000
+#define BENCHMARK_CONTEXTS_PER_THREAD 64
+/* message time advances a second after this many messages in each thread,
+ * so that contexts expire and the set of live contexts remains bounded */
+#define BENCHMARK_MESSAGES_PER_SEC 100
+
+static gchar *pdb_benchmark = "<patterndb version='4' pub_date='2010-02-22'>\
+ <ruleset name='testset' id='1'>\
+  <patterns>\
+   <pattern>prog1</pattern>\
+  </patterns>\
+  <rule provider='test' id='1' class='system'>\
+   <patterns>\
+    <pattern>stateless message @NUMBER:num@</pattern>\
+   </patterns>\
+   <values>\
+    <value name='stateless'>${num}</value>\
+   </values>\
+  </rule>\
+  <rule provider='test' id='2' class='system' context-scope='process' context-id='$PID' context-timeout='5'>\
+   <patterns>\
+    <pattern>correllated message @NUMBER:num@</pattern>\
+   </patterns>\
+   <values>\
+    <value name='context-length'>$(context-length)</value>\
+   </values>\
+  </rule>\
+ </ruleset>\
+</patterndb>";
+
+static PatternDB *patterndb;
+static gint emitted_messages;
+static gboolean success = TRUE;
+
+typedef struct _BenchmarkThread
+{
+  GThread *thread;
+  gint id;
+  gint num_messages;
+  glong start_time;
+  const gchar *message;
+} BenchmarkThread;
+
+static void
+_emit_func(LogMessage *msg, gboolean synthetic, gpointer user_data)
+{
+  g_atomic_int_inc(&emitted_messages);
+}
+
+static gpointer
+_process_messages_thread(gpointer user_data)
+{
+  BenchmarkThread *self = (BenchmarkThread *) user_data;
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *msgs[BENCHMARK_CONTEXTS_PER_THREAD];
+  gchar buf[32];
+  gint i;
+
+  app_thread_start();
+  path_options.ack_needed = FALSE;
+  for (i = 0; i < BENCHMARK_CONTEXTS_PER_THREAD; i++)
+    {
+      msgs[i] = log_msg_new_empty();
+      log_msg_set_value(msgs[i], LM_V_PROGRAM, "prog1", -1);
+      log_msg_set_value(msgs[i], LM_V_HOST, "bzorp", -1);
+      g_snprintf(buf, sizeof(buf), "%d", self->id * BENCHMARK_CONTEXTS_PER_THREAD + i);
+      log_msg_set_value(msgs[i], LM_V_PID, buf, -1);
+      log_msg_set_value(msgs[i], LM_V_MESSAGE, self->message, -1);
+    }
+
+  for (i = 0; i < self->num_messages; i++)
+    {
+      LogMessage *msg = log_msg_clone_cow(msgs[i % BENCHMARK_CONTEXTS_PER_THREAD], &path_options);
+
+      msg->timestamps[LM_TS_STAMP].tv_sec = self->start_time + i / BENCHMARK_MESSAGES_PER_SEC;
+      if (!pattern_db_process(patterndb, msg))
+        success = FALSE;
+      log_msg_unref(msg);
+    }
+
+  for (i = 0; i < BENCHMARK_CONTEXTS_PER_THREAD; i++)
+    log_msg_unref(msgs[i]);
+  app_thread_stop();
+  return NULL;
+}
+
+static void
+_test_throughput(gint num_threads, const gchar *message)
+{
+  BenchmarkThread threads[num_threads];
+  GTimeVal now;
+  gint i;
+
+  pattern_db_forget_state(patterndb);
+  emitted_messages = 0;
+
+  g_get_current_time(&now);
+  start_stopwatch();
+  for (i = 0; i < num_threads; i++)
+    {
+      threads[i].id = i;
+      threads[i].num_messages = BENCHMARK_MESSAGES_TOTAL / num_threads;
+      /* messages from the past, so that the time of the correllation
+       * engine follows their timestamps */
+      threads[i].start_time = now.tv_sec - BENCHMARK_MESSAGES_TOTAL / BENCHMARK_MESSAGES_PER_SEC - 60;
+      threads[i].message = message;
+      threads[i].thread = g_thread_create(_process_messages_thread, &threads[i], TRUE, NULL);
+    }
+  for (i = 0; i < num_threads; i++)
+    g_thread_join(threads[i].thread);
+  stop_stopwatch_and_display_result(BENCHMARK_MESSAGES_TOTAL, "processing %d messages \"%s\" in %d threads took",
+                                    BENCHMARK_MESSAGES_TOTAL, message, num_threads);
+
+  if (emitted_messages != (BENCHMARK_MESSAGES_TOTAL / num_threads) * num_threads)
+    {
+      fprintf(stderr, "Number of emitted messages mismatch, emitted=%d\n", emitted_messages);
+      success = FALSE;
+    }
+}
+
+static void
+_load_pattern_db(const gchar *pdb)
+{
+  gchar *filename;
+
+  patterndb = pattern_db_new();
+  pattern_db_set_emit_func(patterndb, _emit_func, NULL);
+
+  g_file_open_tmp("patterndbXXXXXX.xml", &filename, NULL);
+  g_file_set_contents(filename, pdb, strlen(pdb), NULL);
+  if (!pattern_db_reload_ruleset(patterndb, configuration, filename))
+    {
+      fprintf(stderr, "Error loading ruleset [[[%s]]]\n", pdb);
+      success = FALSE;
+    }
+  g_unlink(filename);
+  g_free(filename);
+}
+
+int
+main(int argc, char *argv[])
+{
+  app_startup();
+  msg_init(TRUE);
+
+  configuration = cfg_new(0x0302);
+  plugin_load_module("basicfuncs", configuration, NULL);
+  plugin_load_module("syslogformat", configuration, NULL);
+  pattern_db_global_init();
+
+  _load_pattern_db(pdb_benchmark);
+
+  _test_throughput(1, "stateless message 1234");
+  _test_throughput(4, "stateless message 1234");
+  _test_throughput(16, "stateless message 1234");
+  _test_throughput(1, "correllated message 1234");
+  _test_throughput(4, "correllated message 1234");
+  _test_throughput(16, "correllated message 1234");
+
+  pattern_db_free(patterndb);
+  app_shutdown();
+  return !success;
+}
@@ -296,6 +296,45 @@ test_literals(void)
   r_free_node(root, NULL);
 }
 
+void
+test_compiled_tree(void)
+{
+  RNode *root = r_new_node("", NULL);
+
+  insert_node(root, "alma");
+  insert_node(root, "barack");
+  insert_node(root, "cseresznye");
+  insert_node(root, "dinnye");
+  insert_node(root, "eper");
+  insert_node(root, "fuge");
+  insert_node(root, "goji");
+  insert_node(root, "korte");
+  insert_node(root, "ko");
+  insert_node(root, "@STRING:str:.-@ string");
+  insert_node(root, "@NUMBER:num@ number");
+
+  r_compile_node(root, NULL);
+
+  test_search(root, "alma", TRUE);
+  test_search(root, "goji", TRUE);
+  test_search(root, "korte", TRUE);
+  test_search_value(root, "kort", "ko");
+  test_search(root, "mmm", FALSE);
+  test_search_matches(root, "foo-bar.baz string",
+                      "str", "foo-bar.baz",
+                      NULL);
+  test_search_matches(root, "-1234 number",
+                      "num", "-1234",
+                      NULL);
+
+  /* inserting after compilation drops the lookup table of the node */
+  insert_node(root, "hazelnut");
+  test_search(root, "hazelnut", TRUE);
+  test_search(root, "eper", TRUE);
+
+  r_free_node(root, NULL);
+}
+
 void
 test_parsers(void)
 {
@@ -910,6 +949,7 @@ main(int argc, char *argv[])
 
   test_literals();
   test_parsers();
+  test_compiled_tree();
 
   test_ip_matches();
   test_ipv4_matches();
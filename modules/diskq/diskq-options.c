@@ -76,6 +76,12 @@ disk_queue_options_mem_buf_length_set(DiskQueueOptions *self, gint mem_buf_lengt
   self->mem_buf_length = mem_buf_length;
 }
 
+void
+disk_queue_options_sync_interval_set(DiskQueueOptions *self, gint sync_interval)
+{
+  self->sync_interval = sync_interval;
+}
+
 void
 disk_queue_options_check_plugin_settings(DiskQueueOptions *self)
 {
@@ -92,6 +98,10 @@ disk_queue_options_check_plugin_settings(DiskQueueOptions *self)
         {
           msg_warning("WARNING: Non-reliable queue: the mem-buf-size parameter is omitted");
         }
+      if (self->sync_interval > 0)
+        {
+          msg_warning("WARNING: Non-reliable queue: the sync-interval parameter is omitted");
+        }
     }
 }
 
@@ -113,6 +123,7 @@ disk_queue_options_set_default_options(DiskQueueOptions *self)
   self->reliable = FALSE;
   self->mem_buf_size = -1;
   self->qout_size = -1;
+  self->sync_interval = 0;
   self->dir = g_strdup(get_installation_path_for(SYSLOG_NG_PATH_LOCALSTATEDIR));
 }
 
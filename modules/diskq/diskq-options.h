@@ -37,6 +37,7 @@ typedef struct _DiskQueueOptions
   gboolean reliable;
   gint mem_buf_size;
   gint mem_buf_length;
+  gint sync_interval;
   gchar *dir;
 } DiskQueueOptions;
 
@@ -45,6 +46,7 @@ void disk_queue_options_disk_buf_size_set(DiskQueueOptions *self, gint64 disk_bu
 void disk_queue_options_reliable_set(DiskQueueOptions *self, gboolean reliable);
 void disk_queue_options_mem_buf_size_set(DiskQueueOptions *self, gint mem_buf_size);
 void disk_queue_options_mem_buf_length_set(DiskQueueOptions *self, gint mem_buf_length);
+void disk_queue_options_sync_interval_set(DiskQueueOptions *self, gint sync_interval);
 void disk_queue_options_check_plugin_settings(DiskQueueOptions *self);
 void disk_queue_options_set_dir(DiskQueueOptions *self, const gchar *dir);
 void disk_queue_options_set_default_options(DiskQueueOptions *self);
@@ -37,6 +37,7 @@ static CfgLexerKeyword diskq_keywords[] =
   { "mem_buf_size",      KW_MEM_BUF_SIZE },
   { "qout_size",         KW_QOUT_SIZE },
   { "dir",               KW_DIR },
+  { "sync_interval",     KW_SYNC_INTERVAL },
   { NULL }
 };
 
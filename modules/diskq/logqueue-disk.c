@@ -29,6 +29,8 @@
 #include "stats/stats-registry.h"
 #include "reloc.h"
 #include "qdisk.h"
+#include "timeutils.h"
+#include "mainloop.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -199,6 +201,56 @@ log_queue_disk_is_reliable(LogQueue *s)
   return FALSE;
 }
 
+static void
+_arm_flush_timer(LogQueueDisk *self)
+{
+  if (iv_timer_registered(&self->flush_timer))
+    iv_timer_unregister(&self->flush_timer);
+
+  if (self->flush_interval <= 0)
+    return;
+
+  iv_validate_now();
+  self->flush_timer.expires = iv_now;
+  timespec_add_msec(&self->flush_timer.expires, self->flush_interval);
+  iv_timer_register(&self->flush_timer);
+}
+
+static void
+_flush_timer_expired(gpointer s)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+
+  g_static_mutex_lock(&self->super.lock);
+  if (qdisk_initialized(self->qdisk))
+    qdisk_flush(self->qdisk);
+  g_static_mutex_unlock(&self->super.lock);
+
+  _arm_flush_timer(self);
+}
+
+/* the flush timer writes out the records and the pending fdatasync() of an
+ * idle queue, it runs in the main thread */
+void
+log_queue_disk_start_flush_timer(LogQueue *s)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+
+  main_loop_assert_main_thread();
+  self->flush_interval = qdisk_initialized(self->qdisk) ? qdisk_get_flush_interval(self->qdisk) : 0;
+  _arm_flush_timer(self);
+}
+
+void
+log_queue_disk_stop_flush_timer(LogQueue *s)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+
+  main_loop_assert_main_thread();
+  if (iv_timer_registered(&self->flush_timer))
+    iv_timer_unregister(&self->flush_timer);
+}
+
 const gchar *
 log_queue_disk_get_filename(LogQueue *s)
 {
@@ -214,6 +266,8 @@ _free(LogQueue *s)
   if (self->free_fn)
     self->free_fn(self);
 
+  if (iv_timer_registered(&self->flush_timer))
+    iv_timer_unregister(&self->flush_timer);
   qdisk_deinit(self->qdisk);
   qdisk_free(self->qdisk);
   g_free(self);
@@ -337,6 +391,10 @@ log_queue_disk_init_instance(LogQueueDisk *self)
   log_queue_init_instance(&self->super,NULL);
   self->qdisk = qdisk_new();
 
+  IV_TIMER_INIT(&self->flush_timer);
+  self->flush_timer.cookie = self;
+  self->flush_timer.handler = _flush_timer_expired;
+
   self->super.get_length = _get_length;
   self->super.push_tail = _push_tail;
   self->super.push_head = _push_head;
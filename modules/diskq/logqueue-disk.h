@@ -29,6 +29,8 @@
 #include "qdisk.h"
 #include "logmsg/logmsg-serialize.h"
 
+#include <iv.h>
+
 typedef struct _LogQueueDisk LogQueueDisk;
 
 #define LOG_PATH_OPTIONS_FOR_BACKLOG GINT_TO_POINTER(0x80000000)
@@ -37,6 +39,8 @@ struct _LogQueueDisk
 {
   LogQueue super;
   QDisk *qdisk;         /* disk based queue */
+  struct iv_timer flush_timer;
+  gint flush_interval;
   gint64 (*get_length)(LogQueueDisk *s);
   gboolean (*push_tail)(LogQueueDisk *s, LogMessage *msg, LogPathOptions *local_options, const LogPathOptions *path_options);
   void (*push_head)(LogQueueDisk *s, LogMessage *msg, const LogPathOptions *path_options);
@@ -60,6 +64,8 @@ gboolean log_queue_disk_is_reliable(LogQueue *s);
 const gchar *log_queue_disk_get_filename(LogQueue *self);
 gboolean log_queue_disk_save_queue(LogQueue *self, gboolean *persistent);
 gboolean log_queue_disk_load_queue(LogQueue *self, const gchar *filename);
+void log_queue_disk_start_flush_timer(LogQueue *self);
+void log_queue_disk_stop_flush_timer(LogQueue *self);
 void log_queue_disk_init_instance(LogQueueDisk *self);
 
 #endif
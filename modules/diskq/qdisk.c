@@ -28,6 +28,7 @@
 #include "logmsg/logmsg-serialize.h"
 #include "stats/stats-registry.h"
 #include "reloc.h"
+#include "timeutils.h"
 #include "compat/lfs.h"
 
 #include <fcntl.h>
@@ -36,6 +37,7 @@
 #include <errno.h>
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 /* MADV_RANDOM not defined on legacy Linux systems. Could be removed in the
  * future, when support for Glibc 2.1.X drops.*/
@@ -48,6 +50,16 @@
 
 #define PATH_QDISK              PATH_LOCALSTATEDIR
 
+/* records of a non-reliable queue are collected into a buffer of this size
+ * before being written out, pops are served from a read-ahead buffer of
+ * QDISK_READ_AHEAD_SIZE bytes */
+#define QDISK_WRITE_BATCH_SIZE  (64 * 1024)
+#define QDISK_READ_AHEAD_SIZE   (64 * 1024)
+
+/* buffered records of an idle non-reliable queue are written out after at
+ * most this many msecs */
+#define QDISK_FLUSH_INTERVAL    1000
+
 typedef union _QDiskFileHeader
 {
   struct
@@ -76,6 +88,8 @@ typedef union _QDiskFileHeader
   gchar _pad2[QDISK_RESERVED_SPACE];
 } QDiskFileHeader;
 
+#define QDISK_HEADER_FIELDS_SIZE (G_STRUCT_OFFSET(QDiskFileHeader, backlog_len) + sizeof(gint64))
+
 struct _QDisk
 {
   gchar *filename;
@@ -86,7 +100,23 @@ struct _QDisk
   gint64 prev_length;
   gint64 file_size;
   QDiskFileHeader *hdr;
+  /* non-reliable queues work on an in-memory copy of the header, the
+   * mapped one never covers records still sitting in write_buffer */
+  QDiskFileHeader *mapped_hdr;
   DiskQueueOptions *options;
+
+  /* records pushed but not yet written to the file, starting at write_buffer_ofs */
+  GString *write_buffer;
+  gint64 write_buffer_ofs;
+  gint64 write_buffer_records;
+
+  /* a copy of the file contents at [read_buffer_ofs, read_buffer_ofs + read_buffer_len) */
+  gchar *read_buffer;
+  gint64 read_buffer_ofs;
+  gsize read_buffer_len;
+
+  GTimeVal last_sync;
+  gboolean sync_pending;
 };
 
 static gboolean
@@ -108,6 +138,220 @@ pwrite_strict(gint fd, const void *buf, size_t count, off_t offset)
   return result;
 }
 
+static gboolean
+pwritev_strict(gint fd, struct iovec *iov, gint iovcnt, off_t offset)
+{
+#if SYSLOG_NG_HAVE_PWRITEV
+  size_t count = 0;
+  ssize_t written;
+  gint i;
+
+  for (i = 0; i < iovcnt; i++)
+    count += iov[i].iov_len;
+
+  written = pwritev(fd, iov, iovcnt, offset);
+  if (written != count)
+    {
+      if (written != -1)
+        {
+          msg_error("Short written",
+                    evt_tag_int("Number of bytes want to write", count),
+                    evt_tag_int("Number of bytes written", written));
+          errno = ENOSPC;
+        }
+      return FALSE;
+    }
+  return TRUE;
+#else
+  gint i;
+
+  for (i = 0; i < iovcnt; i++)
+    {
+      if (!pwrite_strict(fd, iov[i].iov_base, iov[i].iov_len, offset))
+        return FALSE;
+      offset += iov[i].iov_len;
+    }
+  return TRUE;
+#endif
+}
+
+static inline gboolean
+_ranges_overlap(gint64 ofs1, gsize len1, gint64 ofs2, gsize len2)
+{
+  return ofs1 < ofs2 + (gint64) len2 && ofs2 < ofs1 + (gint64) len1;
+}
+
+static inline void
+_invalidate_read_buffer(QDisk *self)
+{
+  self->read_buffer_len = 0;
+}
+
+/* copy the in-memory header to the file, the write head and the length
+ * only include records that have already been written */
+static void
+_publish_header(QDisk *self)
+{
+  if (!self->mapped_hdr || self->mapped_hdr == self->hdr)
+    return;
+
+  memcpy(self->mapped_hdr, self->hdr, QDISK_HEADER_FIELDS_SIZE);
+  if (self->write_buffer->len > 0)
+    {
+      self->mapped_hdr->write_head = self->write_buffer_ofs;
+      self->mapped_hdr->length = self->hdr->length - self->write_buffer_records;
+    }
+}
+
+static void
+_release_header(QDisk *self)
+{
+  if (self->hdr != self->mapped_hdr)
+    g_free(self->hdr);
+  if (self->mapped_hdr)
+    munmap((void *)self->mapped_hdr, sizeof(QDiskFileHeader));
+  self->hdr = NULL;
+  self->mapped_hdr = NULL;
+}
+
+static gboolean
+_flush_write_buffer(QDisk *self)
+{
+  gboolean success;
+
+  if (self->write_buffer->len == 0)
+    return TRUE;
+
+  success = pwrite_strict(self->fd, self->write_buffer->str, self->write_buffer->len, self->write_buffer_ofs);
+  if (!success)
+    msg_error("Error writing disk-queue file",
+              evt_tag_errno("error", errno),
+              evt_tag_str("filename", self->filename));
+  g_string_truncate(self->write_buffer, 0);
+  self->write_buffer_records = 0;
+  if (success)
+    _publish_header(self);
+  return success;
+}
+
+static void
+_sync_file(QDisk *self)
+{
+#if SYSLOG_NG_HAVE_FDATASYNC
+  if (fdatasync(self->fd) < 0)
+#else
+  if (fsync(self->fd) < 0)
+#endif
+    msg_error("Error syncing disk-queue file",
+              evt_tag_errno("error", errno),
+              evt_tag_str("filename", self->filename));
+  g_get_current_time(&self->last_sync);
+  self->sync_pending = FALSE;
+}
+
+/* group commit: records written within sync-interval() share a single
+ * fdatasync(), the file is synced at the first write after the interval
+ * has elapsed and when the queue is saved */
+static void
+_sync_file_if_needed(QDisk *self)
+{
+  GTimeVal now;
+
+  if (self->options->sync_interval <= 0)
+    return;
+
+  self->sync_pending = TRUE;
+  g_get_current_time(&now);
+  if (g_time_val_diff(&now, &self->last_sync) >= (glong) self->options->sync_interval * 1000)
+    _sync_file(self);
+}
+
+static gboolean
+_write_record(QDisk *self, GString *record)
+{
+  guint32 n = GUINT32_TO_BE(record->len);
+  gsize record_size = record->len + sizeof(n);
+
+  if (self->read_buffer_len &&
+      _ranges_overlap(self->hdr->write_head, record_size, self->read_buffer_ofs, self->read_buffer_len))
+    _invalidate_read_buffer(self);
+
+  if (self->options->reliable)
+    {
+      struct iovec iov[2] =
+      {
+        { .iov_base = (gchar *) &n, .iov_len = sizeof(n) },
+        { .iov_base = record->str, .iov_len = record->len },
+      };
+
+      if (!pwritev_strict(self->fd, iov, 2, self->hdr->write_head))
+        {
+          msg_error("Error writing disk-queue file",
+                    evt_tag_errno("error", errno));
+          return FALSE;
+        }
+      _sync_file_if_needed(self);
+      return TRUE;
+    }
+
+  /* the batch must stay contiguous in the file, it is flushed when the
+   * write head wraps around */
+  if (self->write_buffer->len > 0 &&
+      self->write_buffer_ofs + self->write_buffer->len != self->hdr->write_head)
+    {
+      if (!_flush_write_buffer(self))
+        return FALSE;
+    }
+
+  if (self->write_buffer->len == 0)
+    self->write_buffer_ofs = self->hdr->write_head;
+
+  g_string_append_len(self->write_buffer, (gchar *) &n, sizeof(n));
+  g_string_append_len(self->write_buffer, record->str, record->len);
+  self->write_buffer_records++;
+
+  if (self->write_buffer->len >= QDISK_WRITE_BATCH_SIZE)
+    return _flush_write_buffer(self);
+  return TRUE;
+}
+
+/* pread() like interface on top of the read-ahead buffer, records not yet
+ * flushed are written out first */
+static gssize
+_read_at(QDisk *self, gchar *buffer, gsize len, gint64 position)
+{
+  gssize res;
+
+  if (self->read_buffer_len &&
+      position >= self->read_buffer_ofs &&
+      position + len <= self->read_buffer_ofs + self->read_buffer_len)
+    {
+      memcpy(buffer, self->read_buffer + (position - self->read_buffer_ofs), len);
+      return len;
+    }
+
+  if (self->write_buffer->len &&
+      _ranges_overlap(position, MAX(len, QDISK_READ_AHEAD_SIZE), self->write_buffer_ofs, self->write_buffer->len))
+    {
+      if (!_flush_write_buffer(self))
+        return -1;
+    }
+
+  if (len > QDISK_READ_AHEAD_SIZE)
+    return pread(self->fd, buffer, len, position);
+
+  _invalidate_read_buffer(self);
+  res = pread(self->fd, self->read_buffer, QDISK_READ_AHEAD_SIZE, position);
+  if (res <= 0)
+    return res;
+
+  self->read_buffer_ofs = position;
+  self->read_buffer_len = res;
+
+  res = MIN(res, len);
+  memcpy(buffer, self->read_buffer, res);
+  return res;
+}
 
 static gboolean
 _is_position_eof(QDisk *self, gint64 position)
@@ -202,6 +446,7 @@ _truncate_file(QDisk *self, gint64 new_size)
 {
   gboolean success = TRUE;
 
+  _invalidate_read_buffer(self);
   if (ftruncate(self->fd, (glong)new_size) < 0)
     {
       success = FALSE;
@@ -237,13 +482,8 @@ qdisk_push_tail(QDisk *self, GString *record)
       return FALSE;
     }
 
-  if (!pwrite_strict(self->fd, (gchar *) &n, sizeof(n), self->hdr->write_head) ||
-      !pwrite_strict(self->fd, record->str, record->len, self->hdr->write_head + sizeof(n)))
-    {
-      msg_error("Error writing disk-queue file",
-                evt_tag_errno("error", errno));
-      return FALSE;
-    }
+  if (!_write_record(self, record))
+    return FALSE;
 
   self->hdr->write_head = self->hdr->write_head + record->len + sizeof(n);
 
@@ -291,6 +531,7 @@ qdisk_push_tail(QDisk *self, GString *record)
         }
     }
   self->hdr->length++;
+  _publish_header(self);
   return TRUE;
 }
 
@@ -301,13 +542,13 @@ qdisk_pop_head(QDisk *self, GString *record)
     {
       guint32 n;
       gssize res;
-      res = pread(self->fd, (gchar *) &n, sizeof(n), self->hdr->read_head);
+      res = _read_at(self, (gchar *) &n, sizeof(n), self->hdr->read_head);
 
       if (res == 0)
         {
           /* hmm, we are either at EOF or at hdr->qout_ofs, we need to wrap */
           self->hdr->read_head = QDISK_RESERVED_SPACE;
-          res = pread(self->fd, (gchar *) &n, sizeof(n), self->hdr->read_head);
+          res = _read_at(self, (gchar *) &n, sizeof(n), self->hdr->read_head);
         }
       if (res != sizeof(n))
         {
@@ -334,7 +575,7 @@ qdisk_pop_head(QDisk *self, GString *record)
         }
 
       g_string_set_size(record, n);
-      res = pread(self->fd, record->str, n, self->hdr->read_head + sizeof(n));
+      res = _read_at(self, record->str, n, self->hdr->read_head + sizeof(n));
       if (res != n)
         {
           msg_error("Error reading disk-queue file",
@@ -370,6 +611,7 @@ qdisk_pop_head(QDisk *self, GString *record)
           self->hdr->length = 0;
           _truncate_file(self, self->hdr->write_head);
         }
+      _publish_header(self);
       return TRUE;
 
     }
@@ -602,6 +844,12 @@ qdisk_save_state(QDisk *self, GQueue *qout, GQueue *qbacklog, GQueue *qoverflow)
   gint32 qoverflow_len = 0;
   gint32 qoverflow_count = 0;
 
+  if (!_flush_write_buffer(self))
+    return FALSE;
+
+  if (self->sync_pending)
+    _sync_file(self);
+
   if (!self->options->reliable)
     {
       qout_count = qout->length / 2;
@@ -627,6 +875,7 @@ qdisk_save_state(QDisk *self, GQueue *qout, GQueue *qbacklog, GQueue *qoverflow)
   self->hdr->qoverflow_ofs = qoverflow_ofs;
   self->hdr->qoverflow_len = qoverflow_len;
   self->hdr->qoverflow_count = qoverflow_count;
+  _publish_header(self);
 
   if (!self->options->reliable)
     msg_info("Disk-buffer state saved",
@@ -679,6 +928,10 @@ qdisk_start(QDisk *self, const gchar *filename, GQueue *qout, GQueue *qbacklog,
     }
 
   self->filename = g_strdup(filename);
+  g_string_truncate(self->write_buffer, 0);
+  _invalidate_read_buffer(self);
+  self->sync_pending = FALSE;
+  g_get_current_time(&self->last_sync);
   /* assumes self is zero initialized */
   openflags = self->options->read_only ? (O_RDONLY | O_LARGEFILE) : (O_RDWR | O_LARGEFILE | (new_file ? O_CREAT : 0));
 
@@ -713,9 +966,15 @@ qdisk_start(QDisk *self, const gchar *filename, GQueue *qout, GQueue *qbacklog,
       munmap(p, sizeof(QDiskFileHeader) );
       p = NULL;
     }
+  else if (!self->options->reliable)
+    {
+      self->mapped_hdr = p;
+      self->hdr = g_new(QDiskFileHeader, 1);
+      memcpy(self->hdr, p, sizeof(QDiskFileHeader));
+    }
   else
     {
-      self->hdr = p;
+      self->hdr = self->mapped_hdr = p;
     }
   /* initialize new file */
 
@@ -727,8 +986,7 @@ qdisk_start(QDisk *self, const gchar *filename, GQueue *qout, GQueue *qbacklog,
         {
           msg_error("Error occured while initalizing the new queue file",evt_tag_str("filename",self->filename),
                     evt_tag_errno("error",errno));
-          munmap((void *)self->hdr, sizeof(QDiskFileHeader));
-          self->hdr = NULL;
+          _release_header(self);
           close(self->fd);
           self->fd = -1;
           return FALSE;
@@ -743,8 +1001,7 @@ qdisk_start(QDisk *self, const gchar *filename, GQueue *qout, GQueue *qbacklog,
 
       if (!qdisk_save_state(self, qout, qbacklog, qoverflow))
         {
-          munmap((void *)self->hdr, sizeof(QDiskFileHeader));
-          self->hdr = NULL;
+          _release_header(self);
           close(self->fd);
           self->fd = -1;
           return FALSE;
@@ -760,8 +1017,7 @@ qdisk_start(QDisk *self, const gchar *filename, GQueue *qout, GQueue *qbacklog,
                     evt_tag_str("filename", self->filename),
                     evt_tag_errno("fstat error", errno),
                     evt_tag_int("size", st.st_size));
-          munmap((void *)self->hdr, sizeof(QDiskFileHeader));
-          self->hdr = NULL;
+          _release_header(self);
           close(self->fd);
           self->fd = -1;
           return FALSE;
@@ -794,17 +1050,38 @@ qdisk_start(QDisk *self, const gchar *filename, GQueue *qout, GQueue *qbacklog,
         }
       if (!_load_state(self, qout, qbacklog, qoverflow))
         {
-          munmap((void *)self->hdr, sizeof(QDiskFileHeader));
-          self->hdr = NULL;
+          _release_header(self);
           close(self->fd);
           self->fd = -1;
           return FALSE;
         }
-
+      _publish_header(self);
     }
   return TRUE;
 }
 
+/* write out the buffered records and perform a pending group commit, an
+ * idle queue would otherwise keep them until the next push */
+void
+qdisk_flush(QDisk *self)
+{
+  if (self->fd == -1)
+    return;
+
+  _flush_write_buffer(self);
+  if (self->sync_pending)
+    _sync_file(self);
+}
+
+/* msec between two qdisk_flush() calls, 0 if there is nothing to flush */
+gint
+qdisk_get_flush_interval(QDisk *self)
+{
+  if (!self->options->reliable)
+    return QDISK_FLUSH_INTERVAL;
+  return MAX(self->options->sync_interval, 0);
+}
+
 void
 qdisk_init(QDisk *self, DiskQueueOptions *options)
 {
@@ -825,6 +1102,14 @@ qdisk_init(QDisk *self, DiskQueueOptions *options)
 void
 qdisk_deinit(QDisk *self)
 {
+  if (self->fd != -1)
+    {
+      _flush_write_buffer(self);
+      if (self->sync_pending)
+        _sync_file(self);
+    }
+  _invalidate_read_buffer(self);
+
   if (self->filename)
     {
       g_free(self->filename);
@@ -832,13 +1117,7 @@ qdisk_deinit(QDisk *self)
     }
 
   if (self->hdr)
-    {
-      if (self->options->read_only)
-        g_free(self->hdr);
-      else
-        munmap((void *)self->hdr, sizeof(QDiskFileHeader));
-      self->hdr = NULL;
-    }
+    _release_header(self);
 
   if (self->fd != -1)
     {
@@ -853,11 +1132,11 @@ gssize
 qdisk_read_from_backlog(QDisk *self, gpointer buffer, gsize bytes_to_read)
 {
   gssize res;
-  res = pread(self->fd, buffer, bytes_to_read, self->hdr->backlog_head);
+  res = _read_at(self, buffer, bytes_to_read, self->hdr->backlog_head);
   if (res == 0)
     {
       self->hdr->backlog_head = QDISK_RESERVED_SPACE;
-      res = pread(self->fd, buffer, bytes_to_read, self->hdr->backlog_head);
+      res = _read_at(self, buffer, bytes_to_read, self->hdr->backlog_head);
     }
   if (res != bytes_to_read)
     {
@@ -876,7 +1155,7 @@ gssize
 qdisk_read(QDisk *self, gpointer buffer, gsize bytes_to_read, gint64 position)
 {
   gssize res;
-  res = pread(self->fd, buffer, bytes_to_read, position);
+  res = _read_at(self, buffer, bytes_to_read, position);
   if (res <= 0)
     {
       msg_error("Error reading disk-queue file",
@@ -1006,6 +1285,8 @@ qdisk_is_read_only(QDisk *self)
 void
 qdisk_free(QDisk *self)
 {
+  g_string_free(self->write_buffer, TRUE);
+  g_free(self->read_buffer);
   g_free(self);
 }
 
@@ -1013,6 +1294,9 @@ QDisk *
 qdisk_new()
 {
   QDisk *self = g_new0(QDisk, 1);
+
+  self->write_buffer = g_string_sized_new(QDISK_WRITE_BATCH_SIZE);
+  self->read_buffer = g_malloc(QDISK_READ_AHEAD_SIZE);
   return self;
 }
 
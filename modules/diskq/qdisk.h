@@ -48,6 +48,8 @@ void qdisk_init(QDisk *self, DiskQueueOptions *options);
 void qdisk_deinit(QDisk *self);
 void qdisk_reset_file_if_possible(QDisk *self);
 gboolean qdisk_initialized(QDisk *self);
+void qdisk_flush(QDisk *self);
+gint qdisk_get_flush_interval(QDisk *self);
 void qdisk_free(QDisk *self);
 
 gboolean qdisk_save_state(QDisk *self, GQueue *qout, GQueue *qbacklog, GQueue *qoverflow);
@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2002-2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "qdisk.h"
+#include "apphook.h"
+#include "timeutils.h"
+#include "test_diskq_tools.h"
+#include "testutils.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define FILENAME "test_qdisk_speed.qf"
+#define NUM_RECORDS 200000
+#define RECORD_SIZE 300
+
+static gboolean success = TRUE;
+static GQueue *qout, *qbacklog, *qoverflow;
+
+static void
+_format_record(GString *record, gint i)
+{
+  g_string_printf(record, "%08d", i);
+  while (record->len < RECORD_SIZE)
+    g_string_append_c(record, 'a' + (record->len % 26));
+}
+
+static void
+_report(const gchar *name, gint num, GTimeVal *start)
+{
+  GTimeVal end;
+  glong diff;
+
+  g_get_current_time(&end);
+  diff = g_time_val_diff(&end, start);
+  printf("%-50.50s speed: %12.3f msg/sec\n", name, num * 1e6 / diff);
+}
+
+static void
+_push_records(QDisk *qdisk, gint num, const gchar *name)
+{
+  GString *record = g_string_sized_new(RECORD_SIZE);
+  GTimeVal start;
+  gint i;
+
+  g_get_current_time(&start);
+  for (i = 0; i < num; i++)
+    {
+      _format_record(record, i);
+      if (!qdisk_push_tail(qdisk, record))
+        {
+          fprintf(stderr, "Error pushing record, i=%d\n", i);
+          success = FALSE;
+          break;
+        }
+    }
+  _report(name, num, &start);
+  g_string_free(record, TRUE);
+}
+
+static void
+_pop_records(QDisk *qdisk, gint num, const gchar *name)
+{
+  GString *record = g_string_sized_new(RECORD_SIZE);
+  GString *expected = g_string_sized_new(RECORD_SIZE);
+  GTimeVal start;
+  gint i;
+
+  g_get_current_time(&start);
+  for (i = 0; i < num; i++)
+    {
+      if (!qdisk_pop_head(qdisk, record))
+        {
+          fprintf(stderr, "Error popping record, i=%d\n", i);
+          success = FALSE;
+          break;
+        }
+      _format_record(expected, i);
+      if (strcmp(record->str, expected->str) != 0)
+        {
+          fprintf(stderr, "Record mismatch, i=%d, record=%s\n", i, record->str);
+          success = FALSE;
+          break;
+        }
+    }
+  _report(name, num, &start);
+  g_string_free(expected, TRUE);
+  g_string_free(record, TRUE);
+}
+
+static void
+_test_push_pop(gboolean reliable)
+{
+  DiskQueueOptions options;
+  QDisk *qdisk = qdisk_new();
+
+  _construct_options(&options, 1024 * 1024 * 1024, 0, reliable);
+  qdisk_init(qdisk, &options);
+  unlink(FILENAME);
+  assert_true(qdisk_start(qdisk, FILENAME, qout, qbacklog, qoverflow), "Error starting disk queue");
+
+  _push_records(qdisk, NUM_RECORDS, reliable ? "reliable push" : "non-reliable push");
+  _pop_records(qdisk, NUM_RECORDS, reliable ? "reliable pop" : "non-reliable pop");
+
+  qdisk_deinit(qdisk);
+  qdisk_free(qdisk);
+  unlink(FILENAME);
+}
+
+static void
+_test_replay(void)
+{
+  DiskQueueOptions options;
+  QDisk *qdisk = qdisk_new();
+
+  _construct_options(&options, 1024 * 1024 * 1024, 0, FALSE);
+  qdisk_init(qdisk, &options);
+  unlink(FILENAME);
+  assert_true(qdisk_start(qdisk, FILENAME, qout, qbacklog, qoverflow), "Error starting disk queue");
+  _push_records(qdisk, NUM_RECORDS, "non-reliable push before replay");
+  assert_true(qdisk_save_state(qdisk, qout, qbacklog, qoverflow), "Error saving disk queue state");
+  qdisk_deinit(qdisk);
+
+  qdisk_init(qdisk, &options);
+  assert_true(qdisk_start(qdisk, FILENAME, qout, qbacklog, qoverflow), "Error restarting disk queue");
+  _pop_records(qdisk, NUM_RECORDS, "non-reliable replay");
+
+  qdisk_deinit(qdisk);
+  qdisk_free(qdisk);
+  unlink(FILENAME);
+}
+
+/* the record layout used by the disk queue, written/read with one syscall
+ * for the length and one for the payload */
+static void
+_test_unbatched_io(void)
+{
+  GString *record = g_string_sized_new(RECORD_SIZE);
+  GTimeVal start;
+  gint64 pos;
+  guint32 n;
+  gint fd, i;
+
+  unlink(FILENAME);
+  fd = open(FILENAME, O_RDWR | O_CREAT, 0600);
+  assert_true(fd >= 0, "Error opening file");
+
+  g_get_current_time(&start);
+  for (i = 0, pos = QDISK_RESERVED_SPACE; i < NUM_RECORDS; i++)
+    {
+      _format_record(record, i);
+      n = GUINT32_TO_BE(record->len);
+      if (pwrite(fd, &n, sizeof(n), pos) != sizeof(n) ||
+          pwrite(fd, record->str, record->len, pos + sizeof(n)) != record->len)
+        success = FALSE;
+      pos += sizeof(n) + record->len;
+    }
+  _report("unbatched push (two pwrite() per record)", NUM_RECORDS, &start);
+
+  g_get_current_time(&start);
+  for (i = 0, pos = QDISK_RESERVED_SPACE; i < NUM_RECORDS; i++)
+    {
+      if (pread(fd, &n, sizeof(n), pos) != sizeof(n))
+        success = FALSE;
+      n = GUINT32_FROM_BE(n);
+      g_string_set_size(record, n);
+      if (pread(fd, record->str, n, pos + sizeof(n)) != n)
+        success = FALSE;
+      pos += sizeof(n) + n;
+    }
+  _report("unbatched pop (two pread() per record)", NUM_RECORDS, &start);
+
+  close(fd);
+  unlink(FILENAME);
+  g_string_free(record, TRUE);
+}
+
+int
+main(int argc, char *argv[])
+{
+  app_startup();
+  qout = g_queue_new();
+  qbacklog = g_queue_new();
+  qoverflow = g_queue_new();
+
+  _test_unbatched_io();
+  _test_push_pop(FALSE);
+  _test_push_pop(TRUE);
+  _test_replay();
+
+  g_queue_free(qout);
+  g_queue_free(qbacklog);
+  g_queue_free(qoverflow);
+  app_shutdown();
+  return !success;
+}
@@ -38,6 +38,12 @@ static CfgLexerKeyword http_keywords[] =
   { "headers",      KW_HEADERS },
   { "method",       KW_METHOD },
   { "body",         KW_BODY },
+  { "batch_lines",  KW_BATCH_LINES },
+  { "batch_bytes",  KW_BATCH_BYTES },
+  { "batch_timeout", KW_BATCH_TIMEOUT },
+  { "body_prefix",  KW_BODY_PREFIX },
+  { "body_suffix",  KW_BODY_SUFFIX },
+  { "delimiter",    KW_DELIMITER },
   { NULL }
 };
 
@@ -26,13 +26,23 @@
 #define HTTP_DEFAULT_URL "http://localhost/"
 #define METHOD_TYPE_POST 1
 #define METHOD_TYPE_PUT  2
+#define HTTP_MAX_WORKERS 64
 
 #include "logthrdestdrv.h"
 
+#include <curl/curl.h>
+
+/* per worker thread state, indexed by LogThrDestWorker.worker_index */
+typedef struct
+{
+  CURL *curl;
+  GString *request_body;
+  struct curl_slist *request_headers;
+} HTTPDestinationWorker;
+
 typedef struct
 {
   LogThrDestDriver super;
-  gchar *curl;
   gchar *url;
   gchar *user;
   gchar *password;
@@ -41,6 +51,15 @@ typedef struct
   short int method_type;
   LogTemplate *body_template;
   LogTemplateOptions template_options;
+
+  /* batching */
+  gint batch_lines;
+  gint batch_bytes;
+  gchar *body_prefix;
+  gchar *body_suffix;
+  gchar *delimiter;
+
+  HTTPDestinationWorker *http_workers;
 } HTTPDestinationDriver;
 
 gboolean http_dd_init(LogPipe *s);
@@ -53,6 +72,11 @@ void http_dd_set_method(LogDriver *d, const gchar *method);
 void http_dd_set_user_agent(LogDriver *d, const gchar *user_agent);
 void http_dd_set_headers(LogDriver *d, GList *headers);
 void http_dd_set_body(LogDriver *d, LogTemplate *body);
+void http_dd_set_batch_lines(LogDriver *d, gint batch_lines);
+void http_dd_set_batch_bytes(LogDriver *d, gint batch_bytes);
+void http_dd_set_body_prefix(LogDriver *d, const gchar *body_prefix);
+void http_dd_set_body_suffix(LogDriver *d, const gchar *body_suffix);
+void http_dd_set_delimiter(LogDriver *d, const gchar *delimiter);
 LogTemplateOptions *http_dd_get_template_options(LogDriver *d);
 
 #endif
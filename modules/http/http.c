@@ -58,38 +58,112 @@ _http_write_cb(char *ptr, size_t size, size_t nmemb, void *userdata)
   return nmemb * size;
 }
 
+static gboolean
+_is_batching_enabled(HTTPDestinationDriver *self)
+{
+  return self->batch_lines > 1 || self->batch_bytes > 0;
+}
+
+static HTTPDestinationWorker *
+_get_current_http_worker(HTTPDestinationDriver *self)
+{
+  LogThrDestWorker *worker = log_threaded_dest_driver_get_current_worker(&self->super);
+
+  return &self->http_workers[worker->worker_index];
+}
+
+static gint
+_get_current_batch_size(HTTPDestinationDriver *self)
+{
+  return log_threaded_dest_driver_get_current_worker(&self->super)->batch.size;
+}
+
+/*
+ * The handle is set up only once: libcurl keeps the connection cache in
+ * the easy handle, so reusing it (instead of resetting it for every
+ * request) lets consecutive requests go through the same keep-alive
+ * connection.
+ */
+static void
+_setup_static_options_in_curl(HTTPDestinationDriver *self, CURL *curl)
+{
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, _http_write_cb);
+
+  curl_easy_setopt(curl, CURLOPT_URL, self->url);
+
+  if (self->user)
+    curl_easy_setopt(curl, CURLOPT_USERNAME, self->user);
+
+  if (self->password)
+    curl_easy_setopt(curl, CURLOPT_PASSWORD, self->password);
+
+  if (self->user_agent)
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, self->user_agent);
+
+  if (self->method_type == METHOD_TYPE_PUT)
+    curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
+}
+
 static void
 _thread_init(LogThrDestDriver *s)
 {
   HTTPDestinationDriver *self = (HTTPDestinationDriver *) s;
+  HTTPDestinationWorker *worker = _get_current_http_worker(self);
 
-  curl_version_info_data *curl_info = curl_version_info(CURLVERSION_NOW);
-  if (!self->user_agent)
-    self->user_agent = g_strdup_printf("syslog-ng %s/libcurl %s",
-                                       SYSLOG_NG_VERSION, curl_info->version);
+  if (!(worker->curl = curl_easy_init()))
+    {
+      msg_error("curl: cannot initialize libcurl",
+                evt_tag_str("driver", self->super.super.super.id));
+      return;
+    }
+
+  worker->request_body = g_string_sized_new(4096);
+  _setup_static_options_in_curl(self, worker->curl);
 }
 
 static void
 _thread_deinit(LogThrDestDriver *s)
 {
+  HTTPDestinationDriver *self = (HTTPDestinationDriver *) s;
+  HTTPDestinationWorker *worker = _get_current_http_worker(self);
+
+  if (worker->curl)
+    curl_easy_cleanup(worker->curl);
+  worker->curl = NULL;
+
+  if (worker->request_body)
+    g_string_free(worker->request_body, TRUE);
+  worker->request_body = NULL;
 }
 
 static gboolean
 _connect(LogThrDestDriver *s)
 {
-  return TRUE;
+  HTTPDestinationDriver *self = (HTTPDestinationDriver *) s;
+
+  return _get_current_http_worker(self)->curl != NULL;
+}
+
+static void
+_reset_request(HTTPDestinationWorker *worker)
+{
+  if (worker->request_body)
+    g_string_truncate(worker->request_body, 0);
+  curl_slist_free_all(worker->request_headers);
+  worker->request_headers = NULL;
 }
 
 static void
 _disconnect(LogThrDestDriver *s)
 {
+  HTTPDestinationDriver *self = (HTTPDestinationDriver *) s;
+
+  _reset_request(_get_current_http_worker(self));
 }
 
 static struct curl_slist *
-_get_curl_headers(HTTPDestinationDriver *self, LogMessage *msg)
+_append_message_headers(struct curl_slist *curl_headers, LogMessage *msg)
 {
-  GList *header = NULL;
-  struct curl_slist *curl_headers = NULL;
   gchar header_host[128] = {0};
   gchar header_program[32] = {0};
   gchar header_facility[32] = {0};
@@ -111,6 +185,22 @@ _get_curl_headers(HTTPDestinationDriver *self, LogMessage *msg)
              "X-Syslog-Level: %s", syslog_name_lookup_name_by_value(msg->pri & LOG_PRIMASK, sl_levels));
   curl_headers = curl_slist_append(curl_headers, header_level);
 
+  return curl_headers;
+}
+
+/*
+ * The X-Syslog-* headers describe a single message, so they are only sent
+ * if every request carries exactly one message.
+ */
+static struct curl_slist *
+_get_curl_headers(HTTPDestinationDriver *self, LogMessage *msg)
+{
+  GList *header = NULL;
+  struct curl_slist *curl_headers = NULL;
+
+  if (!_is_batching_enabled(self))
+    curl_headers = _append_message_headers(curl_headers, msg);
+
   header = self->headers;
   while (header != NULL)
     {
@@ -121,79 +211,121 @@ _get_curl_headers(HTTPDestinationDriver *self, LogMessage *msg)
   return curl_headers;
 }
 
-static GString *
-_get_body_rendered(HTTPDestinationDriver *self, LogMessage *msg)
+static void
+_append_body_rendered(HTTPDestinationDriver *self, HTTPDestinationWorker *worker, LogMessage *msg)
 {
-  GString *body_rendered = NULL;
-
   if (self->body_template)
     {
-      body_rendered = g_string_new(NULL);
-      log_template_format(self->body_template, msg, &self->template_options, LTZ_SEND,
-                          self->super.seq_num, NULL, body_rendered);
+      LogThrDestWorker *thr_worker = log_threaded_dest_driver_get_current_worker(&self->super);
+
+      log_template_append_format(self->body_template, msg, &self->template_options, LTZ_SEND,
+                                 *thr_worker->seq_num, NULL, worker->request_body);
+    }
+  else
+    {
+      gssize message_len;
+      const gchar *message = log_msg_get_value(msg, LM_V_MESSAGE, &message_len);
+
+      g_string_append_len(worker->request_body, message, message_len);
     }
-  return body_rendered;
 }
 
 static void
-_set_curl_opt(HTTPDestinationDriver *self, LogMessage *msg, struct curl_slist *curl_headers, GString *body_rendered)
+_add_message_to_batch(HTTPDestinationDriver *self, HTTPDestinationWorker *worker, LogMessage *msg)
 {
-  curl_easy_reset(self->curl);
-
-  curl_easy_setopt(self->curl, CURLOPT_WRITEFUNCTION, _http_write_cb);
-
-  curl_easy_setopt(self->curl, CURLOPT_URL, self->url);
-
-  if (self->user)
-    curl_easy_setopt(self->curl, CURLOPT_USERNAME, self->user);
-
-  if (self->password)
-    curl_easy_setopt(self->curl, CURLOPT_PASSWORD, self->password);
+  if (_get_current_batch_size(self) == 1)
+    {
+      worker->request_headers = _get_curl_headers(self, msg);
+      if (self->body_prefix)
+        g_string_append(worker->request_body, self->body_prefix);
+    }
+  else if (self->delimiter)
+    {
+      g_string_append(worker->request_body, self->delimiter);
+    }
 
-  if (self->user_agent)
-    curl_easy_setopt(self->curl, CURLOPT_USERAGENT, self->user_agent);
+  _append_body_rendered(self, worker, msg);
+}
 
+static gboolean
+_is_batch_full(HTTPDestinationDriver *self, HTTPDestinationWorker *worker)
+{
+  if (self->batch_lines > 0 && _get_current_batch_size(self) >= self->batch_lines)
+    return TRUE;
+  if (self->batch_bytes > 0 && worker->request_body->len >= self->batch_bytes)
+    return TRUE;
+  return FALSE;
+}
 
-  curl_easy_setopt(self->curl, CURLOPT_HTTPHEADER, curl_headers);
+static worker_insert_result_t
+_map_http_status_to_worker_status(HTTPDestinationDriver *self, glong http_code)
+{
+  if (http_code >= 200 && http_code < 300)
+    return WORKER_INSERT_RESULT_SUCCESS;
 
-  const gchar *body = body_rendered ? body_rendered->str : log_msg_get_value(msg, LM_V_MESSAGE, NULL);
+  if (http_code >= 400 && http_code < 500)
+    {
+      msg_error("http: server rejected the request, dropping messages",
+                evt_tag_str("url", self->url),
+                evt_tag_int("status_code", http_code),
+                evt_tag_int("batch_size", _get_current_batch_size(self)),
+                evt_tag_str("driver", self->super.super.super.id));
+      return WORKER_INSERT_RESULT_DROP;
+    }
 
-  curl_easy_setopt(self->curl, CURLOPT_POSTFIELDS, body);
-  if (self->method_type == METHOD_TYPE_PUT)
-    curl_easy_setopt(self->curl, CURLOPT_CUSTOMREQUEST, "PUT");
+  msg_error("http: error response from server",
+            evt_tag_str("url", self->url),
+            evt_tag_int("status_code", http_code),
+            evt_tag_int("batch_size", _get_current_batch_size(self)),
+            evt_tag_str("driver", self->super.super.super.id));
+  return WORKER_INSERT_RESULT_ERROR;
 }
 
 static worker_insert_result_t
-_insert(LogThrDestDriver *s, LogMessage *msg)
+_flush(LogThrDestDriver *s)
 {
-  CURLcode ret;
-
   HTTPDestinationDriver *self = (HTTPDestinationDriver *) s;
+  HTTPDestinationWorker *worker = _get_current_http_worker(self);
+  worker_insert_result_t result;
+  CURLcode ret;
+  glong http_code = 0;
 
-  struct curl_slist *curl_headers = _get_curl_headers(self, msg);
-  GString *body_rendered = _get_body_rendered(self, msg);
+  if (self->body_suffix)
+    g_string_append(worker->request_body, self->body_suffix);
 
-  _set_curl_opt(self, msg, curl_headers, body_rendered);
+  curl_easy_setopt(worker->curl, CURLOPT_HTTPHEADER, worker->request_headers);
+  curl_easy_setopt(worker->curl, CURLOPT_POSTFIELDS, worker->request_body->str);
+  curl_easy_setopt(worker->curl, CURLOPT_POSTFIELDSIZE, (long) worker->request_body->len);
 
-  if ((ret = curl_easy_perform(self->curl)) != CURLE_OK)
+  if ((ret = curl_easy_perform(worker->curl)) != CURLE_OK)
     {
       msg_error("curl: error sending HTTP request",
                 evt_tag_str("error", curl_easy_strerror(ret)));
 
-      if (body_rendered)
-        g_string_free(body_rendered, TRUE);
+      result = WORKER_INSERT_RESULT_ERROR;
+    }
+  else
+    {
+      curl_easy_getinfo(worker->curl, CURLINFO_RESPONSE_CODE, &http_code);
+      result = _map_http_status_to_worker_status(self, http_code);
+    }
 
-      curl_slist_free_all(curl_headers);
+  _reset_request(worker);
+  return result;
+}
 
-      return WORKER_INSERT_RESULT_ERROR;
-    }
+static worker_insert_result_t
+_insert(LogThrDestDriver *s, LogMessage *msg)
+{
+  HTTPDestinationDriver *self = (HTTPDestinationDriver *) s;
+  HTTPDestinationWorker *worker = _get_current_http_worker(self);
 
-  if (body_rendered)
-    g_string_free(body_rendered, TRUE);
+  _add_message_to_batch(self, worker, msg);
 
-  curl_slist_free_all(curl_headers);
+  if (!_is_batching_enabled(self) || _is_batch_full(self, worker))
+    return _flush(s);
 
-  return WORKER_INSERT_RESULT_SUCCESS;
+  return WORKER_INSERT_RESULT_QUEUED;
 }
 
 void
@@ -274,6 +406,49 @@ http_dd_set_body(LogDriver *d, LogTemplate *body)
   self->body_template = log_template_ref(body);
 }
 
+void
+http_dd_set_batch_lines(LogDriver *d, gint batch_lines)
+{
+  HTTPDestinationDriver *self = (HTTPDestinationDriver *) d;
+
+  self->batch_lines = batch_lines;
+}
+
+void
+http_dd_set_batch_bytes(LogDriver *d, gint batch_bytes)
+{
+  HTTPDestinationDriver *self = (HTTPDestinationDriver *) d;
+
+  self->batch_bytes = batch_bytes;
+}
+
+void
+http_dd_set_body_prefix(LogDriver *d, const gchar *body_prefix)
+{
+  HTTPDestinationDriver *self = (HTTPDestinationDriver *) d;
+
+  g_free(self->body_prefix);
+  self->body_prefix = g_strdup(body_prefix);
+}
+
+void
+http_dd_set_body_suffix(LogDriver *d, const gchar *body_suffix)
+{
+  HTTPDestinationDriver *self = (HTTPDestinationDriver *) d;
+
+  g_free(self->body_suffix);
+  self->body_suffix = g_strdup(body_suffix);
+}
+
+void
+http_dd_set_delimiter(LogDriver *d, const gchar *delimiter)
+{
+  HTTPDestinationDriver *self = (HTTPDestinationDriver *) d;
+
+  g_free(self->delimiter);
+  self->delimiter = g_strdup(delimiter);
+}
+
 LogTemplateOptions *
 http_dd_get_template_options(LogDriver *d)
 {
@@ -298,6 +473,17 @@ http_dd_init(LogPipe *s)
       self->url = g_strdup(HTTP_DEFAULT_URL);
     }
 
+  if (!self->user_agent)
+    {
+      curl_version_info_data *curl_info = curl_version_info(CURLVERSION_NOW);
+
+      self->user_agent = g_strdup_printf("syslog-ng %s/libcurl %s",
+                                         SYSLOG_NG_VERSION, curl_info->version);
+    }
+
+  g_free(self->http_workers);
+  self->http_workers = g_new0(HTTPDestinationWorker, MIN(self->super.num_workers, self->super.max_workers));
+
   return log_threaded_dest_driver_start(s);
 }
 
@@ -312,7 +498,6 @@ http_dd_free(LogPipe *s)
 {
   HTTPDestinationDriver *self = (HTTPDestinationDriver *)s;
 
-  curl_easy_cleanup(self->curl);
   curl_global_cleanup();
 
   g_free(self->url);
@@ -320,6 +505,10 @@ http_dd_free(LogPipe *s)
   g_free(self->password);
   g_free(self->user_agent);
   g_list_free_full(self->headers, g_free);
+  g_free(self->body_prefix);
+  g_free(self->body_suffix);
+  g_free(self->delimiter);
+  g_free(self->http_workers);
 
   log_threaded_dest_driver_free(s);
 }
@@ -339,19 +528,16 @@ http_dd_new(GlobalConfig *cfg)
   self->super.worker.connect = _connect;
   self->super.worker.disconnect = _disconnect;
   self->super.worker.insert = _insert;
+  self->super.worker.flush = _flush;
   self->super.super.super.super.generate_persist_name = _format_persist_name;
   self->super.format.stats_instance = _format_stats_instance;
   self->super.stats_source = SCS_HTTP;
   self->super.super.super.super.free_fn = http_dd_free;
 
-  curl_global_init(CURL_GLOBAL_ALL);
-
-  if (!(self->curl = curl_easy_init()))
-    {
-      msg_error("curl: cannot initialize libcurl", NULL);
+  self->super.max_workers = HTTP_MAX_WORKERS;
+  self->delimiter = g_strdup("\n");
 
-      return NULL;
-    }
+  curl_global_init(CURL_GLOBAL_ALL);
 
   return &self->super.super.super;
 }
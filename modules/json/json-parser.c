@@ -21,6 +21,7 @@
  */
 
 #include "json-parser.h"
+#include "json-scanner.h"
 #include "dot-notation.h"
 #include "scratch-buffers.h"
 
@@ -37,6 +38,7 @@ typedef struct _JSONParser
   gchar *marker;
   gint marker_len;
   gchar *extract_prefix;
+  gboolean streaming;
 } JSONParser;
 
 void
@@ -67,6 +69,14 @@ json_parser_set_extract_prefix(LogParser *s, const gchar *extract_prefix)
   self->extract_prefix = g_strdup(extract_prefix);
 }
 
+void
+json_parser_set_streaming(LogParser *s, gboolean streaming)
+{
+  JSONParser *self = (JSONParser *) s;
+
+  self->streaming = streaming;
+}
+
 static void
 json_parser_process_object(struct json_object *jso,
                            const gchar *prefix,
@@ -203,22 +213,30 @@ json_tokener_error_desc(enum json_tokener_error err)
 #endif
 
 static gboolean
-json_parser_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_options, const gchar *input,
-                    gsize input_len)
+json_parser_process_streaming(JSONParser *self, LogMessage **pmsg, const LogPathOptions *path_options,
+                              const gchar *input, gsize input_len)
 {
-  JSONParser *self = (JSONParser *) s;
-  struct json_object *jso;
-  struct json_tokener *tok;
+  NVHandle input_handle;
+  gsize input_ofs = 0;
 
-  if (self->marker)
-    {
-      if (strncmp(input, self->marker, self->marker_len) != 0)
-        return FALSE;
-      input += self->marker_len;
+  /* the scanner collects the members first and only stores them once the
+   * whole object was accepted, so a rejected input leaves the message as
+   * it was and falls back to json-c.  Anything that is not an object is
+   * left to json-c right away. */
+  if (input_len == 0 || input[0] != '{')
+    return FALSE;
 
-      while (isspace(*input))
-        input++;
-    }
+  input_handle = log_parser_lookup_input_handle(&self->super, *pmsg, input, input_len, &input_ofs);
+  log_msg_make_writable(pmsg, path_options);
+  return json_scanner_extract(*pmsg, self->prefix, input, input_len, input_handle, input_ofs);
+}
+
+static gboolean
+json_parser_process_dom(JSONParser *self, LogMessage **pmsg, const LogPathOptions *path_options,
+                        const gchar *input, gsize input_len)
+{
+  struct json_object *jso;
+  struct json_tokener *tok;
 
   tok = json_tokener_new();
   jso = json_tokener_parse_ex(tok, input, input_len);
@@ -245,6 +263,34 @@ json_parser_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_
   return TRUE;
 }
 
+static gboolean
+json_parser_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_options, const gchar *input,
+                    gsize input_len)
+{
+  JSONParser *self = (JSONParser *) s;
+  const gchar *end = input + input_len;
+
+  if (self->marker)
+    {
+      if (strncmp(input, self->marker, self->marker_len) != 0)
+        return FALSE;
+      input += self->marker_len;
+
+      while (isspace(*input))
+        input++;
+      input_len = end - input;
+    }
+
+  /* extract-prefix() needs the whole object tree, and anything the strict
+   * scanner rejects is left to json-c, which accepts a couple of
+   * extensions and reports the errors */
+  if (self->streaming && !self->extract_prefix &&
+      json_parser_process_streaming(self, pmsg, path_options, input, input_len))
+    return TRUE;
+
+  return json_parser_process_dom(self, pmsg, path_options, input, input_len);
+}
+
 static LogPipe *
 json_parser_clone(LogPipe *s)
 {
@@ -255,6 +301,7 @@ json_parser_clone(LogPipe *s)
   json_parser_set_prefix(cloned, self->prefix);
   json_parser_set_marker(cloned, self->marker);
   json_parser_set_extract_prefix(cloned, self->extract_prefix);
+  json_parser_set_streaming(cloned, self->streaming);
   log_parser_set_template(cloned, log_template_ref(self->super.template));
 
   return &cloned->super;
@@ -280,6 +327,7 @@ json_parser_new(GlobalConfig *cfg)
   self->super.super.free_fn = json_parser_free;
   self->super.super.clone = json_parser_clone;
   self->super.process = json_parser_process;
+  self->streaming = TRUE;
 
   return &self->super;
 }
@@ -0,0 +1,561 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ */
+
+#include "json-scanner.h"
+#include "scratch-buffers.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+/* the same as the default depth limit of json-c */
+#define JSON_SCANNER_MAX_DEPTH 32
+
+/* a member found in the input, stored into the message once the whole
+ * object turned out to be valid */
+typedef struct _JSONScannerMember
+{
+  NVHandle handle;
+  /* the value is at ofs in the input, or in JSONScanner->values */
+  gboolean in_input;
+  gsize ofs;
+  gsize len;
+} JSONScannerMember;
+
+typedef struct _JSONScanner
+{
+  LogMessage *msg;
+  const gchar *input;
+  const gchar *pos;
+  const gchar *end;
+  GString *key;
+  GString *value;
+
+  /* array of JSONScannerMember, and the values that are not verbatim in the input */
+  GString *members;
+  GString *values;
+
+  /* the value that contains input, 0 if input is not part of the message */
+  NVHandle input_handle;
+  gsize input_ofs;
+  gint depth;
+} JSONScanner;
+
+/* word-at-a-time helpers to skip over the bytes of a string that need no
+ * special handling, 8 bytes at a time */
+#define SWAR_ONES  G_GUINT64_CONSTANT(0x0101010101010101)
+#define SWAR_HIGHS G_GUINT64_CONSTANT(0x8080808080808080)
+
+static inline guint64
+_swar_has_byte(guint64 v, guchar c)
+{
+  guint64 x = v ^ (SWAR_ONES * c);
+
+  return (x - SWAR_ONES) & ~x & SWAR_HIGHS;
+}
+
+static inline guint64
+_swar_has_less_than(guint64 v, guchar c)
+{
+  return (v - SWAR_ONES * c) & ~v & SWAR_HIGHS;
+}
+
+static inline void
+_skip_whitespace(JSONScanner *self)
+{
+  while (self->pos < self->end &&
+         (*self->pos == ' ' || *self->pos == '\n' || *self->pos == '\r' || *self->pos == '\t'))
+    self->pos++;
+}
+
+static inline gboolean
+_skip_literal(JSONScanner *self, const gchar *literal, gsize literal_len)
+{
+  if ((gsize) (self->end - self->pos) < literal_len || memcmp(self->pos, literal, literal_len) != 0)
+    return FALSE;
+  self->pos += literal_len;
+  return TRUE;
+}
+
+/* scans a string starting at its opening quote, returns the raw characters
+ * between the quotes and whether they contain escape sequences */
+static gboolean
+_scan_string(JSONScanner *self, const gchar **raw, gsize *raw_len, gboolean *escaped)
+{
+  const gchar quote = *self->pos;
+  const gchar *p = self->pos + 1;
+
+  *escaped = FALSE;
+  while (p < self->end)
+    {
+      while (self->end - p >= 8)
+        {
+          guint64 v;
+
+          memcpy(&v, p, sizeof(v));
+          if (_swar_has_byte(v, quote) | _swar_has_byte(v, '\\') | _swar_has_less_than(v, 0x20))
+            break;
+          p += 8;
+        }
+      if (p >= self->end)
+        break;
+
+      if (*p == quote)
+        {
+          *raw = self->pos + 1;
+          *raw_len = p - *raw;
+          self->pos = p + 1;
+          return TRUE;
+        }
+      else if (*p == '\\')
+        {
+          *escaped = TRUE;
+          p += 2;
+        }
+      else if ((guchar) *p < 0x20)
+        {
+          return FALSE;
+        }
+      else
+        {
+          p++;
+        }
+    }
+  return FALSE;
+}
+
+static inline gboolean
+_parse_hex4(const gchar *p, const gchar *end, gunichar *result)
+{
+  gint i;
+
+  if (end - p < 4)
+    return FALSE;
+
+  *result = 0;
+  for (i = 0; i < 4; i++)
+    {
+      gint digit = g_ascii_xdigit_value(p[i]);
+
+      if (digit < 0)
+        return FALSE;
+      *result = (*result << 4) + digit;
+    }
+  return TRUE;
+}
+
+static gboolean
+_unescape_string(const gchar *src, gsize len, GString *dest)
+{
+  const gchar *end = src + len;
+  gsize start = dest->len;
+  gunichar cp, low;
+
+  while (src < end)
+    {
+      const gchar *backslash = memchr(src, '\\', end - src);
+
+      if (!backslash)
+        {
+          g_string_append_len(dest, src, end - src);
+          break;
+        }
+      g_string_append_len(dest, src, backslash - src);
+      src = backslash + 1;
+      switch (*src++)
+        {
+        case '"':
+        case '\\':
+        case '/':
+          g_string_append_c(dest, src[-1]);
+          break;
+        case 'b':
+          g_string_append_c(dest, '\b');
+          break;
+        case 'f':
+          g_string_append_c(dest, '\f');
+          break;
+        case 'n':
+          g_string_append_c(dest, '\n');
+          break;
+        case 'r':
+          g_string_append_c(dest, '\r');
+          break;
+        case 't':
+          g_string_append_c(dest, '\t');
+          break;
+        case 'u':
+          if (!_parse_hex4(src, end, &cp))
+            return FALSE;
+          src += 4;
+          if (cp >= 0xD800 && cp <= 0xDBFF)
+            {
+              /* surrogate pair */
+              if (end - src < 6 || src[0] != '\\' || src[1] != 'u' ||
+                  !_parse_hex4(src + 2, end, &low) || low < 0xDC00 || low > 0xDFFF)
+                return FALSE;
+              cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+              src += 6;
+            }
+          else if (cp >= 0xDC00 && cp <= 0xDFFF)
+            {
+              return FALSE;
+            }
+          g_string_append_unichar(dest, cp);
+          break;
+        default:
+          return FALSE;
+        }
+    }
+
+  /* json-c strings are NUL terminated, an escaped NUL character truncates them */
+  g_string_truncate(dest, start + strlen(dest->str + start));
+  return TRUE;
+}
+
+static gboolean
+_scan_number(JSONScanner *self, const gchar **raw, gsize *raw_len, gboolean *is_double)
+{
+  const gchar *p = self->pos;
+
+  *is_double = FALSE;
+  if (p < self->end && *p == '-')
+    p++;
+  if (p >= self->end || !g_ascii_isdigit(*p))
+    return FALSE;
+
+  if (*p == '0')
+    p++;
+  else
+    while (p < self->end && g_ascii_isdigit(*p))
+      p++;
+
+  if (p < self->end && *p == '.')
+    {
+      *is_double = TRUE;
+      p++;
+      if (p >= self->end || !g_ascii_isdigit(*p))
+        return FALSE;
+      while (p < self->end && g_ascii_isdigit(*p))
+        p++;
+    }
+  if (p < self->end && (*p == 'e' || *p == 'E'))
+    {
+      *is_double = TRUE;
+      p++;
+      if (p < self->end && (*p == '+' || *p == '-'))
+        p++;
+      if (p >= self->end || !g_ascii_isdigit(*p))
+        return FALSE;
+      while (p < self->end && g_ascii_isdigit(*p))
+        p++;
+    }
+
+  *raw = self->pos;
+  *raw_len = p - self->pos;
+  self->pos = p;
+  return TRUE;
+}
+
+static void
+_add_member(JSONScanner *self, gboolean in_input, gsize ofs, gsize len)
+{
+  JSONScannerMember member;
+
+  member.handle = log_msg_get_value_handle(self->key->str);
+  member.in_input = in_input;
+  member.ofs = ofs;
+  member.len = len;
+  g_string_append_len(self->members, (const gchar *) &member, sizeof(member));
+}
+
+static void
+_set_value(JSONScanner *self, const gchar *value, gsize value_len)
+{
+  _add_member(self, FALSE, self->values->len, value_len);
+  g_string_append_len(self->values, value, value_len);
+}
+
+/* sets a value that is stored verbatim in the input */
+static void
+_set_value_from_input(JSONScanner *self, const gchar *raw, gsize raw_len)
+{
+  _add_member(self, TRUE, raw - self->input, raw_len);
+}
+
+static void
+_store_member(JSONScanner *self, JSONScannerMember *member)
+{
+  gsize ofs = self->input_ofs + member->ofs;
+
+  if (member->in_input &&
+      self->input_handle &&
+      member->handle != self->input_handle &&
+      log_msg_is_handle_settable_with_an_indirect_value(member->handle) &&
+      ofs + member->len <= G_MAXUINT16)
+    {
+      log_msg_set_value_indirect(self->msg, member->handle, self->input_handle, 0, ofs, member->len);
+      return;
+    }
+
+  /* the input is going to change, we can't reference it anymore */
+  if (member->handle == self->input_handle)
+    self->input_handle = 0;
+  log_msg_set_value(self->msg, member->handle,
+                    member->in_input ? self->input + member->ofs : self->values->str + member->ofs,
+                    member->len);
+}
+
+/* nothing is stored until the whole input is parsed, so that the message
+ * is left intact if the input is rejected */
+static void
+_store_members(JSONScanner *self)
+{
+  JSONScannerMember *members = (JSONScannerMember *) self->members->str;
+  gsize num_members = self->members->len / sizeof(members[0]);
+  gsize i;
+
+  for (i = 0; i < num_members; i++)
+    _store_member(self, &members[i]);
+}
+
+/* ints and doubles are formatted the same way as json-c returns them */
+static void
+_set_number_value(JSONScanner *self, const gchar *raw, gsize raw_len, gboolean is_double)
+{
+  gint digits = raw_len - (raw[0] == '-');
+  gint64 value;
+
+  if (!is_double && digits <= 9 && !(raw_len == 2 && raw[0] == '-' && raw[1] == '0'))
+    {
+      /* canonical and fits into 32 bits, the same as formatted */
+      _set_value_from_input(self, raw, raw_len);
+      return;
+    }
+
+  g_string_truncate(self->value, 0);
+  g_string_append_len(self->value, raw, raw_len);
+  if (is_double)
+    {
+      g_string_printf(self->value, "%f", g_ascii_strtod(self->value->str, NULL));
+    }
+  else
+    {
+      value = g_ascii_strtoll(self->value->str, NULL, 10);
+      g_string_printf(self->value, "%i", (gint) CLAMP(value, G_MININT32, G_MAXINT32));
+    }
+  _set_value(self, self->value->str, self->value->len);
+}
+
+static gboolean _parse_value(JSONScanner *self);
+
+static gboolean
+_parse_object(JSONScanner *self)
+{
+  gsize base_len = self->key->len;
+  const gchar *raw;
+  gsize raw_len;
+  gboolean escaped;
+
+  if (++self->depth > JSON_SCANNER_MAX_DEPTH)
+    return FALSE;
+
+  self->pos++;
+  _skip_whitespace(self);
+  if (self->pos < self->end && *self->pos == '}')
+    {
+      self->pos++;
+      self->depth--;
+      return TRUE;
+    }
+
+  while (TRUE)
+    {
+      if (self->pos >= self->end || (*self->pos != '"' && *self->pos != '\''))
+        return FALSE;
+      if (!_scan_string(self, &raw, &raw_len, &escaped))
+        return FALSE;
+
+      g_string_truncate(self->key, base_len);
+      if (!escaped)
+        g_string_append_len(self->key, raw, raw_len);
+      else if (!_unescape_string(raw, raw_len, self->key))
+        return FALSE;
+
+      _skip_whitespace(self);
+      if (self->pos >= self->end || *self->pos != ':')
+        return FALSE;
+      self->pos++;
+      _skip_whitespace(self);
+
+      if (!_parse_value(self))
+        return FALSE;
+
+      _skip_whitespace(self);
+      if (self->pos >= self->end)
+        return FALSE;
+      if (*self->pos == '}')
+        break;
+      if (*self->pos != ',')
+        return FALSE;
+      self->pos++;
+      _skip_whitespace(self);
+    }
+  self->pos++;
+  g_string_truncate(self->key, base_len);
+  self->depth--;
+  return TRUE;
+}
+
+static gboolean
+_parse_array(JSONScanner *self)
+{
+  gsize base_len = self->key->len;
+  gint i;
+
+  if (++self->depth > JSON_SCANNER_MAX_DEPTH)
+    return FALSE;
+
+  self->pos++;
+  _skip_whitespace(self);
+  if (self->pos < self->end && *self->pos == ']')
+    {
+      self->pos++;
+      self->depth--;
+      return TRUE;
+    }
+
+  for (i = 0; ; i++)
+    {
+      g_string_truncate(self->key, base_len);
+      g_string_append_printf(self->key, "[%d]", i);
+
+      if (!_parse_value(self))
+        return FALSE;
+
+      _skip_whitespace(self);
+      if (self->pos >= self->end)
+        return FALSE;
+      if (*self->pos == ']')
+        break;
+      if (*self->pos != ',')
+        return FALSE;
+      self->pos++;
+      _skip_whitespace(self);
+    }
+  self->pos++;
+  g_string_truncate(self->key, base_len);
+  self->depth--;
+  return TRUE;
+}
+
+static gboolean
+_parse_value(JSONScanner *self)
+{
+  const gchar *raw;
+  gsize raw_len;
+  gboolean flag;
+
+  if (self->pos >= self->end)
+    return FALSE;
+
+  switch (*self->pos)
+    {
+    case '"':
+    case '\'':
+      if (!_scan_string(self, &raw, &raw_len, &flag))
+        return FALSE;
+      if (!flag)
+        {
+          _set_value_from_input(self, raw, raw_len);
+          return TRUE;
+        }
+      g_string_truncate(self->value, 0);
+      if (!_unescape_string(raw, raw_len, self->value))
+        return FALSE;
+      _set_value(self, self->value->str, self->value->len);
+      return TRUE;
+    case '{':
+      g_string_append_c(self->key, '.');
+      return _parse_object(self);
+    case '[':
+      return _parse_array(self);
+    case 't':
+      raw = self->pos;
+      if (!_skip_literal(self, "true", 4))
+        return FALSE;
+      _set_value_from_input(self, raw, 4);
+      return TRUE;
+    case 'f':
+      raw = self->pos;
+      if (!_skip_literal(self, "false", 5))
+        return FALSE;
+      _set_value_from_input(self, raw, 5);
+      return TRUE;
+    case 'n':
+      /* null values are skipped */
+      return _skip_literal(self, "null", 4);
+    default:
+      if (!_scan_number(self, &raw, &raw_len, &flag))
+        return FALSE;
+      _set_number_value(self, raw, raw_len, flag);
+      return TRUE;
+    }
+}
+
+gboolean
+json_scanner_extract(LogMessage *msg, const gchar *prefix,
+                     const gchar *input, gsize input_len,
+                     NVHandle input_handle, gsize input_ofs)
+{
+  JSONScanner self;
+  SBGString *key = sb_gstring_acquire();
+  SBGString *value = sb_gstring_acquire();
+  SBGString *members = sb_gstring_acquire();
+  SBGString *values = sb_gstring_acquire();
+  gboolean success = FALSE;
+
+  self.msg = msg;
+  self.input = self.pos = input;
+  self.end = input + input_len;
+  self.key = sb_gstring_string(key);
+  self.value = sb_gstring_string(value);
+  self.members = sb_gstring_string(members);
+  self.values = sb_gstring_string(values);
+  self.input_handle = input_handle;
+  self.input_ofs = input_ofs;
+  self.depth = 0;
+
+  if (prefix)
+    g_string_assign(self.key, prefix);
+
+  _skip_whitespace(&self);
+  if (self.pos < self.end && *self.pos == '{')
+    success = _parse_object(&self);
+
+  if (success)
+    _store_members(&self);
+
+  sb_gstring_release(key);
+  sb_gstring_release(value);
+  sb_gstring_release(members);
+  sb_gstring_release(values);
+  return success;
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ */
+
+#ifndef JSON_SCANNER_H_INCLUDED
+#define JSON_SCANNER_H_INCLUDED
+
+#include "logmsg/logmsg.h"
+
+/*
+ * Single pass JSON scanner that stores the members of a JSON object
+ * directly into a LogMessage, without building a json-c object tree.  The
+ * names and the formatting of values are the same as the ones produced by
+ * the json-c based code path.
+ *
+ * If @input is part of the value @input_handle of @msg (starting at
+ * @input_ofs), strings that need no unescaping are stored as indirect
+ * values referencing it.
+ *
+ * Returns FALSE if the input is not a strict JSON object, in which case
+ * @msg is left unchanged.
+ */
+gboolean json_scanner_extract(LogMessage *msg, const gchar *prefix,
+                              const gchar *input, gsize input_len,
+                              NVHandle input_handle, gsize input_ofs);
+
+#endif
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "template_lib.h"
+#include "apphook.h"
+#include "plugin.h"
+#include "cfg.h"
+
+#define ITERATIONS 100000
+
+static void
+test_format_json_speed(const gchar *template_code)
+{
+  LogTemplate *template = compile_template(template_code, FALSE);
+  LogMessage *msg = create_sample_message();
+  GString *result = g_string_sized_new(1024);
+  gint i;
+
+  start_stopwatch();
+  for (i = 0; i < ITERATIONS; i++)
+    log_template_format(template, msg, NULL, LTZ_LOCAL, 0, NULL, result);
+  stop_stopwatch_and_display_result(ITERATIONS, "formatting %s, %d iterations took", template_code, ITERATIONS);
+
+  g_string_free(result, TRUE);
+  log_msg_unref(msg);
+  log_template_unref(template);
+}
+
+int
+main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
+{
+  app_startup();
+  putenv("TZ=UTC");
+  tzset();
+  init_template_tests();
+  plugin_load_module("json-plugin", configuration, NULL);
+
+  test_format_json_speed("$(format-json --scope rfc5424 --scope nv-pairs)");
+  test_format_json_speed("$(format-json --scope rfc5424 --scope nv-pairs --rekey .* --add-prefix _)");
+  test_format_json_speed("$(format-json --scope selected-macros foo=$HOST bar=$PROGRAM)");
+
+  deinit_template_tests();
+  app_shutdown();
+  return 0;
+}
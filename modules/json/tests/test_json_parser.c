@@ -186,6 +186,86 @@ test_json_parser_works_with_templates(void)
   log_msg_unref(msg);
 }
 
+static void
+test_json_parser_unescapes_strings(void)
+{
+  LogMessage *msg;
+
+  msg = parse_json_into_log_message("{\"quote\": \"a\\\"b\", \"newline\": \"a\\nb\", \"unicode\": \"\\u00e9\\ud83d\\ude00\", \"esc\\u0061ped\": \"key\"}");
+  assert_log_message_value(msg, log_msg_get_value_handle("quote"), "a\"b");
+  assert_log_message_value(msg, log_msg_get_value_handle("newline"), "a\nb");
+  assert_log_message_value(msg, log_msg_get_value_handle("unicode"), "\xc3\xa9\xf0\x9f\x98\x80");
+  assert_log_message_value(msg, log_msg_get_value_handle("escaped"), "key");
+  log_msg_unref(msg);
+}
+
+static void
+test_json_parser_formats_numbers_like_json_c(void)
+{
+  LogMessage *msg;
+
+  msg = parse_json_into_log_message("{\"neg\": -5, \"zero\": -0, \"big\": 12345678901, \"exp\": 1e2}");
+  assert_log_message_value(msg, log_msg_get_value_handle("neg"), "-5");
+  assert_log_message_value(msg, log_msg_get_value_handle("zero"), "0");
+  assert_log_message_value(msg, log_msg_get_value_handle("big"), "2147483647");
+  assert_log_message_value(msg, log_msg_get_value_handle("exp"), "100.000000");
+  log_msg_unref(msg);
+}
+
+static void
+test_json_parser_handles_nested_arrays_and_objects(void)
+{
+  LogMessage *msg;
+
+  msg = parse_json_into_log_message("{\"a\": [[1, 2], {\"b\": [\"c\"]}], \"d\": {\"e\": {\"f\": \"g\"}, \"h\": []}}");
+  assert_log_message_value(msg, log_msg_get_value_handle("a[0][0]"), "1");
+  assert_log_message_value(msg, log_msg_get_value_handle("a[0][1]"), "2");
+  assert_log_message_value(msg, log_msg_get_value_handle("a[1].b[0]"), "c");
+  assert_log_message_value(msg, log_msg_get_value_handle("d.e.f"), "g");
+  log_msg_unref(msg);
+}
+
+static void
+test_json_parser_can_overwrite_its_input(void)
+{
+  LogMessage *msg;
+
+  msg = parse_json_into_log_message("{\"foo\": \"bar\", \"MESSAGE\": \"new message\", \"baz\": \"bax\"}");
+  assert_log_message_value(msg, log_msg_get_value_handle("foo"), "bar");
+  assert_log_message_value(msg, LM_V_MESSAGE, "new message");
+  assert_log_message_value(msg, log_msg_get_value_handle("baz"), "bax");
+  log_msg_unref(msg);
+}
+
+static void
+test_json_parser_without_streaming_gives_the_same_results(void)
+{
+  LogMessage *msg;
+
+  json_parser_set_streaming(json_parser, FALSE);
+  msg = parse_json_into_log_message("{\"foo\": \"b\\u0061r\", \"num\": 12345678901, \"obj\": {\"arr\": [true, null, 1.5]}}");
+  assert_log_message_value(msg, log_msg_get_value_handle("foo"), "bar");
+  assert_log_message_value(msg, log_msg_get_value_handle("num"), "2147483647");
+  assert_log_message_value(msg, log_msg_get_value_handle("obj.arr[0]"), "true");
+  assert_log_message_value(msg, log_msg_get_value_handle("obj.arr[2]"), "1.500000");
+  log_msg_unref(msg);
+}
+
+static void
+test_json_parser_leaves_message_intact_for_truncated_json(void)
+{
+  LogMessage *msg;
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+  msg = log_msg_new_empty();
+  log_msg_set_value(msg, LM_V_MESSAGE, "{\"foo\": \"bar\", \"baz\": ", -1);
+  log_msg_set_value_by_name(msg, "foo", "original", -1);
+  assert_false(log_parser_process_message(json_parser, &msg, &path_options),
+               "expected json-parser failure for truncated input");
+  assert_log_message_value(msg, log_msg_get_value_handle("foo"), "original");
+  log_msg_unref(msg);
+}
+
 static void
 test_json_parser(void)
 {
@@ -198,6 +278,12 @@ test_json_parser(void)
   JSON_PARSER_TESTCASE(test_json_parser_fails_for_non_object_top_element);
   JSON_PARSER_TESTCASE(test_json_parser_extracts_subobjects_if_extract_prefix_is_specified);
   JSON_PARSER_TESTCASE(test_json_parser_works_with_templates);
+  JSON_PARSER_TESTCASE(test_json_parser_unescapes_strings);
+  JSON_PARSER_TESTCASE(test_json_parser_formats_numbers_like_json_c);
+  JSON_PARSER_TESTCASE(test_json_parser_handles_nested_arrays_and_objects);
+  JSON_PARSER_TESTCASE(test_json_parser_can_overwrite_its_input);
+  JSON_PARSER_TESTCASE(test_json_parser_without_streaming_gives_the_same_results);
+  JSON_PARSER_TESTCASE(test_json_parser_leaves_message_intact_for_truncated_json);
 }
 
 int
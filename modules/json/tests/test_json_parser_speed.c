@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ */
+#include "testutils.h"
+#include "json-parser.h"
+#include "apphook.h"
+#include "msg_parse_lib.h"
+
+#define ITERATIONS 100000
+
+static GString *
+_generate_json_log(void)
+{
+  GString *json = g_string_new("{\"timestamp\": \"2016-10-17T12:34:56.789+02:00\", \"host\": \"web-frontend-01\", "
+                               "\"severity\": \"info\", \"pid\": 12345, \"latency\": 0.123, \"cached\": false, "
+                               "\"request\": {\"method\": \"GET\", \"uri\": \"/api/v1/items?id=1234\", "
+                               "\"headers\": {\"user-agent\": \"Mozilla/5.0 (X11; Linux x86_64)\", "
+                               "\"accept\": \"application/json\"}}, \"tags\": [");
+  gint i;
+
+  for (i = 0; i < 32; i++)
+    g_string_append_printf(json, "%s\"tag%d\"", i ? ", " : "", i);
+  g_string_append(json, "], \"fields\": {");
+  for (i = 0; i < 32; i++)
+    g_string_append_printf(json, "%s\"field%d\": \"value of field %d, \\\"quoted\\\"\"", i ? ", " : "", i, i);
+  g_string_append(json, "}}");
+  return json;
+}
+
+static void
+test_json_parser_speed(gboolean streaming)
+{
+  LogParser *json_parser = json_parser_new(NULL);
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  GString *json = _generate_json_log();
+  LogMessage *msg;
+  gint i;
+
+  json_parser_set_streaming(json_parser, streaming);
+  start_stopwatch();
+  for (i = 0; i < ITERATIONS; i++)
+    {
+      msg = log_msg_new_empty();
+      log_msg_set_value(msg, LM_V_MESSAGE, json->str, json->len);
+      if (!log_parser_process_message(json_parser, &msg, &path_options))
+        fprintf(stderr, "json-parser failed to parse benchmark input\n");
+      log_msg_unref(msg);
+    }
+  stop_stopwatch_and_display_result(ITERATIONS, "parsing %d byte JSON messages %s, %d iterations took",
+                                    (gint) json->len, streaming ? "in a single pass" : "using json-c", ITERATIONS);
+
+  g_string_free(json, TRUE);
+  log_pipe_unref(&json_parser->super);
+}
+
+int
+main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
+{
+  app_startup();
+
+  test_json_parser_speed(FALSE);
+  test_json_parser_speed(TRUE);
+  app_shutdown();
+  return 0;
+}
@@ -131,21 +131,39 @@ _is_delimiter(const gchar *cur)
   return (*cur == ' ') || (strncmp(cur, ", ", 2) == 0);
 }
 
+/* appends the characters up to the next one that needs attention in the
+ * current state in one go, returns the position of that character */
+static const gchar *
+_kv_scanner_append_run(KVScanner *self, const gchar *cur, const gchar *end, gchar c1, gchar c2, gchar c3, gchar c4)
+{
+  const gchar *next = _memchr_any4(cur, end - cur, c1, c2, c3, c4);
+
+  if (!next)
+    next = end;
+  g_string_append_len(self->value, cur, next - cur);
+  return next;
+}
+
 static gboolean
 _kv_scanner_extract_value(KVScanner *self)
 {
-  const gchar *cur;
+  const gchar *cur, *end;
 
   g_string_truncate(self->value, 0);
   self->value_was_quoted = FALSE;
   cur = &self->input[self->input_pos];
+  end = &self->input[self->input_len];
 
   self->quote_state = KV_QUOTE_INITIAL;
-  while (*cur && self->quote_state != KV_QUOTE_FINISH)
+  while (cur < end && self->quote_state != KV_QUOTE_FINISH)
     {
       switch (self->quote_state)
         {
         case KV_QUOTE_INITIAL:
+          cur = _kv_scanner_append_run(self, cur, end, ' ', ',', '\"', '\'');
+          if (cur == end)
+            continue;
+
           if (_is_delimiter(cur))
             {
               self->quote_state = KV_QUOTE_FINISH;
@@ -163,12 +181,14 @@ _kv_scanner_extract_value(KVScanner *self)
             }
           break;
         case KV_QUOTE_STRING:
+          cur = _kv_scanner_append_run(self, cur, end, self->quote_char, '\\', self->quote_char, '\\');
+          if (cur == end)
+            continue;
+
           if (*cur == self->quote_char)
             self->quote_state = KV_QUOTE_INITIAL;
-          else if (*cur == '\\')
-            self->quote_state = KV_QUOTE_BACKSLASH;
           else
-            g_string_append_c(self->value, *cur);
+            self->quote_state = KV_QUOTE_BACKSLASH;
           break;
         case KV_QUOTE_BACKSLASH:
           _decode_backslash_escape(self, *cur);
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "kv-scanner.h"
+#include "linux-audit-scanner.h"
+#include "testutils.h"
+
+#define ITERATIONS 200000
+
+static const gchar *firewall_log =
+  "devname=\"FG100D3G12345678\" devid=\"FG100D3G12345678\" logid=\"0000000013\" type=\"traffic\" "
+  "subtype=\"forward\" level=\"notice\" vd=\"root\" date=2016-10-17 time=12:34:56 srcip=192.168.1.100 "
+  "srcport=54321 srcintf=\"internal\" dstip=93.184.216.34 dstport=443 dstintf=\"wan1\" sessionid=123456789 "
+  "proto=6 action=\"accept\" policyid=42 policytype=\"policy\" service=\"HTTPS\" dstcountry=\"United States\" "
+  "srccountry=\"Reserved\" trandisp=\"snat\" transip=203.0.113.10 transport=54321 appcat=\"unscanned\" "
+  "duration=120 sentbyte=123456 rcvdbyte=654321 sentpkt=1234 rcvdpkt=4321 msg=\"connection closed, \\\"normally\\\"\"";
+
+static const gchar *audit_log =
+  "type=EXECVE msg=audit(1476700496.123:4567): argc=3 a0=\"/usr/bin/ssh\" "
+  "a1=2D6F5374726963744B6579436865636B696E673D6E6F a2=\"user@example.com\" "
+  "proctitle=2F7573722F62696E2F737368002D6F5374726963744B6579436865636B696E673D6E6F";
+
+static void
+test_scanner_speed(KVScanner *scanner, const gchar *name, const gchar *input)
+{
+  gint i, pairs = 0;
+
+  start_stopwatch();
+  for (i = 0; i < ITERATIONS; i++)
+    {
+      kv_scanner_input(scanner, input);
+      while (kv_scanner_scan_next(scanner))
+        pairs++;
+    }
+  stop_stopwatch_and_display_result(ITERATIONS, "scanning %s lines (%d bytes, %d pairs), %d iterations took",
+                                    name, (gint) strlen(input), pairs / ITERATIONS, ITERATIONS);
+  kv_scanner_free(scanner);
+}
+
+int
+main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
+{
+  test_scanner_speed(kv_scanner_new(), "firewall", firewall_log);
+  test_scanner_speed(linux_audit_scanner_new(), "linux-audit", audit_log);
+  return 0;
+}
@@ -30,6 +30,7 @@
 #include "str-format.h"
 #include "utf8utils.h"
 #include "str-utils.h"
+#include "tls-support.h"
 
 #include <regex.h>
 #include <ctype.h>
@@ -353,8 +354,34 @@ __is_bsd_linksys(const guchar *src, guint32 left)
          );
 }
 
+typedef enum
+{
+  TS_SHAPE_NONE,
+  TS_SHAPE_ISO,
+  TS_SHAPE_BSD_PIX_OR_ASA,
+  TS_SHAPE_BSD_LINKSYS,
+  TS_SHAPE_BSD_RFC3164,
+} TimestampShape;
+
+static TimestampShape
+__get_timestamp_shape(const guchar *src, gint left, guint parse_flags)
+{
+  if (__is_iso_stamp((const gchar *) src, left))
+    return TS_SHAPE_ISO;
+  if (parse_flags & LP_SYSLOG_PROTOCOL)
+    return TS_SHAPE_NONE;
+  if (__is_bsd_pix_or_asa(src, left))
+    return TS_SHAPE_BSD_PIX_OR_ASA;
+  if (__is_bsd_linksys(src, left))
+    return TS_SHAPE_BSD_LINKSYS;
+  if (__is_bsd_rfc_3164(src, left))
+    return TS_SHAPE_BSD_RFC3164;
+  return TS_SHAPE_NONE;
+}
+
 static gboolean
-__parse_bsd_timestamp(const guchar **data, gint *length, const GTimeVal *now, struct tm *tm, glong *usec)
+__parse_bsd_timestamp(TimestampShape shape, const guchar **data, gint *length, const GTimeVal *now, struct tm *tm,
+                      glong *usec)
 {
   gint left = *length;
   const guchar *src = *data;
@@ -363,7 +390,7 @@ __parse_bsd_timestamp(const guchar **data, gint *length, const GTimeVal *now, st
   cached_localtime(&now_tv_sec, tm);
   cached_localtime(&now_tv_sec, &local_time);
 
-  if (__is_bsd_pix_or_asa(src, left))
+  if (shape == TS_SHAPE_BSD_PIX_OR_ASA)
     {
       if (!scan_pix_timestamp((const gchar **) &src, &left, tm))
         return FALSE;
@@ -374,12 +401,12 @@ __parse_bsd_timestamp(const guchar **data, gint *length, const GTimeVal *now, st
           left--;
         }
     }
-  else if (__is_bsd_linksys(src, left))
+  else if (shape == TS_SHAPE_BSD_LINKSYS)
     {
       if (!scan_linksys_timestamp((const gchar **) &src, &left, tm))
         return FALSE;
     }
-  else if (__is_bsd_rfc_3164(src, left))
+  else if (shape == TS_SHAPE_BSD_RFC3164)
     {
       if (!scan_bsd_timestamp((const gchar **) &src, &left, tm))
         return FALSE;
@@ -419,63 +446,52 @@ __get_normalized_time(LogStamp const timestamp, gint const normalized_hour, gint
          - timestamp.zone_offset;
 }
 
-/* FIXME: this function should really be exploded to a lot of smaller functions... (Bazsi) */
+static void
+log_msg_parse_cisco_sync_marker(LogMessage *self, const guchar **data, gint *length, guint parse_flags)
+{
+  /* Cisco timestamp extensions, the first '*' indicates that the clock is
+   * unsynced, '.' if it is known to be synced */
+  if (G_UNLIKELY((*data)[0] == '*'))
+    {
+      if (!(parse_flags & LP_NO_PARSE_DATE))
+        log_msg_set_value(self, is_synced, "0", 1);
+      (*data)++;
+      (*length)--;
+    }
+  else if (G_UNLIKELY((*data)[0] == '.'))
+    {
+      if (!(parse_flags & LP_NO_PARSE_DATE))
+        log_msg_set_value(self, is_synced, "1", 1);
+      (*data)++;
+      (*length)--;
+    }
+}
+
 static gboolean
-log_msg_parse_date_unnormalized(LogMessage *self, const guchar **data, gint *length, guint parse_flags, struct tm *tm)
+log_msg_parse_date_unnormalized(LogMessage *self, const guchar **data, gint *length, TimestampShape shape,
+                                const GTimeVal *now, struct tm *tm)
 {
   const guchar *src = *data;
   gint left = *length;
-  GTimeVal now;
-
-  cached_g_current_time(&now);
 
-  if ((parse_flags & LP_SYSLOG_PROTOCOL) == 0)
-    {
-      /* Cisco timestamp extensions, the first '*' indicates that the clock is
-       * unsynced, '.' if it is known to be synced */
-      if (G_UNLIKELY(src[0] == '*'))
-        {
-          if (!(parse_flags & LP_NO_PARSE_DATE))
-            log_msg_set_value(self, is_synced, "0", 1);
-          src++;
-          left--;
-        }
-      else if (G_UNLIKELY(src[0] == '.'))
-        {
-          if (!(parse_flags & LP_NO_PARSE_DATE))
-            log_msg_set_value(self, is_synced, "1", 1);
-          src++;
-          left--;
-        }
-    }
   /* If the next chars look like a date, then read them as a date. */
-  if (__is_iso_stamp((const gchar *)src, left))
+  if (shape == TS_SHAPE_ISO)
     {
-      if (!__parse_iso_stamp(&now, self, tm, &src, &left))
+      if (!__parse_iso_stamp(now, self, tm, &src, &left))
         goto error;
     }
-  else if ((parse_flags & LP_SYSLOG_PROTOCOL) == 0)
+  else if (shape != TS_SHAPE_NONE)
     {
       glong usec = 0;
-      if (!__parse_bsd_timestamp(&src, &left, &now, tm, &usec))
+      if (!__parse_bsd_timestamp(shape, &src, &left, now, tm, &usec))
         goto error;
       self->timestamps[LM_TS_STAMP].tv_usec = usec;
     }
   else
     {
-      if (left >= 1 && src[0] == '-')
-        {
-          /* NILVALUE */
-          self->timestamps[LM_TS_STAMP] = self->timestamps[LM_TS_RECVD];
-          *length = --left;
-          *data = ++src;
-          return TRUE;
-        }
-      else
-        return FALSE;
+      goto error;
     }
 
-
   *data = src;
   *length = left;
   return TRUE;
@@ -496,25 +512,140 @@ _normalize_time(LogStamp *stamp, struct tm *tm, glong assume_timezone)
   stamp->tv_sec = __get_normalized_time(*stamp, tm->tm_hour, unnormalized_hour);
 }
 
+/*
+ * Timestamp cache
+ *
+ * Consecutive messages of a sender usually carry the same timestamp, so
+ * the last parsed one is remembered (per thread) along with its raw
+ * characters.  If the next message starts with the same characters we
+ * can reuse the resulting LogStamp, without going through the scanner and
+ * mktime().
+ *
+ * The result of parsing depends on the shape of the timestamp (which may
+ * look beyond the timestamp itself, see linksys), on the current time
+ * (the year of BSD timestamps, the local timezone) and on the parse
+ * options, so these are part of the key.  A character that could have
+ * continued the timestamp (fractions, timezone) also prevents a match.
+ */
+
+#define TIMESTAMP_CACHE_MAX_LEN 48
+
+typedef struct _TimestampCache
+{
+  glong now;
+  guint parse_flags;
+  glong assume_timezone;
+  TimestampShape shape;
+  gint date_len;
+  guchar date[TIMESTAMP_CACHE_MAX_LEN];
+  LogStamp stamp;
+} TimestampCache;
+
+TLS_BLOCK_START
+{
+  TimestampCache timestamp_cache;
+}
+TLS_BLOCK_END;
+
+#define timestamp_cache  __tls_deref(timestamp_cache)
+
 static gboolean
-log_msg_parse_date(LogMessage *self, const guchar **data, gint *length, guint parse_flags, glong assume_timezone)
+_timestamp_cache_lookup(const GTimeVal *now, TimestampShape shape, guint parse_flags, glong assume_timezone,
+                        const guchar **data, gint *length, LogStamp *stamp)
 {
-  struct tm tm;
-  if (!log_msg_parse_date_unnormalized(self, data, length, parse_flags, &tm))
+  TimestampCache *cache = &timestamp_cache;
+  gint date_len = cache->date_len;
+
+  if (shape == TS_SHAPE_NONE ||
+      cache->shape != shape ||
+      cache->now != now->tv_sec ||
+      cache->parse_flags != parse_flags ||
+      cache->assume_timezone != assume_timezone ||
+      *length < date_len ||
+      memcmp(*data, cache->date, date_len) != 0)
+    return FALSE;
+
+  if (*length > date_len && strchr(".0123456789Z+-:", (*data)[date_len]))
     return FALSE;
 
+  *stamp = cache->stamp;
+  *data += date_len;
+  *length -= date_len;
+  return TRUE;
+}
+
+static void
+_timestamp_cache_store(const GTimeVal *now, TimestampShape shape, guint parse_flags, glong assume_timezone,
+                       const guchar *date, gint date_len, const LogStamp *stamp)
+{
+  TimestampCache *cache = &timestamp_cache;
+
+  if (date_len > TIMESTAMP_CACHE_MAX_LEN)
+    {
+      cache->shape = TS_SHAPE_NONE;
+      return;
+    }
+
+  cache->now = now->tv_sec;
+  cache->shape = shape;
+  cache->parse_flags = parse_flags;
+  cache->assume_timezone = assume_timezone;
+  cache->date_len = date_len;
+  memcpy(cache->date, date, date_len);
+  cache->stamp = *stamp;
+}
+
+static gboolean
+log_msg_parse_date(LogMessage *self, const guchar **data, gint *length, guint parse_flags, glong assume_timezone)
+{
+  const guchar *src = *data;
+  gint left = *length;
+  const guchar *date_start;
+  TimestampShape shape;
   LogStamp *stamp = &self->timestamps[LM_TS_STAMP];
+  GTimeVal now;
+  struct tm tm;
+
+  cached_g_current_time(&now);
+
+  if ((parse_flags & LP_SYSLOG_PROTOCOL) == 0)
+    log_msg_parse_cisco_sync_marker(self, &src, &left, parse_flags);
+
+  shape = __get_timestamp_shape(src, left, parse_flags);
+  if (shape == TS_SHAPE_NONE && (parse_flags & LP_SYSLOG_PROTOCOL))
+    {
+      if (left < 1 || src[0] != '-')
+        return FALSE;
+
+      /* NILVALUE */
+      *stamp = self->timestamps[LM_TS_RECVD];
+      src++;
+      left--;
+    }
+  else if (parse_flags & LP_NO_PARSE_DATE)
+    {
+      if (!log_msg_parse_date_unnormalized(self, &src, &left, shape, &now, &tm))
+        return FALSE;
+    }
+  else if (!_timestamp_cache_lookup(&now, shape, parse_flags, assume_timezone, &src, &left, stamp))
+    {
+      date_start = src;
+      if (!log_msg_parse_date_unnormalized(self, &src, &left, shape, &now, &tm))
+        return FALSE;
+
+      _normalize_time(stamp, &tm, assume_timezone);
+      _timestamp_cache_store(&now, shape, parse_flags, assume_timezone, date_start, src - date_start, stamp);
+    }
+
   if (parse_flags & LP_NO_PARSE_DATE)
     {
       *stamp = (const LogStamp) {};
       stamp->tv_sec = -1;
       stamp->zone_offset = -1;
     }
-  else
-    {
-      _normalize_time(stamp, &tm, assume_timezone);
-    }
 
+  *data = src;
+  *length = left;
   return TRUE;
 }
 
@@ -546,6 +677,19 @@ log_msg_parse_version(LogMessage *self, const guchar **data, gint *length)
   return TRUE;
 }
 
+/* skips characters until one of @c1, @c2 or @c3, or the end of the input */
+static inline void
+log_msg_parse_skip_to_any_of(const guchar **data, gint *length, gchar c1, gchar c2, gchar c3)
+{
+  const guchar *end;
+
+  end = (const guchar *) _memchr_any4((const gchar *) *data, *length, c1, c2, c3, c3);
+  if (!end)
+    end = *data + *length;
+  *length -= end - *data;
+  *data = end;
+}
+
 static void
 log_msg_parse_legacy_program_name(LogMessage *self, const guchar **data, gint *length, guint flags)
 {
@@ -556,20 +700,13 @@ log_msg_parse_legacy_program_name(LogMessage *self, const guchar **data, gint *l
   src = *data;
   left = *length;
   prog_start = src;
-  while (left && *src != ' ' && *src != '[' && *src != ':')
-    {
-      src++;
-      left--;
-    }
+  log_msg_parse_skip_to_any_of(&src, &left, ' ', '[', ':');
   log_msg_set_value(self, LM_V_PROGRAM, (gchar *) prog_start, src - prog_start);
   if (left > 0 && *src == '[')
     {
       const guchar *pid_start = src + 1;
-      while (left && *src != ' ' && *src != ']' && *src != ':')
-        {
-          src++;
-          left--;
-        }
+
+      log_msg_parse_skip_to_any_of(&src, &left, ' ', ']', ':');
       if (left)
         {
           log_msg_set_value(self, LM_V_PID, (gchar *) pid_start, src - pid_start);
@@ -646,17 +783,30 @@ log_msg_parse_hostname(LogMessage *self, const guchar **data, gint *length,
   oldsrc = src;
   oldleft = left;
 
-  while (left && *src != ' ' && *src != ':' && *src != '[' && dst < sizeof(hostname_buf) - 1)
+  if ((flags & LP_CHECK_HOSTNAME) == 0 && !bad_hostname)
+    {
+      /* the common case, no need to look at the characters one-by-one
+       * and there's no need for a NUL terminated copy either */
+      gint max_len = MIN(left, (gint) sizeof(hostname_buf) - 1);
+
+      left -= max_len;
+      log_msg_parse_skip_to_any_of(&src, &max_len, ' ', ':', '[');
+      left += max_len;
+    }
+  else
     {
-      if (G_UNLIKELY((flags & LP_CHECK_HOSTNAME) && (invalid_chars[((guint) *src) >> 8] & (1 << (((guint) *src) % 8)))))
+      while (left && *src != ' ' && *src != ':' && *src != '[' && dst < sizeof(hostname_buf) - 1)
         {
-          break;
+          if (G_UNLIKELY((flags & LP_CHECK_HOSTNAME) && (invalid_chars[((guint) *src) >> 8] & (1 << (((guint) *src) % 8)))))
+            {
+              break;
+            }
+          hostname_buf[dst++] = *src;
+          src++;
+          left--;
         }
-      hostname_buf[dst++] = *src;
-      src++;
-      left--;
+      hostname_buf[dst] = 0;
     }
-  hostname_buf[dst] = 0;
 
   if (left && *src == ' ' &&
       (!bad_hostname || regexec(bad_hostname, hostname_buf, 0, NULL, 0)))
@@ -1017,7 +1167,7 @@ log_msg_parse_legacy(const MsgFormatOptions *parse_options,
       self->timestamps[LM_TS_STAMP] = self->timestamps[LM_TS_RECVD];
     }
 
-  if (parse_options->flags & LP_SANITIZE_UTF8 && !g_utf8_validate((gchar *) src, left, NULL))
+  if (parse_options->flags & LP_SANITIZE_UTF8 && !is_valid_utf8((gchar *) src, left))
     {
       GString sanitized_message;
       gchar buf[left * 6 + 1];
@@ -1041,7 +1191,7 @@ log_msg_parse_legacy(const MsgFormatOptions *parse_options,
       /* we don't need revalidation if sanitize already said it was valid utf8 */
       if ((parse_options->flags & LP_VALIDATE_UTF8) &&
           ((parse_options->flags & LP_SANITIZE_UTF8) == 0) &&
-          g_utf8_validate((gchar *) src, left, NULL))
+          is_valid_utf8((gchar *) src, left))
         self->flags |= LF_UTF8;
     }
 
@@ -1144,7 +1294,7 @@ log_msg_parse_syslog_proto(const MsgFormatOptions *parse_options, const guchar *
       src += 3;
       left -= 3;
     }
-  else if ((parse_options->flags & LP_VALIDATE_UTF8) && g_utf8_validate((gchar *) src, left, NULL))
+  else if ((parse_options->flags & LP_VALIDATE_UTF8) && is_valid_utf8((gchar *) src, left))
     {
       self->flags |= LF_UTF8;
     }
@@ -80,13 +80,15 @@ l625DLckaYmOPTh0ECFKzhaPF+/LNmzD36ToOAeuNjfbUjiUVGfntr2mc4E8mUFyo+TskrkSfw==
 
 # import test modules
 import test_file_source
+import test_file_destination
 import test_filters
 import test_input_drivers
 import test_performance
 import test_sql
 import test_python
+import test_http
 
-tests = (test_input_drivers, test_sql, test_file_source, test_filters, test_performance, test_python)
+tests = (test_input_drivers, test_sql, test_file_source, test_file_destination, test_filters, test_performance, test_python, test_http)
 
 init_env()
 seed_rnd()
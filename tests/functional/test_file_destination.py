@@ -0,0 +1,61 @@
+#############################################################################
+# Copyright (c) 2007-2015 Balabit
+#
+# This program is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License version 2 as published
+# by the Free Software Foundation, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+#
+# As an additional exemption you are allowed to compile & link against the
+# OpenSSL libraries as published by the OpenSSL project. See the file
+# COPYING for details.
+#
+#############################################################################
+
+from globals import *
+from log import *
+from messagegen import *
+from messagecheck import *
+
+config = """@version: 3.8
+
+options { ts_format(iso); chain_hostnames(no); keep_hostname(yes); threaded(yes); };
+
+source s_int { internal(); };
+source s_unix { unix-stream("log-stream" flags(expect-hostname)); };
+
+destination d_facility { file("test-dest-$FACILITY.log" max-open-files(2)); };
+
+log { source(s_unix); destination(d_facility); };
+
+""" % locals()
+
+def test_file_destination_max_open_files():
+    # the files are opened asynchronously and with max-open-files(2) the
+    # least recently used ones are closed and reopened all the time, the
+    # messages of every session still have to arrive complete and in order
+    facilities = (
+      (7, 'kern'),
+      (15, 'user'),
+      (23, 'mail'),
+      (31, 'daemon'),
+    )
+    expected = {}
+
+    for round in range(0, 5):
+        for (pri, facility) in facilities:
+            s = SocketSender(AF_UNIX, 'log-stream', dgram=0, repeat=100)
+            expected.setdefault(facility, []).extend(s.sendMessages('file_destination', pri=pri))
+
+    for (pri, facility) in facilities:
+        if not check_file_expected('test-dest-%s' % facility, expected[facility]):
+            return False
+    return True
@@ -0,0 +1,105 @@
+#############################################################################
+# Copyright (c) 2016 Balabit
+#
+# This program is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License version 2 as published
+# by the Free Software Foundation, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+#
+# As an additional exemption you are allowed to compile & link against the
+# OpenSSL libraries as published by the OpenSSL project. See the file
+# COPYING for details.
+#
+#############################################################################
+
+from globals import *
+from log import *
+from messagegen import *
+from messagecheck import *
+from control import stop_syslogng
+import BaseHTTPServer
+import threading
+
+port_number_http = port_number + 4
+
+config = """@version: 3.8
+
+source s_int { internal(); };
+source s_tcp { tcp(port(%(port_number)d)); };
+
+destination d_http {
+    http(url("http://127.0.0.1:%(port_number_http)d/")
+         batch-lines(10)
+         batch-timeout(200)
+         delimiter("\\n")
+         body("${ISODATE} bzorp ${MSGHDR}${MSG}"));
+};
+
+log { source(s_tcp); destination(d_http); };
+
+""" % locals()
+
+class HTTPStandIn(BaseHTTPServer.BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+    requests = 0
+    connections = set()
+
+    def do_POST(self):
+        body = self.rfile.read(int(self.headers.getheader('Content-Length')))
+        HTTPStandIn.requests += 1
+        HTTPStandIn.connections.add(self.client_address)
+        with open('test-http.log', 'a') as f:
+            f.write(body + '\n')
+        self.send_response(200)
+        self.send_header('Content-Length', '0')
+        self.end_headers()
+
+    def log_message(self, format, *args):
+        pass
+
+def check_env():
+
+    if not has_module('curl'):
+        print 'HTTP module is not available, skipping HTTP test'
+        return False
+
+    print 'HTTP module found, proceeding to HTTP tests'
+    return True
+
+def start_http_server():
+    server = BaseHTTPServer.HTTPServer(('127.0.0.1', port_number_http), HTTPStandIn)
+    thread = threading.Thread(target=server.serve_forever)
+    thread.daemon = True
+    thread.start()
+    return server
+
+def test_http_batch():
+
+    messages = (
+        'http1',
+        'http2'
+    )
+    server = start_http_server()
+    s = SocketSender(AF_INET, ('localhost', port_number), dgram=0)
+
+    expected = []
+    for msg in messages:
+        expected.extend(s.sendMessages(msg, pri=7))
+    stopped = stop_syslogng()
+    server.shutdown()
+    if not stopped or not check_file_expected('test-http', expected, settle_time=2):
+        return False
+
+    print_user("HTTP requests: %d, connections: %d" % (HTTPStandIn.requests, len(HTTPStandIn.connections)))
+    if HTTPStandIn.requests >= sum([count for (msg, session, count) in expected]):
+        print_user("messages were not batched")
+        return False
+    return True
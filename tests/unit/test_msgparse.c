@@ -442,6 +442,81 @@ Test(msgparse, test_foreign_timezone)
   run_parameterized_test(params);
 }
 
+Test(msgparse, test_timestamp_cache)
+{
+  /* consecutive messages sharing the timestamp characters, only the
+   * exact same timestamps may yield the cached result */
+  struct msgparse_params params[] =
+  {
+    {
+      "<15>Jan  1 01:00:00 bzorp openvpn[2499]: PTHREAD support initialized", LP_EXPECT_HOSTNAME, NULL,
+      15,             // pri
+      _get_bsd_year_utc(0) + 3600, 0, 3600,        // timestamp (sec/usec/zone)
+      "bzorp",        // host
+      "openvpn",        // openvpn
+      "PTHREAD support initialized", // msg
+      NULL, "2499", NULL, ignore_sdata_pairs
+    },
+    {
+      "<15>Jan  1 01:00:00 other openvpn[2499]: PTHREAD support initialized", LP_EXPECT_HOSTNAME, NULL,
+      15,             // pri
+      _get_bsd_year_utc(0) + 3600, 0, 3600,        // timestamp (sec/usec/zone)
+      "other",        // host
+      "openvpn",        // openvpn
+      "PTHREAD support initialized", // msg
+      NULL, "2499", NULL, ignore_sdata_pairs
+    },
+    {
+      "<15>Jan  1 01:00:00.5 bzorp openvpn[2499]: PTHREAD support initialized", LP_EXPECT_HOSTNAME, NULL,
+      15,             // pri
+      _get_bsd_year_utc(0) + 3600, 500000, 3600,        // timestamp (sec/usec/zone)
+      "bzorp",        // host
+      "openvpn",        // openvpn
+      "PTHREAD support initialized", // msg
+      NULL, "2499", NULL, ignore_sdata_pairs
+    },
+    {
+      "<15>Jan  1 01:00:00 2016 bzorp openvpn[2499]: PTHREAD support initialized", LP_EXPECT_HOSTNAME, NULL,
+      15,             // pri
+      1451606400, 0, 3600,        // timestamp (sec/usec/zone)
+      "bzorp",        // host
+      "openvpn",        // openvpn
+      "PTHREAD support initialized", // msg
+      NULL, "2499", NULL, ignore_sdata_pairs
+    },
+    {
+      "<7>2006-10-29T01:00:00.156+01:00 bzorp openvpn[2499]: PTHREAD support initialized", LP_EXPECT_HOSTNAME, NULL,
+      7,             // pri
+      1162080000, 156000, 3600,    // timestamp (sec/usec/zone)
+      "bzorp",        // host
+      "openvpn",        // openvpn
+      "PTHREAD support initialized", // msg
+      NULL, "2499", NULL, ignore_sdata_pairs
+    },
+    {
+      "<7>2006-10-29T01:00:00.156+01:00 other openvpn[2499]: PTHREAD support initialized", LP_EXPECT_HOSTNAME, NULL,
+      7,             // pri
+      1162080000, 156000, 3600,    // timestamp (sec/usec/zone)
+      "other",        // host
+      "openvpn",        // openvpn
+      "PTHREAD support initialized", // msg
+      NULL, "2499", NULL, ignore_sdata_pairs
+    },
+    {
+      "<7>2006-10-29T01:00:00.156Z bzorp openvpn[2499]: PTHREAD support initialized", LP_EXPECT_HOSTNAME, NULL,
+      7,             // pri
+      1162083600, 156000, 0,    // timestamp (sec/usec/zone)
+      "bzorp",        // host
+      "openvpn",        // openvpn
+      "PTHREAD support initialized", // msg
+      NULL, "2499", NULL, ignore_sdata_pairs
+    },
+    {NULL}
+  };
+
+  run_parameterized_test(params);
+}
+
 Test(msgparse, test_hostname)
 {
   struct msgparse_params params[] =
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2002-2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "msg_parse_lib.h"
+#include "apphook.h"
+#include "logmsg/logmsg.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+#define ITERATIONS 1000000
+
+static void
+_parse_messages(const gchar *description, const gchar *messages[], guint flags)
+{
+  gint i;
+
+  parse_options.flags = flags;
+  start_stopwatch();
+  for (i = 0; i < ITERATIONS; i++)
+    {
+      const gchar *msg = messages[i % 4];
+
+      log_msg_unref(log_msg_new(msg, strlen(msg), NULL, &parse_options));
+    }
+  stop_stopwatch_and_display_result(ITERATIONS, "parsing %d %s messages took", ITERATIONS, description);
+}
+
+static void
+test_rfc3164_same_timestamp(void)
+{
+  const gchar *messages[] =
+  {
+    "<38>Feb 11 21:27:22 web01 sshd[28641]: Accepted publickey for deploy from 10.1.2.3 port 50122 ssh2",
+    "<86>Feb 11 21:27:22 web01 sshd[28641]: pam_unix(sshd:session): session opened for user deploy by (uid=0)",
+    "<30>Feb 11 21:27:22 web02 systemd[1]: Started Session 1322 of user deploy.",
+    "<78>Feb 11 21:27:22 web02 CRON[28654]: (root) CMD (command -v debian-sa1 > /dev/null && debian-sa1 1 1)",
+  };
+
+  _parse_messages("RFC3164, same timestamp", messages, LP_EXPECT_HOSTNAME);
+}
+
+static void
+test_rfc3164_different_timestamps(void)
+{
+  const gchar *messages[] =
+  {
+    "<38>Feb 11 21:27:22 web01 sshd[28641]: Accepted publickey for deploy from 10.1.2.3 port 50122 ssh2",
+    "<86>Feb 11 21:27:23 web01 sshd[28641]: pam_unix(sshd:session): session opened for user deploy by (uid=0)",
+    "<30>Feb 11 21:27:24 web02 systemd[1]: Started Session 1322 of user deploy.",
+    "<78>Feb 11 21:27:25 web02 CRON[28654]: (root) CMD (command -v debian-sa1 > /dev/null && debian-sa1 1 1)",
+  };
+
+  _parse_messages("RFC3164, different timestamps", messages, LP_EXPECT_HOSTNAME);
+}
+
+static void
+test_rfc5424_same_timestamp(void)
+{
+  const gchar *messages[] =
+  {
+    "<165>1 2016-02-11T21:27:22.003Z web01 evntslog 1234 ID47 [exampleSDID@32473 iut=\"3\" eventSource=\"Application\"] An application event log entry",
+    "<165>1 2016-02-11T21:27:22.003Z web01 evntslog 1234 ID47 - Another application event log entry",
+    "<165>1 2016-02-11T21:27:22.003Z web02 sshd 28641 - - Accepted publickey for deploy from 10.1.2.3 port 50122 ssh2",
+    "<165>1 2016-02-11T21:27:22.003Z web02 CRON 28654 - - (root) CMD (command -v debian-sa1 > /dev/null && debian-sa1 1 1)",
+  };
+
+  _parse_messages("RFC5424, same timestamp", messages, LP_SYSLOG_PROTOCOL);
+}
+
+int
+main(int argc, char *argv[])
+{
+  app_startup();
+  init_and_load_syslogformat_module();
+
+  test_rfc3164_same_timestamp();
+  test_rfc3164_different_timestamps();
+  test_rfc5424_same_timestamp();
+
+  deinit_syslogformat_module();
+  app_shutdown();
+  return 0;
+}